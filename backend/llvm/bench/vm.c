@@ -0,0 +1,137 @@
+#include "parser/parser.h"
+#include "sema/sema.h"
+#include "vm/vm.h"
+#include "llvm/jit.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define LF "\n"
+
+// Built-in workloads: a short script, where startup dominates, and a long
+// recursive one, where the code the engines run dominates.
+static const char *const workload_s[][2] =
+{
+    {
+        "script",
+        "bool is_leap_year(int year)" LF
+        "    return year % 4 == 0 && year % 100 != 0 || year % 400 == 0;" LF
+        "int main()" LF
+        "{" LF
+        "    if (is_leap_year(2024) && is_leap_year(1900) == false)" LF
+        "        return 1;" LF
+        "    return 0;" LF
+        "}" LF
+    },
+    {
+        "fib(27)",
+        "int fib(int n)" LF
+        "{" LF
+        "    if (n < 2)" LF
+        "        return n;" LF
+        "    return fib(n - 1) + fib(n - 2);" LF
+        "}" LF
+        "int main()" LF
+        "    return fib(27) % 256;" LF
+    },
+};
+
+static
+double now_ms(void)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * 1e3 + time.tv_nsec / 1e6;
+}
+
+// A workload is a file when it has a path, built-in code otherwise.
+static
+compilation_t frontend(const char *path, const char *code)
+{
+    source_t source = path != NULL ? source_load(path) : source_inline(code, "bench.iz");
+    if (source == NULL)
+    {
+        fprintf(stderr, "can't open %s\n", path);
+        return NULL;
+    }
+
+    unit_t unit = syntax_analysis(source);
+    return unit == NULL ? NULL : semantic_analysis(array_add(array_empty(), unit));
+}
+
+static
+void bench_vm(const char *name, const char *path, const char *code)
+{
+    compilation_t compilation = frontend(path, code);
+    if (compilation == NULL)
+        return;
+
+    double start = now_ms();
+    bytecode_t bytecode = bytecode_compile(compilation);
+    double compiled = now_ms();
+    if (bytecode == NULL)
+    {
+        compilation_free(compilation);
+        return;
+    }
+
+    int64_t result = 0;
+    int main = bytecode_find(bytecode, "main");
+    vm_status_t status = main < 0 ? VM_OK : vm_call(bytecode, main, NULL, &result);
+    double ran = now_ms();
+
+    printf("%-8s %-12s compile %9.3f ms, run %9.3f ms, total %9.3f ms, exit %d%s%s\n",
+        name, "vm", compiled - start, ran - compiled, ran - start, (int)result,
+        status == VM_OK ? "" : ", ", status == VM_OK ? "" : vm_status_string(status));
+
+    bytecode_free(bytecode);
+    compilation_free(compilation);
+}
+
+static
+void bench_jit(const char *name, const char *path, const char *code, const char *engine, jit_mode_t mode, backend_level_t level)
+{
+    compilation_t compilation = frontend(path, code);
+    if (compilation == NULL)
+        return;
+
+    jit_t jit = jit_compile(compilation, mode, level, NULL);
+    if (jit == NULL)
+        return;
+
+    int status = 0;
+    if (jit_run(jit, &status))
+    {
+        jit_stats_t stats = jit_stats(jit);
+        printf("%-8s %-12s compile %9.3f ms, run %9.3f ms, total %9.3f ms, exit %d\n",
+            name, engine, stats.compile / 1e6, stats.run / 1e6, (stats.compile + stats.run) / 1e6, status);
+    }
+
+    jit_free(jit);
+}
+
+static
+void bench(const char *name, const char *path, const char *code)
+{
+    bench_vm(name, path, code);
+    bench_jit(name, path, code, "jit -O0", JIT_EAGER, BACKEND_O0);
+    bench_jit(name, path, code, "jit -O2", JIT_EAGER, BACKEND_O2);
+    bench_jit(name, path, code, "jit lazy", JIT_LAZY, BACKEND_O2);
+    bench_jit(name, path, code, "jit tiered", JIT_TIERED, BACKEND_O2);
+}
+
+// Compares the bytecode interpreter with the JIT modes, from the checked
+// AST to main's return: time to start running, and time to finish. Files
+// given as arguments replace the built-in workloads.
+int main(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; i++)
+        bench(argv[i], argv[i], NULL);
+
+    if (argc == 1)
+        for (size_t i = 0; i < sizeof(workload_s) / sizeof(workload_s[0]); i++)
+            bench(workload_s[i][0], NULL, workload_s[i][1]);
+
+    return EXIT_SUCCESS;
+}
@@ -1,7 +1,14 @@
 #include "llvm/backend.h"
+#include "llvm/codegen.h"
+#include "ir/pass.h"
 #include "common/mem.h"
-#include "map.h"
+#include "common/thread_pool.h"
 
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
 #include <string.h>
 #include <llvm-c/Linker.h>
 #include <llvm-c/Analysis.h>
@@ -12,49 +19,72 @@
 #include <llvm-c/Transforms/PassBuilder.h>
 #include <llvm-c/ExecutionEngine.h>
 #include <llvm-c/IRReader.h>
+#include <llvm-c/BitReader.h>
 #include <llvm-c/BitWriter.h>
 #include <llvm-c/Support.h>
 
 #include <llvm-c/Linker.h>
 
+// Each unit gets its own context, module and target machine, so no LLVM
+// state is shared between units and a worker can take any one of them.
+typedef struct backend_unit_t backend_unit_t;
+struct backend_unit_t
+{
+    LLVMContextRef          context;
+    LLVMModuleRef           module;
+    LLVMTargetMachineRef    machine;
+};
+
 struct backend_t
 {
     compilation_t           compilation;
+    thread_pool_t           pool;
 
-    LLVMContextRef          context;
-    array_t(LLVMModuleRef)  module_s;
+    backend_unit_t         *unit_s;
+    size_t                  units;
 
-    LLVMTargetRef           target;
-    LLVMTargetMachineRef    machine;
+    backend_level_t         level;
+    backend_lto_t           lto;
 };
 
-typedef struct codegen_t* codegen_t;
-struct codegen_t
-{
-    LLVMModuleRef  module;
-    LLVMBuilderRef builder;
-    LLVMContextRef context;
-    map_t values;
+// Functions of at most this many instructions are imported by thin LTO,
+// the default instruction limit of LLVM's ThinLTO.
+#define IMPORT_LIMIT 100
 
-    LLVMValueRef function;
+static const char *const level_name[] =
+{
+    [BACKEND_O0] = "O0",
+    [BACKEND_O1] = "O1",
+    [BACKEND_O2] = "O2",
+    [BACKEND_O3] = "O3",
+    [BACKEND_OS] = "Os",
+    [BACKEND_OZ] = "Oz",
 };
 
-array_t(LLVMModuleRef) codegen_compilation(codegen_t codegen, compilation_t compilation);
+// Same mapping as clang: the size levels optimize code generation like -O2.
 
-static
-codegen_t codegen_new()
+static const LLVMCodeGenOptLevel level_codegen[] =
+{
+    [BACKEND_O0] = LLVMCodeGenLevelNone,
+    [BACKEND_O1] = LLVMCodeGenLevelLess,
+    [BACKEND_O2] = LLVMCodeGenLevelDefault,
+    [BACKEND_O3] = LLVMCodeGenLevelAggressive,
+    [BACKEND_OS] = LLVMCodeGenLevelDefault,
+    [BACKEND_OZ] = LLVMCodeGenLevelDefault,
+};
+
+codegen_t codegen_new(compilation_t compilation, LLVMContextRef context)
 {
     codegen_t codegen = mem_alloc(sizeof(struct codegen_t));
 
     codegen->module = NULL;
-    codegen->context = LLVMContextCreate();
+    codegen->context = context;
     codegen->builder = LLVMCreateBuilderInContext(codegen->context);
-    codegen->values = map_new();
+    codegen->values = map_new(compilation_declarations(compilation));
 
     return codegen;
 }
 
-static
 void codegen_free(codegen_t codegen)
 {
     LLVMDisposeBuilder(codegen->builder);
@@ -62,600 +92,794 @@ void codegen_free(codegen_t codegen)
     mem_free(codegen);
 }
 
-backend_t backend_new(compilation_t compilation, LLVMContextRef context, array_t(LLVMModuleRef) module_s)
-{
-    backend_t backend = mem_alloc(sizeof(struct backend_t));
-    backend->compilation = compilation;
-    backend->context = context;
-    backend->module_s = module_s;
-
-    return backend;
-}
-
 void backend_free(backend_t backend)
 {
+    for (size_t i = 0; i < backend->units; i++)
+    {
+        backend_unit_t *unit = &backend->unit_s[i];
+        LLVMDisposeTargetMachine(unit->machine);
+        LLVMDisposeModule(unit->module);
+        LLVMContextDispose(unit->context);
+    }
+
+    thread_pool_free(backend->pool);
     compilation_free(backend->compilation);
-    array_cleanup_free(backend->module_s, (release_t)LLVMDisposeModule);
-    LLVMContextDispose(backend->context);
+    mem_free(backend->unit_s);
     mem_free(backend);
 }
 
-void backend_dump(backend_t backend)
+compilation_t backend_compilation(backend_t backend)
 {
-    array_t(LLVMModuleRef) module_s = backend->module_s;
-    size_t size = array_size(module_s);
-
-    for (size_t i = 0 ; i < size; i++)
-        LLVMDumpModule(module_s[i]);
+    return backend->compilation;
 }
 
-void backend_emit_object(backend_t backend)
+char *backend_ir(backend_t backend, size_t index)
 {
-    array_t(LLVMModuleRef) module_s = backend->module_s;
-    size_t size = array_size(module_s);
+    char *ir = LLVMPrintModuleToString(backend->unit_s[index].module);
+    size_t size = strlen(ir) + 1;
 
-    for (size_t i = 0 ; i < size; i++)
-    {
-        char *error = NULL;
-        LLVMModuleRef module = module_s[i];
+    char *copy = mem_alloc(size);
+    memcpy(copy, ir, size);
+    LLVMDisposeMessage(ir);
 
-        source_t source = unit_source(compilation_unit_s(backend->compilation)[i]);
-        char *filename = source_object_name(source);
-        LLVMTargetMachineEmitToFile(backend->machine, module, filename, LLVMObjectFile, &error);
-
-        mem_free(filename);
-    }
+    return copy;
 }
 
-void backend_emit_assembly(backend_t backend)
+void backend_dump(backend_t backend)
 {
-    array_t(LLVMModuleRef) module_s = backend->module_s;
-    size_t size = array_size(module_s);
-
-    for (size_t i = 0 ; i < size; i++)
-    {
-        char *error = NULL;
-        LLVMModuleRef module = module_s[i];
-
-        source_t source = unit_source(compilation_unit_s(backend->compilation)[i]);
-        char *filename = source_assembly_name(source);
-        LLVMTargetMachineEmitToFile(backend->machine, module, filename, LLVMAssemblyFile, &error);
-
-        mem_free(filename);
-    }
+    for (size_t i = 0 ; i < backend->units; i++)
+        LLVMDumpModule(backend->unit_s[i].module);
 }
 
 bool backend_validate(backend_t backend)
 {
     bool failed = false;
-    array_t(LLVMModuleRef) module_s = backend->module_s;
-    size_t size = array_size(module_s);
-    for (size_t i = 0 ; i < size; i++)
+    for (size_t i = 0 ; i < backend->units; i++)
     {
         char *error = NULL;
-        failed = LLVMVerifyModule(module_s[i], LLVMPrintMessageAction, &error);
+        failed = LLVMVerifyModule(backend->unit_s[i].module, LLVMPrintMessageAction, &error);
         LLVMDisposeMessage(error);
     }
 
     return !failed;
 }
 
-void backend_optimize(backend_t backend)
+typedef struct optimize_t optimize_t;
+struct optimize_t
 {
-    LLVMPassBuilderOptionsRef pass_builder_options = LLVMCreatePassBuilderOptions();
+    backend_t       backend;
+    const char     *pipeline;
+    LLVMErrorRef   *error_s;
+};
 
-    array_t(LLVMModuleRef) module_s = backend->module_s;
-    size_t size = array_size(module_s);
-    for (size_t i = 0 ; i < size; i++)
-    {
-        LLVMRunPasses(module_s[i], "default<O3>", backend->machine, pass_builder_options);
-    }
+static
+void optimize_task(void *context, size_t index)
+{
+    optimize_t *optimize = context;
+    backend_unit_t *unit = &optimize->backend->unit_s[index];
 
+    LLVMPassBuilderOptionsRef pass_builder_options = LLVMCreatePassBuilderOptions();
+    optimize->error_s[index] = LLVMRunPasses(unit->module, optimize->pipeline, unit->machine, pass_builder_options);
     LLVMDisposePassBuilderOptions(pass_builder_options);
 }
 
-void backend_emit_llvm(backend_t backend)
-{
-    array_t(LLVMModuleRef) module_s = backend->module_s;
-    size_t size = array_size(module_s);
-
-    for (size_t i = 0 ; i < size; i++)
-    {
-        char *error = NULL;
-        LLVMModuleRef module = module_s[i];
-
-        source_t source = unit_source(compilation_unit_s(backend->compilation)[i]);
-        char *filename = source_llvm_name(source);
-        LLVMPrintModuleToFile(module, filename, &error);
+// iz has no loops and reaches LLVM in SSA form, already folded by its own
+// passes, so at O1 the inliner and a few cheap function passes are enough.
+static const char light_pipeline[] = "cgscc(inline,function(sroa,early-cse,instcombine,simplifycfg,tailcallelim))";
 
-        mem_free(filename);
-    }
+void level_pipeline(backend_level_t level, const char *stage, char *pipeline, size_t size)
+{
+    if (level == BACKEND_O1 && strcmp(stage, "default") == 0)
+        snprintf(pipeline, size, "%s", light_pipeline);
+    else
+        snprintf(pipeline, size, "%s<%s>", stage, level_name[level]);
 }
 
-void backend_setup(backend_t backend)
+static
+bool run_pipeline(backend_t backend, const char *pipeline)
 {
-    LLVMInitializeNativeTarget();
-    LLVMInitializeAllAsmParsers();
-    LLVMInitializeAllAsmPrinters();
-
-    char *error = NULL;
-    LLVMTargetRef target = NULL;
-    LLVMGetTargetFromTriple(LLVMGetDefaultTargetTriple(), &target, &error);
-
-    LLVMTargetMachineRef machine = LLVMCreateTargetMachine
-    (
-        target,
-        LLVMGetDefaultTargetTriple(),
-        LLVMGetHostCPUName(),
-        LLVMGetHostCPUFeatures(),
-        LLVMCodeGenLevelAggressive,
-        LLVMRelocPIC,
-        LLVMCodeModelLarge
-    );
+    LLVMErrorRef error_s[backend->units + 1];
+    optimize_t optimize = { backend, pipeline, error_s };
+    thread_pool_run(backend->pool, backend->units, optimize_task, &optimize);
 
-    backend->target = target;
-    backend->machine = machine;
+    // every module fails the same way on a bad pipeline; report it once
+    bool succeeded = true;
+    for (size_t i = 0; i < backend->units; i++)
+    {
+        if (error_s[i] == NULL)
+            continue;
 
-    array_t(LLVMModuleRef) module_s = backend->module_s;
-    size_t size = array_size(module_s);
+        char *message = LLVMGetErrorMessage(error_s[i]);
+        if (succeeded)
+            fprintf(stderr, "invalid pass pipeline '%s': %s\n", pipeline, message);
+        LLVMDisposeErrorMessage(message);
+        succeeded = false;
+    }
 
-    for (size_t i = 0 ; i < size; i++)
-        LLVMSetTarget(module_s[i], LLVMGetDefaultTargetTriple());
+    return succeeded;
 }
 
-backend_t backend_codegen(compilation_t compilation)
+bool backend_optimize(backend_t backend, const char *pipeline)
 {
-    codegen_t codegen = codegen_new();
-    array_t(LLVMModuleRef) module_s = codegen_compilation(codegen, compilation);
-
-    backend_t backend = backend_new(compilation, codegen->context, module_s);
-
-    codegen_free(codegen);
+    static const char *const stage[] =
+    {
+        [BACKEND_LTO_NONE] = "default",
+        [BACKEND_LTO_FULL] = "lto",
+        [BACKEND_LTO_THIN] = "thinlto",
+    };
 
-    backend_setup(backend);
+    char level[128];
+    if (pipeline == NULL)
+    {
+        level_pipeline(backend->level, stage[backend->lto], level, sizeof(level));
+        pipeline = level;
+    }
 
-    return backend;
+    return run_pipeline(backend, pipeline);
 }
 
-LLVMTypeRef codegen_type(codegen_t codegen, type_t type);
-
-LLVMTypeRef codegen_callable(codegen_t codegen, callable_t callable)
+static
+LLVMMemoryBufferRef backend_render(backend_t backend, size_t unit, backend_artifact_t artifact)
 {
-    type_t return_type = callable_return_type(callable);
-    LLVMTypeRef llvm_return_type = codegen_type(codegen, return_type);
-
-    array_t(type_t) param_s = callable_param_s(callable);
-    size_t size = array_size(param_s);
+    LLVMModuleRef module = backend->unit_s[unit].module;
+    LLVMMemoryBufferRef buffer = NULL;
+    char *error = NULL;
 
-    LLVMTypeRef llvm_param_s[size];
-    for (size_t i = 0; i < size; i++)
-        llvm_param_s[i] = codegen_type(codegen, param_s[i]);
+    switch (artifact) // LCOV_EXCL_LINE
+    {
+        case BACKEND_OBJECT:
+        case BACKEND_ASSEMBLY:
+        {
+            LLVMCodeGenFileType type = artifact == BACKEND_OBJECT ? LLVMObjectFile : LLVMAssemblyFile;
+            if (LLVMTargetMachineEmitToMemoryBuffer(backend->unit_s[unit].machine, module, type, &error, &buffer))
+            {
+                // LCOV_EXCL_START
+                source_t source = unit_source(compilation_unit_s(backend->compilation)[unit]);
+                fprintf(stderr, "%s: %s\n", source_path(source), error);
+                LLVMDisposeMessage(error);
+                return NULL;
+                // LCOV_EXCL_STOP
+            }
+            break;
+        }
+        case BACKEND_LLVM:
+        {
+            char *ir = LLVMPrintModuleToString(module);
+            buffer = LLVMCreateMemoryBufferWithMemoryRangeCopy(ir, strlen(ir), "");
+            LLVMDisposeMessage(ir);
+            break;
+        }
+        case BACKEND_BITCODE:
+            buffer = LLVMWriteBitcodeToMemoryBuffer(module);
+            break;
+        default:
+            break;                                                  // LCOV_EXCL_LINE
+    }
 
-    LLVMTypeRef llvm_callable = LLVMFunctionType(llvm_return_type, llvm_param_s, size, 0);
-    return llvm_callable;
+    return buffer;
 }
 
-LLVMTypeRef codegen_type(codegen_t codegen, type_t type)
+static
+bool write_buffer(const char *path, LLVMMemoryBufferRef buffer)
 {
-    switch (type_kind(type)) // LCOV_EXCL_LINE
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
     {
-        case TYPE_BOOL:
-            return LLVMInt1TypeInContext(codegen->context);
-        case TYPE_INT:
-            return LLVMInt32TypeInContext(codegen->context);
-        case TYPE_CHAR:
-            return LLVMInt8TypeInContext(codegen->context);
-        case TYPE_VOID:
-            return LLVMVoidTypeInContext(codegen->context);
-        case TYPE_CALLABLE:
-            return codegen_callable(codegen, CALLABLE(type));
-        case TYPE_POINTER:
-            return LLVMPointerTypeInContext(codegen->context, 0);
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return false;
     }
-    return NULL; // LCOV_EXCL_LINE
-}
 
+    size_t size = LLVMGetBufferSize(buffer);
+    bool written = fwrite(LLVMGetBufferStart(buffer), 1, size, file) == size;
+    written = fclose(file) == 0 && written;
+    if (!written)
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));        // LCOV_EXCL_LINE
 
-LLVMValueRef codegen_expression(codegen_t codegen, expression_t expression);
+    return written;
+}
 
-LLVMValueRef codegen_constant(codegen_t codegen, constant_t constant)
+// Rendering runs one task per unit, since a module and its machine must
+// stay on one thread; writing runs one task per output.
+typedef struct emit_t emit_t;
+struct emit_t
 {
-    switch (constant_kind(constant)) // LCOV_EXCL_LINE
+    backend_t                 backend;
+    const backend_output_t   *output_s;
+    size_t                    size;
+    LLVMMemoryBufferRef     (*rendered_s)[BACKEND_ARTIFACTS];
+    atomic_bool               failed;
+};
+
+static
+void render_task(void *context, size_t index)
+{
+    emit_t *emit = context;
+
+    for (size_t i = 0; i < emit->size; i++)
     {
-        case CONSTANT_BOOL:
-        {
-            bool _bool = constant_bool(constant);
-            return LLVMConstInt(LLVMInt1TypeInContext(codegen->context), _bool, 0);
-        }
-        case CONSTANT_U64:
-        {
-            u_int64_t u64 = constant_u64(constant);
-            return LLVMConstInt(LLVMInt32TypeInContext(codegen->context), u64, 0);
-        }
-        case CONSTANT_CHAR:
-        {
-            char _char = constant_char(constant);
-            return LLVMConstInt(LLVMInt8TypeInContext(codegen->context), (unsigned char)_char, 0);
-        }
+        const backend_output_t *output = &emit->output_s[i];
+        LLVMMemoryBufferRef *rendered = &emit->rendered_s[index][output->artifact];
+        if (output->unit == index && *rendered == NULL)
+            *rendered = backend_render(emit->backend, index, output->artifact);
     }
-    return NULL; // LCOV_EXCL_LINE
 }
 
-LLVMValueRef codegen_identifier(codegen_t codegen, identifier_t identifier)
+static
+void write_task(void *context, size_t index)
 {
-    declaration_t declaration = identifier_declaration(identifier);
+    emit_t *emit = context;
+    const backend_output_t *output = &emit->output_s[index];
 
-    if (declaration_kind(declaration) == DECLARATION_FUNCTION)
-        return map_get(codegen->values, declaration);
+    LLVMMemoryBufferRef buffer = emit->rendered_s[output->unit][output->artifact];
+    if (buffer == NULL || !write_buffer(output->path, buffer))
+        atomic_store(&emit->failed, true);
+}
 
-    return map_get(codegen->values, declaration);
+bool backend_emit(backend_t backend, const backend_output_t *output_s, size_t size)
+{
+    if (size == 0)
+        return true;
 
-    //LLVMValueRef alloca = map_get(codegen->values, declaration);
-    //LLVMTypeRef type = codegen_type(codegen, declaration_type(declaration));
+    for (size_t i = 0; i < size; i++)
+        assert(output_s[i].unit < backend->units && output_s[i].artifact < BACKEND_ARTIFACTS);
 
-    //return LLVMBuildLoad2(codegen->builder, type, alloca, "");
-}
+    // one buffer per module and artifact, shared by outputs asking for the same
+    LLVMMemoryBufferRef rendered_s[backend->units][BACKEND_ARTIFACTS];
+    memset(rendered_s, 0, sizeof(rendered_s));
 
-// Returns the address an lvalue expression designates: for an identifier,
-// its alloca; for a dereferenced pointer (*p), the (already loaded) pointer
-// value itself. Used both as an assignment target and for the & operator.
-LLVMValueRef codegen_lvalue_address(codegen_t codegen, expression_t lvalue)
-{
-    if (expression_kind(lvalue) == EXPRESSION_IDENTIFIER)
-        return map_get(codegen->values, identifier_declaration(IDENTIFIER(lvalue)));
+    emit_t emit = { .backend = backend, .output_s = output_s, .size = size, .rendered_s = rendered_s };
+    atomic_init(&emit.failed, false);
 
-    return codegen_expression(codegen, unary_expression(UNARY(lvalue)));
+    thread_pool_run(backend->pool, backend->units, render_task, &emit);
+    thread_pool_run(backend->pool, size, write_task, &emit);
+
+    for (size_t i = 0; i < backend->units; i++)
+        for (size_t j = 0; j < BACKEND_ARTIFACTS; j++)
+            if (rendered_s[i][j] != NULL)
+                LLVMDisposeMemoryBuffer(rendered_s[i][j]);
+
+    return !atomic_load(&emit.failed);
 }
 
-LLVMValueRef codegen_unary(codegen_t codegen, unary_t unary)
+// Targets are registered and the host described once per process, however
+// many compilations it runs; every target machine is created from these.
+static struct
+{
+    pthread_once_t  once;
+    LLVMTargetRef   target;
+    char           *triple;
+    char           *cpu;
+    char           *features;
+} host = { .once = PTHREAD_ONCE_INIT };
+
+static
+void host_setup(void)
 {
-    switch (unary_op(unary)) // LCOV_EXCL_LINE
+    LLVMInitializeNativeTarget();
+    LLVMInitializeAllAsmParsers();
+    LLVMInitializeAllAsmPrinters();
+
+    host.triple = LLVMGetDefaultTargetTriple();
+    host.cpu = LLVMGetHostCPUName();
+    host.features = LLVMGetHostCPUFeatures();
+
+    char *error = NULL;
+    if (LLVMGetTargetFromTriple(host.triple, &host.target, &error))
     {
-        case UNARY_ADDRESS_OF:
-            return codegen_lvalue_address(codegen, unary_expression(unary));
-        case UNARY_DEREF:
-            return codegen_expression(codegen, unary_expression(unary));
+        fprintf(stderr, "%s: %s\n", host.triple, error);      // LCOV_EXCL_LINE
+        abort();                                                // LCOV_EXCL_LINE
     }
-    return NULL; // LCOV_EXCL_LINE
 }
 
-LLVMValueRef codegen_binary(codegen_t codegen, binary_t binary)
+LLVMTargetMachineRef host_machine(backend_level_t level)
 {
-    LLVMValueRef lhs = codegen_expression(codegen, binary_lhs(binary));
-    LLVMValueRef rhs = codegen_expression(codegen, binary_rhs(binary));
+    pthread_once(&host.once, host_setup);
+    return LLVMCreateTargetMachine
+    (
+        host.target,
+        host.triple,
+        host.cpu,
+        host.features,
+        level_codegen[level],
+        LLVMRelocPIC,
+        LLVMCodeModelLarge
+    );
+}
 
-    switch (binary_op(binary)) // LCOV_EXCL_LINE
-    {
-        case BINARY_LT:
-            return LLVMBuildICmp(codegen->builder, LLVMIntSLT, lhs, rhs, "");
-        case BINARY_LE:
-            return LLVMBuildICmp(codegen->builder, LLVMIntSLE, lhs, rhs, "");
-        case BINARY_GT:
-            return LLVMBuildICmp(codegen->builder, LLVMIntSGT, lhs, rhs, "");
-        case BINARY_GE:
-            return LLVMBuildICmp(codegen->builder, LLVMIntSGE, lhs, rhs, "");
-        case BINARY_EQ:
-            return LLVMBuildICmp(codegen->builder, LLVMIntEQ, lhs, rhs, "");
-        case BINARY_NE:
-            return LLVMBuildICmp(codegen->builder, LLVMIntNE, lhs, rhs, "");
-        case BINARY_ADD:
-            return LLVMBuildAdd(codegen->builder, lhs, rhs, "");
-        case BINARY_SUB:
-            return LLVMBuildSub(codegen->builder, lhs, rhs, "");
-        case BINARY_MUL:
-            return LLVMBuildMul(codegen->builder, lhs, rhs, "");
-        case BINARY_DIV:
-            return LLVMBuildSDiv(codegen->builder, lhs, rhs, "");
-        case BINARY_REM:
-            return LLVMBuildSRem(codegen->builder, lhs, rhs, "");
-    }
-    return NULL; // LCOV_EXCL_LINE
+const char* host_triple(void)
+{
+    pthread_once(&host.once, host_setup);
+    return host.triple;
 }
 
-LLVMValueRef codegen_call(codegen_t codegen, call_t call)
+static
+void codegen_task(void *context, size_t index)
 {
-    expression_t callee = call_callee(call);
-    type_t callee_ty = expression_type(callee);
-    LLVMTypeRef llvm_call_ty = codegen_type(codegen, callee_ty);
+    backend_t backend = context;
+    backend_unit_t *unit = &backend->unit_s[index];
 
-    LLVMValueRef llvm_callee = codegen_expression(codegen, callee);
-    array_t(expression_t) argument_s = call_argument_s(call);
-    size_t size = array_size(argument_s);
+    unit->context = LLVMContextCreate();
+    unit->machine = host_machine(backend->level);
 
-    LLVMValueRef llvm_argument_s[size];
-    for (size_t i = 0; i < size; i++)
-        llvm_argument_s[i] = codegen_expression(codegen, argument_s[i]);
+    codegen_t codegen = codegen_new(backend->compilation, unit->context);
+    unit->module = codegen_unit(codegen, compilation_unit_s(backend->compilation)[index]);
+    codegen_free(codegen);
 
-    return LLVMBuildCall2(codegen->builder, llvm_call_ty, llvm_callee, llvm_argument_s, size, "");
+    LLVMSetTarget(unit->module, host.triple);
 }
 
-LLVMValueRef codegen_assignment(codegen_t codegen, assignment_t assignment)
+size_t backend_modules(backend_t backend)
 {
-    expression_t lvalue = assignment_lvalue(assignment);
-    LLVMValueRef llvm_lvalue = codegen_lvalue_address(codegen, lvalue);
-
-    expression_t rvalue = assignment_rvalue(assignment);
-    LLVMValueRef llvm_rvalue = codegen_expression(codegen, rvalue);
+    return backend->units;
+}
 
-    LLVMBuildStore(codegen->builder, llvm_rvalue, llvm_lvalue);
+// A defined function as the thin LTO summary records it, by symbol id.
+typedef struct summary_t summary_t;
+struct summary_t
+{
+    uint32_t module;            // defining module + 1, 0 when undefined
+    uint32_t instructions;
+};
 
-    LLVMTypeRef type = codegen_type(codegen, expression_type(lvalue));
+typedef struct lto_t lto_t;
+struct lto_t
+{
+    backend_t             backend;
+    LLVMMemoryBufferRef  *bitcode_s;
+    summary_t            *summary_s;
+    atomic_bool           failed;
+};
 
-    return LLVMBuildLoad2(codegen->builder, type, llvm_lvalue, "");
+static
+void bitcode_task(void *context, size_t index)
+{
+    lto_t *lto = context;
+    lto->bitcode_s[index] = backend_render(lto->backend, index, BACKEND_BITCODE);
 }
 
-LLVMValueRef codegen_implicit_cast(codegen_t codegen, implicit_cast_t implicit_cast)
+static
+symbol_t function_symbol(LLVMValueRef function)
 {
-    type_t type = implicit_cast_type(implicit_cast);
-    LLVMTypeRef type_llvm = codegen_type(codegen, type);
-    LLVMValueRef expression_llvm = codegen_expression(codegen, implicit_cast_expression(implicit_cast));
+    size_t size = 0;
+    const char *name = LLVMGetValueName2(function, &size);
+    return symbol_find(span_ctor(size, name));
+}
 
-    switch (implicit_cast_kind(implicit_cast)) // LCOV_EXCL_BR_LINE (only one enum value exists)
+static
+bool parse_bitcode(LLVMContextRef context, LLVMMemoryBufferRef bitcode, LLVMModuleRef *module)
+{
+    if (LLVMParseBitcodeInContext2(context, bitcode, module))
     {
-    case IMPLICIT_CAST_LVALUE_TO_RVALUE:
-        return LLVMBuildLoad2(codegen->builder, type_llvm, expression_llvm, "");
-        break;
-    default: // LCOV_EXCL_LINE
-        return NULL; // LCOV_EXCL_LINE
+        fprintf(stderr, "lto: cannot read back a module's bitcode\n");   // LCOV_EXCL_LINE
+        return false;                                                   // LCOV_EXCL_LINE
     }
-    return NULL; // LCOV_EXCL_LINE
+
+    return true;
 }
 
-LLVMValueRef codegen_conditional(codegen_t codegen, conditional_t conditional)
+static
+bool is_exported(LLVMValueRef function, const char *const *export_s, size_t exports)
 {
-    LLVMValueRef lhs = codegen_expression(codegen, conditional_lhs(conditional));
-    LLVMValueRef rhs = codegen_expression(codegen, conditional_rhs(conditional));
+    size_t size = 0;
+    const char *name = LLVMGetValueName2(function, &size);
+    for (size_t i = 0; i < exports; i++)
+        if (strlen(export_s[i]) == size && memcmp(export_s[i], name, size) == 0)
+            return true;
 
-    LLVMBasicBlockRef rhsBlock = LLVMAppendBasicBlock(codegen->function, "cond.rhs");
-    LLVMBasicBlockRef mergeBlock = LLVMAppendBasicBlock(codegen->function, "cond.merge");
-    LLVMValueRef temp = LLVMBuildAlloca(codegen->builder, LLVMTypeOf(lhs), "");
+    return false;
+}
 
-    LLVMBuildStore(codegen->builder, lhs, temp);
+// Modules live in contexts of their own, so they meet in a fresh context
+// through their bitcode before they can be linked.
+static
+bool lto_link(backend_t backend, lto_t *lto, const char *const *export_s, size_t exports)
+{
+    LLVMContextRef context = LLVMContextCreate();
+    LLVMModuleRef linked = NULL;
 
-    if (conditional_op(conditional) == CONDITIONAL_AND)
-        LLVMBuildCondBr(codegen->builder, lhs, rhsBlock, mergeBlock);
-    if (conditional_op(conditional) == CONDITIONAL_OR)
-        LLVMBuildCondBr(codegen->builder, lhs, mergeBlock, rhsBlock);
+    bool succeeded = parse_bitcode(context, lto->bitcode_s[0], &linked);
+    for (size_t i = 1; i < backend->units && succeeded; i++)
+    {
+        LLVMModuleRef module = NULL;
+        succeeded = parse_bitcode(context, lto->bitcode_s[i], &module) && !LLVMLinkModules2(linked, module);
+    }
 
-    LLVMPositionBuilderAtEnd(codegen->builder, rhsBlock);
-    LLVMBuildStore(codegen->builder, rhs, temp);
-    LLVMBuildBr(codegen->builder, mergeBlock);
+    if (!succeeded)
+    {
+        // LCOV_EXCL_START
+        if (linked != NULL)
+            LLVMDisposeModule(linked);
+        LLVMContextDispose(context);
+        return false;
+        // LCOV_EXCL_STOP
+    }
 
-    LLVMPositionBuilderAtEnd(codegen->builder, mergeBlock);
-    return LLVMBuildLoad2(codegen->builder, LLVMInt1TypeInContext(codegen->context), temp, "");
-}
+    for (LLVMValueRef function = LLVMGetFirstFunction(linked); function != NULL; function = LLVMGetNextFunction(function))
+        if (!LLVMIsDeclaration(function) && !is_exported(function, export_s, exports))
+            LLVMSetLinkage(function, LLVMInternalLinkage);
 
-LLVMValueRef codegen_expression(codegen_t codegen, expression_t expression)
-{
-    switch (expression_kind(expression)) // LCOV_EXCL_LINE
+    for (size_t i = 0; i < backend->units; i++)
     {
-        case EXPRESSION_CONSTANT:
-            return codegen_constant(codegen, CONSTANT(expression));
-        case EXPRESSION_IDENTIFIER:
-            return codegen_identifier(codegen, IDENTIFIER(expression));
-        case EXPRESSION_BINARY:
-            return codegen_binary(codegen, BINARY(expression));
-        case EXPRESSION_CALL:
-            return codegen_call(codegen, CALL(expression));
-        case EXPRESSION_ASSIGNMENT:
-            return codegen_assignment(codegen, ASSIGNMENT(expression));
-        case EXPRESSION_IMPLICIT_CAST:
-            return codegen_implicit_cast(codegen, IMPLICIT_CAST(expression));
-        case EXPRESSION_CONDITIONAL:
-            return codegen_conditional(codegen, CONDITIONAL(expression));
-        case EXPRESSION_UNARY:
-            return codegen_unary(codegen, UNARY(expression));
+        backend_unit_t *unit = &backend->unit_s[i];
+        LLVMDisposeTargetMachine(unit->machine);
+        LLVMDisposeModule(unit->module);
+        LLVMContextDispose(unit->context);
     }
-    return NULL; // LCOV_EXCL_LINE
-}
 
+    backend->unit_s[0] = (backend_unit_t){ context, linked, host_machine(backend->level) };
+    backend->units = 1;
 
-void codegen_statement(codegen_t codegen, statement_t statement);
+    return true;
+}
 
 static
-void codegen_block(codegen_t codegen, block_t block)
+void summary_task(void *context, size_t index)
 {
-    array_t(statement_t) statement_s = block_statement_s(block);
-    size_t size = array_size(statement_s);
-    for (int i = 0; i < size; i++)
+    lto_t *lto = context;
+    LLVMModuleRef module = lto->backend->unit_s[index].module;
+
+    // every function is defined by exactly one module, so writes never overlap
+    for (LLVMValueRef function = LLVMGetFirstFunction(module); function != NULL; function = LLVMGetNextFunction(function))
     {
-        statement_t statement = statement_s[i];
-        codegen_statement(codegen, statement);
+        symbol_t symbol = function_symbol(function);
+        if (LLVMIsDeclaration(function) || symbol == SYMBOL_NONE)
+            continue;
+
+        uint32_t instructions = 0;
+        for (LLVMBasicBlockRef block = LLVMGetFirstBasicBlock(function); block != NULL; block = LLVMGetNextBasicBlock(block))
+            for (LLVMValueRef instruction = LLVMGetFirstInstruction(block); instruction != NULL; instruction = LLVMGetNextInstruction(instruction))
+                instructions++;
+
+        lto->summary_s[symbol] = (summary_t){ index + 1, instructions };
     }
 }
 
+// Turns a definition the importing module did not ask for back into a
+// declaration, or drops it when nothing uses it.
 static
-void codegen_return(codegen_t codegen, return_t ret)
+void strip_function(LLVMModuleRef module, LLVMValueRef function)
 {
-    LLVMValueRef llvm_expression = codegen_expression(codegen, return_expression(ret));
-    LLVMBuildRet(codegen->builder, llvm_expression);
+    if (LLVMGetFirstUse(function) != NULL)
+    {
+        size_t size = 0;
+        const char *name = LLVMGetValueName2(function, &size);
+        char copy[size + 1];
+        memcpy(copy, name, size);
+
+        LLVMValueRef declaration = LLVMAddFunction(module, "", LLVMGlobalGetValueType(function));
+        LLVMReplaceAllUsesWith(function, declaration);
+        LLVMDeleteFunction(function);
+        LLVMSetValueName2(declaration, copy, size);
+    }
+    else
+        LLVMDeleteFunction(function);
 }
 
 static
-void codegen_if_only(codegen_t codegen, if_t ifelse)
+void import_task(void *context, size_t index)
 {
-    LLVMValueRef llvm_condition = codegen_expression(codegen, if_condition(ifelse));
+    lto_t *lto = context;
+    backend_t backend = lto->backend;
+    backend_unit_t *unit = &backend->unit_s[index];
 
-    LLVMBasicBlockRef then_block = LLVMAppendBasicBlock(codegen->function, "if.then");
-    LLVMBasicBlockRef join_block = LLVMAppendBasicBlock(codegen->function, "if.join");
+    // small functions of other modules this one calls, by defining module
+    array_t(symbol_t) import_s = array_empty();
+    bool from_s[backend->units];
+    memset(from_s, 0, sizeof(from_s));
 
-    LLVMBuildCondBr(codegen->builder, llvm_condition, then_block, join_block);
+    for (LLVMValueRef function = LLVMGetFirstFunction(unit->module); function != NULL; function = LLVMGetNextFunction(function))
+    {
+        symbol_t symbol = function_symbol(function);
+        if (!LLVMIsDeclaration(function) || LLVMGetFirstUse(function) == NULL || symbol == SYMBOL_NONE)
+            continue;
 
-    LLVMPositionBuilderAtEnd(codegen->builder, then_block);
-    codegen_statement(codegen, if_then_branch(ifelse));
+        summary_t summary = lto->summary_s[symbol];
+        if (summary.module == 0 || summary.instructions > IMPORT_LIMIT)
+            continue;
 
-    LLVMPositionBuilderAtEnd(codegen->builder, join_block);
+        import_s = array_add(import_s, symbol);
+        from_s[summary.module - 1] = true;
+    }
+
+    for (size_t source = 0; source < backend->units; source++)
+    {
+        LLVMModuleRef copy = NULL;
+        if (!from_s[source] || !parse_bitcode(unit->context, lto->bitcode_s[source], &copy))
+            continue;
+
+        LLVMValueRef next = NULL;
+        for (LLVMValueRef function = LLVMGetFirstFunction(copy); function != NULL; function = next)
+        {
+            next = LLVMGetNextFunction(function);
+            if (LLVMIsDeclaration(function))
+                continue;
+
+            bool imported = false;
+            symbol_t symbol = function_symbol(function);
+            for (size_t i = 0; i < array_size(import_s) && !imported; i++)
+                imported = import_s[i] == symbol;
+
+            if (imported)
+                LLVMSetLinkage(function, LLVMAvailableExternallyLinkage);
+            else
+                strip_function(copy, function);
+        }
+
+        if (LLVMLinkModules2(unit->module, copy))
+            atomic_store(&lto->failed, true);                       // LCOV_EXCL_LINE
+    }
+
+    array_free(import_s);
 }
 
-static
-void codegen_if_else(codegen_t codegen, if_t ifelse)
+bool backend_lto(backend_t backend, backend_lto_t mode, const char *const *export_s, size_t exports)
 {
-    LLVMValueRef llvm_condition = codegen_expression(codegen, if_condition(ifelse));
+    assert(backend->lto == BACKEND_LTO_NONE && "backend_lto runs once");
+    if (mode == BACKEND_LTO_NONE || backend->units == 0)
+        return true;
 
-    bool then_terminator = statement_all_path_return_value(if_then_branch(ifelse));
-    bool else_terminator = statement_all_path_return_value(if_else_branch(ifelse));
-    bool both_terminator = then_terminator && else_terminator;
+    char pipeline[32];
+    level_pipeline(backend->level, mode == BACKEND_LTO_FULL ? "lto-pre-link" : "thinlto-pre-link", pipeline, sizeof(pipeline));
+    if (!run_pipeline(backend, pipeline))
+        return false;                                               // LCOV_EXCL_LINE
 
-    LLVMBasicBlockRef then_block = LLVMAppendBasicBlock(codegen->function, "if.then");
-    LLVMBasicBlockRef else_block = LLVMAppendBasicBlock(codegen->function, "if.else");
+    backend->lto = mode;
 
-    LLVMBasicBlockRef join_block = both_terminator ? NULL : LLVMAppendBasicBlock(codegen->function, "if.join");
+    size_t units = backend->units;
+    LLVMMemoryBufferRef bitcode_s[units];
+    lto_t lto = { .backend = backend, .bitcode_s = bitcode_s };
+    atomic_init(&lto.failed, false);
+    thread_pool_run(backend->pool, units, bitcode_task, &lto);
 
-    LLVMBuildCondBr(codegen->builder, llvm_condition, then_block, else_block);
-
-    LLVMPositionBuilderAtEnd(codegen->builder, then_block);
-    codegen_statement(codegen, if_then_branch(ifelse));
+    bool succeeded;
+    if (mode == BACKEND_LTO_FULL)
+        succeeded = lto_link(backend, &lto, export_s, exports);
+    else
+    {
+        size_t symbols = symbol_count() + 1;
+        lto.summary_s = mem_alloc(sizeof(summary_t) * symbols);
+        memset(lto.summary_s, 0, sizeof(summary_t) * symbols);
 
-    if (!then_terminator)
-        LLVMBuildBr(codegen->builder, join_block);
+        thread_pool_run(backend->pool, units, summary_task, &lto);
+        thread_pool_run(backend->pool, units, import_task, &lto);
 
-    LLVMPositionBuilderAtEnd(codegen->builder, else_block);
-    codegen_statement(codegen, if_else_branch(ifelse));
+        mem_free(lto.summary_s);
+        succeeded = !atomic_load(&lto.failed);
+    }
 
-    if (!else_terminator)
-        LLVMBuildBr(codegen->builder, join_block);
+    for (size_t i = 0; i < units; i++)
+        LLVMDisposeMemoryBuffer(bitcode_s[i]);
 
-    if (!both_terminator)
-        LLVMPositionBuilderAtEnd(codegen->builder, join_block);
+    return succeeded;
 }
 
-static
-void codegen_if(codegen_t codegen, if_t ifelse)
+backend_t backend_codegen(compilation_t compilation, backend_level_t level)
 {
-    if (if_else_branch(ifelse) == NULL)
-        codegen_if_only(codegen, ifelse);
-    else
-        codegen_if_else(codegen, ifelse);
+    backend_t backend = mem_alloc(sizeof(struct backend_t));
+    backend->compilation = compilation;
+    backend->pool = thread_pool_new(0);
+    backend->units = array_size(compilation_unit_s(compilation));
+    backend->unit_s = mem_alloc(sizeof(backend_unit_t) * backend->units);
+    backend->level = level;
+    backend->lto = BACKEND_LTO_NONE;
+
+    thread_pool_run(backend->pool, backend->units, codegen_task, backend);
+
+    return backend;
 }
 
-void codegen_var(codegen_t codegen, var_t var)
+LLVMTypeRef codegen_type(codegen_t codegen, type_t type);
+
+LLVMTypeRef codegen_callable(codegen_t codegen, callable_t callable)
 {
-    array_t(declaration_t) variable_s = var_variable_s(var);
+    type_t return_type = callable_return_type(callable);
+    LLVMTypeRef llvm_return_type = codegen_type(codegen, return_type);
 
-    size_t size = array_size(variable_s);
+    array_t(type_t) param_s = callable_param_s(callable);
+    size_t size = array_size(param_s);
 
+    LLVMTypeRef llvm_param_s[size];
     for (size_t i = 0; i < size; i++)
-    {
-        declaration_t declaration = variable_s[i];
-        type_t type = declaration_type(declaration);
-        LLVMTypeRef llvm_type = codegen_type(codegen, type);
-
-        LLVMValueRef llvm_var = LLVMBuildAlloca(codegen->builder, llvm_type, "");
-        map_at(codegen->values, declaration, llvm_var);
-
-        variable_t variable = VARIABLE(declaration);
-        expression_t expression = variable_initializer(variable);
-        if (expression == NULL)
-            continue;
+        llvm_param_s[i] = codegen_type(codegen, param_s[i]);
 
-        LLVMValueRef llvm_expression = codegen_expression(codegen, expression);
+    LLVMTypeRef llvm_callable = LLVMFunctionType(llvm_return_type, llvm_param_s, size, 0);
+    return llvm_callable;
+}
 
-        LLVMBuildStore(codegen->builder, llvm_expression, llvm_var);
+LLVMTypeRef codegen_type_kind(codegen_t codegen, type_kind_t kind)
+{
+    switch (kind) // LCOV_EXCL_LINE
+    {
+        case TYPE_BOOL:
+            return LLVMInt1TypeInContext(codegen->context);
+        case TYPE_INT:
+            return LLVMInt32TypeInContext(codegen->context);
+        case TYPE_CHAR:
+            return LLVMInt8TypeInContext(codegen->context);
+        case TYPE_VOID:
+            return LLVMVoidTypeInContext(codegen->context);
+        case TYPE_CALLABLE:
+        case TYPE_POINTER:
+            return LLVMPointerTypeInContext(codegen->context, 0);
     }
+    return NULL; // LCOV_EXCL_LINE
+}
+
+LLVMTypeRef codegen_type(codegen_t codegen, type_t type)
+{
+    if (type_kind(type) == TYPE_CALLABLE)
+        return codegen_callable(codegen, CALLABLE(type));
+    return codegen_type_kind(codegen, type_kind(type));
 }
 
-void codegen_act(codegen_t codegen, act_t act)
+
+LLVMValueRef codegen_binary(codegen_t codegen, binary_kind_t kind, LLVMValueRef lhs, LLVMValueRef rhs)
 {
-    array_t(expression_t) expression_s = act_expression_s(act);
-    size_t size = array_size(expression_s);
-    for (int i = 0; i < size; i++)
+    switch (kind) // LCOV_EXCL_LINE
     {
-        expression_t expression = expression_s[i];
-        codegen_expression(codegen, expression);
+        case BINARY_LT:
+            return LLVMBuildICmp(codegen->builder, LLVMIntSLT, lhs, rhs, "");
+        case BINARY_LE:
+            return LLVMBuildICmp(codegen->builder, LLVMIntSLE, lhs, rhs, "");
+        case BINARY_GT:
+            return LLVMBuildICmp(codegen->builder, LLVMIntSGT, lhs, rhs, "");
+        case BINARY_GE:
+            return LLVMBuildICmp(codegen->builder, LLVMIntSGE, lhs, rhs, "");
+        case BINARY_EQ:
+            return LLVMBuildICmp(codegen->builder, LLVMIntEQ, lhs, rhs, "");
+        case BINARY_NE:
+            return LLVMBuildICmp(codegen->builder, LLVMIntNE, lhs, rhs, "");
+        case BINARY_ADD:
+            return LLVMBuildAdd(codegen->builder, lhs, rhs, "");
+        case BINARY_SUB:
+            return LLVMBuildSub(codegen->builder, lhs, rhs, "");
+        case BINARY_MUL:
+            return LLVMBuildMul(codegen->builder, lhs, rhs, "");
+        case BINARY_DIV:
+            return LLVMBuildSDiv(codegen->builder, lhs, rhs, "");
+        case BINARY_REM:
+            return LLVMBuildSRem(codegen->builder, lhs, rhs, "");
     }
+    return NULL; // LCOV_EXCL_LINE
 }
 
-void codegen_statement(codegen_t codegen, statement_t statement)
+void codegen_function_extern(codegen_t codegen, function_t function);
+
+// A function of another unit is declared in this module on first use.
+LLVMValueRef codegen_callee(codegen_t codegen, function_t function)
 {
-    switch (statement_kind(statement)) // LCOV_EXCL_LINE
+    LLVMValueRef value = map_get(codegen->values, (declaration_t)function);
+    if (value == NULL)
     {
-        case STATEMENT_BLOCK:
-            return codegen_block(codegen, BLOCK(statement));
-        case STATEMENT_RETURN:
-            return codegen_return(codegen, RETURN(statement));
-        case STATEMENT_IF:
-            return codegen_if(codegen, IF(statement));
-        case STATEMENT_VAR:
-            return codegen_var(codegen, VAR(statement));
-        case STATEMENT_ACT:
-            return codegen_act(codegen, ACT(statement));
+        codegen_function_extern(codegen, function);
+        value = map_get(codegen->values, (declaration_t)function);
     }
+
+    return value;
 }
 
-LLVMValueRef LLVMAddFunction2(LLVMModuleRef M, span_t name, LLVMTypeRef FunctionTy)
+// The IR is in SSA form with its blocks in order, so every operand, phis'
+// included, is translated before the instruction that uses it.
+static
+LLVMValueRef codegen_instruction(codegen_t codegen, ir_t ir, ir_instruction_t *instruction,
+                                 LLVMValueRef *value_s, LLVMBasicBlockRef *block_s)
 {
-    char name_sz[name.size + 1];
-    memcpy(name_sz, name.data, name.size);
-    name_sz[name.size] = 0;
+    LLVMTypeRef type = codegen_type_kind(codegen, instruction->type);
+    uint32_t operands = instruction->operands;
+    LLVMValueRef operand_s[operands + 1];
+    for (uint32_t i = 0; i < operands; i++)
+        operand_s[i] = value_s[ir_operand(ir, instruction, i)];
 
-    return LLVMAddFunction(M, name_sz, FunctionTy);
+    switch (instruction->op) // LCOV_EXCL_LINE
+    {
+        case IR_NOP:
+            return NULL; // LCOV_EXCL_LINE
+        case IR_COPY:
+            return operand_s[0]; // LCOV_EXCL_LINE
+        case IR_CONST:
+            return LLVMConstInt(type, instruction->imm, 1);
+        case IR_ARGUMENT:
+            return LLVMGetParam(codegen->function, instruction->imm);
+        case IR_FUNCTION:
+            return codegen_callee(codegen, instruction->function);
+        case IR_PHI:
+        {
+            LLVMValueRef phi = LLVMBuildPhi(codegen->builder, type, "");
+            array_t(uint32_t) pred_s = ir->block_s[instruction->block].pred_s;
+            LLVMBasicBlockRef incoming_s[operands + 1];
+            for (uint32_t i = 0; i < operands; i++)
+                incoming_s[i] = block_s[pred_s[i]];
+            LLVMAddIncoming(phi, operand_s, incoming_s, operands);
+            return phi;
+        }
+        case IR_BINARY:
+            return codegen_binary(codegen, instruction->kind, operand_s[0], operand_s[1]);
+        case IR_AND:
+            return LLVMBuildAnd(codegen->builder, operand_s[0], operand_s[1], "");
+        case IR_OR:
+            return LLVMBuildOr(codegen->builder, operand_s[0], operand_s[1], "");
+        case IR_SLOT:
+            return LLVMBuildAlloca(codegen->builder, codegen_type_kind(codegen, instruction->kind), "");
+        case IR_LOAD:
+            return LLVMBuildLoad2(codegen->builder, type, operand_s[0], "");
+        case IR_STORE:
+            return LLVMBuildStore(codegen->builder, operand_s[1], operand_s[0]);
+        case IR_CALL:
+        {
+            LLVMTypeRef callee_type = codegen_type(codegen, function_type(instruction->function));
+            LLVMValueRef callee = codegen_callee(codegen, instruction->function);
+            return LLVMBuildCall2(codegen->builder, callee_type, callee, operand_s, operands, "");
+        }
+        case IR_JUMP:
+            return LLVMBuildBr(codegen->builder, block_s[instruction->target_s[0]]);
+        case IR_BRANCH:
+            return LLVMBuildCondBr(codegen->builder, operand_s[0], block_s[instruction->target_s[0]], block_s[instruction->target_s[1]]);
+        case IR_RETURN:
+            if (operands == 0)
+                return LLVMBuildRetVoid(codegen->builder);
+            return LLVMBuildRet(codegen->builder, operand_s[0]);
+    }
+    return NULL; // LCOV_EXCL_LINE
 }
 
-void codegen_function_prototype(codegen_t codegen, function_t function)
+void codegen_function_extern(codegen_t codegen, function_t function)
 {
     type_t fn_type = function_type(function);
     LLVMTypeRef llvm_fn_type = codegen_type(codegen, fn_type);
 
-    LLVMValueRef llvm_function = LLVMAddFunction2(codegen->module, location_span(function_name(function)), llvm_fn_type);
+    symbol_t name = declaration_symbol((declaration_t)function);
+    LLVMValueRef llvm_function = LLVMAddFunction(codegen->module, symbol_sz(name), llvm_fn_type);
     map_at(codegen->values, (declaration_t)function, llvm_function);
-
-    array_t(declaration_t) argument_s = function_argument_s(function);
-    size_t size = array_size(argument_s);
-    for (size_t i = 0; i < size; i++)
-    {
-        declaration_t argument = argument_s[i];
-        LLVMValueRef llvm_arg = LLVMGetParam(llvm_function, i);
-
-        span_t argument_name = location_span(declaration_name(argument));
-        LLVMSetValueName2(llvm_arg, argument_name.data, argument_name.size);
-
-        map_at(codegen->values, argument, llvm_arg);
-    }
 }
 
-void alloca_and_store_arguments(codegen_t codegen, function_t function)
+void codegen_function_prototype(codegen_t codegen, function_t function)
 {
-    LLVMValueRef llvm_function = codegen->function;
+    codegen_function_extern(codegen, function);
+    LLVMValueRef llvm_function = map_get(codegen->values, (declaration_t)function);
 
     array_t(declaration_t) argument_s = function_argument_s(function);
     size_t size = array_size(argument_s);
-
-    LLVMValueRef llvmarg_s[size];
-    LLVMValueRef alloca_s[size];
-
-    for (size_t i = 0; i < size; i++)
-    {
-        llvmarg_s[i] = LLVMGetParam(llvm_function, i);
-        alloca_s[i] = LLVMBuildAlloca(codegen->builder, LLVMTypeOf(llvmarg_s[i]), "");
-    }
-
     for (size_t i = 0; i < size; i++)
     {
-        LLVMBuildStore(codegen->builder, llvmarg_s[i], alloca_s[i]);
         declaration_t argument = argument_s[i];
-        map_at(codegen->values, argument, alloca_s[i]);
+        LLVMValueRef llvm_arg = LLVMGetParam(llvm_function, i);
+
+        span_t argument_name = symbol_name(declaration_symbol(argument));
+        LLVMSetValueName2(llvm_arg, argument_name.data, argument_name.size);
     }
 }
 
+// The function goes through the iz IR, whose passes leave LLVM code that
+// is already in SSA form, folded and without dead blocks.
 void codegen_function(codegen_t codegen, function_t function)
 {
     LLVMValueRef llvm_function = map_get(codegen->values, (declaration_t)function);
+    codegen->function = llvm_function;
 
-    LLVMBasicBlockRef entry = LLVMAppendBasicBlockInContext(codegen->context, llvm_function, "entry");
-    LLVMPositionBuilderAtEnd(codegen->builder, entry);
+    ir_t ir = ir_build(function);
+    ir_optimize(ir);
 
-    codegen->function = llvm_function;
+    size_t blocks = array_size(ir->block_s);
+    LLVMBasicBlockRef *block_s = mem_alloc(sizeof(LLVMBasicBlockRef) * blocks);
+    for (size_t i = 0; i < blocks; i++)
+        block_s[i] = LLVMAppendBasicBlockInContext(codegen->context, llvm_function, ir_label_string(ir->block_s[i].label));
 
-    alloca_and_store_arguments(codegen, function);
+    LLVMValueRef *value_s = mem_alloc(sizeof(LLVMValueRef) * array_size(ir->instruction_s));
+    for (size_t i = 0; i < blocks; i++)
+    {
+        LLVMPositionBuilderAtEnd(codegen->builder, block_s[i]);
 
-    statement_t statement = function_statement(function);
-    codegen_statement(codegen, statement);
+        array_t(uint32_t) instruction_s = ir->block_s[i].instruction_s;
+        for (size_t j = 0; j < array_size(instruction_s); j++)
+        {
+            uint32_t value = instruction_s[j];
+            value_s[value] = codegen_instruction(codegen, ir, &ir->instruction_s[value], value_s, block_s);
+        }
+    }
 
-    // A void function's body never contains a return statement (sema only
-    // requires "all paths return" for non-void functions), so it always
-    // falls off the end and needs a synthetic terminator here.
-    if (type_kind(function_return_type(function)) == TYPE_VOID)
-        LLVMBuildRetVoid(codegen->builder);
+    mem_free(value_s);
+    mem_free(block_s);
+    ir_free(ir);
 
     codegen->function = NULL;
 }
@@ -686,17 +910,15 @@ LLVMModuleRef codegen_unit(codegen_t codegen, unit_t unit)
     return module;
 }
 
-array_t(LLVMModuleRef) codegen_compilation(codegen_t codegen, compilation_t compilation)
+LLVMModuleRef codegen_function_module(codegen_t codegen, function_t function)
 {
-    array_t(LLVMModuleRef) module_s = array_empty();
-    array_t(unit_t) unit_s = compilation_unit_s(compilation);
-    size_t size = array_size(unit_s);
-    for (int i = 0; i < size; i++)
-    {
-        unit_t unit = unit_s[i];
-        LLVMModuleRef module = codegen_unit(codegen, unit);
-        module_s = array_add(module_s, module);
-    }
+    symbol_t name = declaration_symbol((declaration_t)function);
+    LLVMModuleRef module = LLVMModuleCreateWithNameInContext(symbol_sz(name), codegen->context);
 
-    return module_s;
+    codegen->module = module;
+    codegen_function_prototype(codegen, function);
+    codegen_function(codegen, function);
+    codegen->module = NULL;
+
+    return module;
 }
@@ -5,15 +5,76 @@
 
 typedef  struct backend_t*  backend_t;
 
-backend_t  backend_codegen(compilation_t compilation);
+// Optimization level, as in -O0 .. -Oz. It selects both the default pass
+// pipeline and the code generation level of the target machine.
+typedef enum backend_level_t backend_level_t;
+enum backend_level_t
+{
+    BACKEND_O0,
+    BACKEND_O1,
+    BACKEND_O2,
+    BACKEND_O3,
+    BACKEND_OS,
+    BACKEND_OZ,
+};
+
+backend_t  backend_codegen(compilation_t compilation, backend_level_t level);
 void       backend_free(backend_t backend);
 
+compilation_t backend_compilation(backend_t backend);
+
 bool       backend_validate(backend_t backend);
-void       backend_optimize(backend_t backend);
+
+// Runs a new pass manager pipeline, e.g. "function(mem2reg,instcombine)",
+// over every module. NULL runs the default pipeline of the level, or its
+// LTO post-link pipeline after backend_lto. A pipeline that does not
+// parse is reported on stderr and returns false.
+bool       backend_optimize(backend_t backend, const char *pipeline);
+
+typedef enum backend_lto_t backend_lto_t;
+enum backend_lto_t
+{
+    BACKEND_LTO_NONE,
+    // Links every module into one, index 0, and internalizes all functions
+    // but the exported ones so they can be inlined and dropped.
+    BACKEND_LTO_FULL,
+    // Keeps the modules apart: a summary of every module's functions
+    // decides which small ones each module imports as available_externally
+    // copies, so calls across units can be inlined in parallel.
+    BACKEND_LTO_THIN,
+};
+
+// Runs the pre-link pipeline of the level on every module, then links or
+// imports. Call it once, before backend_optimize.
+bool       backend_lto(backend_t backend, backend_lto_t lto, const char *const *export_s, size_t exports);
+size_t     backend_modules(backend_t backend);
 void       backend_dump(backend_t backend);
 
-void       backend_emit_object(backend_t backend);
-void       backend_emit_assembly(backend_t backend);
-void       backend_emit_llvm(backend_t backend);
+// Textual IR of the module of the unit at index; free it with mem_free.
+char*      backend_ir(backend_t backend, size_t index);
+
+typedef enum backend_artifact_t backend_artifact_t;
+enum backend_artifact_t
+{
+    BACKEND_OBJECT,
+    BACKEND_ASSEMBLY,
+    BACKEND_LLVM,
+    BACKEND_BITCODE,
+    BACKEND_ARTIFACTS,
+};
+
+// One file to write: an artifact of the module of the unit at index unit.
+typedef struct backend_output_t backend_output_t;
+struct backend_output_t
+{
+    size_t              unit;
+    backend_artifact_t  artifact;
+    const char         *path;
+};
+
+// Renders every requested artifact to memory, each module and artifact at
+// most once, then writes the files concurrently. Failures are reported on
+// stderr; returns false if any output could not be produced.
+bool       backend_emit(backend_t backend, const backend_output_t *output_s, size_t size);
 
 #endif
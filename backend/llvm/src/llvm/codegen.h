@@ -0,0 +1,43 @@
+#ifndef _CODEGEN_H_
+#define _CODEGEN_H_
+
+// Shared by the ahead-of-time backend and the JIT; not part of the
+// public interface of the LLVM backend.
+
+#include "ast/ast.h"
+#include "llvm/backend.h"
+#include "map.h"
+
+#include <llvm-c/Core.h>
+#include <llvm-c/TargetMachine.h>
+
+typedef struct codegen_t* codegen_t;
+struct codegen_t
+{
+    LLVMModuleRef  module;
+    LLVMBuilderRef builder;
+    LLVMContextRef context;
+    map_t values;
+
+    LLVMValueRef function;
+};
+
+codegen_t     codegen_new(compilation_t compilation, LLVMContextRef context);
+void          codegen_free(codegen_t codegen);
+
+// The module of a unit, created in the codegen's context. Functions of
+// other units are declared as they are referenced.
+LLVMModuleRef codegen_unit(codegen_t codegen, unit_t unit);
+// A module with the function alone, named after it.
+LLVMModuleRef codegen_function_module(codegen_t codegen, function_t function);
+
+// A target machine for the host at the code generation level of level,
+// and the host triple. Targets are initialized on first use.
+LLVMTargetMachineRef host_machine(backend_level_t level);
+const char*          host_triple(void);
+
+// The pipeline of the given stage at the level, e.g. "lto-pre-link<O2>";
+// the default stage at O1 is a shorter pipeline of its own.
+void          level_pipeline(backend_level_t level, const char *stage, char *pipeline, size_t size);
+
+#endif
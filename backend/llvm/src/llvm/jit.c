@@ -0,0 +1,816 @@
+#include "llvm/jit.h"
+#include "llvm/codegen.h"
+#include "common/mem.h"
+#include "common/thread_pool.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <llvm-c/Error.h>
+#include <llvm-c/LLJIT.h>
+#include <llvm-c/Orc.h>
+#include <llvm-c/Transforms/PassBuilder.h>
+
+struct jit_t
+{
+    compilation_t                       compilation;
+    LLVMOrcLLJITRef                     lljit;
+    backend_level_t                     level;
+    char                               *pipeline;
+
+    // lazy mode only
+    LLVMOrcLazyCallThroughManagerRef    call_through;
+    LLVMOrcIndirectStubsManagerRef      stubs;
+
+    // tiered mode only
+    struct tier_t                      *tier;
+
+    jit_stats_t                         stats;
+    // time and functions compiled on demand, while main runs
+    atomic_uint_fast64_t                lazy_compile;
+    atomic_size_t                       lazy_compiled;
+};
+
+// One unit on its way into the JIT. The module lives in its own thread
+// safe context, so units are generated and optimized concurrently.
+typedef struct jit_unit_t jit_unit_t;
+struct jit_unit_t
+{
+    LLVMOrcThreadSafeContextRef context;
+    LLVMModuleRef               module;
+    LLVMErrorRef                error;
+};
+
+typedef struct prepare_t prepare_t;
+struct prepare_t
+{
+    jit_t               jit;
+    jit_unit_t         *unit_s;
+};
+
+// A function not compiled yet: the context of its materialization unit.
+typedef struct lazy_t lazy_t;
+struct lazy_t
+{
+    jit_t               jit;
+    function_t          function;
+};
+
+// Tiered mode. Every call loads its target from the callee's slot, which
+// starts at the O0 code and is swapped for the optimized code once the
+// callee's entry counter reaches TIER_THRESHOLD. iz has no loops, so entry
+// counters alone see every hot path, recursion included.
+typedef struct tier_t tier_t;
+struct tier_t
+{
+    function_t                 *function_s;
+    uint32_t                   *index_s;        // function index + 1, by symbol id
+    size_t                      symbols;
+    atomic_uintptr_t           *slot_s;
+    atomic_uint                *counter_s;
+
+    // the background compiler; the rest is guarded by mutex
+    pthread_t                   thread;
+    pthread_mutex_t             mutex;
+    pthread_cond_t              wake;           // work to do or stop
+    pthread_cond_t              idle;           // nothing pending or compiling
+    array_t(uint32_t)           pending_s;
+    bool                       *requested_s;
+    bool                        busy;
+    bool                        stop;
+    uint64_t                    start;          // of the current run
+    array_t(jit_tier_up_t)      tier_up_s;
+};
+
+#define TIER_THRESHOLD 1000
+
+// The lazy stub of a function keeps its name; its code is this symbol.
+#define BODY_SUFFIX ".body"
+
+static const LLVMJITSymbolFlags function_flags =
+{
+    LLVMJITSymbolGenericFlagsExported | LLVMJITSymbolGenericFlagsCallable, 0
+};
+
+static
+uint64_t now(void)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+// Prints and consumes the error; false when there was one.
+static
+bool report(LLVMErrorRef error, const char *what)
+{
+    if (error == NULL)
+        return true;
+
+    char *message = LLVMGetErrorMessage(error);
+    fprintf(stderr, "%s: %s\n", what, message);
+    LLVMDisposeErrorMessage(message);
+    return false;
+}
+
+static
+LLVMErrorRef optimize(jit_t jit, LLVMModuleRef module, const char *pipeline)
+{
+    LLVMSetTarget(module, LLVMOrcLLJITGetTripleString(jit->lljit));
+    LLVMSetDataLayout(module, LLVMOrcLLJITGetDataLayoutStr(jit->lljit));
+
+    LLVMTargetMachineRef machine = host_machine(jit->level);
+    LLVMPassBuilderOptionsRef options = LLVMCreatePassBuilderOptions();
+    LLVMErrorRef error = LLVMRunPasses(module, pipeline, machine, options);
+    LLVMDisposePassBuilderOptions(options);
+    LLVMDisposeTargetMachine(machine);
+
+    return error;
+}
+
+static
+void prepare_task(void *context, size_t index)
+{
+    prepare_t *prepare = context;
+    jit_unit_t *unit = &prepare->unit_s[index];
+    jit_t jit = prepare->jit;
+
+    unit->context = LLVMOrcCreateNewThreadSafeContext();
+    codegen_t codegen = codegen_new(jit->compilation, LLVMOrcThreadSafeContextGetContext(unit->context));
+    unit->module = codegen_unit(codegen, compilation_unit_s(jit->compilation)[index]);
+    codegen_free(codegen);
+
+    unit->error = optimize(jit, unit->module, jit->pipeline);
+}
+
+static
+bool eager_add(jit_t jit)
+{
+    size_t units = array_size(compilation_unit_s(jit->compilation));
+    jit_unit_t unit_s[units + 1];
+    prepare_t prepare = { jit, unit_s };
+
+    thread_pool_t pool = thread_pool_new(0);
+    thread_pool_run(pool, units, prepare_task, &prepare);
+    thread_pool_free(pool);
+
+    // every module fails the same way on a bad pipeline; report it once
+    bool succeeded = true;
+    for (size_t i = 0; i < units; i++)
+    {
+        jit_unit_t *unit = &unit_s[i];
+        if (unit->error != NULL)
+        {
+            if (succeeded)
+                report(unit->error, "invalid pass pipeline");
+            else
+                LLVMConsumeError(unit->error);
+            succeeded = false;
+        }
+
+        if (succeeded)
+        {
+            LLVMOrcThreadSafeModuleRef module = LLVMOrcCreateNewThreadSafeModule(unit->module, unit->context);
+            LLVMOrcJITDylibRef dylib = LLVMOrcLLJITGetMainJITDylib(jit->lljit);
+            succeeded = report(LLVMOrcLLJITAddLLVMIRModule(jit->lljit, dylib, module), "jit");
+        }
+        else
+            LLVMDisposeModule(unit->module);
+
+        LLVMOrcDisposeThreadSafeContext(unit->context);
+    }
+
+    jit->stats.compiled = jit->stats.functions;
+    return succeeded;
+}
+
+// The name of the function's code in the JIT: its own name and a suffix.
+static
+void suffixed(function_t function, const char *suffix, char *name, size_t size)
+{
+    snprintf(name, size, "%s%s", symbol_sz(declaration_symbol((declaration_t)function)), suffix);
+}
+
+static
+size_t suffixed_size(function_t function, const char *suffix)
+{
+    return strlen(symbol_sz(declaration_symbol((declaration_t)function))) + strlen(suffix) + 1;
+}
+
+static
+LLVMValueRef rename_function(LLVMModuleRef module, function_t function, const char *suffix)
+{
+    LLVMValueRef value = LLVMGetNamedFunction(module, symbol_sz(declaration_symbol((declaration_t)function)));
+
+    char name[suffixed_size(function, suffix)];
+    suffixed(function, suffix, name, sizeof(name));
+    LLVMSetValueName2(value, name, strlen(name));
+
+    return value;
+}
+
+static
+bool pipeline_parses(jit_t jit)
+{
+    LLVMModuleRef empty = LLVMModuleCreateWithName("");
+    bool parses = report(optimize(jit, empty, jit->pipeline), "invalid pass pipeline");
+    LLVMDisposeModule(empty);
+
+    return parses;
+}
+
+// LCOV_EXCL_START
+static
+void lazy_failure(void)
+{
+    fprintf(stderr, "jit: a function failed to compile\n");
+    abort();
+}
+
+static
+void lazy_discard(void *context, LLVMOrcJITDylibRef dylib, LLVMOrcSymbolStringPoolEntryRef symbol)
+{
+    (void) context;
+    (void) dylib;
+    (void) symbol;
+}
+// LCOV_EXCL_STOP
+
+// Runs on the thread that first calls the function, while the call waits
+// in its stub. The context is ours to free from here on.
+static
+void lazy_materialize(void *context, LLVMOrcMaterializationResponsibilityRef responsibility)
+{
+    lazy_t *lazy = context;
+    jit_t jit = lazy->jit;
+    uint64_t start = now();
+
+    LLVMOrcThreadSafeContextRef thread_safe = LLVMOrcCreateNewThreadSafeContext();
+    codegen_t codegen = codegen_new(jit->compilation, LLVMOrcThreadSafeContextGetContext(thread_safe));
+    LLVMModuleRef module = codegen_function_module(codegen, lazy->function);
+    codegen_free(codegen);
+
+    // calls to other functions still go to their stubs
+    rename_function(module, lazy->function, BODY_SUFFIX);
+
+    LLVMErrorRef error = optimize(jit, module, jit->pipeline);
+    if (error != NULL)
+    {
+        report(error, "jit");                                       // LCOV_EXCL_LINE
+        LLVMDisposeModule(module);                                  // LCOV_EXCL_LINE
+        LLVMOrcMaterializationResponsibilityFailMaterialization(responsibility); // LCOV_EXCL_LINE
+        LLVMOrcDisposeMaterializationResponsibility(responsibility); // LCOV_EXCL_LINE
+    }
+    else
+    {
+        LLVMOrcThreadSafeModuleRef thread_safe_module = LLVMOrcCreateNewThreadSafeModule(module, thread_safe);
+        LLVMOrcIRTransformLayerEmit(LLVMOrcLLJITGetIRTransformLayer(jit->lljit), responsibility, thread_safe_module);
+    }
+    LLVMOrcDisposeThreadSafeContext(thread_safe);
+
+    mem_free(lazy);
+
+    atomic_fetch_add(&jit->lazy_compiled, 1);
+    atomic_fetch_add(&jit->lazy_compile, now() - start);
+}
+
+// Defines a materialization unit for the body of every function, and a
+// lazy reexport of each body under the function's own name.
+static
+bool lazy_add(jit_t jit)
+{
+    LLVMOrcExecutionSessionRef session = LLVMOrcLLJITGetExecutionSession(jit->lljit);
+    const char *triple = LLVMOrcLLJITGetTripleString(jit->lljit);
+    if (!report(LLVMOrcCreateLocalLazyCallThroughManager(triple, session,
+            (LLVMOrcJITTargetAddress)(uintptr_t)lazy_failure, &jit->call_through), "jit"))
+        return false;                                               // LCOV_EXCL_LINE
+    jit->stubs = LLVMOrcCreateLocalIndirectStubsManager(triple);
+
+    // the pipeline is otherwise only parsed on the first call
+    bool succeeded = pipeline_parses(jit);
+    if (!succeeded)
+        return false;
+
+    LLVMOrcJITDylibRef dylib = LLVMOrcLLJITGetMainJITDylib(jit->lljit);
+    LLVMOrcCSymbolAliasMapPair alias_s[jit->stats.functions + 1];
+    size_t aliases = 0;
+
+    array_t(unit_t) unit_s = compilation_unit_s(jit->compilation);
+    for (size_t i = 0; i < array_size(unit_s) && succeeded; i++)
+    {
+        array_t(declaration_t) declaration_s = unit_declaration_s(unit_s[i]);
+        for (size_t j = 0; j < array_size(declaration_s) && succeeded; j++)
+        {
+            const char *name = symbol_sz(declaration_symbol(declaration_s[j]));
+            char body[suffixed_size(FUNCTION(declaration_s[j]), BODY_SUFFIX)];
+            suffixed(FUNCTION(declaration_s[j]), BODY_SUFFIX, body, sizeof(body));
+
+            lazy_t *lazy = mem_alloc(sizeof(lazy_t));
+            *lazy = (lazy_t){ jit, FUNCTION(declaration_s[j]) };
+
+            LLVMOrcCSymbolFlagsMapPair symbol = { LLVMOrcLLJITMangleAndIntern(jit->lljit, body), function_flags };
+            LLVMOrcMaterializationUnitRef unit = LLVMOrcCreateCustomMaterializationUnit(
+                name, lazy, &symbol, 1, NULL, lazy_materialize, lazy_discard, mem_free);
+
+            succeeded = report(LLVMOrcJITDylibDefine(dylib, unit), "jit");
+            if (!succeeded)
+            {
+                LLVMOrcDisposeMaterializationUnit(unit);            // LCOV_EXCL_LINE
+                break;                                              // LCOV_EXCL_LINE
+            }
+
+            alias_s[aliases++] = (LLVMOrcCSymbolAliasMapPair)
+            {
+                LLVMOrcLLJITMangleAndIntern(jit->lljit, name),
+                { LLVMOrcLLJITMangleAndIntern(jit->lljit, body), function_flags }
+            };
+        }
+    }
+
+    LLVMOrcMaterializationUnitRef reexports = LLVMOrcLazyReexports(jit->call_through, jit->stubs, dylib, alias_s, aliases);
+    if (!report(LLVMOrcJITDylibDefine(dylib, reexports), "jit"))
+    {
+        LLVMOrcDisposeMaterializationUnit(reexports);               // LCOV_EXCL_LINE
+        return false;                                               // LCOV_EXCL_LINE
+    }
+
+    return succeeded;
+}
+
+static
+LLVMValueRef address_of(LLVMModuleRef module, const void *address)
+{
+    LLVMContextRef context = LLVMGetModuleContext(module);
+    LLVMValueRef integer = LLVMConstInt(LLVMInt64TypeInContext(context), (uintptr_t)address, false);
+    return LLVMConstIntToPtr(integer, LLVMPointerTypeInContext(context, 0));
+}
+
+static
+uint32_t tier_index(tier_t *tier, LLVMValueRef function)
+{
+    size_t size = 0;
+    const char *name = LLVMGetValueName2(function, &size);
+    symbol_t symbol = symbol_find(span_ctor(size, name));
+
+    return symbol < tier->symbols ? tier->index_s[symbol] : 0;
+}
+
+// Makes every call to an iz function other than except load its target from the
+// callee's slot, then drops the declarations no call uses anymore.
+static
+void route_calls(jit_t jit, LLVMModuleRef module, LLVMValueRef except)
+{
+    tier_t *tier = jit->tier;
+    LLVMContextRef context = LLVMGetModuleContext(module);
+    LLVMBuilderRef builder = LLVMCreateBuilderInContext(context);
+    LLVMTypeRef pointer = LLVMPointerTypeInContext(context, 0);
+
+    for (LLVMValueRef function = LLVMGetFirstFunction(module); function != NULL; function = LLVMGetNextFunction(function))
+        for (LLVMBasicBlockRef block = LLVMGetFirstBasicBlock(function); block != NULL; block = LLVMGetNextBasicBlock(block))
+            for (LLVMValueRef instruction = LLVMGetFirstInstruction(block); instruction != NULL; instruction = LLVMGetNextInstruction(instruction))
+            {
+                if (LLVMGetInstructionOpcode(instruction) != LLVMCall)
+                    continue;
+
+                LLVMValueRef callee = LLVMGetCalledValue(instruction);
+                uint32_t index = LLVMIsAFunction(callee) && callee != except ? tier_index(tier, callee) : 0;
+                if (index == 0)
+                    continue;
+
+                LLVMPositionBuilderBefore(builder, instruction);
+                LLVMValueRef target = LLVMBuildLoad2(builder, pointer, address_of(module, &tier->slot_s[index - 1]), "");
+                LLVMSetOrdering(target, LLVMAtomicOrderingMonotonic);
+                LLVMSetAlignment(target, sizeof(uintptr_t));
+                LLVMSetOperand(instruction, LLVMGetNumOperands(instruction) - 1, target);
+            }
+
+    LLVMDisposeBuilder(builder);
+
+    for (LLVMValueRef function = LLVMGetFirstFunction(module); function != NULL; )
+    {
+        LLVMValueRef next = LLVMGetNextFunction(function);
+        if (LLVMIsDeclaration(function) && LLVMGetFirstUse(function) == NULL)
+            LLVMDeleteFunction(function);
+        function = next;
+    }
+}
+
+// Called by the O0 code of a function whose counter reaches the threshold.
+static
+void tier_request(jit_t jit, uint32_t index)
+{
+    tier_t *tier = jit->tier;
+
+    pthread_mutex_lock(&tier->mutex);
+    if (!tier->requested_s[index])
+    {
+        tier->requested_s[index] = true;
+        tier->pending_s = array_add(tier->pending_s, index);
+        pthread_cond_signal(&tier->wake);
+    }
+    pthread_mutex_unlock(&tier->mutex);
+}
+
+// Counts calls on entry to the function, asking for a recompilation when
+// the count reaches the threshold. The counting block becomes the entry.
+static
+void instrument(jit_t jit, LLVMModuleRef module, LLVMValueRef function, uint32_t index)
+{
+    LLVMContextRef context = LLVMGetModuleContext(module);
+    LLVMTypeRef int32 = LLVMInt32TypeInContext(context);
+    LLVMBuilderRef builder = LLVMCreateBuilderInContext(context);
+
+    LLVMBasicBlockRef body = LLVMGetEntryBasicBlock(function);
+    LLVMBasicBlockRef count = LLVMInsertBasicBlockInContext(context, body, "count");
+    LLVMBasicBlockRef hot = LLVMInsertBasicBlockInContext(context, body, "hot");
+
+    LLVMPositionBuilderAtEnd(builder, count);
+    LLVMValueRef counter = address_of(module, &jit->tier->counter_s[index]);
+    LLVMValueRef calls = LLVMBuildAtomicRMW(builder, LLVMAtomicRMWBinOpAdd, counter,
+        LLVMConstInt(int32, 1, false), LLVMAtomicOrderingMonotonic, false);
+    LLVMValueRef reached = LLVMBuildICmp(builder, LLVMIntEQ, calls, LLVMConstInt(int32, TIER_THRESHOLD - 1, false), "");
+    LLVMBuildCondBr(builder, reached, hot, body);
+
+    LLVMPositionBuilderAtEnd(builder, hot);
+    LLVMTypeRef param_s[] = { LLVMPointerTypeInContext(context, 0), int32 };
+    LLVMTypeRef request_type = LLVMFunctionType(LLVMVoidTypeInContext(context), param_s, 2, false);
+    LLVMValueRef argument_s[] = { address_of(module, jit), LLVMConstInt(int32, index, false) };
+    LLVMBuildCall2(builder, request_type, address_of(module, (const void*)(uintptr_t)tier_request), argument_s, 2, "");
+    LLVMBuildBr(builder, body);
+
+    LLVMDisposeBuilder(builder);
+}
+
+static
+bool tier_baseline(jit_t jit)
+{
+    tier_t *tier = jit->tier;
+    array_t(unit_t) unit_s = compilation_unit_s(jit->compilation);
+    LLVMOrcJITDylibRef dylib = LLVMOrcLLJITGetMainJITDylib(jit->lljit);
+
+    bool succeeded = true;
+    for (size_t i = 0; i < array_size(unit_s) && succeeded; i++)
+    {
+        LLVMOrcThreadSafeContextRef thread_safe = LLVMOrcCreateNewThreadSafeContext();
+        codegen_t codegen = codegen_new(jit->compilation, LLVMOrcThreadSafeContextGetContext(thread_safe));
+        LLVMModuleRef module = codegen_unit(codegen, unit_s[i]);
+        codegen_free(codegen);
+
+        // calls are routed by the names the functions have in the AST
+        array_t(declaration_t) declaration_s = unit_declaration_s(unit_s[i]);
+        for (size_t j = 0; j < array_size(declaration_s); j++)
+        {
+            LLVMValueRef value = LLVMGetNamedFunction(module, symbol_sz(declaration_symbol(declaration_s[j])));
+            instrument(jit, module, value, tier_index(tier, value) - 1);
+        }
+        route_calls(jit, module, NULL);
+        for (size_t j = 0; j < array_size(declaration_s); j++)
+            rename_function(module, FUNCTION(declaration_s[j]), ".tier0");
+
+        succeeded = report(optimize(jit, module, "default<O0>"), "jit");
+        if (succeeded)
+        {
+            LLVMOrcThreadSafeModuleRef thread_safe_module = LLVMOrcCreateNewThreadSafeModule(module, thread_safe);
+            succeeded = report(LLVMOrcLLJITAddLLVMIRModule(jit->lljit, dylib, thread_safe_module), "jit");
+        }
+        else
+            LLVMDisposeModule(module);                              // LCOV_EXCL_LINE
+        LLVMOrcDisposeThreadSafeContext(thread_safe);
+    }
+
+    for (size_t i = 0; i < jit->stats.functions && succeeded; i++)
+    {
+        char name[suffixed_size(tier->function_s[i], ".tier0")];
+        suffixed(tier->function_s[i], ".tier0", name, sizeof(name));
+
+        LLVMOrcExecutorAddress address = 0;
+        succeeded = report(LLVMOrcLLJITLookup(jit->lljit, &address, name), "jit");
+        atomic_init(&tier->slot_s[i], address);
+    }
+
+    jit->stats.compiled = jit->stats.functions;
+    return succeeded;
+}
+
+// Generates the function alone at the level of the JIT, calling itself
+// directly and everything else through the slots, and installs it.
+static
+void tier_up(jit_t jit, uint32_t index)
+{
+    tier_t *tier = jit->tier;
+    function_t function = tier->function_s[index];
+    uint64_t start = now();
+
+    LLVMOrcThreadSafeContextRef thread_safe = LLVMOrcCreateNewThreadSafeContext();
+    codegen_t codegen = codegen_new(jit->compilation, LLVMOrcThreadSafeContextGetContext(thread_safe));
+    LLVMModuleRef module = codegen_function_module(codegen, function);
+    codegen_free(codegen);
+
+    route_calls(jit, module, rename_function(module, function, ".tier1"));
+
+    char name[suffixed_size(function, ".tier1")];
+    suffixed(function, ".tier1", name, sizeof(name));
+
+    LLVMOrcExecutorAddress address = 0;
+    bool succeeded = report(optimize(jit, module, jit->pipeline), "jit");
+    if (succeeded)
+    {
+        LLVMOrcThreadSafeModuleRef thread_safe_module = LLVMOrcCreateNewThreadSafeModule(module, thread_safe);
+        LLVMOrcJITDylibRef dylib = LLVMOrcLLJITGetMainJITDylib(jit->lljit);
+        succeeded = report(LLVMOrcLLJITAddLLVMIRModule(jit->lljit, dylib, thread_safe_module), "jit")
+            && report(LLVMOrcLLJITLookup(jit->lljit, &address, name), "jit");
+    }
+    else
+        LLVMDisposeModule(module);                                  // LCOV_EXCL_LINE
+    LLVMOrcDisposeThreadSafeContext(thread_safe);
+
+    // a failed function keeps running its O0 code
+    if (!succeeded)
+        return;                                                     // LCOV_EXCL_LINE
+
+    atomic_store(&tier->slot_s[index], address);
+
+    uint64_t end = now();
+    pthread_mutex_lock(&tier->mutex);
+    jit_tier_up_t tier_up = { symbol_sz(declaration_symbol((declaration_t)function)), end - tier->start, end - start };
+    tier->tier_up_s = array_add(tier->tier_up_s, tier_up);
+    pthread_mutex_unlock(&tier->mutex);
+}
+
+static
+void *tier_thread(void *context)
+{
+    jit_t jit = context;
+    tier_t *tier = jit->tier;
+
+    pthread_mutex_lock(&tier->mutex);
+    while (true)
+    {
+        size_t pending = array_size(tier->pending_s);
+        if (tier->stop)
+            break;
+        if (pending == 0)
+        {
+            pthread_cond_broadcast(&tier->idle);
+            pthread_cond_wait(&tier->wake, &tier->mutex);
+            continue;
+        }
+
+        uint32_t index = tier->pending_s[pending - 1];
+        array_truncate(tier->pending_s, pending - 1);
+        tier->busy = true;
+        pthread_mutex_unlock(&tier->mutex);
+
+        tier_up(jit, index);
+
+        pthread_mutex_lock(&tier->mutex);
+        tier->busy = false;
+    }
+    pthread_mutex_unlock(&tier->mutex);
+
+    return NULL;
+}
+
+static
+bool tier_add(jit_t jit)
+{
+    if (!pipeline_parses(jit))
+        return false;
+
+    size_t functions = jit->stats.functions;
+    tier_t *tier = mem_alloc(sizeof(tier_t));
+    jit->tier = tier;
+
+    tier->function_s = mem_alloc(sizeof(function_t) * (functions + 1));
+    tier->slot_s = mem_alloc(sizeof(atomic_uintptr_t) * (functions + 1));
+    tier->counter_s = mem_alloc(sizeof(atomic_uint) * (functions + 1));
+    tier->requested_s = mem_alloc(sizeof(bool) * (functions + 1));
+    tier->symbols = symbol_count() + 1;
+    tier->index_s = mem_alloc(sizeof(uint32_t) * tier->symbols);
+    memset(tier->index_s, 0, sizeof(uint32_t) * tier->symbols);
+
+    size_t index = 0;
+    array_t(unit_t) unit_s = compilation_unit_s(jit->compilation);
+    for (size_t i = 0; i < array_size(unit_s); i++)
+    {
+        array_t(declaration_t) declaration_s = unit_declaration_s(unit_s[i]);
+        for (size_t j = 0; j < array_size(declaration_s); j++, index++)
+        {
+            tier->function_s[index] = FUNCTION(declaration_s[j]);
+            tier->index_s[declaration_symbol(declaration_s[j])] = index + 1;
+            atomic_init(&tier->slot_s[index], 0);
+            atomic_init(&tier->counter_s[index], 0);
+            tier->requested_s[index] = false;
+        }
+    }
+
+    pthread_mutex_init(&tier->mutex, NULL);
+    pthread_cond_init(&tier->wake, NULL);
+    pthread_cond_init(&tier->idle, NULL);
+    tier->pending_s = array_empty();
+    tier->busy = false;
+    tier->stop = false;
+    tier->start = now();
+    tier->tier_up_s = array_empty();
+    pthread_create(&tier->thread, NULL, tier_thread, jit);
+
+    return tier_baseline(jit);
+}
+
+static
+void tier_free(tier_t *tier)
+{
+    pthread_mutex_lock(&tier->mutex);
+    tier->stop = true;
+    pthread_cond_signal(&tier->wake);
+    pthread_mutex_unlock(&tier->mutex);
+    pthread_join(tier->thread, NULL);
+
+    pthread_cond_destroy(&tier->idle);
+    pthread_cond_destroy(&tier->wake);
+    pthread_mutex_destroy(&tier->mutex);
+
+    array_free(tier->tier_up_s);
+    array_free(tier->pending_s);
+    mem_free(tier->index_s);
+    mem_free(tier->requested_s);
+    mem_free(tier->counter_s);
+    mem_free(tier->slot_s);
+    mem_free(tier->function_s);
+    mem_free(tier);
+}
+
+static
+LLVMOrcLLJITRef lljit_new(backend_level_t level)
+{
+    LLVMOrcLLJITBuilderRef builder = LLVMOrcCreateLLJITBuilder();
+    LLVMOrcLLJITBuilderSetJITTargetMachineBuilder(builder,
+        LLVMOrcJITTargetMachineBuilderCreateFromTargetMachine(host_machine(level)));
+
+    LLVMOrcLLJITRef lljit = NULL;
+    if (!report(LLVMOrcCreateLLJIT(&lljit, builder), "jit"))
+        return NULL;                                                // LCOV_EXCL_LINE
+
+    // symbols the units do not define, e.g. memset, come from the process
+    LLVMOrcDefinitionGeneratorRef generator = NULL;
+    if (report(LLVMOrcCreateDynamicLibrarySearchGeneratorForProcess(&generator,
+            LLVMOrcLLJITGetGlobalPrefix(lljit), NULL, NULL), "jit"))
+        LLVMOrcJITDylibAddGenerator(LLVMOrcLLJITGetMainJITDylib(lljit), generator);
+
+    return lljit;
+}
+
+jit_t jit_compile(compilation_t compilation, jit_mode_t mode, backend_level_t level, const char *pipeline)
+{
+    uint64_t start = now();
+
+    char level_default[128];
+    if (pipeline == NULL)
+    {
+        level_pipeline(level, "default", level_default, sizeof(level_default));
+        pipeline = level_default;
+    }
+
+    jit_t jit = mem_alloc(sizeof(struct jit_t));
+    jit->compilation = compilation;
+    jit->level = level;
+    jit->pipeline = mem_alloc(strlen(pipeline) + 1);
+    strcpy(jit->pipeline, pipeline);
+    jit->call_through = NULL;
+    jit->stubs = NULL;
+    jit->tier = NULL;
+    jit->stats = (jit_stats_t){ 0 };
+    atomic_init(&jit->lazy_compile, 0);
+    atomic_init(&jit->lazy_compiled, 0);
+
+    array_t(unit_t) unit_s = compilation_unit_s(compilation);
+    for (size_t i = 0; i < array_size(unit_s); i++)
+        jit->stats.functions += array_size(unit_declaration_s(unit_s[i]));
+
+    jit->lljit = lljit_new(level);
+    bool succeeded = jit->lljit != NULL;
+    if (succeeded)
+    {
+        static bool (*const add[])(jit_t) =
+        {
+            [JIT_EAGER] = eager_add,
+            [JIT_LAZY] = lazy_add,
+            [JIT_TIERED] = tier_add,
+        };
+        succeeded = add[mode](jit);
+    }
+
+    if (!succeeded)
+    {
+        jit_free(jit);
+        return NULL;
+    }
+
+    jit->stats.compile = now() - start;
+    return jit;
+}
+
+void jit_free(jit_t jit)
+{
+    // the compiler thread and unmaterialized units still use the compilation
+    if (jit->tier != NULL)
+        tier_free(jit->tier);
+    // the stubs and the call-through manager go before the session, as
+    // in LLVM's own lazy JIT; the other way round corrupts the heap
+    if (jit->stubs != NULL)
+        LLVMOrcDisposeIndirectStubsManager(jit->stubs);
+    if (jit->call_through != NULL)
+        LLVMOrcDisposeLazyCallThroughManager(jit->call_through);
+    if (jit->lljit != NULL)
+        report(LLVMOrcDisposeLLJIT(jit->lljit), "jit");
+
+    compilation_free(jit->compilation);
+    mem_free(jit->pipeline);
+    mem_free(jit);
+}
+
+// The entry of main; in tiered mode, whatever its slot holds.
+static
+bool resolve_main(jit_t jit, LLVMOrcExecutorAddress *address)
+{
+    if (jit->tier == NULL)
+        return report(LLVMOrcLLJITLookup(jit->lljit, address, "main"), "jit");
+
+    symbol_t symbol = symbol_find(span_sz("main"));
+    uint32_t index = symbol < jit->tier->symbols ? jit->tier->index_s[symbol] : 0;
+    if (index == 0)
+    {
+        fprintf(stderr, "jit: main is not defined\n");
+        return false;
+    }
+
+    *address = atomic_load(&jit->tier->slot_s[index - 1]);
+    return true;
+}
+
+bool jit_run(jit_t jit, int *status)
+{
+    uint64_t start = now();
+
+    LLVMOrcExecutorAddress address = 0;
+    if (!resolve_main(jit, &address))
+        return false;
+
+    if (jit->tier != NULL)
+    {
+        pthread_mutex_lock(&jit->tier->mutex);
+        jit->tier->start = start;
+        pthread_mutex_unlock(&jit->tier->mutex);
+    }
+
+    uint64_t compiled = now();
+    jit->stats.compile += compiled - start;
+
+    int (*entry)(void) = (int (*)(void))address;
+    *status = entry();
+
+    // functions compiled on their first call count as compile time
+    uint64_t lazy = atomic_exchange(&jit->lazy_compile, 0);
+    jit->stats.run = now() - compiled - lazy;
+    jit->stats.compile += lazy;
+    return true;
+}
+
+jit_stats_t jit_stats(jit_t jit)
+{
+    jit_stats_t stats = jit->stats;
+    stats.compiled += atomic_load(&jit->lazy_compiled);
+
+    if (jit->tier != NULL)
+    {
+        pthread_mutex_lock(&jit->tier->mutex);
+        stats.tier_ups = array_size(jit->tier->tier_up_s);
+        pthread_mutex_unlock(&jit->tier->mutex);
+    }
+
+    return stats;
+}
+
+jit_tier_up_t jit_tier_up(jit_t jit, size_t index)
+{
+    pthread_mutex_lock(&jit->tier->mutex);
+    jit_tier_up_t tier_up = jit->tier->tier_up_s[index];
+    pthread_mutex_unlock(&jit->tier->mutex);
+
+    return tier_up;
+}
+
+void jit_settle(jit_t jit)
+{
+    if (jit->tier == NULL)
+        return;
+
+    tier_t *tier = jit->tier;
+    pthread_mutex_lock(&tier->mutex);
+    while (array_size(tier->pending_s) > 0 || tier->busy)
+        pthread_cond_wait(&tier->idle, &tier->mutex);
+    pthread_mutex_unlock(&tier->mutex);
+}
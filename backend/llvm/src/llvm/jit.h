@@ -0,0 +1,65 @@
+#ifndef _JIT_H_
+#define _JIT_H_
+
+#include "ast/ast.h"
+#include "llvm/backend.h"
+
+#include <stdint.h>
+
+typedef  struct jit_t*  jit_t;
+
+typedef enum jit_mode_t jit_mode_t;
+enum jit_mode_t
+{
+    // Every function is generated and optimized before main starts.
+    JIT_EAGER,
+    // Every function is a stub until its first call, which generates and
+    // optimizes that function alone. Calls between functions go through
+    // the stubs, so nothing is inlined across functions.
+    JIT_LAZY,
+    // Every function starts as O0 code that counts its calls. A function
+    // called often enough is recompiled alone at the level, or with the
+    // pipeline, on a background thread and its callers switch to the new
+    // code on their next call.
+    JIT_TIERED,
+};
+
+// Wall clock time of each phase, in nanoseconds, and how many functions
+// had code generated.
+typedef struct jit_stats_t jit_stats_t;
+struct jit_stats_t
+{
+    uint64_t    compile;    // codegen, optimization and machine code
+    uint64_t    run;        // main, until it returns, less lazy compiles
+    size_t      functions;
+    size_t      compiled;   // functions whose code was generated
+    size_t      tier_ups;   // functions recompiled by the tiered mode
+};
+
+// A function the tiered mode recompiled.
+typedef struct jit_tier_up_t jit_tier_up_t;
+struct jit_tier_up_t
+{
+    const char *function;
+    uint64_t    at;         // since its run started, when callers switched
+    uint64_t    compile;    // spent recompiling it
+};
+
+// Adds the units to an ORC JIT, to be optimized with the pipeline or the
+// default one of the level when NULL. Eagerly, every unit is generated and
+// optimized here. Takes ownership of the compilation. A pipeline that does
+// not parse is reported on stderr and returns NULL.
+jit_t       jit_compile(compilation_t compilation, jit_mode_t mode, backend_level_t level, const char *pipeline);
+void        jit_free(jit_t jit);
+
+// Resolves main, which materializes the machine code, and calls it in
+// this process. Returns false if main cannot be resolved.
+bool        jit_run(jit_t jit, int *status);
+jit_stats_t jit_stats(jit_t jit);
+
+// The tier-ups so far, index below jit_stats(jit).tier_ups, in the order
+// they happened. jit_settle waits until every requested one is done.
+jit_tier_up_t jit_tier_up(jit_t jit, size_t index);
+void        jit_settle(jit_t jit);
+
+#endif
@@ -2,52 +2,53 @@
 
 #include "map.h"
 
-struct key_value_t
-{
-    declaration_t key;
-    LLVMValueRef value;
-};
+#include <assert.h>
+#include <string.h>
 
 struct map_t
 {
-    array_t(struct key_value_t) data;
+    LLVMValueRef *value_s;
+    uint32_t      size;
 };
 
-map_t map_new()
+// Sized for ids 0..declarations up front; map_at still grows it for
+// declarations numbered after the map was made.
+map_t map_new(uint32_t declarations)
 {
     map_t map = mem_alloc(sizeof(struct map_t));
-    map->data = array_empty();
+    map->size = declarations + 1;
+    map->value_s = mem_alloc(map->size * sizeof(LLVMValueRef));
+    memset(map->value_s, 0, map->size * sizeof(LLVMValueRef));
     return map;
 }
 
 void map_free(map_t map)
 {
-    array_free(map->data);
+    mem_free(map->value_s);
     mem_free(map);
 }
 
 LLVMValueRef map_get(map_t map, declaration_t declaration)
 {
-    size_t size = array_size(map->data);
-    for (int i = 0; i < size; i++)
-    {
-        struct key_value_t key_value = map->data[i];
-        if (key_value.key == declaration)
-            return key_value.value;
-    }
+    if (declaration == NULL)
+        return NULL;
 
-    return NULL;
+    uint32_t id = declaration_id(declaration);
+    return id < map->size ? map->value_s[id] : NULL;
 }
 
 void map_at(map_t map, declaration_t declaration, LLVMValueRef llvm_value)
 {
-    size_t size = array_size(map->data);
-    for (int i = 0; i < size; i++)
+    uint32_t id = declaration_id(declaration);
+    assert(id != 0 && "declaration not numbered by sema");
+
+    if (id >= map->size)
     {
-        struct key_value_t key_value = map->data[i];
-        if (key_value.key == declaration)
-            map->data[i].value = llvm_value;
+        uint32_t size = map->size * 2 > id ? map->size * 2 : id + 1;
+        map->value_s = mem_realloc(map->value_s, size * sizeof(LLVMValueRef));
+        memset(map->value_s + map->size, 0, (size - map->size) * sizeof(LLVMValueRef));
+        map->size = size;
     }
-    struct key_value_t key_value = {declaration, llvm_value};
-    map->data = array_add(map->data, key_value);
+
+    map->value_s[id] = llvm_value;
 }
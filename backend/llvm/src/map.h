@@ -4,9 +4,10 @@
 #include "ast/ast.h"
 #include <llvm-c/Core.h>
 
+// Values of declarations, indexed by the dense id sema gave each one.
 typedef  struct map_t*  map_t;
 
-map_t         map_new();
+map_t         map_new(uint32_t declarations);
 void          map_free(map_t map);
 
 LLVMValueRef  map_get(map_t map, declaration_t declaration);
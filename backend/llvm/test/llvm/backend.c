@@ -4,12 +4,49 @@
 #include <string.h>
 #include <cmocka.h>
 
+#include <stdio.h>
+#include <unistd.h>
+
 #define LF "\n"
 
+#include "common/mem.h"
 #include "parser/parser.h"
 #include "sema/sema.h"
 #include "llvm/backend.h"
 
+static size_t count(const char *haystack, const char *needle)
+{
+    size_t n = 0;
+    for (const char *at = strstr(haystack, needle); at != NULL; at = strstr(at + 1, needle))
+        n++;
+
+    return n;
+}
+
+// Writes every artifact of every unit next to its source.
+static void emit(backend_t backend)
+{
+    array_t(unit_t) unit_s = compilation_unit_s(backend_compilation(backend));
+    size_t size = array_size(unit_s);
+
+    backend_output_t output_s[size * BACKEND_ARTIFACTS];
+    const char *extension_s[] = { ".o", ".s", ".ll", ".bc" };
+    for (size_t i = 0; i < size; i++)
+        for (size_t j = 0; j < BACKEND_ARTIFACTS; j++)
+        {
+            char *path = source_output_name(unit_source(unit_s[i]), extension_s[j]);
+            output_s[i * BACKEND_ARTIFACTS + j] = (backend_output_t){ i, j, path };
+        }
+
+    assert_true(backend_emit(backend, output_s, size * BACKEND_ARTIFACTS));
+
+    for (size_t i = 0; i < size * BACKEND_ARTIFACTS; i++)
+    {
+        assert_int_equal(0, access(output_s[i].path, F_OK));
+        mem_free((char*)output_s[i].path);
+    }
+}
+
 static void success_branch(void **arg)
 {
     (void) arg;
@@ -18,15 +55,13 @@ static void success_branch(void **arg)
         source_t code_v001 = source_load("../docs/samples/v0.0.1.iz");
         unit_t unit = syntax_analysis(code_v001);
         compilation_t compilation = semantic_analysis(array_add(array_empty(), unit));
-        backend_t backend = backend_codegen(compilation);
+        backend_t backend = backend_codegen(compilation, BACKEND_O3);
         assert_non_null(backend);
 
         assert_true(backend_validate(backend));
-        backend_optimize(backend);
+        backend_optimize(backend, NULL);
         backend_dump(backend);
-        backend_emit_object(backend);
-        backend_emit_assembly(backend);
-        backend_emit_llvm(backend);
+        emit(backend);
 
         backend_free(backend);
     }
@@ -35,15 +70,13 @@ static void success_branch(void **arg)
         source_t code_v002 = source_load("../docs/samples/v0.0.2.iz");
         unit_t unit = syntax_analysis(code_v002);
         compilation_t compilation = semantic_analysis(array_add(array_empty(), unit));
-        backend_t backend = backend_codegen(compilation);
+        backend_t backend = backend_codegen(compilation, BACKEND_O3);
         assert_non_null(backend);
 
         assert_true(backend_validate(backend));
-        //backend_optimize(backend);
+        //backend_optimize(backend, NULL);
         backend_dump(backend);
-        backend_emit_object(backend);
-        backend_emit_assembly(backend);
-        backend_emit_llvm(backend);
+        emit(backend);
 
         backend_free(backend);
     }
@@ -52,15 +85,13 @@ static void success_branch(void **arg)
         source_t code_v003 = source_load("../docs/samples/v0.0.3.iz");
         unit_t unit = syntax_analysis(code_v003);
         compilation_t compilation = semantic_analysis(array_add(array_empty(), unit));
-        backend_t backend = backend_codegen(compilation);
+        backend_t backend = backend_codegen(compilation, BACKEND_O3);
         assert_non_null(backend);
 
         assert_true(backend_validate(backend));
-        //backend_optimize(backend);
+        //backend_optimize(backend, NULL);
         backend_dump(backend);
-        backend_emit_object(backend);
-        backend_emit_assembly(backend);
-        backend_emit_llvm(backend);
+        emit(backend);
 
         backend_free(backend);
     }
@@ -69,15 +100,13 @@ static void success_branch(void **arg)
         source_t code_v004 = source_load("../docs/samples/v0.0.4.iz");
         unit_t unit = syntax_analysis(code_v004);
         compilation_t compilation = semantic_analysis(array_add(array_empty(), unit));
-        backend_t backend = backend_codegen(compilation);
+        backend_t backend = backend_codegen(compilation, BACKEND_O3);
         assert_non_null(backend);
 
         assert_true(backend_validate(backend));
-        //backend_optimize(backend);
+        //backend_optimize(backend, NULL);
         backend_dump(backend);
-        backend_emit_object(backend);
-        backend_emit_assembly(backend);
-        backend_emit_llvm(backend);
+        emit(backend);
 
         backend_free(backend);
     }
@@ -86,14 +115,12 @@ static void success_branch(void **arg)
         source_t code_v005 = source_load("../docs/samples/v0.0.5.iz");
         unit_t unit = syntax_analysis(code_v005);
         compilation_t compilation = semantic_analysis(array_add(array_empty(), unit));
-        backend_t backend = backend_codegen(compilation);
+        backend_t backend = backend_codegen(compilation, BACKEND_O3);
         assert_non_null(backend);
 
         assert_true(backend_validate(backend));
         backend_dump(backend);
-        backend_emit_object(backend);
-        backend_emit_assembly(backend);
-        backend_emit_llvm(backend);
+        emit(backend);
 
         backend_free(backend);
     }
@@ -102,14 +129,12 @@ static void success_branch(void **arg)
         source_t code_v006 = source_load("../docs/samples/v0.0.6.iz");
         unit_t unit = syntax_analysis(code_v006);
         compilation_t compilation = semantic_analysis(array_add(array_empty(), unit));
-        backend_t backend = backend_codegen(compilation);
+        backend_t backend = backend_codegen(compilation, BACKEND_O3);
         assert_non_null(backend);
 
         assert_true(backend_validate(backend));
         backend_dump(backend);
-        backend_emit_object(backend);
-        backend_emit_assembly(backend);
-        backend_emit_llvm(backend);
+        emit(backend);
 
         backend_free(backend);
     }
@@ -133,17 +158,355 @@ static void success_branch(void **arg)
 
         unit_t unit = syntax_analysis(source_inline(code, "if_else_no_return.iz"));
         compilation_t compilation = semantic_analysis(array_add(array_empty(), unit));
-        backend_t backend = backend_codegen(compilation);
+        backend_t backend = backend_codegen(compilation, BACKEND_O3);
         assert_non_null(backend);
 
         assert_true(backend_validate(backend));
         backend_dump(backend);
-        backend_emit_object(backend);
-        backend_emit_assembly(backend);
-        backend_emit_llvm(backend);
+        emit(backend);
 
         backend_free(backend);
     }
+
+    {
+        // a call on the rhs only runs when the lhs does not decide the
+        // result; cheap operands are combined without branching
+        char *code =
+        "bool check(int n)"                     LF
+        "    return n > 10;"                    LF
+        "bool both(int n)"                      LF
+        "    return n > 0 && check(n);"         LF
+        "bool either(int n)"                    LF
+        "    return n > 0 || check(n) && n < 5;" LF
+        "bool cheap(bool a, int n)"             LF
+        "    return a && n != 3 || n < 2;"      LF
+        ;
+
+        unit_t unit = syntax_analysis(source_inline(code, "short_circuit.iz"));
+        compilation_t compilation = semantic_analysis(array_add(array_empty(), unit));
+        backend_t backend = backend_codegen(compilation, BACKEND_O3);
+        assert_non_null(backend);
+        assert_true(backend_validate(backend));
+
+        char *ir = backend_ir(backend, 0);
+        assert_int_equal(2, count(ir, "cond.rhs:"));
+        assert_int_equal(2, count(ir, "phi i1"));
+        assert_int_equal(2, count(ir, "call i1"));
+        assert_non_null(strstr(ir, "and i1"));
+        assert_non_null(strstr(ir, "or i1"));
+        mem_free(ir);
+
+        backend_free(backend);
+    }
+}
+
+static void optimize_level(void **arg)
+{
+    (void) arg;
+
+    char *code =
+    "int twice(int n)"                          LF
+    "{"                                         LF
+    "    int x = n;"                            LF
+    "    x = x + n;"                            LF
+    "    return x;"                             LF
+    "}"                                         LF
+    ;
+
+    {
+        // locals reach LLVM as SSA values, whatever the level
+        backend_level_t level_s[] = { BACKEND_O0, BACKEND_O1, BACKEND_O2, BACKEND_O3, BACKEND_OS, BACKEND_OZ };
+        for (size_t i = 0; i < sizeof(level_s) / sizeof(level_s[0]); i++)
+        {
+            unit_t unit = syntax_analysis(source_inline(code, "level.iz"));
+            compilation_t compilation = semantic_analysis(array_add(array_empty(), unit));
+            backend_t backend = backend_codegen(compilation, level_s[i]);
+            assert_true(backend_optimize(backend, NULL));
+            assert_true(backend_validate(backend));
+
+            char *ir = backend_ir(backend, 0);
+            assert_null(strstr(ir, "alloca"));
+            mem_free(ir);
+
+            backend_free(backend);
+        }
+    }
+
+    {
+        unit_t unit = syntax_analysis(source_inline(code, "pipeline.iz"));
+        compilation_t compilation = semantic_analysis(array_add(array_empty(), unit));
+        backend_t backend = backend_codegen(compilation, BACKEND_O0);
+        assert_true(backend_optimize(backend, "function(mem2reg)"));
+        assert_true(backend_validate(backend));
+
+        char *ir = backend_ir(backend, 0);
+        assert_null(strstr(ir, "alloca"));
+        mem_free(ir);
+
+        assert_false(backend_optimize(backend, "no-such-pass"));
+
+        backend_free(backend);
+    }
+}
+
+static char* read_file(const char *path, size_t *size)
+{
+    FILE *file = fopen(path, "rb");
+    assert_non_null(file);
+    fseek(file, 0, SEEK_END);
+    *size = ftell(file);
+    rewind(file);
+
+    char *data = mem_alloc(*size + 1);
+    assert_int_equal(*size, fread(data, 1, *size, file));
+    data[*size] = '\0';
+    fclose(file);
+
+    return data;
+}
+
+static void emit_output(void **arg)
+{
+    (void) arg;
+
+    char *code =
+    "int one()"         LF
+    "    return 1;"     LF
+    ;
+
+    unit_t unit = syntax_analysis(source_inline(code, "emit.iz"));
+    compilation_t compilation = semantic_analysis(array_add(array_empty(), unit));
+    backend_t backend = backend_codegen(compilation, BACKEND_O0);
+
+    {
+        // explicit paths; the same artifact twice is rendered once and written twice
+        backend_output_t output_s[] =
+        {
+            { 0, BACKEND_OBJECT,   "emit_out.o" },
+            { 0, BACKEND_ASSEMBLY, "emit_out.s" },
+            { 0, BACKEND_LLVM,     "emit_out.ll" },
+            { 0, BACKEND_BITCODE,  "emit_out.bc" },
+            { 0, BACKEND_OBJECT,   "emit_copy.o" },
+        };
+        assert_true(backend_emit(backend, output_s, 5));
+
+        size_t size, copy_size;
+        char *data = read_file("emit_out.o", &size);
+        assert_memory_equal("\x7f" "ELF", data, 4);
+        char *copy = read_file("emit_copy.o", &copy_size);
+        assert_int_equal(size, copy_size);
+        assert_memory_equal(data, copy, size);
+        mem_free(copy);
+        mem_free(data);
+
+        data = read_file("emit_out.s", &size);
+        assert_non_null(strstr(data, "one:"));
+        mem_free(data);
+
+        data = read_file("emit_out.ll", &size);
+        assert_non_null(strstr(data, "define i32 @one()"));
+        mem_free(data);
+
+        data = read_file("emit_out.bc", &size);
+        assert_memory_equal("BC\xc0\xde", data, 4);
+        mem_free(data);
+
+        for (size_t i = 0; i < 5; i++)
+            unlink(output_s[i].path);
+    }
+
+    {
+        assert_true(backend_emit(backend, NULL, 0));
+
+        backend_output_t output_s[] =
+        {
+            { 0, BACKEND_OBJECT, "emit_ok.o" },
+            { 0, BACKEND_OBJECT, "no/such/dir/emit.o" },
+        };
+        assert_false(backend_emit(backend, output_s, 2));
+        assert_int_equal(0, access("emit_ok.o", F_OK));
+        unlink("emit_ok.o");
+    }
+
+    backend_free(backend);
+}
+
+// Writes code to path and parses it, so every unit has a source of its own.
+static unit_t unit_file(const char *path, const char *code)
+{
+    FILE *file = fopen(path, "w");
+    assert_non_null(file);
+    fputs(code, file);
+    fclose(file);
+
+    unit_t unit = syntax_analysis(source_load(path));
+    assert_non_null(unit);
+    unlink(path);
+
+    return unit;
+}
+
+// add1 is small enough for thin LTO to import, big is not
+static backend_t lto_backend(void)
+{
+    char big[4096] = "int big(int n)" LF "    return add1(n)";
+    for (int i = 1; i < 60; i++)
+        snprintf(big + strlen(big), sizeof(big) - strlen(big), " * add1(n + %d)", i);
+    strcat(big, ";" LF);
+
+    array_t(unit_t) unit_s = array_empty();
+    unit_t unit = unit_file("lto_add.iz", "int add1(int n)" LF "    return n + 1;" LF);
+    unit_s = array_add(unit_s, unit);
+    unit = unit_file("lto_big.iz", big);
+    unit_s = array_add(unit_s, unit);
+    // through a local, so sema does not run the calls
+    unit = unit_file("lto_main.iz", "int main()" LF "{" LF "    int n = 41;" LF "    return add1(n) + big(n - 41);" LF "}" LF);
+    unit_s = array_add(unit_s, unit);
+
+    compilation_t compilation = semantic_analysis(unit_s);
+    assert_non_null(compilation);
+
+    return backend_codegen(compilation, BACKEND_O2);
+}
+
+static void lto(void **arg)
+{
+    (void) arg;
+
+    {
+        backend_t backend = lto_backend();
+        const char *export_s[] = { "main" };
+        assert_true(backend_lto(backend, BACKEND_LTO_FULL, export_s, 1));
+        assert_int_equal(1, backend_modules(backend));
+        assert_true(backend_validate(backend));
+        assert_true(backend_optimize(backend, NULL));
+        assert_true(backend_validate(backend));
+
+        // everything but main is internal, inlined and gone
+        char *ir = backend_ir(backend, 0);
+        assert_int_equal(1, count(ir, "define "));
+        assert_non_null(strstr(ir, "define i32 @main()"));
+        assert_null(strstr(ir, "call "));
+        mem_free(ir);
+
+        backend_output_t output_s[] = { { 0, BACKEND_OBJECT, "lto_full.o" } };
+        assert_true(backend_emit(backend, output_s, 1));
+        assert_int_equal(0, access("lto_full.o", F_OK));
+        unlink("lto_full.o");
+
+        backend_free(backend);
+    }
+
+    {
+        // an exported function keeps its definition
+        backend_t backend = lto_backend();
+        const char *export_s[] = { "main", "add1" };
+        assert_true(backend_lto(backend, BACKEND_LTO_FULL, export_s, 2));
+        assert_true(backend_optimize(backend, NULL));
+
+        char *ir = backend_ir(backend, 0);
+        assert_non_null(strstr(ir, "define i32 @add1("));
+        assert_null(strstr(ir, "@big("));
+        mem_free(ir);
+
+        backend_free(backend);
+    }
+
+    {
+        backend_t backend = lto_backend();
+        assert_true(backend_lto(backend, BACKEND_LTO_THIN, NULL, 0));
+        assert_int_equal(3, backend_modules(backend));
+        assert_true(backend_validate(backend));
+
+        // main imports add1 but not big, which is over the limit
+        char *ir = backend_ir(backend, 2);
+        assert_non_null(strstr(ir, "define available_externally i32 @add1("));
+        assert_non_null(strstr(ir, "declare i32 @big("));
+        mem_free(ir);
+
+        assert_true(backend_optimize(backend, NULL));
+        assert_true(backend_validate(backend));
+
+        ir = backend_ir(backend, 2);
+        assert_null(strstr(ir, "@add1"));
+        assert_non_null(strstr(ir, "call i32 @big(i32 0)"));
+        mem_free(ir);
+
+        // the imported copies are not emitted, the definition still is
+        ir = backend_ir(backend, 0);
+        assert_non_null(strstr(ir, "define i32 @add1("));
+        mem_free(ir);
+        ir = backend_ir(backend, 1);
+        assert_null(strstr(ir, "call i32 @add1"));
+        mem_free(ir);
+
+        backend_free(backend);
+    }
+}
+
+static void parallel_units(void **arg)
+{
+    (void) arg;
+
+    // each unit calls into the previous one, so every module but the
+    // first declares a function defined in another module
+    enum { UNITS = 24 };
+    char path_s[UNITS][32];
+    array_t(unit_t) unit_s = array_empty();
+    for (int i = 0; i < UNITS; i++)
+    {
+        snprintf(path_s[i], sizeof(path_s[i]), "parallel_%d.iz", i);
+        FILE *file = fopen(path_s[i], "w");
+        assert_non_null(file);
+        if (i == 0)
+            fprintf(file, "int f0(int n)\n    return n;\n");
+        else
+            fprintf(file, "int f%d(int n)\n    return f%d(n) + 1;\n", i, i - 1);
+        fclose(file);
+
+        unit_t unit = syntax_analysis(source_load(path_s[i]));
+        assert_non_null(unit);
+        unit_s = array_add(unit_s, unit);
+    }
+
+    compilation_t compilation = semantic_analysis(unit_s);
+    assert_non_null(compilation);
+    backend_t backend = backend_codegen(compilation, BACKEND_O2);
+    assert_true(backend_validate(backend));
+    assert_true(backend_optimize(backend, NULL));
+    assert_true(backend_validate(backend));
+
+    // modules come back in unit order regardless of which worker built them
+    for (int i = 0; i < UNITS; i++)
+    {
+        char define[32], declare[32];
+        snprintf(define, sizeof(define), "define i32 @f%d(", i);
+        snprintf(declare, sizeof(declare), "declare i32 @f%d(", i - 1);
+
+        char *ir = backend_ir(backend, i);
+        assert_non_null(strstr(ir, define));
+        assert_int_equal(i > 0, strstr(ir, declare) != NULL);
+        mem_free(ir);
+    }
+
+    backend_output_t output_s[UNITS];
+    char *object_s[UNITS];
+    for (int i = 0; i < UNITS; i++)
+    {
+        object_s[i] = source_output_name(unit_source(unit_s[i]), ".o");
+        output_s[i] = (backend_output_t){ i, BACKEND_OBJECT, object_s[i] };
+    }
+    assert_true(backend_emit(backend, output_s, UNITS));
+
+    for (int i = 0; i < UNITS; i++)
+    {
+        assert_int_equal(0, access(object_s[i], F_OK));
+        unlink(object_s[i]);
+        unlink(path_s[i]);
+        mem_free(object_s[i]);
+    }
+
+    backend_free(backend);
 }
 
 int main()
@@ -151,6 +514,10 @@ int main()
     const struct CMUnitTest tests[] =
     {
         cmocka_unit_test(success_branch),
+        cmocka_unit_test(optimize_level),
+        cmocka_unit_test(emit_output),
+        cmocka_unit_test(parallel_units),
+        cmocka_unit_test(lto),
     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
@@ -0,0 +1,223 @@
+#include <stdlib.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include <stdio.h>
+
+#define LF "\n"
+
+#include "parser/parser.h"
+#include "sema/sema.h"
+#include "llvm/jit.h"
+
+static compilation_t compile(const char *const *code_s, size_t size)
+{
+    array_t(unit_t) unit_s = array_empty();
+    for (size_t i = 0; i < size; i++)
+    {
+        char path[32];
+        snprintf(path, sizeof(path), "unit%zu.iz", i);
+        unit_t unit = syntax_analysis(source_inline(code_s[i], path));
+        assert_non_null(unit);
+        unit_s = array_add(unit_s, unit);
+    }
+
+    compilation_t compilation = semantic_analysis(unit_s);
+    assert_non_null(compilation);
+
+    return compilation;
+}
+
+static const char *const fib_s[] =
+{
+    "int fib(int n)" LF
+    "{" LF
+    "    if (n < 2)" LF
+    "        return n;" LF
+    "    return fib(n - 1) + fib(n - 2);" LF
+    "}" LF,
+
+    // through a local, so sema does not run the call
+    "int main()" LF
+    "{" LF
+    "    int n = 10;" LF
+    "    return fib(n) - 13;" LF
+    "}" LF
+    "int unused(int n)" LF
+    "    return fib(n) * 2;" LF,
+};
+
+static void run(void **arg)
+{
+    (void) arg;
+
+    backend_level_t level_s[] = { BACKEND_O0, BACKEND_O1, BACKEND_O2, BACKEND_O3, BACKEND_OS, BACKEND_OZ };
+    for (jit_mode_t mode = JIT_EAGER; mode <= JIT_TIERED; mode++)
+        for (size_t i = 0; i < sizeof(level_s) / sizeof(level_s[0]); i++)
+        {
+            jit_t jit = jit_compile(compile(fib_s, 2), mode, level_s[i], NULL);
+            assert_non_null(jit);
+
+            int status = 0;
+            assert_true(jit_run(jit, &status));
+            assert_int_equal(42, status);
+
+            jit_stats_t stats = jit_stats(jit);
+            assert_true(stats.compile > 0);
+            assert_int_equal(3, stats.functions);
+
+            jit_free(jit);
+        }
+
+    {
+        const char *code = "int main()" LF "    return 42;" LF;
+        jit_t jit = jit_compile(compile(&code, 1), JIT_EAGER, BACKEND_O0, "function(mem2reg,instcombine)");
+        assert_non_null(jit);
+
+        int status = 0;
+        assert_true(jit_run(jit, &status));
+        assert_int_equal(42, status);
+
+        jit_free(jit);
+    }
+}
+
+static void lazy(void **arg)
+{
+    (void) arg;
+
+    // unused is never called, so never compiled
+    {
+        jit_t jit = jit_compile(compile(fib_s, 2), JIT_LAZY, BACKEND_O2, NULL);
+        assert_non_null(jit);
+        assert_int_equal(0, jit_stats(jit).compiled);
+
+        int status = 0;
+        assert_true(jit_run(jit, &status));
+        assert_int_equal(42, status);
+        assert_int_equal(2, jit_stats(jit).compiled);
+
+        // the second run finds everything compiled
+        assert_true(jit_run(jit, &status));
+        assert_int_equal(42, status);
+        assert_int_equal(2, jit_stats(jit).compiled);
+
+        jit_free(jit);
+    }
+
+    {
+        jit_t jit = jit_compile(compile(fib_s, 2), JIT_EAGER, BACKEND_O2, NULL);
+        assert_non_null(jit);
+        assert_int_equal(3, jit_stats(jit).compiled);
+        jit_free(jit);
+    }
+
+    // dropped before anything was compiled
+    {
+        jit_t jit = jit_compile(compile(fib_s, 2), JIT_LAZY, BACKEND_O0, NULL);
+        assert_non_null(jit);
+        jit_free(jit);
+    }
+}
+
+// fib(20) makes 21891 calls, enough for fib to tier up but not main
+static const char *const hot_s[] =
+{
+    "int fib(int n)" LF
+    "{" LF
+    "    if (n < 2)" LF
+    "        return n;" LF
+    "    return fib(n - 1) + fib(n - 2);" LF
+    "}" LF,
+
+    "int twice(int n)" LF
+    "    return fib(n) + fib(n);" LF
+    "int main()" LF
+    "    return twice(20) - 13488;" LF,
+};
+
+static void tiered(void **arg)
+{
+    (void) arg;
+
+    jit_t jit = jit_compile(compile(hot_s, 2), JIT_TIERED, BACKEND_O3, NULL);
+    assert_non_null(jit);
+    assert_int_equal(3, jit_stats(jit).compiled);
+
+    int status = 0;
+    assert_true(jit_run(jit, &status));
+    assert_int_equal(42, status);
+
+    jit_settle(jit);
+    jit_stats_t stats = jit_stats(jit);
+    assert_int_equal(1, stats.tier_ups);
+
+    jit_tier_up_t tier_up = jit_tier_up(jit, 0);
+    assert_string_equal("fib", tier_up.function);
+    assert_true(tier_up.compile > 0);
+
+    // callers now reach the optimized fib, and nothing tiers up twice
+    for (int i = 0; i < 3; i++)
+    {
+        assert_true(jit_run(jit, &status));
+        assert_int_equal(42, status);
+    }
+    jit_settle(jit);
+    assert_int_equal(1, jit_stats(jit).tier_ups);
+
+    jit_free(jit);
+
+    // dropped while fib may still be recompiling
+    jit = jit_compile(compile(hot_s, 2), JIT_TIERED, BACKEND_O2, NULL);
+    assert_true(jit_run(jit, &status));
+    assert_int_equal(42, status);
+    jit_free(jit);
+}
+
+static void failure(void **arg)
+{
+    (void) arg;
+
+    // no main to resolve
+    {
+        const char *code = "int one()" LF "    return 1;" LF;
+        jit_t jit = jit_compile(compile(&code, 1), JIT_LAZY, BACKEND_O2, NULL);
+        assert_non_null(jit);
+
+        int status = -1;
+        assert_false(jit_run(jit, &status));
+        assert_int_equal(-1, status);
+
+        jit_free(jit);
+    }
+
+    assert_null(jit_compile(compile(fib_s, 2), JIT_EAGER, BACKEND_O2, "no-such-pass"));
+    assert_null(jit_compile(compile(fib_s, 2), JIT_LAZY, BACKEND_O2, "no-such-pass"));
+    assert_null(jit_compile(compile(fib_s, 2), JIT_TIERED, BACKEND_O2, "no-such-pass"));
+
+    {
+        const char *code = "int one()" LF "    return 1;" LF;
+        jit_t jit = jit_compile(compile(&code, 1), JIT_TIERED, BACKEND_O2, NULL);
+        assert_non_null(jit);
+
+        int status = -1;
+        assert_false(jit_run(jit, &status));
+        jit_settle(jit);
+        jit_free(jit);
+    }
+}
+
+int main()
+{
+    const struct CMUnitTest tests[] =
+    {
+        cmocka_unit_test(run),
+        cmocka_unit_test(lazy),
+        cmocka_unit_test(tiered),
+        cmocka_unit_test(failure),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -5,19 +5,25 @@
 #include <cmocka.h>
 
 #include "map.h"
+#include "common/arena.h"
 
 static void success_branch(void **arg)
 {
     (void) arg;
 
+    arena_t arena = arena_new();
+    arena_use(arena);
+
     {
-        map_t map = map_new();
+        map_t map = map_new(1);
 
         assert_null(map_get(map, NULL));
 
-        declaration_t declaration = (declaration_t)10;
+        declaration_t declaration = argument_new(type_int(), (struct location_t){ .span = span_sz("a") });
+        declaration_set_id(declaration, 1);
         LLVMValueRef llvm_value = (LLVMValueRef)100;
 
+        assert_null(map_get(map, declaration));
         map_at(map, declaration, llvm_value);
         assert_int_equal(map_get(map, declaration), llvm_value);
 
@@ -28,15 +34,20 @@ static void success_branch(void **arg)
         map_at(map, declaration, llvm_other_value);
         assert_int_equal(map_get(map, declaration), llvm_other_value);
 
-
-        declaration_t declaration_other = (declaration_t)20;
+        // numbered past the size the map was made for
+        declaration_t declaration_other = argument_new(type_int(), (struct location_t){ .span = span_sz("b") });
+        declaration_set_id(declaration_other, 20);
         LLVMValueRef llvm_other_value2 = (LLVMValueRef)10000;
 
+        assert_null(map_get(map, declaration_other));
         map_at(map, declaration_other, llvm_other_value2);
         assert_int_equal(map_get(map, declaration_other), llvm_other_value2);
+        assert_int_equal(map_get(map, declaration), llvm_other_value);
 
         map_free(map);
     }
+
+    arena_free(arena);
 }
 
 int main()
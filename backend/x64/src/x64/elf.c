@@ -0,0 +1,139 @@
+#include "x64/elf.h"
+#include "common/mem.h"
+
+#include <elf.h>
+#include <string.h>
+
+enum
+{
+    SECTION_NULL,
+    SECTION_TEXT,
+    SECTION_RELA,
+    SECTION_SYMTAB,
+    SECTION_STRTAB,
+    SECTION_NOTE,
+    SECTION_SHSTRTAB,
+    SECTIONS,
+};
+
+// Section names, at the offsets below.
+static const char shstrtab[] = "\0.text\0.rela.text\0.symtab\0.strtab\0.note.GNU-stack\0.shstrtab";
+static const uint32_t section_name_s[SECTIONS] = { 0, 1, 7, 18, 26, 34, 50 };
+
+// Locals come before globals: the null symbol, the file and .text.
+#define LOCAL_SYMBOLS 3
+
+static inline
+size_t align(size_t size, size_t alignment)
+{
+    return (size + alignment - 1) & ~(alignment - 1);
+}
+
+static
+void section(Elf64_Shdr *header, int index, uint32_t type, uint64_t flags, size_t offset, size_t size)
+{
+    header[index].sh_name = section_name_s[index];
+    header[index].sh_type = type;
+    header[index].sh_flags = flags;
+    header[index].sh_offset = offset;
+    header[index].sh_size = size;
+    header[index].sh_addralign = 1;
+}
+
+uint8_t* elf_object(const char *file, const uint8_t *text, size_t text_size,
+                    const elf_symbol_t *symbol_s, size_t symbols,
+                    const elf_call_t *call_s, size_t calls, size_t *size)
+{
+    size_t str_size = 1 + strlen(file) + 1;
+    for (size_t i = 0; i < symbols; i++)
+        str_size += strlen(symbol_s[i].name) + 1;
+
+    size_t text_offset = align(sizeof(Elf64_Ehdr), 16);
+    size_t rela_offset = align(text_offset + text_size, 8);
+    size_t rela_size = calls * sizeof(Elf64_Rela);
+    size_t sym_offset = rela_offset + rela_size;
+    size_t sym_size = (LOCAL_SYMBOLS + symbols) * sizeof(Elf64_Sym);
+    size_t str_offset = sym_offset + sym_size;
+    size_t shstr_offset = str_offset + str_size;
+    size_t sh_offset = align(shstr_offset + sizeof(shstrtab), 8);
+    *size = sh_offset + SECTIONS * sizeof(Elf64_Shdr);
+
+    uint8_t *image = mem_alloc(*size);
+    memset(image, 0, *size);
+
+    Elf64_Ehdr *elf = (Elf64_Ehdr*)image;
+    memcpy(elf->e_ident, ELFMAG, SELFMAG);
+    elf->e_ident[EI_CLASS] = ELFCLASS64;
+    elf->e_ident[EI_DATA] = ELFDATA2LSB;
+    elf->e_ident[EI_VERSION] = EV_CURRENT;
+    elf->e_ident[EI_OSABI] = ELFOSABI_SYSV;
+    elf->e_type = ET_REL;
+    elf->e_machine = EM_X86_64;
+    elf->e_version = EV_CURRENT;
+    elf->e_shoff = sh_offset;
+    elf->e_ehsize = sizeof(Elf64_Ehdr);
+    elf->e_shentsize = sizeof(Elf64_Shdr);
+    elf->e_shnum = SECTIONS;
+    elf->e_shstrndx = SECTION_SHSTRTAB;
+
+    memcpy(image + text_offset, text, text_size);
+
+    Elf64_Rela *rela = (Elf64_Rela*)(image + rela_offset);
+    for (size_t i = 0; i < calls; i++)
+    {
+        rela[i].r_offset = call_s[i].offset;
+        rela[i].r_info = ELF64_R_INFO(LOCAL_SYMBOLS + call_s[i].symbol, R_X86_64_PLT32);
+        // the displacement counts from the end of the call
+        rela[i].r_addend = -4;
+    }
+
+    char *str = (char*)(image + str_offset);
+    size_t name = 1;
+    strcpy(str + name, file);
+
+    Elf64_Sym *sym = (Elf64_Sym*)(image + sym_offset);
+    sym[1].st_name = name;
+    sym[1].st_info = ELF64_ST_INFO(STB_LOCAL, STT_FILE);
+    sym[1].st_shndx = SHN_ABS;
+    sym[2].st_info = ELF64_ST_INFO(STB_LOCAL, STT_SECTION);
+    sym[2].st_shndx = SECTION_TEXT;
+    name += strlen(file) + 1;
+
+    for (size_t i = 0; i < symbols; i++)
+    {
+        Elf64_Sym *symbol = &sym[LOCAL_SYMBOLS + i];
+        symbol->st_name = name;
+        symbol->st_info = ELF64_ST_INFO(STB_GLOBAL, symbol_s[i].defined ? STT_FUNC : STT_NOTYPE);
+        symbol->st_shndx = symbol_s[i].defined ? SECTION_TEXT : SHN_UNDEF;
+        symbol->st_value = symbol_s[i].value;
+        symbol->st_size = symbol_s[i].size;
+
+        strcpy(str + name, symbol_s[i].name);
+        name += strlen(symbol_s[i].name) + 1;
+    }
+
+    memcpy(image + shstr_offset, shstrtab, sizeof(shstrtab));
+
+    Elf64_Shdr *header = (Elf64_Shdr*)(image + sh_offset);
+    section(header, SECTION_TEXT, SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, text_offset, text_size);
+    header[SECTION_TEXT].sh_addralign = 16;
+
+    section(header, SECTION_RELA, SHT_RELA, SHF_INFO_LINK, rela_offset, rela_size);
+    header[SECTION_RELA].sh_link = SECTION_SYMTAB;
+    header[SECTION_RELA].sh_info = SECTION_TEXT;
+    header[SECTION_RELA].sh_addralign = 8;
+    header[SECTION_RELA].sh_entsize = sizeof(Elf64_Rela);
+
+    section(header, SECTION_SYMTAB, SHT_SYMTAB, 0, sym_offset, sym_size);
+    header[SECTION_SYMTAB].sh_link = SECTION_STRTAB;
+    header[SECTION_SYMTAB].sh_info = LOCAL_SYMBOLS;
+    header[SECTION_SYMTAB].sh_addralign = 8;
+    header[SECTION_SYMTAB].sh_entsize = sizeof(Elf64_Sym);
+
+    section(header, SECTION_STRTAB, SHT_STRTAB, 0, str_offset, str_size);
+    // no executable stack
+    section(header, SECTION_NOTE, SHT_PROGBITS, 0, shstr_offset, 0);
+    section(header, SECTION_SHSTRTAB, SHT_STRTAB, 0, shstr_offset, sizeof(shstrtab));
+
+    return image;
+}
@@ -0,0 +1,35 @@
+#ifndef _ELF_OBJECT_H_
+#define _ELF_OBJECT_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// A global function symbol: defined at value in .text, or undefined.
+typedef struct elf_symbol_t elf_symbol_t;
+struct elf_symbol_t
+{
+    const char *name;
+    uint64_t    value;
+    uint64_t    size;
+    bool        defined;
+};
+
+// A call to symbol (an index into the symbols) whose 32 bit displacement
+// is at offset in .text.
+typedef struct elf_call_t elf_call_t;
+struct elf_call_t
+{
+    uint64_t    offset;
+    uint32_t    symbol;
+};
+
+// Lays out an x86-64 relocatable object with the code as .text, the
+// symbols as globals and the calls as R_X86_64_PLT32 relocations, the way
+// a C compiler's objects are, so the linker mixes them with any others.
+// Returns the image, from mem_alloc, and its size.
+uint8_t* elf_object(const char *file, const uint8_t *text, size_t text_size,
+                    const elf_symbol_t *symbol_s, size_t symbols,
+                    const elf_call_t *call_s, size_t calls, size_t *size);
+
+#endif
@@ -0,0 +1,277 @@
+#include "x64/encode.h"
+
+static inline
+void byte(code_t *code, uint8_t value)
+{
+    code->byte_s = array_add(code->byte_s, value);
+}
+
+static
+void imm32(code_t *code, int32_t value)
+{
+    uint32_t bits = (uint32_t)value;
+    for (int i = 0; i < 4; i++)
+        byte(code, bits >> (8 * i));
+}
+
+// A REX prefix when one is needed: 64 bit operand, an extended register,
+// or, with force, the low byte of rsp, rbp, rsi or rdi.
+static
+void rex(code_t *code, bool w, int reg, int base, bool force)
+{
+    uint8_t prefix = 0x40 | (w << 3) | ((reg >> 3) << 2) | (base >> 3);
+    if (prefix != 0x40 || force)
+        byte(code, prefix);
+}
+
+static inline
+bool byte_needs_rex(reg_t reg)
+{
+    return reg >= RSP && reg <= RDI;
+}
+
+static inline
+void direct(code_t *code, int reg, int rm)
+{
+    byte(code, 0xc0 | (reg & 7) << 3 | (rm & 7));
+}
+
+// [base + disp], with the shortest displacement.
+static
+void memory(code_t *code, int reg, reg_t base, int32_t disp)
+{
+    int mod = disp == 0 && (base & 7) != RBP ? 0 : disp >= -128 && disp <= 127 ? 1 : 2;
+    byte(code, mod << 6 | (reg & 7) << 3 | (base & 7));
+    if ((base & 7) == RSP)
+        byte(code, 0x24);
+
+    if (mod == 1)
+        byte(code, (int8_t)disp);
+    else if (mod == 2)
+        imm32(code, disp);
+}
+
+size_t code_size(code_t *code)
+{
+    return array_size(code->byte_s);
+}
+
+void asm_mov_rr(code_t *code, reg_t dst, reg_t src)
+{
+    rex(code, true, src, dst, false);
+    byte(code, 0x89);
+    direct(code, src, dst);
+}
+
+void asm_mov_ri(code_t *code, reg_t dst, int32_t imm)
+{
+    // writing the low 32 bits clears the rest
+    if (imm >= 0)
+    {
+        rex(code, false, 0, dst, false);
+        byte(code, 0xb8 + (dst & 7));
+        imm32(code, imm);
+        return;
+    }
+
+    rex(code, true, 0, dst, false);
+    byte(code, 0xc7);
+    direct(code, 0, dst);
+    imm32(code, imm);
+}
+
+void asm_load(code_t *code, load_t load, reg_t dst, reg_t base, int32_t disp)
+{
+    rex(code, true, dst, base, false);
+    switch (load) // LCOV_EXCL_LINE
+    {
+        case LOAD_I8:
+            byte(code, 0x0f);
+            byte(code, 0xbe);
+            break;
+        case LOAD_U8:
+            byte(code, 0x0f);
+            byte(code, 0xb6);
+            break;
+        case LOAD_I32:
+            byte(code, 0x63);
+            break;
+        case LOAD_I64:
+            byte(code, 0x8b);
+            break;
+    }
+    memory(code, dst, base, disp);
+}
+
+void asm_store(code_t *code, int width, reg_t base, int32_t disp, reg_t src)
+{
+    rex(code, width == 8, src, base, width == 1 && byte_needs_rex(src));
+    byte(code, width == 1 ? 0x88 : 0x89);
+    memory(code, src, base, disp);
+}
+
+void asm_lea(code_t *code, reg_t dst, reg_t base, int32_t disp)
+{
+    rex(code, true, dst, base, false);
+    byte(code, 0x8d);
+    memory(code, dst, base, disp);
+}
+
+void asm_alu32(code_t *code, alu_t op, reg_t dst, reg_t src)
+{
+    switch (op) // LCOV_EXCL_LINE
+    {
+        case ALU_ADD:
+            rex(code, false, src, dst, false);
+            byte(code, 0x01);
+            direct(code, src, dst);
+            break;
+        case ALU_SUB:
+            rex(code, false, src, dst, false);
+            byte(code, 0x29);
+            direct(code, src, dst);
+            break;
+        case ALU_IMUL:
+            rex(code, false, dst, src, false);
+            byte(code, 0x0f);
+            byte(code, 0xaf);
+            direct(code, dst, src);
+            break;
+    }
+}
+
+void asm_add_ri(code_t *code, reg_t dst, int32_t imm)
+{
+    rex(code, true, 0, dst, false);
+    if (imm >= -128 && imm <= 127)
+    {
+        byte(code, 0x83);
+        direct(code, 0, dst);
+        byte(code, (int8_t)imm);
+        return;
+    }
+
+    byte(code, 0x81);
+    direct(code, 0, dst);
+    imm32(code, imm);
+}
+
+void asm_and_ri(code_t *code, reg_t dst, int8_t imm)
+{
+    rex(code, true, 0, dst, false);
+    byte(code, 0x83);
+    direct(code, 4, dst);
+    byte(code, imm);
+}
+
+void asm_movsxd(code_t *code, reg_t dst, reg_t src)
+{
+    rex(code, true, dst, src, false);
+    byte(code, 0x63);
+    direct(code, dst, src);
+}
+
+void asm_movsx8(code_t *code, reg_t dst, reg_t src)
+{
+    rex(code, true, dst, src, false);
+    byte(code, 0x0f);
+    byte(code, 0xbe);
+    direct(code, dst, src);
+}
+
+void asm_cqo(code_t *code)
+{
+    byte(code, 0x48);
+    byte(code, 0x99);
+}
+
+void asm_idiv(code_t *code, reg_t divisor)
+{
+    rex(code, true, 0, divisor, false);
+    byte(code, 0xf7);
+    direct(code, 7, divisor);
+}
+
+void asm_cmp(code_t *code, reg_t lhs, reg_t rhs)
+{
+    rex(code, true, rhs, lhs, false);
+    byte(code, 0x39);
+    direct(code, rhs, lhs);
+}
+
+void asm_test(code_t *code, reg_t lhs, reg_t rhs)
+{
+    rex(code, true, rhs, lhs, false);
+    byte(code, 0x85);
+    direct(code, rhs, lhs);
+}
+
+void asm_set(code_t *code, cond_t cond, reg_t dst)
+{
+    // setcc writes the low byte only, movzx clears the rest
+    rex(code, false, 0, dst, byte_needs_rex(dst));
+    byte(code, 0x0f);
+    byte(code, 0x90 + cond);
+    direct(code, 0, dst);
+
+    rex(code, false, dst, dst, byte_needs_rex(dst));
+    byte(code, 0x0f);
+    byte(code, 0xb6);
+    direct(code, dst, dst);
+}
+
+size_t asm_jcc(code_t *code, cond_t cond)
+{
+    byte(code, 0x0f);
+    byte(code, 0x80 + cond);
+    size_t at = code_size(code);
+    imm32(code, 0);
+    return at;
+}
+
+size_t asm_jmp(code_t *code)
+{
+    byte(code, 0xe9);
+    size_t at = code_size(code);
+    imm32(code, 0);
+    return at;
+}
+
+size_t asm_call(code_t *code)
+{
+    byte(code, 0xe8);
+    size_t at = code_size(code);
+    imm32(code, 0);
+    return at;
+}
+
+void asm_patch(code_t *code, size_t at, size_t target)
+{
+    uint32_t rel = (uint32_t)(int32_t)(target - (at + 4));
+    for (int i = 0; i < 4; i++)
+        code->byte_s[at + i] = rel >> (8 * i);
+}
+
+void asm_push(code_t *code, reg_t reg)
+{
+    rex(code, false, 0, reg, false);
+    byte(code, 0x50 + (reg & 7));
+}
+
+void asm_push_mem(code_t *code, reg_t base, int32_t disp)
+{
+    rex(code, false, 0, base, false);
+    byte(code, 0xff);
+    memory(code, 6, base, disp);
+}
+
+void asm_pop(code_t *code, reg_t reg)
+{
+    rex(code, false, 0, reg, false);
+    byte(code, 0x58 + (reg & 7));
+}
+
+void asm_ret(code_t *code)
+{
+    byte(code, 0xc3);
+}
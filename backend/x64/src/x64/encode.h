@@ -0,0 +1,94 @@
+#ifndef _ENCODE_H_
+#define _ENCODE_H_
+
+#include "common/array.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Just enough of the x86-64 instruction set for the direct backend. Every
+// function appends the encoding to the buffer; memory operands are
+// [base + disp].
+
+typedef enum reg_t reg_t;
+enum reg_t
+{
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15,
+    REGISTERS,
+};
+
+// Condition codes, as in the low nibble of jcc and setcc.
+typedef enum cond_t cond_t;
+enum cond_t
+{
+    CC_E = 0x4,
+    CC_NE = 0x5,
+    CC_L = 0xc,
+    CC_GE = 0xd,
+    CC_LE = 0xe,
+    CC_G = 0xf,
+};
+
+// How a value of 8, 32 or 64 bits is read into a whole register.
+typedef enum load_t load_t;
+enum load_t
+{
+    LOAD_I8,            // sign extended
+    LOAD_U8,            // zero extended
+    LOAD_I32,           // sign extended
+    LOAD_I64,
+};
+
+typedef enum alu_t alu_t;
+enum alu_t
+{
+    ALU_ADD,
+    ALU_SUB,
+    ALU_IMUL,
+};
+
+typedef struct code_t code_t;
+struct code_t
+{
+    array_t(uint8_t)    byte_s;
+};
+
+size_t  code_size(code_t *code);
+
+void    asm_mov_rr(code_t *code, reg_t dst, reg_t src);
+// dst = imm, sign extended to 64 bits
+void    asm_mov_ri(code_t *code, reg_t dst, int32_t imm);
+void    asm_load(code_t *code, load_t load, reg_t dst, reg_t base, int32_t disp);
+// Stores the low width bytes (1, 4 or 8) of src.
+void    asm_store(code_t *code, int width, reg_t base, int32_t disp, reg_t src);
+void    asm_lea(code_t *code, reg_t dst, reg_t base, int32_t disp);
+
+// dst = dst op src, on the low 32 bits
+void    asm_alu32(code_t *code, alu_t op, reg_t dst, reg_t src);
+void    asm_add_ri(code_t *code, reg_t dst, int32_t imm);
+void    asm_and_ri(code_t *code, reg_t dst, int8_t imm);
+void    asm_movsxd(code_t *code, reg_t dst, reg_t src);
+void    asm_movsx8(code_t *code, reg_t dst, reg_t src);
+void    asm_cqo(code_t *code);
+void    asm_idiv(code_t *code, reg_t divisor);
+
+// flags of lhs - rhs, on 64 bits
+void    asm_cmp(code_t *code, reg_t lhs, reg_t rhs);
+void    asm_test(code_t *code, reg_t lhs, reg_t rhs);
+// dst = cond ? 1 : 0, whole register
+void    asm_set(code_t *code, cond_t cond, reg_t dst);
+
+// Branches return where their 32 bit displacement is, for asm_patch or a
+// relocation.
+size_t  asm_jcc(code_t *code, cond_t cond);
+size_t  asm_jmp(code_t *code);
+size_t  asm_call(code_t *code);
+void    asm_patch(code_t *code, size_t at, size_t target);
+
+void    asm_push(code_t *code, reg_t reg);
+void    asm_push_mem(code_t *code, reg_t base, int32_t disp);
+void    asm_pop(code_t *code, reg_t reg);
+void    asm_ret(code_t *code);
+
+#endif
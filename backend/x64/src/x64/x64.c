@@ -0,0 +1,1496 @@
+#include "x64/x64.h"
+#include "x64/encode.h"
+#include "x64/elf.h"
+#include "common/mem.h"
+#include "common/thread_pool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NONE UINT32_MAX
+
+// Virtual register code of one function. Every value gets a fresh virtual
+// register, but a local keeps one for its whole life; a local whose
+// address is taken lives in a stack slot instead. iz has no loops, so
+// every jump goes forward and a register is live from its first to its
+// last mention.
+typedef enum vop_t vop_t;
+enum vop_t
+{
+    V_CONST,        // d = imm
+    V_MOVE,         // d = a
+    V_BINARY,       // d = a kind b, on values of type
+    V_LOAD,         // d = *a, of type
+    V_STORE,        // *a = b, of type
+    V_SLOT_LOAD,    // d = slot imm, of type
+    V_SLOT_STORE,   // slot imm = a, of type
+    V_ADDRESS,      // d = &slot imm
+    V_CALL,         // d = symbol imm with arguments a .. a + b of argument_s,
+                    // returning type; d is NONE for void
+    V_BRANCH,       // to label imm when a is kind
+    V_JUMP,         // to label imm
+    V_LABEL,        // label imm
+    V_RETURN,       // a, or nothing when NONE
+};
+
+typedef struct vinst_t vinst_t;
+struct vinst_t
+{
+    uint8_t     op;
+    uint8_t     kind;
+    uint8_t     type;
+    uint32_t    d;
+    uint32_t    a;
+    uint32_t    b;
+    uint32_t    imm;
+};
+
+typedef struct fixup_t fixup_t;
+struct fixup_t
+{
+    size_t      at;
+    uint32_t    label;
+};
+
+typedef struct call_site_t call_site_t;
+struct call_site_t
+{
+    size_t      at;
+    symbol_t    symbol;
+};
+
+typedef struct interval_t interval_t;
+struct interval_t
+{
+    uint32_t    vreg;
+    uint32_t    start;
+    uint32_t    end;
+};
+
+// Registers left to the allocator. rax, rdx and r11 are scratch: results,
+// division, and operands that live in stack slots.
+#define BIT(reg)        (1u << (reg))
+#define CALLER_SAVED    (BIT(RCX) | BIT(RSI) | BIT(RDI) | BIT(R8) | BIT(R9) | BIT(R10))
+#define CALLEE_SAVED    (BIT(RBX) | BIT(R12) | BIT(R13) | BIT(R14) | BIT(R15))
+
+static const reg_t argument_register_s[] = { RDI, RSI, RDX, RCX, R8, R9 };
+#define REGISTER_ARGUMENTS 6
+
+// Everything one unit needs; a thread generates one unit at a time.
+typedef struct generator_t generator_t;
+struct generator_t
+{
+    // lowering
+    array_t(vinst_t)        inst_s;
+    array_t(uint32_t)       argument_s;
+    array_t(declaration_t)  taken_s;        // locals whose address is taken
+    uint32_t                vregs;
+    uint32_t                labels;
+    uint32_t                slots;          // locals in memory, then spills
+    uint32_t                first;          // declaration ids of the function's
+    uint32_t                last;           // locals are within first .. last
+    uint32_t               *home_s;         // by id - first: vreg, or slot in memory
+    bool                   *memory_s;       // by id - first
+    size_t                  home_capacity;
+    bool                    failed;
+
+    // allocation, by vreg: live range and register, or REGISTERS + slot
+    uint32_t               *start_s;
+    uint32_t               *end_s;
+    uint32_t               *loc_s;
+    size_t                  vreg_capacity;
+    array_t(interval_t)     interval_s;
+    array_t(uint32_t)       call_at_s;      // positions of calls
+    uint32_t                used;           // callee saved registers used
+    uint32_t                saved;
+
+    // emission
+    code_t                  code;
+    array_t(size_t)         label_s;
+    array_t(fixup_t)        fixup_s;
+    array_t(call_site_t)    call_s;
+    array_t(elf_symbol_t)   symbol_s;
+    array_t(symbol_t)       defined_s;
+};
+
+typedef struct x64_unit_t x64_unit_t;
+struct x64_unit_t
+{
+    uint8_t    *object;
+    size_t      size;
+    bool        failed;
+};
+
+struct x64_t
+{
+    compilation_t   compilation;
+    x64_unit_t     *unit_s;
+    size_t          units;
+};
+
+static
+void unsupported(generator_t *generator, const char *what)
+{
+    if (!generator->failed)
+        fprintf(stderr, "x64: %s is not supported\n", what);
+    generator->failed = true;
+}
+
+static inline
+bool is_local(declaration_t declaration)
+{
+    return declaration_kind(declaration) != DECLARATION_FUNCTION;
+}
+
+static inline
+uint32_t local_index(generator_t *generator, declaration_t declaration)
+{
+    return declaration_id(declaration) - generator->first;
+}
+
+static inline
+bool in_memory(generator_t *generator, declaration_t declaration)
+{
+    return generator->memory_s[local_index(generator, declaration)];
+}
+
+static inline
+uint32_t home(generator_t *generator, declaration_t declaration)
+{
+    return generator->home_s[local_index(generator, declaration)];
+}
+
+// ---------------------------------------------------------------------------
+// Scan: the range of local ids, and the locals whose address is taken.
+
+static
+void scan_local(generator_t *generator, declaration_t declaration)
+{
+    uint32_t id = declaration_id(declaration);
+    if (id < generator->first)
+        generator->first = id;
+    if (id > generator->last)
+        generator->last = id;
+}
+
+static
+void scan_expression(generator_t *generator, expression_t expression)
+{
+    switch (expression_kind(expression)) // LCOV_EXCL_LINE
+    {
+        case EXPRESSION_CONSTANT:
+            break;
+        case EXPRESSION_IDENTIFIER:
+        {
+            // anywhere but read or assigned, an identifier is an address
+            declaration_t declaration = identifier_declaration(IDENTIFIER(expression));
+            if (is_local(declaration))
+                generator->taken_s = array_add(generator->taken_s, declaration);
+            break;
+        }
+        case EXPRESSION_BINARY:
+            scan_expression(generator, binary_lhs(BINARY(expression)));
+            scan_expression(generator, binary_rhs(BINARY(expression)));
+            break;
+        case EXPRESSION_CALL:
+        {
+            call_t call = CALL(expression);
+            if (expression_kind(call_callee(call)) != EXPRESSION_IDENTIFIER)
+                scan_expression(generator, call_callee(call));
+
+            array_t(expression_t) argument_s = call_argument_s(call);
+            for (size_t i = 0; i < array_size(argument_s); i++)
+                scan_expression(generator, argument_s[i]);
+            break;
+        }
+        case EXPRESSION_ASSIGNMENT:
+        {
+            expression_t lvalue = assignment_lvalue(ASSIGNMENT(expression));
+            if (expression_kind(lvalue) != EXPRESSION_IDENTIFIER)
+                scan_expression(generator, lvalue);
+            scan_expression(generator, assignment_rvalue(ASSIGNMENT(expression)));
+            break;
+        }
+        case EXPRESSION_IMPLICIT_CAST:
+        {
+            expression_t inner = implicit_cast_expression(IMPLICIT_CAST(expression));
+            if (expression_kind(inner) != EXPRESSION_IDENTIFIER)
+                scan_expression(generator, inner);
+            break;
+        }
+        case EXPRESSION_CONDITIONAL:
+            scan_expression(generator, conditional_lhs(CONDITIONAL(expression)));
+            scan_expression(generator, conditional_rhs(CONDITIONAL(expression)));
+            break;
+        case EXPRESSION_UNARY:
+            scan_expression(generator, unary_expression(UNARY(expression)));
+            break;
+    }
+}
+
+static
+void scan_statement(generator_t *generator, statement_t statement)
+{
+    switch (statement_kind(statement)) // LCOV_EXCL_LINE
+    {
+        case STATEMENT_BLOCK:
+        {
+            array_t(statement_t) statement_s = block_statement_s(BLOCK(statement));
+            for (size_t i = 0; i < array_size(statement_s); i++)
+                scan_statement(generator, statement_s[i]);
+            break;
+        }
+        case STATEMENT_RETURN:
+            if (return_expression(RETURN(statement)) != NULL)
+                scan_expression(generator, return_expression(RETURN(statement)));
+            break;
+        case STATEMENT_IF:
+            scan_expression(generator, if_condition(IF(statement)));
+            scan_statement(generator, if_then_branch(IF(statement)));
+            if (if_else_branch(IF(statement)) != NULL)
+                scan_statement(generator, if_else_branch(IF(statement)));
+            break;
+        case STATEMENT_VAR:
+        {
+            array_t(declaration_t) variable_s = var_variable_s(VAR(statement));
+            for (size_t i = 0; i < array_size(variable_s); i++)
+            {
+                scan_local(generator, variable_s[i]);
+                expression_t initializer = variable_initializer(VARIABLE(variable_s[i]));
+                if (initializer != NULL)
+                    scan_expression(generator, initializer);
+            }
+            break;
+        }
+        case STATEMENT_ACT:
+        {
+            array_t(expression_t) expression_s = act_expression_s(ACT(statement));
+            for (size_t i = 0; i < array_size(expression_s); i++)
+                scan_expression(generator, expression_s[i]);
+            break;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Lowering to virtual register code.
+
+static inline
+uint32_t new_vreg(generator_t *generator)
+{
+    return generator->vregs++;
+}
+
+static inline
+uint32_t new_label(generator_t *generator)
+{
+    return generator->labels++;
+}
+
+static inline
+void emit(generator_t *generator, vinst_t inst)
+{
+    generator->inst_s = array_add(generator->inst_s, inst);
+}
+
+static
+uint32_t copy(generator_t *generator, uint32_t vreg)
+{
+    uint32_t d = new_vreg(generator);
+    emit(generator, (vinst_t){ .op = V_MOVE, .d = d, .a = vreg });
+    return d;
+}
+
+static
+bool has_assignment(expression_t expression)
+{
+    switch (expression_kind(expression)) // LCOV_EXCL_LINE
+    {
+        case EXPRESSION_CONSTANT:
+        case EXPRESSION_IDENTIFIER:
+            return false;
+        case EXPRESSION_BINARY:
+            return has_assignment(binary_lhs(BINARY(expression))) || has_assignment(binary_rhs(BINARY(expression)));
+        case EXPRESSION_CALL:
+        {
+            array_t(expression_t) argument_s = call_argument_s(CALL(expression));
+            for (size_t i = 0; i < array_size(argument_s); i++)
+                if (has_assignment(argument_s[i]))
+                    return true;
+            return false;
+        }
+        case EXPRESSION_ASSIGNMENT:
+            return true;
+        case EXPRESSION_IMPLICIT_CAST:
+            return has_assignment(implicit_cast_expression(IMPLICIT_CAST(expression)));
+        case EXPRESSION_CONDITIONAL:
+            return has_assignment(conditional_lhs(CONDITIONAL(expression))) || has_assignment(conditional_rhs(CONDITIONAL(expression)));
+        case EXPRESSION_UNARY:
+            return has_assignment(unary_expression(UNARY(expression)));
+    }
+
+    return false; // LCOV_EXCL_LINE
+}
+
+// A local read straight from its register: an assignment evaluated later
+// in the same expression would change it under the reader.
+static
+bool reads_register(generator_t *generator, expression_t expression)
+{
+    if (expression_kind(expression) != EXPRESSION_IMPLICIT_CAST)
+        return false;
+
+    expression_t inner = implicit_cast_expression(IMPLICIT_CAST(expression));
+    if (expression_kind(inner) != EXPRESSION_IDENTIFIER)
+        return false;
+
+    declaration_t declaration = identifier_declaration(IDENTIFIER(inner));
+    return is_local(declaration) && !in_memory(generator, declaration);
+}
+
+static
+uint32_t lower_expression(generator_t *generator, expression_t expression);
+
+static
+uint32_t lower_constant(generator_t *generator, constant_t constant)
+{
+    int32_t value = 0;
+    switch (constant_kind(constant)) // LCOV_EXCL_LINE
+    {
+        case CONSTANT_BOOL:
+            value = constant_bool(constant);
+            break;
+        case CONSTANT_U64:
+            value = (int32_t)constant_u64(constant);
+            break;
+        case CONSTANT_CHAR:
+            value = (int8_t)constant_char(constant);
+            break;
+    }
+
+    uint32_t d = new_vreg(generator);
+    emit(generator, (vinst_t){ .op = V_CONST, .d = d, .imm = (uint32_t)value });
+    return d;
+}
+
+// The address an lvalue designates: a local's slot, or the pointer under *.
+static
+uint32_t lower_address(generator_t *generator, expression_t lvalue)
+{
+    if (expression_kind(lvalue) == EXPRESSION_UNARY)
+        return lower_expression(generator, unary_expression(UNARY(lvalue)));
+
+    declaration_t declaration = identifier_declaration(IDENTIFIER(lvalue));
+    if (!is_local(declaration))
+    {
+        unsupported(generator, "a function value");
+        return new_vreg(generator);
+    }
+
+    uint32_t d = new_vreg(generator);
+    emit(generator, (vinst_t){ .op = V_ADDRESS, .d = d, .imm = home(generator, declaration) });
+    return d;
+}
+
+static
+uint32_t lower_read(generator_t *generator, implicit_cast_t cast)
+{
+    if (implicit_cast_kind(cast) != IMPLICIT_CAST_LVALUE_TO_RVALUE)
+    {
+        unsupported(generator, "function to pointer decay");
+        return new_vreg(generator);
+    }
+
+    expression_t inner = implicit_cast_expression(cast);
+    uint8_t type = type_kind(implicit_cast_type(cast));
+
+    if (expression_kind(inner) == EXPRESSION_IDENTIFIER)
+    {
+        declaration_t declaration = identifier_declaration(IDENTIFIER(inner));
+        if (!is_local(declaration))
+        {
+            unsupported(generator, "a function value");
+            return new_vreg(generator);
+        }
+        if (!in_memory(generator, declaration))
+            return home(generator, declaration);
+
+        uint32_t d = new_vreg(generator);
+        emit(generator, (vinst_t){ .op = V_SLOT_LOAD, .type = type, .d = d, .imm = home(generator, declaration) });
+        return d;
+    }
+
+    uint32_t pointer = lower_expression(generator, unary_expression(UNARY(inner)));
+    uint32_t d = new_vreg(generator);
+    emit(generator, (vinst_t){ .op = V_LOAD, .type = type, .d = d, .a = pointer });
+    return d;
+}
+
+static
+uint32_t lower_binary(generator_t *generator, binary_t binary)
+{
+    uint32_t a = lower_expression(generator, binary_lhs(binary));
+    if (reads_register(generator, binary_lhs(binary)) && has_assignment(binary_rhs(binary)))
+        a = copy(generator, a);
+    uint32_t b = lower_expression(generator, binary_rhs(binary));
+
+    uint32_t d = new_vreg(generator);
+    emit(generator, (vinst_t)
+    {
+        .op = V_BINARY,
+        .kind = binary_op(binary),
+        .type = type_kind(expression_type(binary_lhs(binary))),
+        .d = d, .a = a, .b = b
+    });
+    return d;
+}
+
+static
+uint32_t lower_conditional(generator_t *generator, conditional_t conditional)
+{
+    uint32_t d = new_vreg(generator);
+    uint32_t end = new_label(generator);
+
+    uint32_t a = lower_expression(generator, conditional_lhs(conditional));
+    emit(generator, (vinst_t){ .op = V_MOVE, .d = d, .a = a });
+    // && is done once false, || once true
+    uint8_t done = conditional_op(conditional) == CONDITIONAL_OR;
+    emit(generator, (vinst_t){ .op = V_BRANCH, .kind = done, .a = d, .imm = end });
+
+    uint32_t b = lower_expression(generator, conditional_rhs(conditional));
+    emit(generator, (vinst_t){ .op = V_MOVE, .d = d, .a = b });
+    emit(generator, (vinst_t){ .op = V_LABEL, .imm = end });
+    return d;
+}
+
+static
+uint32_t lower_call(generator_t *generator, expression_t expression)
+{
+    call_t call = CALL(expression);
+    expression_t callee = call_callee(call);
+    if (expression_kind(callee) != EXPRESSION_IDENTIFIER || is_local(identifier_declaration(IDENTIFIER(callee))))
+    {
+        unsupported(generator, "calling a function value");
+        return new_vreg(generator);
+    }
+
+    // nested calls add their own arguments, so these are gathered first
+    array_t(expression_t) argument_s = call_argument_s(call);
+    size_t arguments = array_size(argument_s);
+    uint32_t value_s[arguments + 1];
+    for (size_t i = 0; i < arguments; i++)
+    {
+        value_s[i] = lower_expression(generator, argument_s[i]);
+        if (reads_register(generator, argument_s[i]))
+            for (size_t j = i + 1; j < arguments; j++)
+                if (has_assignment(argument_s[j]))
+                {
+                    value_s[i] = copy(generator, value_s[i]);
+                    break;
+                }
+    }
+
+    uint32_t start = array_size(generator->argument_s);
+    for (size_t i = 0; i < arguments; i++)
+        generator->argument_s = array_add(generator->argument_s, value_s[i]);
+
+    type_kind_t type = type_kind(expression_type(expression));
+    uint32_t d = type == TYPE_VOID ? NONE : new_vreg(generator);
+    emit(generator, (vinst_t)
+    {
+        .op = V_CALL,
+        .type = type,
+        .d = d, .a = start, .b = arguments,
+        .imm = identifier_symbol(IDENTIFIER(callee))
+    });
+    return d;
+}
+
+// value is false when nothing reads the result.
+static
+uint32_t lower_assignment(generator_t *generator, assignment_t assignment, bool value)
+{
+    expression_t lvalue = assignment_lvalue(assignment);
+    expression_t rvalue = assignment_rvalue(assignment);
+    uint8_t type = type_kind(expression_type(lvalue));
+
+    uint32_t v;
+    if (expression_kind(lvalue) == EXPRESSION_IDENTIFIER)
+    {
+        declaration_t declaration = identifier_declaration(IDENTIFIER(lvalue));
+        v = lower_expression(generator, rvalue);
+        if (!is_local(declaration))
+            unsupported(generator, "a function value");
+        else if (in_memory(generator, declaration))
+            emit(generator, (vinst_t){ .op = V_SLOT_STORE, .type = type, .a = v, .imm = home(generator, declaration) });
+        else
+            emit(generator, (vinst_t){ .op = V_MOVE, .d = home(generator, declaration), .a = v });
+    }
+    else
+    {
+        // the address first, as the LLVM backend does
+        expression_t pointer = unary_expression(UNARY(lvalue));
+        uint32_t p = lower_expression(generator, pointer);
+        if (reads_register(generator, pointer) && has_assignment(rvalue))
+            p = copy(generator, p);
+
+        v = lower_expression(generator, rvalue);
+        emit(generator, (vinst_t){ .op = V_STORE, .type = type, .a = p, .b = v });
+    }
+
+    // v may be a local that changes later in the expression
+    return value ? copy(generator, v) : v;
+}
+
+static
+uint32_t lower_expression(generator_t *generator, expression_t expression)
+{
+    switch (expression_kind(expression)) // LCOV_EXCL_LINE
+    {
+        case EXPRESSION_CONSTANT:
+            return lower_constant(generator, CONSTANT(expression));
+        case EXPRESSION_IDENTIFIER:
+            return lower_address(generator, expression);
+        case EXPRESSION_BINARY:
+            return lower_binary(generator, BINARY(expression));
+        case EXPRESSION_CALL:
+            return lower_call(generator, expression);
+        case EXPRESSION_ASSIGNMENT:
+            return lower_assignment(generator, ASSIGNMENT(expression), true);
+        case EXPRESSION_IMPLICIT_CAST:
+            return lower_read(generator, IMPLICIT_CAST(expression));
+        case EXPRESSION_CONDITIONAL:
+            return lower_conditional(generator, CONDITIONAL(expression));
+        case EXPRESSION_UNARY:
+            if (unary_op(UNARY(expression)) == UNARY_ADDRESS_OF)
+                return lower_address(generator, unary_expression(UNARY(expression)));
+            return lower_address(generator, expression);
+    }
+
+    return NONE; // LCOV_EXCL_LINE
+}
+
+static
+void lower_statement(generator_t *generator, statement_t statement)
+{
+    switch (statement_kind(statement)) // LCOV_EXCL_LINE
+    {
+        case STATEMENT_BLOCK:
+        {
+            array_t(statement_t) statement_s = block_statement_s(BLOCK(statement));
+            for (size_t i = 0; i < array_size(statement_s); i++)
+                lower_statement(generator, statement_s[i]);
+            break;
+        }
+        case STATEMENT_RETURN:
+        {
+            expression_t expression = return_expression(RETURN(statement));
+            uint32_t a = expression == NULL ? NONE : lower_expression(generator, expression);
+            emit(generator, (vinst_t){ .op = V_RETURN, .a = a });
+            break;
+        }
+        case STATEMENT_IF:
+        {
+            if_t ifelse = IF(statement);
+            uint32_t condition = lower_expression(generator, if_condition(ifelse));
+            uint32_t skip_then = new_label(generator);
+            emit(generator, (vinst_t){ .op = V_BRANCH, .kind = 0, .a = condition, .imm = skip_then });
+
+            lower_statement(generator, if_then_branch(ifelse));
+            if (if_else_branch(ifelse) == NULL)
+            {
+                emit(generator, (vinst_t){ .op = V_LABEL, .imm = skip_then });
+                break;
+            }
+
+            uint32_t skip_else = new_label(generator);
+            emit(generator, (vinst_t){ .op = V_JUMP, .imm = skip_else });
+            emit(generator, (vinst_t){ .op = V_LABEL, .imm = skip_then });
+            lower_statement(generator, if_else_branch(ifelse));
+            emit(generator, (vinst_t){ .op = V_LABEL, .imm = skip_else });
+            break;
+        }
+        case STATEMENT_VAR:
+        {
+            array_t(declaration_t) variable_s = var_variable_s(VAR(statement));
+            for (size_t i = 0; i < array_size(variable_s); i++)
+            {
+                declaration_t declaration = variable_s[i];
+                bool memory = in_memory(generator, declaration);
+                if (!memory)
+                    generator->home_s[local_index(generator, declaration)] = new_vreg(generator);
+
+                expression_t initializer = variable_initializer(VARIABLE(declaration));
+                if (initializer == NULL)
+                    continue;
+
+                uint32_t v = lower_expression(generator, initializer);
+                if (memory)
+                    emit(generator, (vinst_t)
+                    {
+                        .op = V_SLOT_STORE,
+                        .type = type_kind(variable_type(VARIABLE(declaration))),
+                        .a = v, .imm = home(generator, declaration)
+                    });
+                else
+                    emit(generator, (vinst_t){ .op = V_MOVE, .d = home(generator, declaration), .a = v });
+            }
+            break;
+        }
+        case STATEMENT_ACT:
+        {
+            array_t(expression_t) expression_s = act_expression_s(ACT(statement));
+            for (size_t i = 0; i < array_size(expression_s); i++)
+                if (expression_kind(expression_s[i]) == EXPRESSION_ASSIGNMENT)
+                    lower_assignment(generator, ASSIGNMENT(expression_s[i]), false);
+                else
+                    lower_expression(generator, expression_s[i]);
+            break;
+        }
+    }
+}
+
+static
+void lower_function(generator_t *generator, function_t function)
+{
+    array_truncate(generator->inst_s, 0);
+    array_truncate(generator->argument_s, 0);
+    array_truncate(generator->taken_s, 0);
+    generator->vregs = 0;
+    generator->labels = 0;
+    generator->slots = 0;
+    generator->first = UINT32_MAX;
+    generator->last = 0;
+
+    array_t(declaration_t) argument_s = function_argument_s(function);
+    for (size_t i = 0; i < array_size(argument_s); i++)
+        scan_local(generator, argument_s[i]);
+    scan_statement(generator, function_statement(function));
+
+    size_t locals = generator->first <= generator->last ? generator->last - generator->first + 1 : 0;
+    if (locals > generator->home_capacity)
+    {
+        generator->home_s = mem_realloc(generator->home_s, sizeof(uint32_t) * locals);
+        generator->memory_s = mem_realloc(generator->memory_s, sizeof(bool) * locals);
+        generator->home_capacity = locals;
+    }
+    if (locals > 0)
+        memset(generator->memory_s, 0, sizeof(bool) * locals);
+
+    for (size_t i = 0; i < array_size(generator->taken_s); i++)
+    {
+        uint32_t index = local_index(generator, generator->taken_s[i]);
+        if (!generator->memory_s[index])
+        {
+            generator->memory_s[index] = true;
+            generator->home_s[index] = generator->slots++;
+        }
+    }
+
+    // arguments in registers are the first vregs
+    for (size_t i = 0; i < array_size(argument_s); i++)
+        if (!in_memory(generator, argument_s[i]))
+            generator->home_s[local_index(generator, argument_s[i])] = new_vreg(generator);
+
+    lower_statement(generator, function_statement(function));
+
+    if (type_kind(function_return_type(function)) == TYPE_VOID)
+        emit(generator, (vinst_t){ .op = V_RETURN, .a = NONE });
+}
+
+// ---------------------------------------------------------------------------
+// Linear scan register allocation.
+
+static inline
+void touch(generator_t *generator, uint32_t vreg, uint32_t at)
+{
+    if (vreg == NONE)
+        return;
+    if (generator->start_s[vreg] == NONE)
+        generator->start_s[vreg] = at;
+    generator->end_s[vreg] = at;
+}
+
+static
+int compare_intervals(const void *lhs, const void *rhs)
+{
+    const interval_t *a = lhs;
+    const interval_t *b = rhs;
+    return a->start != b->start ? (a->start < b->start ? -1 : 1) : (a->vreg < b->vreg ? -1 : a->vreg > b->vreg);
+}
+
+// Whether a call happens strictly inside the interval, clobbering the
+// caller saved registers.
+static
+bool crosses_call(generator_t *generator, interval_t *interval)
+{
+    size_t low = 0, high = array_size(generator->call_at_s);
+    while (low < high)
+    {
+        size_t middle = (low + high) / 2;
+        if (generator->call_at_s[middle] <= interval->start)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    return low < array_size(generator->call_at_s) && generator->call_at_s[low] < interval->end;
+}
+
+static
+void allocate(generator_t *generator, function_t function)
+{
+    uint32_t vregs = generator->vregs;
+    if (vregs > generator->vreg_capacity)
+    {
+        generator->start_s = mem_realloc(generator->start_s, sizeof(uint32_t) * vregs);
+        generator->end_s = mem_realloc(generator->end_s, sizeof(uint32_t) * vregs);
+        generator->loc_s = mem_realloc(generator->loc_s, sizeof(uint32_t) * vregs);
+        generator->vreg_capacity = vregs;
+    }
+    for (uint32_t i = 0; i < vregs; i++)
+    {
+        generator->start_s[i] = NONE;
+        generator->loc_s[i] = NONE;
+    }
+    array_truncate(generator->call_at_s, 0);
+
+    // position 0 is the entry, where arguments arrive
+    size_t instructions = array_size(generator->inst_s);
+    for (size_t i = 0; i < instructions; i++)
+    {
+        vinst_t *inst = &generator->inst_s[i];
+        uint32_t at = i + 1;
+        switch (inst->op) // LCOV_EXCL_LINE
+        {
+            case V_BINARY:
+                touch(generator, inst->a, at);
+                touch(generator, inst->b, at);
+                touch(generator, inst->d, at);
+                break;
+            case V_MOVE:
+            case V_LOAD:
+                touch(generator, inst->a, at);
+                touch(generator, inst->d, at);
+                break;
+            case V_STORE:
+                touch(generator, inst->a, at);
+                touch(generator, inst->b, at);
+                break;
+            case V_SLOT_STORE:
+            case V_BRANCH:
+            case V_RETURN:
+                touch(generator, inst->a, at);
+                break;
+            case V_CONST:
+            case V_SLOT_LOAD:
+            case V_ADDRESS:
+                touch(generator, inst->d, at);
+                break;
+            case V_CALL:
+                for (uint32_t j = 0; j < inst->b; j++)
+                    touch(generator, generator->argument_s[inst->a + j], at);
+                touch(generator, inst->d, at);
+                generator->call_at_s = array_add(generator->call_at_s, at);
+                break;
+            case V_JUMP:
+            case V_LABEL:
+                break;
+        }
+    }
+
+    array_t(declaration_t) argument_s = function_argument_s(function);
+    for (size_t i = 0; i < array_size(argument_s); i++)
+        if (!in_memory(generator, argument_s[i]))
+        {
+            uint32_t vreg = home(generator, argument_s[i]);
+            if (generator->start_s[vreg] != NONE)
+                generator->start_s[vreg] = 0;
+        }
+
+    array_truncate(generator->interval_s, 0);
+    for (uint32_t i = 0; i < vregs; i++)
+        if (generator->start_s[i] != NONE)
+        {
+            interval_t interval = { i, generator->start_s[i], generator->end_s[i] };
+            generator->interval_s = array_add(generator->interval_s, interval);
+        }
+    qsort(generator->interval_s, array_size(generator->interval_s), sizeof(interval_t), compare_intervals);
+
+    // arguments are best left where they arrive
+    uint32_t hint_s[REGISTER_ARGUMENTS] = { NONE, NONE, NONE, NONE, NONE, NONE };
+    for (size_t i = 0; i < array_size(argument_s) && i < REGISTER_ARGUMENTS; i++)
+        if (!in_memory(generator, argument_s[i]))
+            hint_s[i] = home(generator, argument_s[i]);
+
+    interval_t active_s[REGISTERS];
+    size_t actives = 0;
+    uint32_t free = CALLER_SAVED | CALLEE_SAVED;
+    generator->used = 0;
+
+    for (size_t i = 0; i < array_size(generator->interval_s); i++)
+    {
+        interval_t *interval = &generator->interval_s[i];
+
+        // a register is reused only after its last reader
+        for (size_t j = 0; j < actives; )
+            if (active_s[j].end < interval->start)
+            {
+                free |= BIT(generator->loc_s[active_s[j].vreg]);
+                active_s[j] = active_s[--actives];
+            }
+            else
+                j++;
+
+        uint32_t allowed = crosses_call(generator, interval) ? CALLEE_SAVED : CALLER_SAVED | CALLEE_SAVED;
+        uint32_t available = free & allowed;
+
+        int reg = -1;
+        for (size_t j = 0; j < REGISTER_ARGUMENTS; j++)
+            if (hint_s[j] == interval->vreg && (available & BIT(argument_register_s[j])))
+                reg = argument_register_s[j];
+        if (reg < 0 && (available & CALLER_SAVED))
+            reg = __builtin_ctz(available & CALLER_SAVED);
+        if (reg < 0 && available != 0)
+            reg = __builtin_ctz(available);
+
+        if (reg < 0)
+        {
+            // spill whichever ends last, this or an active interval
+            size_t victim = actives;
+            for (size_t j = 0; j < actives; j++)
+                if ((BIT(generator->loc_s[active_s[j].vreg]) & allowed)
+                    && (victim == actives || active_s[j].end > active_s[victim].end))
+                    victim = j;
+
+            if (victim == actives || active_s[victim].end <= interval->end)
+            {
+                generator->loc_s[interval->vreg] = REGISTERS + generator->slots++;
+                continue;
+            }
+
+            reg = generator->loc_s[active_s[victim].vreg];
+            generator->loc_s[active_s[victim].vreg] = REGISTERS + generator->slots++;
+            active_s[victim] = active_s[--actives];
+            free |= BIT(reg);
+        }
+
+        generator->loc_s[interval->vreg] = reg;
+        free &= ~BIT(reg);
+        generator->used |= BIT(reg) & CALLEE_SAVED;
+        active_s[actives++] = *interval;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Emission.
+
+static inline
+int32_t slot_offset(generator_t *generator, uint32_t slot)
+{
+    return -8 * (int32_t)(generator->saved + slot + 1);
+}
+
+static inline
+load_t load_of(uint8_t type)
+{
+    return type == TYPE_INT ? LOAD_I32 : type == TYPE_CHAR ? LOAD_I8 : type == TYPE_BOOL ? LOAD_U8 : LOAD_I64;
+}
+
+static inline
+int width_of(uint8_t type)
+{
+    return type == TYPE_INT ? 4 : type == TYPE_CHAR || type == TYPE_BOOL ? 1 : 8;
+}
+
+// Values are kept whole in registers: int and char sign extended, bool 0
+// or 1. Callers and callees built by LLVM promise only the low bits.
+static
+void normalize(code_t *code, reg_t reg, uint8_t type)
+{
+    if (type == TYPE_INT)
+        asm_movsxd(code, reg, reg);
+    else if (type == TYPE_CHAR)
+        asm_movsx8(code, reg, reg);
+    else if (type == TYPE_BOOL)
+        asm_and_ri(code, reg, 1);
+}
+
+// The register holding vreg, loading it into scratch when spilled.
+static
+reg_t source(generator_t *generator, uint32_t vreg, reg_t scratch)
+{
+    uint32_t loc = generator->loc_s[vreg];
+    if (loc < REGISTERS)
+        return loc;
+
+    asm_load(&generator->code, LOAD_I64, scratch, RBP, slot_offset(generator, loc - REGISTERS));
+    return scratch;
+}
+
+// The register to compute vreg in: its own, or scratch when spilled.
+static inline
+reg_t target(generator_t *generator, uint32_t vreg, reg_t scratch)
+{
+    uint32_t loc = generator->loc_s[vreg];
+    return loc < REGISTERS ? (reg_t)loc : scratch;
+}
+
+static
+void define(generator_t *generator, uint32_t vreg, reg_t value)
+{
+    uint32_t loc = generator->loc_s[vreg];
+    if (loc < REGISTERS)
+    {
+        if (loc != value)
+            asm_mov_rr(&generator->code, loc, value);
+        return;
+    }
+
+    asm_store(&generator->code, 8, RBP, slot_offset(generator, loc - REGISTERS), value);
+}
+
+// Register to register moves that happen at once, e.g. arguments into
+// their registers. A move waits while its destination is still to be
+// read; a cycle is broken through rax.
+static
+void parallel_move(code_t *code, reg_t *dst_s, reg_t *src_s, size_t moves)
+{
+    while (moves > 0)
+    {
+        bool progress = false;
+        for (size_t i = 0; i < moves; )
+        {
+            bool blocked = false;
+            for (size_t j = 0; j < moves && !blocked; j++)
+                blocked = j != i && src_s[j] == dst_s[i];
+
+            if (blocked)
+            {
+                i++;
+                continue;
+            }
+
+            if (dst_s[i] != src_s[i])
+                asm_mov_rr(code, dst_s[i], src_s[i]);
+            dst_s[i] = dst_s[moves - 1];
+            src_s[i] = src_s[moves - 1];
+            moves--;
+            progress = true;
+        }
+
+        if (!progress)
+        {
+            reg_t saved = dst_s[0];
+            asm_mov_rr(code, RAX, saved);
+            for (size_t j = 0; j < moves; j++)
+                if (src_s[j] == saved)
+                    src_s[j] = RAX;
+        }
+    }
+}
+
+static
+void emit_binary(generator_t *generator, vinst_t *inst)
+{
+    static const cond_t cond_s[] =
+    {
+        [BINARY_LT] = CC_L,
+        [BINARY_LE] = CC_LE,
+        [BINARY_GT] = CC_G,
+        [BINARY_GE] = CC_GE,
+        [BINARY_EQ] = CC_E,
+        [BINARY_NE] = CC_NE,
+    };
+    // bools order as signed one bit integers, where true is -1
+    static const cond_t bool_cond_s[] =
+    {
+        [BINARY_LT] = CC_G,
+        [BINARY_LE] = CC_GE,
+        [BINARY_GT] = CC_L,
+        [BINARY_GE] = CC_LE,
+        [BINARY_EQ] = CC_E,
+        [BINARY_NE] = CC_NE,
+    };
+
+    code_t *code = &generator->code;
+    reg_t lhs = source(generator, inst->a, RAX);
+    reg_t rhs = source(generator, inst->b, R11);
+
+    if (inst->kind <= BINARY_NE)
+    {
+        asm_cmp(code, lhs, rhs);
+        reg_t d = target(generator, inst->d, RAX);
+        asm_set(code, inst->type == TYPE_BOOL ? bool_cond_s[inst->kind] : cond_s[inst->kind], d);
+        define(generator, inst->d, d);
+        return;
+    }
+
+    if (inst->kind == BINARY_DIV || inst->kind == BINARY_REM)
+    {
+        // whole register division of normalized values, then narrowed
+        if (lhs != RAX)
+            asm_mov_rr(code, RAX, lhs);
+        asm_cqo(code);
+        asm_idiv(code, rhs);
+        reg_t result = inst->kind == BINARY_DIV ? RAX : RDX;
+        normalize(code, result, inst->type);
+        define(generator, inst->d, result);
+        return;
+    }
+
+    reg_t d = target(generator, inst->d, RAX);
+    if (d == rhs && d != lhs)
+        d = RAX;
+    if (d != lhs)
+        asm_mov_rr(code, d, lhs);
+
+    alu_t op = inst->kind == BINARY_ADD ? ALU_ADD : inst->kind == BINARY_SUB ? ALU_SUB : ALU_IMUL;
+    asm_alu32(code, op, d, rhs);
+    normalize(code, d, inst->type);
+    define(generator, inst->d, d);
+}
+
+static
+void emit_call(generator_t *generator, vinst_t *inst)
+{
+    code_t *code = &generator->code;
+    uint32_t *argument_s = &generator->argument_s[inst->a];
+    uint32_t arguments = inst->b;
+
+    // the rest of the arguments go on the stack, which stays 16 byte aligned
+    uint32_t stacked = arguments > REGISTER_ARGUMENTS ? arguments - REGISTER_ARGUMENTS : 0;
+    int32_t pad = stacked % 2 ? 8 : 0;
+    if (pad)
+        asm_add_ri(code, RSP, -pad);
+    for (uint32_t i = arguments; i-- > REGISTER_ARGUMENTS; )
+    {
+        uint32_t loc = generator->loc_s[argument_s[i]];
+        if (loc < REGISTERS)
+            asm_push(code, loc);
+        else
+            asm_push_mem(code, RBP, slot_offset(generator, loc - REGISTERS));
+    }
+
+    reg_t dst_s[REGISTER_ARGUMENTS], src_s[REGISTER_ARGUMENTS];
+    size_t moves = 0;
+    for (uint32_t i = 0; i < arguments && i < REGISTER_ARGUMENTS; i++)
+    {
+        uint32_t loc = generator->loc_s[argument_s[i]];
+        if (loc < REGISTERS)
+        {
+            dst_s[moves] = argument_register_s[i];
+            src_s[moves++] = loc;
+        }
+    }
+    parallel_move(code, dst_s, src_s, moves);
+
+    for (uint32_t i = 0; i < arguments && i < REGISTER_ARGUMENTS; i++)
+    {
+        uint32_t loc = generator->loc_s[argument_s[i]];
+        if (loc >= REGISTERS)
+            asm_load(code, LOAD_I64, argument_register_s[i], RBP, slot_offset(generator, loc - REGISTERS));
+    }
+
+    call_site_t call = { asm_call(code), inst->imm };
+    generator->call_s = array_add(generator->call_s, call);
+
+    if (stacked > 0)
+        asm_add_ri(code, RSP, 8 * stacked + pad);
+
+    if (inst->d != NONE)
+    {
+        normalize(code, RAX, inst->type);
+        define(generator, inst->d, RAX);
+    }
+}
+
+static
+void jump_to(generator_t *generator, size_t at, uint32_t label)
+{
+    fixup_t fixup = { at, label };
+    generator->fixup_s = array_add(generator->fixup_s, fixup);
+}
+
+// Arguments arrive in registers, then on the stack above the return
+// address; each goes where the allocator put it, or to its slot.
+static
+void emit_arguments(generator_t *generator, function_t function)
+{
+    code_t *code = &generator->code;
+    array_t(declaration_t) argument_s = function_argument_s(function);
+    size_t arguments = array_size(argument_s);
+
+    reg_t dst_s[REGISTER_ARGUMENTS], src_s[REGISTER_ARGUMENTS];
+    size_t moves = 0;
+    for (size_t i = 0; i < arguments && i < REGISTER_ARGUMENTS; i++)
+    {
+        declaration_t argument = argument_s[i];
+        reg_t reg = argument_register_s[i];
+        uint8_t type = type_kind(declaration_type(argument));
+        normalize(code, reg, type);
+
+        if (in_memory(generator, argument))
+        {
+            asm_store(code, width_of(type), RBP, slot_offset(generator, home(generator, argument)), reg);
+            continue;
+        }
+
+        uint32_t loc = generator->loc_s[home(generator, argument)];
+        if (loc == NONE)
+            continue;
+        if (loc >= REGISTERS)
+        {
+            asm_store(code, 8, RBP, slot_offset(generator, loc - REGISTERS), reg);
+            continue;
+        }
+
+        dst_s[moves] = loc;
+        src_s[moves++] = reg;
+    }
+    parallel_move(code, dst_s, src_s, moves);
+
+    for (size_t i = REGISTER_ARGUMENTS; i < arguments; i++)
+    {
+        declaration_t argument = argument_s[i];
+        uint8_t type = type_kind(declaration_type(argument));
+        bool memory = in_memory(generator, argument);
+        if (!memory && generator->loc_s[home(generator, argument)] == NONE)
+            continue;
+
+        asm_load(code, LOAD_I64, RAX, RBP, 16 + 8 * (i - REGISTER_ARGUMENTS));
+        normalize(code, RAX, type);
+        if (memory)
+            asm_store(code, width_of(type), RBP, slot_offset(generator, home(generator, argument)), RAX);
+        else
+            define(generator, home(generator, argument), RAX);
+    }
+}
+
+static
+void emit_function(generator_t *generator, function_t function)
+{
+    code_t *code = &generator->code;
+    size_t start = code_size(code);
+
+    reg_t saved_s[REGISTERS];
+    generator->saved = 0;
+    for (reg_t reg = 0; reg < REGISTERS; reg++)
+        if (generator->used & BIT(reg))
+            saved_s[generator->saved++] = reg;
+
+    asm_push(code, RBP);
+    asm_mov_rr(code, RBP, RSP);
+    for (uint32_t i = 0; i < generator->saved; i++)
+        asm_push(code, saved_s[i]);
+
+    // rsp is 16 byte aligned after pushing rbp
+    int32_t frame = 8 * generator->slots;
+    if ((generator->saved + generator->slots) % 2)
+        frame += 8;
+    if (frame > 0)
+        asm_add_ri(code, RSP, -frame);
+
+    emit_arguments(generator, function);
+
+    uint32_t epilogue = generator->labels;
+    array_truncate(generator->label_s, 0);
+    array_truncate(generator->fixup_s, 0);
+    for (uint32_t i = 0; i <= epilogue; i++)
+    {
+        size_t none = 0;
+        generator->label_s = array_add(generator->label_s, none);
+    }
+
+    size_t instructions = array_size(generator->inst_s);
+    for (size_t i = 0; i < instructions; i++)
+    {
+        vinst_t *inst = &generator->inst_s[i];
+        switch (inst->op) // LCOV_EXCL_LINE
+        {
+            case V_CONST:
+            {
+                reg_t d = target(generator, inst->d, RAX);
+                asm_mov_ri(code, d, (int32_t)inst->imm);
+                define(generator, inst->d, d);
+                break;
+            }
+            case V_MOVE:
+                if (generator->loc_s[inst->d] != generator->loc_s[inst->a])
+                    define(generator, inst->d, source(generator, inst->a, RAX));
+                break;
+            case V_BINARY:
+                emit_binary(generator, inst);
+                break;
+            case V_LOAD:
+            {
+                reg_t pointer = source(generator, inst->a, RAX);
+                reg_t d = target(generator, inst->d, RAX);
+                asm_load(code, load_of(inst->type), d, pointer, 0);
+                define(generator, inst->d, d);
+                break;
+            }
+            case V_STORE:
+            {
+                reg_t pointer = source(generator, inst->a, RAX);
+                reg_t value = source(generator, inst->b, R11);
+                asm_store(code, width_of(inst->type), pointer, 0, value);
+                break;
+            }
+            case V_SLOT_LOAD:
+            {
+                reg_t d = target(generator, inst->d, RAX);
+                asm_load(code, load_of(inst->type), d, RBP, slot_offset(generator, inst->imm));
+                define(generator, inst->d, d);
+                break;
+            }
+            case V_SLOT_STORE:
+                asm_store(code, width_of(inst->type), RBP, slot_offset(generator, inst->imm), source(generator, inst->a, RAX));
+                break;
+            case V_ADDRESS:
+            {
+                reg_t d = target(generator, inst->d, RAX);
+                asm_lea(code, d, RBP, slot_offset(generator, inst->imm));
+                define(generator, inst->d, d);
+                break;
+            }
+            case V_CALL:
+                emit_call(generator, inst);
+                break;
+            case V_BRANCH:
+            {
+                reg_t condition = source(generator, inst->a, RAX);
+                asm_test(code, condition, condition);
+                jump_to(generator, asm_jcc(code, inst->kind ? CC_NE : CC_E), inst->imm);
+                break;
+            }
+            case V_JUMP:
+                jump_to(generator, asm_jmp(code), inst->imm);
+                break;
+            case V_LABEL:
+                generator->label_s[inst->imm] = code_size(code);
+                break;
+            case V_RETURN:
+                if (inst->a != NONE)
+                {
+                    reg_t value = source(generator, inst->a, RAX);
+                    if (value != RAX)
+                        asm_mov_rr(code, RAX, value);
+                }
+                if (i + 1 < instructions)
+                    jump_to(generator, asm_jmp(code), epilogue);
+                break;
+        }
+    }
+
+    generator->label_s[epilogue] = code_size(code);
+    asm_lea(code, RSP, RBP, -8 * (int32_t)generator->saved);
+    for (uint32_t i = generator->saved; i-- > 0; )
+        asm_pop(code, saved_s[i]);
+    asm_pop(code, RBP);
+    asm_ret(code);
+
+    for (size_t i = 0; i < array_size(generator->fixup_s); i++)
+        asm_patch(code, generator->fixup_s[i].at, generator->label_s[generator->fixup_s[i].label]);
+
+    declaration_t declaration = (declaration_t)function;
+    elf_symbol_t symbol = { symbol_sz(declaration_symbol(declaration)), start, code_size(code) - start, true };
+    generator->symbol_s = array_add(generator->symbol_s, symbol);
+    symbol_t name = declaration_symbol(declaration);
+    generator->defined_s = array_add(generator->defined_s, name);
+
+    // the next function starts 16 byte aligned, padded with int3
+    while (code_size(code) % 16)
+    {
+        uint8_t int3 = 0xcc;
+        code->byte_s = array_add(code->byte_s, int3);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Units.
+
+typedef struct named_t named_t;
+struct named_t
+{
+    symbol_t    symbol;
+    uint32_t    index;
+};
+
+static
+int compare_named(const void *lhs, const void *rhs)
+{
+    const named_t *a = lhs;
+    const named_t *b = rhs;
+    return a->symbol < b->symbol ? -1 : a->symbol > b->symbol;
+}
+
+// Calls become relocations against a symbol of the unit: the function,
+// when the unit defines it, or an undefined one otherwise.
+static
+array_t(elf_call_t) resolve_calls(generator_t *generator)
+{
+    size_t defined = array_size(generator->defined_s);
+    named_t *named_s = mem_alloc(sizeof(named_t) * (defined + array_size(generator->call_s) + 1));
+    for (size_t i = 0; i < defined; i++)
+        named_s[i] = (named_t){ generator->defined_s[i], i };
+    qsort(named_s, defined, sizeof(named_t), compare_named);
+
+    size_t names = defined;
+    array_t(elf_call_t) elf_call_s = array_empty();
+    for (size_t i = 0; i < array_size(generator->call_s); i++)
+    {
+        named_t key = { generator->call_s[i].symbol, 0 };
+        named_t *found = bsearch(&key, named_s, names, sizeof(named_t), compare_named);
+        if (found == NULL)
+        {
+            // keep the table sorted for the next search
+            key.index = array_size(generator->symbol_s);
+            elf_symbol_t symbol = { symbol_sz(key.symbol), 0, 0, false };
+            generator->symbol_s = array_add(generator->symbol_s, symbol);
+
+            size_t at = names;
+            while (at > 0 && named_s[at - 1].symbol > key.symbol)
+            {
+                named_s[at] = named_s[at - 1];
+                at--;
+            }
+            named_s[at] = key;
+            names++;
+            found = &named_s[at];
+        }
+
+        elf_call_t call = { generator->call_s[i].at, found->index };
+        elf_call_s = array_add(elf_call_s, call);
+    }
+
+    mem_free(named_s);
+    return elf_call_s;
+}
+
+static
+void generate_unit(generator_t *generator, unit_t unit, x64_unit_t *out)
+{
+    array_t(declaration_t) declaration_s = unit_declaration_s(unit);
+    for (size_t i = 0; i < array_size(declaration_s) && !generator->failed; i++)
+    {
+        function_t function = FUNCTION(declaration_s[i]);
+        lower_function(generator, function);
+        if (generator->failed)
+            break;
+        allocate(generator, function);
+        emit_function(generator, function);
+    }
+
+    out->failed = generator->failed;
+    if (out->failed)
+        return;
+
+    array_t(elf_call_t) call_s = resolve_calls(generator);
+    out->object = elf_object(source_path(unit_source(unit)),
+        generator->code.byte_s, code_size(&generator->code),
+        generator->symbol_s, array_size(generator->symbol_s),
+        call_s, array_size(call_s), &out->size);
+    array_free(call_s);
+}
+
+static
+void generate_task(void *context, size_t index)
+{
+    x64_t x64 = context;
+
+    generator_t generator = { 0 };
+    generator.inst_s = array_empty();
+    generator.argument_s = array_empty();
+    generator.taken_s = array_empty();
+    generator.interval_s = array_empty();
+    generator.call_at_s = array_empty();
+    generator.code.byte_s = array_empty();
+    generator.label_s = array_empty();
+    generator.fixup_s = array_empty();
+    generator.call_s = array_empty();
+    generator.symbol_s = array_empty();
+    generator.defined_s = array_empty();
+
+    generate_unit(&generator, compilation_unit_s(x64->compilation)[index], &x64->unit_s[index]);
+
+    array_free(generator.inst_s);
+    array_free(generator.argument_s);
+    array_free(generator.taken_s);
+    array_free(generator.interval_s);
+    array_free(generator.call_at_s);
+    array_free(generator.code.byte_s);
+    array_free(generator.label_s);
+    array_free(generator.fixup_s);
+    array_free(generator.call_s);
+    array_free(generator.symbol_s);
+    array_free(generator.defined_s);
+    if (generator.home_s != NULL)
+        mem_free(generator.home_s);
+    if (generator.memory_s != NULL)
+        mem_free(generator.memory_s);
+    if (generator.start_s != NULL)
+    {
+        mem_free(generator.start_s);
+        mem_free(generator.end_s);
+        mem_free(generator.loc_s);
+    }
+}
+
+x64_t x64_codegen(compilation_t compilation)
+{
+    x64_t x64 = mem_alloc(sizeof(struct x64_t));
+    x64->compilation = compilation;
+    x64->units = array_size(compilation_unit_s(compilation));
+    x64->unit_s = mem_alloc(sizeof(x64_unit_t) * (x64->units + 1));
+    memset(x64->unit_s, 0, sizeof(x64_unit_t) * (x64->units + 1));
+
+    thread_pool_t pool = thread_pool_new(0);
+    thread_pool_run(pool, x64->units, generate_task, x64);
+    thread_pool_free(pool);
+
+    for (size_t i = 0; i < x64->units; i++)
+        if (x64->unit_s[i].failed)
+        {
+            x64_free(x64);
+            return NULL;
+        }
+
+    return x64;
+}
+
+void x64_free(x64_t x64)
+{
+    for (size_t i = 0; i < x64->units; i++)
+        if (x64->unit_s[i].object != NULL)
+            mem_free(x64->unit_s[i].object);
+
+    compilation_free(x64->compilation);
+    mem_free(x64->unit_s);
+    mem_free(x64);
+}
+
+const uint8_t* x64_object(x64_t x64, size_t index, size_t *size)
+{
+    *size = x64->unit_s[index].size;
+    return x64->unit_s[index].object;
+}
+
+bool x64_write(x64_t x64, size_t index, const char *path)
+{
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "x64: can't open %s\n", path);
+        return false;
+    }
+
+    x64_unit_t *unit = &x64->unit_s[index];
+    bool written = fwrite(unit->object, 1, unit->size, file) == unit->size;
+    written = fclose(file) == 0 && written;
+    if (!written)
+        fprintf(stderr, "x64: can't write %s\n", path);
+
+    return written;
+}
@@ -0,0 +1,25 @@
+#ifndef _X64_H_
+#define _X64_H_
+
+#include "ast/ast.h"
+
+#include <stdint.h>
+
+// Direct x86-64 backend for fast debug builds: the checked AST is lowered
+// to virtual registers, allocated by linear scan and encoded straight into
+// ELF relocatable objects, one per unit. Code follows the System V ABI and
+// the symbols are the LLVM backend's, so objects of both link together.
+typedef  struct x64_t*  x64_t;
+
+// Generates every unit, in parallel, and takes ownership of the
+// compilation. Returns NULL, with the reason on stderr, for what the
+// backend cannot express, e.g. a call through a function value.
+x64_t           x64_codegen(compilation_t compilation);
+void            x64_free(x64_t x64);
+
+// The object of the unit at index, valid until x64_free.
+const uint8_t*  x64_object(x64_t x64, size_t index, size_t *size);
+// Writes the object of the unit at index; failures go to stderr.
+bool            x64_write(x64_t x64, size_t index, const char *path);
+
+#endif
@@ -0,0 +1,100 @@
+#include <stdlib.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include <elf.h>
+
+#include "common/mem.h"
+#include "x64/elf.h"
+
+static const Elf64_Shdr* section(const uint8_t *image, const char *name)
+{
+    const Elf64_Ehdr *elf = (const Elf64_Ehdr*)image;
+    const Elf64_Shdr *header = (const Elf64_Shdr*)(image + elf->e_shoff);
+    const char *shstrtab = (const char*)(image + header[elf->e_shstrndx].sh_offset);
+
+    for (size_t i = 0; i < elf->e_shnum; i++)
+        if (strcmp(shstrtab + header[i].sh_name, name) == 0)
+            return &header[i];
+
+    return NULL;
+}
+
+static void object(void **arg)
+{
+    (void) arg;
+
+    // main: call f; ret
+    const uint8_t text[] = { 0xe8, 0, 0, 0, 0, 0xc3 };
+    const elf_symbol_t symbol_s[] =
+    {
+        { "main", 0, sizeof(text), true },
+        { "f", 0, 0, false },
+    };
+    const elf_call_t call_s[] = { { 1, 1 } };
+
+    size_t size = 0;
+    uint8_t *image = elf_object("unit.iz", text, sizeof(text), symbol_s, 2, call_s, 1, &size);
+    assert_non_null(image);
+
+    const Elf64_Ehdr *elf = (const Elf64_Ehdr*)image;
+    assert_memory_equal(ELFMAG, elf->e_ident, SELFMAG);
+    assert_int_equal(ELFCLASS64, elf->e_ident[EI_CLASS]);
+    assert_int_equal(ET_REL, elf->e_type);
+    assert_int_equal(EM_X86_64, elf->e_machine);
+    assert_int_equal(size, elf->e_shoff + elf->e_shnum * sizeof(Elf64_Shdr));
+
+    const Elf64_Shdr *text_section = section(image, ".text");
+    assert_non_null(text_section);
+    assert_int_equal(SHF_ALLOC | SHF_EXECINSTR, text_section->sh_flags);
+    assert_int_equal(sizeof(text), text_section->sh_size);
+    assert_memory_equal(text, image + text_section->sh_offset, sizeof(text));
+    assert_non_null(section(image, ".note.GNU-stack"));
+
+    const Elf64_Shdr *symtab = section(image, ".symtab");
+    const Elf64_Shdr *strtab = section(image, ".strtab");
+    assert_non_null(symtab);
+    assert_non_null(strtab);
+    const Elf64_Sym *sym = (const Elf64_Sym*)(image + symtab->sh_offset);
+    const char *str = (const char*)(image + strtab->sh_offset);
+    size_t symbols = symtab->sh_size / sizeof(Elf64_Sym);
+    assert_int_equal(5, symbols);
+
+    // locals first: null, file and section
+    assert_int_equal(3, symtab->sh_info);
+    assert_string_equal("unit.iz", str + sym[1].st_name);
+    assert_int_equal(STT_FILE, ELF64_ST_TYPE(sym[1].st_info));
+    assert_int_equal(STT_SECTION, ELF64_ST_TYPE(sym[2].st_info));
+
+    assert_string_equal("main", str + sym[3].st_name);
+    assert_int_equal(STB_GLOBAL, ELF64_ST_BIND(sym[3].st_info));
+    assert_int_equal(STT_FUNC, ELF64_ST_TYPE(sym[3].st_info));
+    assert_int_equal(sizeof(text), sym[3].st_size);
+    assert_int_equal(text_section - (const Elf64_Shdr*)(image + elf->e_shoff), sym[3].st_shndx);
+
+    assert_string_equal("f", str + sym[4].st_name);
+    assert_int_equal(SHN_UNDEF, sym[4].st_shndx);
+
+    const Elf64_Shdr *rela_section = section(image, ".rela.text");
+    assert_non_null(rela_section);
+    assert_int_equal(sizeof(Elf64_Rela), rela_section->sh_size);
+    const Elf64_Rela *rela = (const Elf64_Rela*)(image + rela_section->sh_offset);
+    assert_int_equal(1, rela->r_offset);
+    assert_int_equal(4, ELF64_R_SYM(rela->r_info));
+    assert_int_equal(R_X86_64_PLT32, ELF64_R_TYPE(rela->r_info));
+    assert_int_equal(-4, rela->r_addend);
+
+    mem_free(image);
+}
+
+int main(void)
+{
+    const struct CMUnitTest tests[] =
+    {
+        cmocka_unit_test(object),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
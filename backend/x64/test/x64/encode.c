@@ -0,0 +1,139 @@
+#include <stdlib.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include "x64/encode.h"
+
+#define assert_code(code, ...) \
+    do { \
+        static const uint8_t expected[] = { __VA_ARGS__ }; \
+        assert_int_equal(sizeof(expected), code_size(&code)); \
+        assert_memory_equal(expected, code.byte_s, sizeof(expected)); \
+        array_truncate(code.byte_s, 0); \
+    } while (0)
+
+static void moves(void **arg)
+{
+    (void) arg;
+
+    code_t code = { array_empty() };
+
+    asm_mov_rr(&code, RBP, RSP);
+    assert_code(code, 0x48, 0x89, 0xe5);
+    asm_mov_rr(&code, R12, RDI);
+    assert_code(code, 0x49, 0x89, 0xfc);
+
+    asm_mov_ri(&code, RAX, 42);
+    assert_code(code, 0xb8, 42, 0, 0, 0);
+    asm_mov_ri(&code, R9, 1);
+    assert_code(code, 0x41, 0xb9, 1, 0, 0, 0);
+    asm_mov_ri(&code, RCX, -1);
+    assert_code(code, 0x48, 0xc7, 0xc1, 0xff, 0xff, 0xff, 0xff);
+
+    // rbp needs a displacement, rsp a SIB byte
+    asm_load(&code, LOAD_I64, RAX, RBP, -8);
+    assert_code(code, 0x48, 0x8b, 0x45, 0xf8);
+    asm_load(&code, LOAD_I32, RCX, RSP, 0);
+    assert_code(code, 0x48, 0x63, 0x0c, 0x24);
+    asm_load(&code, LOAD_I8, RDX, RDI, 0);
+    assert_code(code, 0x48, 0x0f, 0xbe, 0x17);
+    asm_load(&code, LOAD_U8, R8, R13, 0);
+    assert_code(code, 0x4d, 0x0f, 0xb6, 0x45, 0x00);
+    asm_load(&code, LOAD_I64, RAX, RBP, 1024);
+    assert_code(code, 0x48, 0x8b, 0x85, 0x00, 0x04, 0x00, 0x00);
+
+    asm_store(&code, 4, RAX, 0, RCX);
+    assert_code(code, 0x89, 0x08);
+    // sil needs a REX prefix, or it would be dh
+    asm_store(&code, 1, RBP, -1, RSI);
+    assert_code(code, 0x40, 0x88, 0x75, 0xff);
+    asm_store(&code, 8, RBP, -16, R11);
+    assert_code(code, 0x4c, 0x89, 0x5d, 0xf0);
+
+    asm_lea(&code, RSP, RBP, -24);
+    assert_code(code, 0x48, 0x8d, 0x65, 0xe8);
+
+    array_free(code.byte_s);
+}
+
+static void arithmetic(void **arg)
+{
+    (void) arg;
+
+    code_t code = { array_empty() };
+
+    asm_alu32(&code, ALU_ADD, RAX, RCX);
+    assert_code(code, 0x01, 0xc8);
+    asm_alu32(&code, ALU_SUB, R10, RSI);
+    assert_code(code, 0x41, 0x29, 0xf2);
+    asm_alu32(&code, ALU_IMUL, RDI, R11);
+    assert_code(code, 0x41, 0x0f, 0xaf, 0xfb);
+
+    asm_add_ri(&code, RSP, -16);
+    assert_code(code, 0x48, 0x83, 0xc4, 0xf0);
+    asm_add_ri(&code, RSP, 4096);
+    assert_code(code, 0x48, 0x81, 0xc4, 0x00, 0x10, 0x00, 0x00);
+    asm_and_ri(&code, RAX, 1);
+    assert_code(code, 0x48, 0x83, 0xe0, 0x01);
+
+    asm_movsxd(&code, RAX, RAX);
+    assert_code(code, 0x48, 0x63, 0xc0);
+    asm_movsx8(&code, RCX, RCX);
+    assert_code(code, 0x48, 0x0f, 0xbe, 0xc9);
+    asm_cqo(&code);
+    asm_idiv(&code, R11);
+    assert_code(code, 0x48, 0x99, 0x49, 0xf7, 0xfb);
+
+    asm_cmp(&code, RAX, R11);
+    assert_code(code, 0x4c, 0x39, 0xd8);
+    asm_test(&code, RCX, RCX);
+    assert_code(code, 0x48, 0x85, 0xc9);
+    asm_set(&code, CC_L, RAX);
+    assert_code(code, 0x0f, 0x9c, 0xc0, 0x0f, 0xb6, 0xc0);
+    asm_set(&code, CC_E, RDI);
+    assert_code(code, 0x40, 0x0f, 0x94, 0xc7, 0x40, 0x0f, 0xb6, 0xff);
+
+    array_free(code.byte_s);
+}
+
+static void control(void **arg)
+{
+    (void) arg;
+
+    code_t code = { array_empty() };
+
+    asm_push(&code, RBP);
+    asm_push(&code, R12);
+    asm_push_mem(&code, RBP, -8);
+    asm_pop(&code, R12);
+    asm_pop(&code, RBP);
+    asm_ret(&code);
+    assert_code(code, 0x55, 0x41, 0x54, 0xff, 0x75, 0xf8, 0x41, 0x5c, 0x5d, 0xc3);
+
+    // displacements count from the end of the instruction
+    size_t jump = asm_jmp(&code);
+    size_t branch = asm_jcc(&code, CC_NE);
+    size_t call = asm_call(&code);
+    assert_int_equal(1, jump);
+    assert_int_equal(7, branch);
+    assert_int_equal(12, call);
+    asm_patch(&code, jump, code_size(&code));
+    asm_patch(&code, branch, 0);
+    assert_code(code, 0xe9, 11, 0, 0, 0, 0x0f, 0x85, 0xf5, 0xff, 0xff, 0xff, 0xe8, 0, 0, 0, 0);
+
+    array_free(code.byte_s);
+}
+
+int main(void)
+{
+    const struct CMUnitTest tests[] =
+    {
+        cmocka_unit_test(moves),
+        cmocka_unit_test(arithmetic),
+        cmocka_unit_test(control),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,412 @@
+#include <stdlib.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include <elf.h>
+#include <stdio.h>
+#include <sys/mman.h>
+
+#include "common/mem.h"
+#include "parser/parser.h"
+#include "sema/sema.h"
+#include "x64/x64.h"
+
+#define LF "\n"
+
+static compilation_t compile(const char *const *code_s, size_t size)
+{
+    array_t(unit_t) unit_s = array_empty();
+    for (size_t i = 0; i < size; i++)
+    {
+        char path[32];
+        snprintf(path, sizeof(path), "unit%zu.iz", i);
+        unit_t unit = syntax_analysis(source_inline(code_s[i], path));
+        assert_non_null(unit);
+        unit_s = array_add(unit_s, unit);
+    }
+
+    compilation_t compilation = semantic_analysis(unit_s);
+    assert_non_null(compilation);
+
+    return compilation;
+}
+
+// The objects' .text sections, laid out one after the other and linked
+// the way ld would: every PLT32 relocation becomes a direct call.
+typedef struct image_t image_t;
+struct image_t
+{
+    uint8_t    *text;
+    size_t      size;
+};
+
+static const Elf64_Shdr* section(const uint8_t *object, uint32_t type)
+{
+    const Elf64_Ehdr *elf = (const Elf64_Ehdr*)object;
+    const Elf64_Shdr *header = (const Elf64_Shdr*)(object + elf->e_shoff);
+    for (size_t i = 0; i < elf->e_shnum; i++)
+        if (header[i].sh_type == type)
+            return &header[i];
+    return NULL;
+}
+
+static const Elf64_Sym* symbols(const uint8_t *object, size_t *count, const char **str)
+{
+    const Elf64_Ehdr *elf = (const Elf64_Ehdr*)object;
+    const Elf64_Shdr *header = (const Elf64_Shdr*)(object + elf->e_shoff);
+    const Elf64_Shdr *symtab = section(object, SHT_SYMTAB);
+    *count = symtab->sh_size / sizeof(Elf64_Sym);
+    *str = (const char*)(object + header[symtab->sh_link].sh_offset);
+    return (const Elf64_Sym*)(object + symtab->sh_offset);
+}
+
+static uint8_t* find(x64_t x64, size_t units, const size_t *base_s, uint8_t *text, const char *name)
+{
+    for (size_t i = 0; i < units; i++)
+    {
+        size_t size, count;
+        const char *str;
+        const Elf64_Sym *sym = symbols(x64_object(x64, i, &size), &count, &str);
+        for (size_t j = 0; j < count; j++)
+            if (sym[j].st_shndx != SHN_UNDEF && ELF64_ST_TYPE(sym[j].st_info) == STT_FUNC
+                && strcmp(str + sym[j].st_name, name) == 0)
+                return text + base_s[i] + sym[j].st_value;
+    }
+
+    fail_msg("undefined %s", name);
+    return NULL;
+}
+
+static image_t load(x64_t x64, size_t units)
+{
+    size_t base_s[units];
+    size_t total = 0;
+    for (size_t i = 0; i < units; i++)
+    {
+        size_t size;
+        base_s[i] = total;
+        total += (section(x64_object(x64, i, &size), SHT_PROGBITS)->sh_size + 15) & ~15;
+    }
+
+    image_t image = { NULL, total + 1 };
+    image.text = mmap(NULL, image.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    assert_true(image.text != MAP_FAILED);
+
+    for (size_t i = 0; i < units; i++)
+    {
+        size_t size;
+        const uint8_t *object = x64_object(x64, i, &size);
+        const Elf64_Shdr *text = section(object, SHT_PROGBITS);
+        memcpy(image.text + base_s[i], object + text->sh_offset, text->sh_size);
+
+        size_t count;
+        const char *str;
+        const Elf64_Sym *sym = symbols(object, &count, &str);
+        const Elf64_Shdr *rela_section = section(object, SHT_RELA);
+        const Elf64_Rela *rela = (const Elf64_Rela*)(object + rela_section->sh_offset);
+        for (size_t j = 0; j < rela_section->sh_size / sizeof(Elf64_Rela); j++)
+        {
+            assert_int_equal(R_X86_64_PLT32, ELF64_R_TYPE(rela[j].r_info));
+            const Elf64_Sym *target = &sym[ELF64_R_SYM(rela[j].r_info)];
+            uint8_t *s = target->st_shndx != SHN_UNDEF
+                ? image.text + base_s[i] + target->st_value
+                : find(x64, units, base_s, image.text, str + target->st_name);
+            uint8_t *p = image.text + base_s[i] + rela[j].r_offset;
+            int32_t value = (int32_t)(s + rela[j].r_addend - p);
+            memcpy(p, &value, sizeof(value));
+        }
+    }
+
+    assert_int_equal(0, mprotect(image.text, image.size, PROT_READ | PROT_EXEC));
+    return image;
+}
+
+// Generates, loads and calls main.
+static int64_t run_units(const char *const *code_s, size_t units)
+{
+    x64_t x64 = x64_codegen(compile(code_s, units));
+    assert_non_null(x64);
+
+    image_t image = load(x64, units);
+    size_t base_s[units];
+    size_t total = 0;
+    for (size_t i = 0; i < units; i++)
+    {
+        size_t size;
+        base_s[i] = total;
+        total += (section(x64_object(x64, i, &size), SHT_PROGBITS)->sh_size + 15) & ~15;
+    }
+    int (*entry)(void) = (int (*)(void))find(x64, units, base_s, image.text, "main");
+    int64_t result = entry();
+
+    munmap(image.text, image.size);
+    x64_free(x64);
+    return result;
+}
+
+static int64_t run(const char *code)
+{
+    return run_units(&code, 1);
+}
+
+static void arithmetic(void **arg)
+{
+    (void) arg;
+
+    assert_int_equal(7, run("int main() return 1 + 2 * 3;"));
+    assert_int_equal(-3, run("int main() { int a = 0 - 7; return a / 2; }"));
+    assert_int_equal(-1, run("int main() { int a = 0 - 7; return a % 2; }"));
+    assert_int_equal(1, run("int main() return 10 - 3 * 3;"));
+
+    // int wraps at 32 bits
+    assert_int_equal(-2147483648LL, run("int main() return 2147483647 + 1;"));
+    assert_int_equal(0, run("int main() return 65536 * 65536;"));
+    assert_int_equal(1, run("bool main() return 2147483647 + 1 < 0;"));
+
+    // char wraps at 8 bits
+    assert_int_equal(-62, (int8_t)run("char main() return 'a' + 'a';"));
+    assert_int_equal(1, run("bool main() { char c = 'a' + 'a'; return c < 'a'; }"));
+    assert_int_equal(1, (uint8_t)run("bool main() return '0' <= '5' && '5' <= '9';"));
+
+    // bool arithmetic is one bit, and true orders below false
+    assert_int_equal(0, (uint8_t)run("bool main() return true + true;"));
+    assert_int_equal(1, (uint8_t)run("bool main() return true < false;"));
+    assert_int_equal(0, (uint8_t)run("bool main() return false < true;"));
+    assert_int_equal(1, (uint8_t)run("bool main() return true != false;"));
+}
+
+static void control(void **arg)
+{
+    (void) arg;
+
+    assert_int_equal(3, run(
+        "int main()" LF
+        "{" LF
+        "    int a = 5;" LF
+        "    if (a > 3)" LF
+        "    {" LF
+        "        int b = a - 2;" LF
+        "        a = b;" LF
+        "    }" LF
+        "    else" LF
+        "        a = 0;" LF
+        "    if (a == 0)" LF
+        "        return 1;" LF
+        "    return a;" LF
+        "}" LF));
+
+    // the right side of && and || runs only when needed
+    assert_int_equal(1, (uint8_t)run(
+        "bool fail()" LF
+        "    return 1 / 0 == 0;" LF
+        "bool main()" LF
+        "    return false && fail() || true || fail();" LF));
+
+    assert_int_equal(2, run(
+        "bool is_leap_year(int year)" LF
+        "    return year % 4 == 0 && year % 100 != 0 || year % 400 == 0;" LF
+        "int count(bool b)" LF
+        "{" LF
+        "    if (b)" LF
+        "        return 1;" LF
+        "    return 0;" LF
+        "}" LF
+        "int main()" LF
+        "    return count(is_leap_year(2024)) + count(is_leap_year(1900)) + count(is_leap_year(2000)) + count(is_leap_year(2023)) * 10;" LF));
+}
+
+static void calls(void **arg)
+{
+    (void) arg;
+
+    assert_int_equal(55, run(
+        "int fib(int n)" LF
+        "{" LF
+        "    if (n < 2)" LF
+        "        return n;" LF
+        "    return fib(n - 1) + fib(n - 2);" LF
+        "}" LF
+        "int main()" LF
+        "    return fib(10);" LF));
+
+    assert_int_equal(46, run(
+        "int add(int a, int b)" LF
+        "    return a + b;" LF
+        "int main()" LF
+        "{" LF
+        "    int x = 4;" LF
+        "    int y = add(add(x, 10), add(20, x));" LF
+        "    x = add(x, y) + x;" LF
+        "    return x;" LF
+        "}" LF));
+
+    // past six arguments go on the stack, an odd count padded
+    assert_int_equal(87654321, run(
+        "int digits(int a, int b, int c, int d, int e, int f, int g, int h)" LF
+        "    return a + 10 * b + 100 * c + 1000 * d + 10000 * e + 100000 * f + 1000000 * g + 10000000 * h;" LF
+        "int main()" LF
+        "    return digits(1, 2, 3, 4, 5, 6, 7, 8);" LF));
+    assert_int_equal(7654321, run(
+        "int digits(int a, int b, int c, int d, int e, int f, int g)" LF
+        "    return a + 10 * b + 100 * c + 1000 * d + 10000 * e + 100000 * f + 1000000 * g;" LF
+        "int pass(int a, int b, int c, int d, int e, int f, int g)" LF
+        "    return digits(a, b, c, d, e, f, g);" LF
+        "int main()" LF
+        "    return pass(1, 2, 3, 4, 5, 6, 7);" LF));
+
+    // the argument registers are permuted in place
+    assert_int_equal(132, run(
+        "int digits(int a, int b, int c)" LF
+        "    return a + 10 * b + 100 * c;" LF
+        "int rotate(int a, int b, int c)" LF
+        "    return digits(c, a, b);" LF
+        "int main()" LF
+        "    return rotate(3, 1, 2);" LF));
+
+    // narrow results and arguments are widened by the callee and caller
+    assert_int_equal(-2, run(
+        "char twice(char c)" LF
+        "    return c + c;" LF
+        "bool not(bool b)" LF
+        "    return b == false;" LF
+        "int main()" LF
+        "{" LF
+        "    if (twice('a') < 'a' && not(false) && not(not(true)))" LF
+        "        return 0 - 2;" LF
+        "    return 0;" LF
+        "}" LF));
+
+    // across units
+    const char *unit_s[] =
+    {
+        "int triple(int n)" LF
+        "    return 3 * n;" LF,
+
+        "int main()" LF
+        "    return triple(14);" LF,
+    };
+    assert_int_equal(42, run_units(unit_s, 2));
+}
+
+static void pointers(void **arg)
+{
+    (void) arg;
+
+    assert_int_equal(12, run(
+        "void swap_int(int* lhs, int* rhs)" LF
+        "{" LF
+        "    int tmp = *lhs;" LF
+        "    *lhs = *rhs;" LF
+        "    *rhs = tmp;" LF
+        "}" LF
+        "int main()" LF
+        "{" LF
+        "    int a = 2, b = 1;" LF
+        "    swap_int(&a, &b);" LF
+        "    return a * 10 + b;" LF
+        "}" LF));
+
+    assert_int_equal(9, run(
+        "void set(char* c, bool* b)" LF
+        "{" LF
+        "    *c = 'a' + 'a';" LF
+        "    *b = true;" LF
+        "}" LF
+        "int main()" LF
+        "{" LF
+        "    char c = 'a';" LF
+        "    bool b = false;" LF
+        "    int i = 7;" LF
+        "    int* p = &i;" LF
+        "    set(&c, &b);" LF
+        "    if (c < 'a' && b)" LF
+        "        *p = *p + 2;" LF
+        "    return i;" LF
+        "}" LF));
+
+    // an argument whose address is taken lives in memory
+    assert_int_equal(10, run(
+        "void bump(int* n)" LF
+        "    *n = *n + 1;" LF
+        "int f(int a, int b)" LF
+        "{" LF
+        "    bump(&b);" LF
+        "    return a + b;" LF
+        "}" LF
+        "int main()" LF
+        "    return f(4, 5);" LF));
+}
+
+static void registers(void **arg)
+{
+    (void) arg;
+
+    // more live values than registers, across calls: some are spilled
+    assert_int_equal(136, run(
+        "int id(int n)" LF
+        "    return n;" LF
+        "int main()" LF
+        "{" LF
+        "    int a = id(1), b = id(2), c = id(3), d = id(4), e = id(5), f = id(6), g = id(7), h = id(8);" LF
+        "    int i = id(9), j = id(10), k = id(11), l = id(12), m = id(13), n = id(14), o = id(15), p = id(16);" LF
+        "    return a + b + c + d + e + f + g + h + i + j + k + l + m + n + o + p;" LF
+        "}" LF));
+
+    // assignments are values, and reads before them see the old value
+    assert_int_equal(43, run(
+        "int add(int a, int b)" LF
+        "    return a + b;" LF
+        "int main()" LF
+        "{" LF
+        "    int x = 1, y = 0;" LF
+        "    y = add(x, x = 41) + 1;" LF
+        "    return y;" LF
+        "}" LF));
+}
+
+static void unsupported(void **arg)
+{
+    (void) arg;
+
+    const char *code =
+        "int one()" LF
+        "    return 1;" LF
+        "int main()" LF
+        "{" LF
+        "    one;" LF
+        "    return 0;" LF
+        "}" LF;
+    assert_null(x64_codegen(compile(&code, 1)));
+
+    // a function read or assigned as a value
+    code =
+        "int f()" LF
+        "    return 1;" LF
+        "bool g()" LF
+        "    return f == f;" LF;
+    assert_null(x64_codegen(compile(&code, 1)));
+
+    code =
+        "int f()" LF
+        "    return 1;" LF
+        "void g()" LF
+        "    f = f;" LF;
+    assert_null(x64_codegen(compile(&code, 1)));
+}
+
+int main(void)
+{
+    const struct CMUnitTest tests[] =
+    {
+        cmocka_unit_test(arithmetic),
+        cmocka_unit_test(control),
+        cmocka_unit_test(calls),
+        cmocka_unit_test(pointers),
+        cmocka_unit_test(registers),
+        cmocka_unit_test(unsupported),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
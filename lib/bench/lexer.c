@@ -0,0 +1,54 @@
+#include "parser/scan.h"
+#include "parser/token.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Lexes a source repeatedly into a token stream and reports throughput,
+// so the lexer can be measured apart from the parser.
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s <file> [iterations]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    int iterations = argc > 2 ? atoi(argv[2]) : 1000;
+
+    source_t source = source_load(argv[1]);
+    if (source == NULL)
+    {
+        fprintf(stderr, "can't open %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    const char *names[] = { "scalar", "sse2", "avx2" };
+    for (scan_kernel_t kernel = SCAN_KERNEL_SCALAR; kernel <= SCAN_KERNEL_AVX2; kernel++)
+    {
+        if (!scan_select(kernel))
+            continue;
+
+        size_t tokens = 0;
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        for (int i = 0; i < iterations; i++)
+        {
+            token_stream_t stream = token_stream_new(source);
+            tokens += token_stream_size(stream);
+            token_stream_free(stream);
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        double bytes = (double)source_size(source) * iterations;
+
+        printf("%s [%s]: %zu tokens, %.3f s, %.1f MB/s, %.1f Mtokens/s\n",
+            argv[1], names[kernel], tokens / iterations, seconds, bytes / seconds / 1e6, tokens / seconds / 1e6);
+    }
+
+    source_free(source);
+    return EXIT_SUCCESS;
+}
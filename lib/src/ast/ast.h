@@ -57,6 +57,12 @@ typedef  struct conditional_t*         conditional_t;
 typedef  enum   unary_kind_t           unary_kind_t;
 typedef  struct unary_t*               unary_t;
 
+// Nodes live in per-kind pools of their unit's arena and refer to their
+// children by pool_ref_t; a node's kind is the pool it was allocated from.
+#define AST_POOL_EXPRESSION   1
+#define AST_POOL_STATEMENT    (AST_POOL_EXPRESSION + EXPRESSION_UNARY + 1)
+#define AST_POOL_DECLARATION  (AST_POOL_STATEMENT + STATEMENT_ACT + 1)
+
 
 #include "ast/expression.h"
 #include "ast/statement.h"
@@ -6,12 +6,14 @@ extern void unit_free(unit_t unit);
 struct compilation_t
 {
     array_t(unit_t) unit_s;
+    uint32_t        declarations;
 };
 
-compilation_t compilation_new(array_t(unit_t) unit_s)
+compilation_t compilation_new(array_t(unit_t) unit_s, uint32_t declarations)
 {
     compilation_t compilation = mem_alloc(sizeof(struct compilation_t));
     compilation->unit_s = unit_s;
+    compilation->declarations = declarations;
     return compilation;
 }
 
@@ -25,3 +27,8 @@ array_t(unit_t) compilation_unit_s(compilation_t compilation)
 {
     return compilation->unit_s;
 }
+
+uint32_t compilation_declarations(compilation_t compilation)
+{
+    return compilation->declarations;
+}
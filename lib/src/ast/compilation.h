@@ -3,9 +3,12 @@
 
 #include "ast/ast.h"
 
-compilation_t   compilation_new(array_t(unit_t) unit_s);
+compilation_t   compilation_new(array_t(unit_t) unit_s, uint32_t declarations);
 void            compilation_free(compilation_t compilation);
 
 array_t(unit_t) compilation_unit_s(compilation_t compilation);
 
+// Declarations are numbered 1..declarations across all units by sema.
+uint32_t        compilation_declarations(compilation_t compilation);
+
 #endif
@@ -1,44 +1,43 @@
 #include "ast/declaration.h"
-#include "common/mem.h"
+#include "common/arena.h"
+
+// Every kind starts with the dense id sema numbers the declaration with,
+// 0 until then, so later passes can keep per-declaration data in arrays.
+struct declaration_t
+{
+    uint32_t id;
+};
 
 struct function_t
 {
+    struct declaration_t base;
     type_t            return_type;
     struct location_t name;
     array_t(declaration_t) argument_s;
-    statement_t       statement;
+    pool_ref_t        statement;
     type_t            type;
 };
 
 struct argument_t
 {
+    struct declaration_t base;
     type_t            type;
     struct location_t name;
 };
 
 struct variable_t
 {
+    struct declaration_t base;
     type_t            type;
     struct location_t name;
-    expression_t      initializer;
-};
-
-struct declaration_t
-{
-    union
-    {
-        struct function_t function;
-        struct argument_t argument;
-        struct variable_t variable;
-    };
-    declaration_kind_t kind;
+    pool_ref_t        initializer;
 };
 
 static
-declaration_t declaration_new(declaration_kind_t kind)
+declaration_t declaration_new(declaration_kind_t kind, size_t size)
 {
-    declaration_t declaration = mem_alloc(sizeof(struct declaration_t));
-    declaration->kind = kind;
+    declaration_t declaration = pool_push(AST_POOL_DECLARATION + kind, size);
+    declaration->id = 0;
     return declaration;
 }
 
@@ -48,26 +47,26 @@ type_t prepare_callable(type_t return_type, array_t(declaration_t) argument_s)
     size_t size = array_size(argument_s);
     array_t(type_t) param_s = array_empty();
     for (size_t i = 0; i < size; i++)
-        param_s = array_add(param_s, argument_s[i]->argument.type);
+        param_s = array_add(param_s, ARGUMENT(argument_s[i])->type);
 
-    return type_callable_new(return_type, param_s);
+    return type_callable(return_type, param_s);
 }
 
 declaration_t function_new(type_t return_type, struct location_t name, array_t(declaration_t) argument_s, statement_t statement)
 {
-    declaration_t declaration = declaration_new(DECLARATION_FUNCTION);
+    declaration_t declaration = declaration_new(DECLARATION_FUNCTION, sizeof(struct function_t));
     function_t function = FUNCTION(declaration);
     function->return_type = return_type;
     function->name = name;
-    function->argument_s = argument_s;
-    function->statement = statement;
-    function->type = prepare_callable(return_type, argument_s);
+    function->argument_s = array_move(argument_s, arena_push);
+    function->statement = pool_ref(function, statement);
+    function->type = prepare_callable(return_type, function->argument_s);
     return declaration;
 }
 
 declaration_t argument_new(type_t type, struct location_t name)
 {
-    declaration_t declaration = declaration_new(DECLARATION_ARGUMENT);
+    declaration_t declaration = declaration_new(DECLARATION_ARGUMENT, sizeof(struct argument_t));
     argument_t argument = ARGUMENT(declaration);
     argument->type = type;
     argument->name = name;
@@ -77,61 +76,33 @@ declaration_t argument_new(type_t type, struct location_t name)
 
 declaration_t variable_new(type_t type, struct location_t name, expression_t initializer)
 {
-    declaration_t declaration = declaration_new(DECLARATION_VARIABLE);
+    declaration_t declaration = declaration_new(DECLARATION_VARIABLE, sizeof(struct variable_t));
     variable_t variable = VARIABLE(declaration);
     variable->type = type;
     variable->name = name;
-    variable->initializer = initializer;
+    variable->initializer = pool_ref(variable, initializer);
 
     return declaration;
 }
 
-static
-void function_free(function_t function)
-{
-    type_free(function->type);
-    statement_free(function->statement);
-    array_cleanup_free(function->argument_s, (release_t)declaration_free);
-}
-
-static
-void argument_free(argument_t argument)
-{
-}
-
-static
-void variable_free(variable_t variable)
+declaration_kind_t declaration_kind(declaration_t declaration)
 {
-    type_free(variable->type);
-    if (variable->initializer != NULL)
-        expression_free(variable->initializer);
+    return pool_of(declaration) - AST_POOL_DECLARATION;
 }
 
-void declaration_free(declaration_t declaration)
+uint32_t declaration_id(declaration_t declaration)
 {
-    switch (declaration->kind) // LCOV_EXCL_LINE
-    {
-    case DECLARATION_FUNCTION:
-        function_free(FUNCTION(declaration));
-        break;
-    case DECLARATION_ARGUMENT:
-        argument_free(ARGUMENT(declaration));
-        break;
-    case DECLARATION_VARIABLE:
-        variable_free(VARIABLE(declaration));
-        break;
-    }
-    mem_free(declaration);
+    return declaration->id;
 }
 
-declaration_kind_t declaration_kind(declaration_t declaration)
+void declaration_set_id(declaration_t declaration, uint32_t id)
 {
-    return declaration->kind;
+    declaration->id = id;
 }
 
 location_t declaration_name(declaration_t declaration)
 {
-    switch (declaration->kind) // LCOV_EXCL_LINE
+    switch (declaration_kind(declaration)) // LCOV_EXCL_LINE
     {
     case DECLARATION_FUNCTION:
         return &FUNCTION(declaration)->name;
@@ -144,12 +115,17 @@ location_t declaration_name(declaration_t declaration)
     __builtin_unreachable();
 }
 
+symbol_t declaration_symbol(declaration_t declaration)
+{
+    return location_symbol(declaration_name(declaration));
+}
+
 type_t declaration_type(declaration_t declaration)
 {
     if (declaration == NULL)
         return NULL;
 
-    switch (declaration->kind) // LCOV_EXCL_LINE
+    switch (declaration_kind(declaration)) // LCOV_EXCL_LINE
     {
     case DECLARATION_FUNCTION:
         return FUNCTION(declaration)->type;
@@ -183,7 +159,12 @@ array_t(declaration_t) function_argument_s(function_t function)
 
 statement_t function_statement(function_t function)
 {
-    return function->statement;
+    return pool_deref(function, function->statement);
+}
+
+void function_set_statement(function_t function, statement_t statement)
+{
+    function->statement = pool_ref(function, statement);
 }
 
 type_t argument_type(argument_t argument)
@@ -208,25 +189,25 @@ location_t variable_name(variable_t variable)
 
 expression_t variable_initializer(variable_t variable)
 {
-    return variable->initializer;
+    return pool_deref(variable, variable->initializer);
 }
 
 void variable_set_initializer(variable_t variable, expression_t initializer)
 {
-    variable->initializer = initializer;
+    variable->initializer = pool_ref(variable, initializer);
 }
 
 function_t FUNCTION(declaration_t declaration)
 {
-    return &declaration->function;
+    return (function_t)declaration;
 }
 
 argument_t ARGUMENT(declaration_t declaration)
 {
-    return &declaration->argument;
+    return (argument_t)declaration;
 }
 
 variable_t VARIABLE(declaration_t declaration)
 {
-    return &declaration->variable;
+    return (variable_t)declaration;
 }
\ No newline at end of file
@@ -14,10 +14,11 @@ declaration_t function_new(type_t return_type, struct location_t name, array_t(d
 declaration_t argument_new(type_t type, struct location_t name);
 declaration_t variable_new(type_t type, struct location_t name, expression_t initializer);
 
-void          declaration_free(declaration_t declaration);
-
 declaration_kind_t  declaration_kind(declaration_t declaration);
+uint32_t            declaration_id(declaration_t declaration);
+void                declaration_set_id(declaration_t declaration, uint32_t id);
 location_t          declaration_name(declaration_t declaration);
+symbol_t            declaration_symbol(declaration_t declaration);
 type_t              declaration_type(declaration_t declaration);
 
 type_t                  function_type(function_t function);
@@ -25,6 +26,7 @@ type_t                  function_return_type(function_t function);
 location_t              function_name(function_t function);
 array_t(declaration_t)  function_argument_s(function_t function);
 statement_t             function_statement(function_t function);
+void                    function_set_statement(function_t function, statement_t statement);
 
 type_t     argument_type(argument_t argument);
 location_t argument_name(argument_t argument);
@@ -1,8 +1,21 @@
 #include "ast/expression.h"
-#include "common/mem.h"
+#include "common/arena.h"
+
+#include <assert.h>
+
+// Each kind has its own pool, so a node is exactly as large as its own
+// fields and children are 32-bit references into the unit's pools.
+
+// Every kind starts with the type sema resolved for the node, NULL until
+// then, so the type is read without dispatching on the kind.
+struct expression_t
+{
+    type_t type;
+};
 
 struct constant_t
 {
+    struct expression_t base;
     union
     {
         uint64_t u64;
@@ -12,76 +25,71 @@ struct constant_t
     constant_kind_t kind;
 };
 
+// Only the name is kept of the location: line and column are found from
+// the span when a diagnostic needs them. The declaration is a pointer as
+// it may belong to another unit.
 struct identifier_t
 {
-    struct location_t location;
-    declaration_t declaration;
+    struct expression_t base;
+    const char    *name;
+    uint32_t       size;
+    symbol_t       symbol;
+    declaration_t  declaration;
 };
 
 struct binary_t
 {
-    expression_t lhs, rhs;
+    struct expression_t base;
+    pool_ref_t lhs, rhs;
     binary_kind_t op;
 };
 
 struct call_t
 {
-    expression_t callee;
+    struct expression_t base;
+    pool_ref_t callee;
     array_t(expression_t) argument_s;
 };
 
 struct assignment_t
 {
-    expression_t lvalue;
-    expression_t rvalue;
+    struct expression_t base;
+    pool_ref_t lvalue;
+    pool_ref_t rvalue;
 };
 
 struct implicit_cast_t
 {
+    struct expression_t base;
     implicit_cast_kind_t kind;
-    expression_t expression;
+    pool_ref_t expression;
 };
 
 struct conditional_t
 {
-    expression_t lhs, rhs;
+    struct expression_t base;
+    pool_ref_t lhs, rhs;
     conditional_kind_t op;
 };
 
 struct unary_t
 {
+    struct expression_t base;
     unary_kind_t op;
-    expression_t expression;
-    type_t       type; // memoized pointer type for UNARY_ADDRESS_OF; unused (NULL) for UNARY_DEREF
-};
-
-struct expression_t
-{
-    union
-    {
-        struct constant_t      constant;
-        struct identifier_t    identifier;
-        struct binary_t        binary;
-        struct call_t          call;
-        struct assignment_t    assignment;
-        struct implicit_cast_t implicit_cast;
-        struct conditional_t   conditional;
-        struct unary_t         unary;
-    };
-    expression_kind_t kind;
+    pool_ref_t   expression;
 };
 
 static
-expression_t expression_new(expression_kind_t kind)
+expression_t expression_new(expression_kind_t kind, size_t size)
 {
-    expression_t expression = mem_alloc(sizeof(struct expression_t));
-    expression->kind = kind;
+    expression_t expression = pool_push(AST_POOL_EXPRESSION + kind, size);
+    expression->type = NULL;
     return expression;
 }
 
 expression_t constant_bool_new(bool _bool)
 {
-    expression_t expression = expression_new(EXPRESSION_CONSTANT);
+    expression_t expression = expression_new(EXPRESSION_CONSTANT, sizeof(struct constant_t));
 
     constant_t constant = CONSTANT(expression);
     constant->kind = CONSTANT_BOOL;
@@ -92,7 +100,7 @@ expression_t constant_bool_new(bool _bool)
 
 expression_t constant_u64_new(uint64_t u64)
 {
-    expression_t expression = expression_new(EXPRESSION_CONSTANT);
+    expression_t expression = expression_new(EXPRESSION_CONSTANT, sizeof(struct constant_t));
 
     constant_t constant = CONSTANT(expression);
     constant->kind = CONSTANT_U64;
@@ -103,7 +111,7 @@ expression_t constant_u64_new(uint64_t u64)
 
 expression_t constant_char_new(char _char)
 {
-    expression_t expression = expression_new(EXPRESSION_CONSTANT);
+    expression_t expression = expression_new(EXPRESSION_CONSTANT, sizeof(struct constant_t));
 
     constant_t constant = CONSTANT(expression);
     constant->kind = CONSTANT_CHAR;
@@ -114,57 +122,59 @@ expression_t constant_char_new(char _char)
 
 expression_t identifier_new(struct location_t location)
 {
-    expression_t expression = expression_new(EXPRESSION_IDENTIFIER);
+    expression_t expression = expression_new(EXPRESSION_IDENTIFIER, sizeof(struct identifier_t));
     identifier_t identifier = IDENTIFIER(expression);
-    identifier->location = location;
+    identifier->name = location.span.data;
+    identifier->size = location.span.size;
+    identifier->symbol = location.symbol;
     identifier->declaration = NULL;
     return expression;
 }
 
 expression_t binary_new(expression_t lhs, binary_kind_t op, expression_t rhs)
 {
-    expression_t expression = expression_new(EXPRESSION_BINARY);
+    expression_t expression = expression_new(EXPRESSION_BINARY, sizeof(struct binary_t));
     binary_t binary = BINARY(expression);
-    binary->lhs = lhs;
-    binary->rhs = rhs;
+    binary->lhs = pool_ref(binary, lhs);
+    binary->rhs = pool_ref(binary, rhs);
     binary->op = op;
     return expression;
 }
 
 expression_t call_new(expression_t callee, array_t(expression_t) argument_s)
 {
-    expression_t expression = expression_new(EXPRESSION_CALL);
+    expression_t expression = expression_new(EXPRESSION_CALL, sizeof(struct call_t));
     call_t call = CALL(expression);
-    call->callee = callee;
-    call->argument_s = argument_s;
+    call->callee = pool_ref(call, callee);
+    call->argument_s = array_move(argument_s, arena_push);
     return expression;
 }
 
 
 expression_t assignment_new(expression_t lvalue, expression_t rvalue)
 {
-    expression_t expression = expression_new(EXPRESSION_ASSIGNMENT);
+    expression_t expression = expression_new(EXPRESSION_ASSIGNMENT, sizeof(struct assignment_t));
     assignment_t assignment = ASSIGNMENT(expression);
-    assignment->lvalue = lvalue;
-    assignment->rvalue = rvalue;
+    assignment->lvalue = pool_ref(assignment, lvalue);
+    assignment->rvalue = pool_ref(assignment, rvalue);
     return expression;
 }
 
 expression_t implicit_cast_new(implicit_cast_kind_t kind, expression_t lvalue)
 {
-    expression_t expression = expression_new(EXPRESSION_IMPLICIT_CAST);
+    expression_t expression = expression_new(EXPRESSION_IMPLICIT_CAST, sizeof(struct implicit_cast_t));
     implicit_cast_t implicit_cast = IMPLICIT_CAST(expression);
     implicit_cast->kind = kind;
-    implicit_cast->expression = lvalue;
+    implicit_cast->expression = pool_ref(implicit_cast, lvalue);
     return expression;
 }
 
 expression_t conditional_new(expression_t lhs, conditional_kind_t op, expression_t rhs)
 {
-    expression_t expression = expression_new(EXPRESSION_CONDITIONAL);
+    expression_t expression = expression_new(EXPRESSION_CONDITIONAL, sizeof(struct conditional_t));
     conditional_t conditional = CONDITIONAL(expression);
-    conditional->lhs = lhs;
-    conditional->rhs = rhs;
+    conditional->lhs = pool_ref(conditional, lhs);
+    conditional->rhs = pool_ref(conditional, rhs);
     conditional->op = op;
 
     return expression;
@@ -172,90 +182,17 @@ expression_t conditional_new(expression_t lhs, conditional_kind_t op, expression
 
 expression_t unary_new(unary_kind_t op, expression_t operand)
 {
-    expression_t expression = expression_new(EXPRESSION_UNARY);
+    expression_t expression = expression_new(EXPRESSION_UNARY, sizeof(struct unary_t));
     unary_t unary = UNARY(expression);
     unary->op = op;
-    unary->expression = operand;
-    unary->type = NULL;
+    unary->expression = pool_ref(unary, operand);
 
     return expression;
 }
 
-static
-void binary_free(binary_t binary)
-{
-    expression_free(binary->lhs);
-    expression_free(binary->rhs);
-}
-
-static
-void call_free(call_t call)
-{
-    expression_free(call->callee);
-    array_cleanup_free(call->argument_s, (release_t)expression_free);
-}
-
-static
-void assignment_free(assignment_t assignment)
-{
-    expression_free(assignment->lvalue);
-    expression_free(assignment->rvalue);
-}
-
-static
-void implict_cast_free(implicit_cast_t implicit_cast)
-{
-    expression_free(implicit_cast->expression);
-}
-
-static
-void conditional_free(conditional_t conditional)
-{
-    expression_free(conditional->lhs);
-    expression_free(conditional->rhs);
-}
-
-static
-void unary_free(unary_t unary)
-{
-    expression_free(unary->expression);
-    if (unary->type != NULL)
-        type_free(unary->type);
-}
-
-void expression_free(expression_t expression)
-{
-    switch (expression->kind) // LCOV_EXCL_LINE
-    {
-        case EXPRESSION_CONSTANT:
-        case EXPRESSION_IDENTIFIER:
-            break;
-        case EXPRESSION_BINARY:
-            binary_free(BINARY(expression));
-            break;
-        case EXPRESSION_CALL:
-            call_free(CALL(expression));
-            break;
-        case EXPRESSION_ASSIGNMENT:
-            assignment_free(ASSIGNMENT(expression));
-            break;
-        case EXPRESSION_IMPLICIT_CAST:
-            implict_cast_free(IMPLICIT_CAST(expression));
-            break;
-        case EXPRESSION_CONDITIONAL:
-            conditional_free(CONDITIONAL(expression));
-            break;
-        case EXPRESSION_UNARY:
-            unary_free(UNARY(expression));
-            break;
-    }
-
-    mem_free(expression);
-}
-
 expression_kind_t expression_kind(expression_t expression)
 {
-    return expression->kind;
+    return pool_of(expression) - AST_POOL_EXPRESSION;
 }
 
 constant_kind_t constant_kind(constant_t constant)
@@ -280,7 +217,15 @@ char constant_char(constant_t constant)
 
 span_t identifier_name(identifier_t identifier)
 {
-    return location_span(&identifier->location);
+    return span_ctor(identifier->size, identifier->name);
+}
+
+symbol_t identifier_symbol(identifier_t identifier)
+{
+    if (identifier->symbol == SYMBOL_NONE)
+        identifier->symbol = symbol_intern(identifier_name(identifier));
+
+    return identifier->symbol;
 }
 
 declaration_t identifier_declaration(identifier_t identifier)
@@ -295,22 +240,22 @@ void identifier_set_declaration(identifier_t identifier, declaration_t declarati
 
 expression_t binary_lhs(binary_t binary)
 {
-    return binary->lhs;
+    return pool_deref(binary, binary->lhs);
 }
 
 void binary_set_lhs(binary_t binary, expression_t lhs)
 {
-    binary->lhs = lhs;
+    binary->lhs = pool_ref(binary, lhs);
 }
 
 expression_t binary_rhs(binary_t binary)
 {
-    return binary->rhs;
+    return pool_deref(binary, binary->rhs);
 }
 
 void binary_set_rhs(binary_t binary, expression_t rhs)
 {
-    binary->rhs = rhs;
+    binary->rhs = pool_ref(binary, rhs);
 }
 
 binary_kind_t binary_op(binary_t binary)
@@ -320,7 +265,7 @@ binary_kind_t binary_op(binary_t binary)
 
 expression_t call_callee(call_t call)
 {
-    return call->callee;
+    return pool_deref(call, call->callee);
 }
 
 array_t(expression_t) call_argument_s(call_t call)
@@ -330,17 +275,17 @@ array_t(expression_t) call_argument_s(call_t call)
 
 expression_t assignment_lvalue(assignment_t assignment)
 {
-    return assignment->lvalue;
+    return pool_deref(assignment, assignment->lvalue);
 }
 
 expression_t assignment_rvalue(assignment_t assignment)
 {
-    return assignment->rvalue;
+    return pool_deref(assignment, assignment->rvalue);
 }
 
 void assignment_set_rvalue(assignment_t assignment, expression_t rvalue)
 {
-    assignment->rvalue = rvalue;
+    assignment->rvalue = pool_ref(assignment, rvalue);
 }
 
 implicit_cast_kind_t implicit_cast_kind(implicit_cast_t implicit_cast)
@@ -350,27 +295,27 @@ implicit_cast_kind_t implicit_cast_kind(implicit_cast_t implicit_cast)
 
 expression_t implicit_cast_expression(implicit_cast_t implicit_cast)
 {
-    return implicit_cast->expression;
+    return pool_deref(implicit_cast, implicit_cast->expression);
 }
 
 expression_t conditional_lhs(conditional_t conditional)
 {
-    return conditional->lhs;
+    return pool_deref(conditional, conditional->lhs);
 }
 
 void conditional_set_lhs(conditional_t conditional, expression_t lhs)
 {
-    conditional->lhs = lhs;
+    conditional->lhs = pool_ref(conditional, lhs);
 }
 
 expression_t conditional_rhs(conditional_t conditional)
 {
-    return conditional->rhs;
+    return pool_deref(conditional, conditional->rhs);
 }
 
 void conditional_set_rhs(conditional_t conditional, expression_t rhs)
 {
-    conditional->rhs = rhs;
+    conditional->rhs = pool_ref(conditional, rhs);
 }
 
 conditional_kind_t conditional_op(conditional_t conditional)
@@ -385,12 +330,25 @@ unary_kind_t unary_op(unary_t unary)
 
 expression_t unary_expression(unary_t unary)
 {
-    return unary->expression;
+    return pool_deref(unary, unary->expression);
 }
 
 void unary_set_expression(unary_t unary, expression_t expression)
 {
-    unary->expression = expression;
+    unary->expression = pool_ref(unary, expression);
+}
+
+static type_t expression_derive_type(expression_t expression);
+
+// The derivations below read the children's types without cross-checking
+// them, which keeps a checked query O(1) as well.
+static inline
+type_t stored_type(expression_t expression)
+{
+    if (expression->type == NULL)
+        return expression_derive_type(expression);
+
+    return expression->type;
 }
 
 static
@@ -417,10 +375,6 @@ type_t identifier_type(identifier_t identifier)
 static
 type_t binary_type(binary_t binary)
 {
-    type_t lhs = expression_type(binary_lhs(binary));
-    type_t rhs = expression_type(binary_rhs(binary));
-    (void)rhs;
-
     binary_kind_t op = binary_op(binary);
     switch (op) // LCOV_EXCL_LINE
     {
@@ -436,7 +390,7 @@ type_t binary_type(binary_t binary)
     case BINARY_MUL:
     case BINARY_DIV:
     case BINARY_REM:
-        return lhs;
+        return stored_type(binary_lhs(binary));
     }
     __builtin_unreachable();
 }
@@ -446,7 +400,7 @@ type_t call_type(call_t call)
 {
     expression_t callee = call_callee(call);
 
-    type_t callee_type = expression_type(callee);
+    type_t callee_type = stored_type(callee);
     if (callee_type == NULL || type_kind(callee_type) != TYPE_CALLABLE)
         return NULL;
 
@@ -457,12 +411,12 @@ type_t call_type(call_t call)
 static
 type_t assignment_type(assignment_t assignment)
 {
-    return expression_type(assignment_lvalue(assignment));
+    return stored_type(assignment_lvalue(assignment));
 }
 
 type_t implicit_cast_type(implicit_cast_t implicit_cast)
 {
-    return expression_type(implicit_cast_expression(implicit_cast));
+    return stored_type(implicit_cast_expression(implicit_cast));
 }
 
 static
@@ -474,16 +428,14 @@ type_t conditional_type(conditional_t conditional)
 static
 type_t unary_type(unary_t unary)
 {
-    type_t operand_type = expression_type(unary_expression(unary));
+    type_t operand_type = stored_type(unary_expression(unary));
     if (operand_type == NULL)
         return NULL;
 
     switch (unary_op(unary)) // LCOV_EXCL_LINE
     {
         case UNARY_ADDRESS_OF:
-            if (unary->type == NULL)
-                unary->type = type_pointer_new(type_clone(operand_type));
-            return unary->type;
+            return type_pointer(operand_type);
         case UNARY_DEREF:
             if (type_kind(operand_type) != TYPE_POINTER)
                 return NULL;
@@ -492,7 +444,10 @@ type_t unary_type(unary_t unary)
     __builtin_unreachable();
 }
 
-type_t expression_type(expression_t expression)
+// Derives the type from the node and the types of its children, which
+// costs O(1) once the children have theirs set.
+static
+type_t expression_derive_type(expression_t expression)
 {
     switch (expression_kind(expression)) // LCOV_EXCL_LINE
     {
@@ -516,46 +471,63 @@ type_t expression_type(expression_t expression)
     __builtin_unreachable();
 }
 
+// With assertions enabled, every query checks the stored type against a
+// fresh derivation; by induction over the tree that validates it all.
+type_t expression_type(expression_t expression)
+{
+    if (expression->type == NULL)
+        return expression_derive_type(expression);
+
+    assert(expression->type == expression_derive_type(expression) && "stale expression type");
+    return expression->type;
+}
+
+void expression_set_type(expression_t expression, type_t type)
+{
+    assert((expression->type == NULL || expression->type == type) && "expression type set twice");
+    expression->type = type;
+}
+
 
 
 constant_t CONSTANT(expression_t expression)
 {
-    return &expression->constant;
+    return (constant_t)expression;
 }
 
 identifier_t IDENTIFIER(expression_t expression)
 {
-    return &expression->identifier;
+    return (identifier_t)expression;
 }
 
 binary_t BINARY(expression_t expression)
 {
-    return &expression->binary;
+    return (binary_t)expression;
 }
 
 call_t CALL(expression_t expression)
 {
-    return &expression->call;
+    return (call_t)expression;
 }
 
 assignment_t ASSIGNMENT(expression_t expression)
 {
-    return &expression->assignment;
+    return (assignment_t)expression;
 }
 
 implicit_cast_t IMPLICIT_CAST(expression_t expression)
 {
-    return &expression->implicit_cast;
+    return (implicit_cast_t)expression;
 }
 
 conditional_t CONDITIONAL(expression_t expression)
 {
-    return &expression->conditional;
+    return (conditional_t)expression;
 }
 
 unary_t UNARY(expression_t expression)
 {
-    return &expression->unary;
+    return (unary_t)expression;
 }
 
 const char* binary_kind_string(binary_kind_t kind)
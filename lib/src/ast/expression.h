@@ -67,10 +67,12 @@ expression_t     assignment_new(expression_t lvalue, expression_t rvalue);
 expression_t     implicit_cast_new(implicit_cast_kind_t kind, expression_t expression);
 expression_t     conditional_new(expression_t lhs, conditional_kind_t op, expression_t rhs);
 expression_t     unary_new(unary_kind_t op, expression_t expression);
-void             expression_free(expression_t expression);
 
+// The type is stored once sema has set it and derived from the children
+// before that; sema sets it bottom up so every query is O(1).
 expression_kind_t expression_kind(expression_t expression);
 type_t            expression_type(expression_t expression);
+void              expression_set_type(expression_t expression, type_t type);
 
 constant_kind_t  constant_kind(constant_t constant);
 uint64_t         constant_u64(constant_t constant);
@@ -78,6 +80,7 @@ bool             constant_bool(constant_t constant);
 char             constant_char(constant_t constant);
 
 span_t         identifier_name(identifier_t identifier);
+symbol_t       identifier_symbol(identifier_t identifier);
 declaration_t  identifier_declaration(identifier_t identifier);
 void           identifier_set_declaration(identifier_t identifier, declaration_t declaration);
 
@@ -1,5 +1,5 @@
 #include "ast/statement.h"
-#include "common/mem.h"
+#include "common/arena.h"
 
 struct block_t
 {
@@ -8,14 +8,14 @@ struct block_t
 
 struct return_t
 {
-    expression_t expression;
+    pool_ref_t expression;
 };
 
 struct if_t
 {
-    expression_t condition;
-    statement_t then_branch;
-    statement_t else_branch;
+    pool_ref_t condition;
+    pool_ref_t then_branch;
+    pool_ref_t else_branch;
 };
 
 struct var_t
@@ -28,132 +28,67 @@ struct act_t
     array_t(expression_t) expression_s;
 };
 
-struct statement_t
-{
-    statement_kind_t kind;
-    union
-    {
-        struct return_t  ret;
-        struct block_t   block;
-        struct if_t      ifelse;
-        struct var_t     var;
-        struct act_t     act;
-    };
-};
-
 static
-statement_t statement_new(statement_kind_t kind)
+statement_t statement_new(statement_kind_t kind, size_t size)
 {
-    statement_t statement = mem_alloc(sizeof(*statement));
-    statement->kind = kind;
-    return statement;
+    return pool_push(AST_POOL_STATEMENT + kind, size);
 }
 
 statement_t block_new(array_t(statement_t) statement_s)
 {
-    statement_t statement = statement_new(STATEMENT_BLOCK);
+    statement_t statement = statement_new(STATEMENT_BLOCK, sizeof(struct block_t));
 
     block_t block = BLOCK(statement);
-    block->statement_s = statement_s;
+    block->statement_s = array_move(statement_s, arena_push);
 
     return statement;
 }
 
 statement_t return_new(expression_t expression)
 {
-    statement_t statement = statement_new(STATEMENT_RETURN);
+    statement_t statement = statement_new(STATEMENT_RETURN, sizeof(struct return_t));
 
     return_t ret = RETURN(statement);
-    ret->expression = expression;
+    ret->expression = pool_ref(ret, expression);
 
     return statement;
 }
 
 statement_t if_new(expression_t condition, statement_t then_branch, statement_t else_branch)
 {
-    statement_t statement = statement_new(STATEMENT_IF);
+    statement_t statement = statement_new(STATEMENT_IF, sizeof(struct if_t));
 
     if_t ifelse = IF(statement);
-    ifelse->condition = condition;
-    ifelse->then_branch = then_branch;
-    ifelse->else_branch = else_branch;
+    ifelse->condition = pool_ref(ifelse, condition);
+    ifelse->then_branch = pool_ref(ifelse, then_branch);
+    ifelse->else_branch = pool_ref(ifelse, else_branch);
 
     return statement;
 }
 
 statement_t var_new(array_t(declaration_t) variable_s)
 {
-    statement_t statement = statement_new(STATEMENT_VAR);
+    statement_t statement = statement_new(STATEMENT_VAR, sizeof(struct var_t));
 
     var_t var = VAR(statement);
-    var->variable_s = variable_s;
+    var->variable_s = array_move(variable_s, arena_push);
 
     return statement;
 }
 
 statement_t act_new(array_t(expression_t) expression_s)
 {
-    statement_t statement = statement_new(STATEMENT_ACT);
+    statement_t statement = statement_new(STATEMENT_ACT, sizeof(struct act_t));
 
     act_t act = ACT(statement);
-    act->expression_s = expression_s;
+    act->expression_s = array_move(expression_s, arena_push);
 
     return statement;
 }
 
-static
-void block_free(block_t block)
-{
-    array_cleanup_free(block->statement_s, (release_t)statement_free);
-}
-
-static
-void if_free(if_t ifelse)
-{
-    expression_free(ifelse->condition);
-    statement_free(ifelse->then_branch);
-    if (ifelse->else_branch)
-        statement_free(ifelse->else_branch);
-}
-
-static
-void var_free(var_t var)
-{
-    array_cleanup_free(var->variable_s, (release_t)declaration_free);
-}
-
-static
-void act_free(act_t act)
-{
-    array_cleanup_free(act->expression_s, (release_t)expression_free);
-}
-
-void statement_free(statement_t statement)
-{
-    switch (statement->kind) // LCOV_EXCL_LINE
-    {
-        case STATEMENT_BLOCK:
-            block_free(BLOCK(statement));
-            break;
-        case STATEMENT_RETURN:
-            expression_free(RETURN(statement)->expression);
-            break;
-        case STATEMENT_IF:
-            if_free(IF(statement));
-            break;
-        case STATEMENT_VAR:
-            var_free(VAR(statement));
-            break;
-        case STATEMENT_ACT:
-            act_free(ACT(statement));
-            break;
-    }
-    mem_free(statement);
-}
-
 statement_kind_t statement_kind(statement_t statement)
 {
-    return statement->kind;
+    return pool_of(statement) - AST_POOL_STATEMENT;
 }
 
 static
@@ -182,16 +117,16 @@ bool return_all_path_return_value(return_t ret)
 static
 bool if_all_path_return_value(if_t ifelse)
 {
-    if (ifelse->else_branch == NULL)
+    if (ifelse->else_branch == 0)
         return false;
 
-    return statement_all_path_return_value(ifelse->then_branch) &&
-           statement_all_path_return_value(ifelse->else_branch);
+    return statement_all_path_return_value(if_then_branch(ifelse)) &&
+           statement_all_path_return_value(if_else_branch(ifelse));
 }
 
 bool statement_all_path_return_value(statement_t statement)
 {
-    switch (statement->kind) // LCOV_EXCL_LINE
+    switch (statement_kind(statement)) // LCOV_EXCL_LINE
     {
         case STATEMENT_BLOCK:
             return block_all_path_return_value(BLOCK(statement));
@@ -213,32 +148,42 @@ array_t(statement_t) block_statement_s(block_t block)
 
 expression_t return_expression(return_t ret)
 {
-    return ret->expression;
+    return pool_deref(ret, ret->expression);
 }
 
 void return_set_expression(return_t ret, expression_t expression)
 {
-    ret->expression = expression;
+    ret->expression = pool_ref(ret, expression);
 }
 
 expression_t if_condition(if_t ifelse)
 {
-    return ifelse->condition;
+    return pool_deref(ifelse, ifelse->condition);
 }
 
 void if_set_condition(if_t ifelse, expression_t condition)
 {
-    ifelse->condition = condition;
+    ifelse->condition = pool_ref(ifelse, condition);
 }
 
 statement_t if_then_branch(if_t ifelse)
 {
-    return ifelse->then_branch;
+    return pool_deref(ifelse, ifelse->then_branch);
+}
+
+void if_set_then_branch(if_t ifelse, statement_t then_branch)
+{
+    ifelse->then_branch = pool_ref(ifelse, then_branch);
 }
 
 statement_t if_else_branch(if_t ifelse)
 {
-    return ifelse->else_branch;
+    return pool_deref(ifelse, ifelse->else_branch);
+}
+
+void if_set_else_branch(if_t ifelse, statement_t else_branch)
+{
+    ifelse->else_branch = pool_ref(ifelse, else_branch);
 }
 
 array_t(declaration_t) var_variable_s(var_t var)
@@ -253,25 +198,25 @@ array_t(expression_t) act_expression_s(act_t act)
 
 block_t BLOCK(statement_t statement)
 {
-    return &statement->block;
+    return (block_t)statement;
 }
 
 return_t RETURN(statement_t statement)
 {
-    return &statement->ret;
+    return (return_t)statement;
 }
 
 if_t IF(statement_t statement)
 {
-    return &statement->ifelse;
+    return (if_t)statement;
 }
 
 var_t VAR(statement_t statement)
 {
-    return &statement->var;
+    return (var_t)statement;
 }
 
 act_t ACT(statement_t statement)
 {
-    return &statement->act;
+    return (act_t)statement;
 }
\ No newline at end of file
@@ -18,7 +18,6 @@ statement_t  if_new(expression_t condition, statement_t then_branch, statement_t
 statement_t  var_new(array_t(declaration_t) variable_s);
 statement_t  act_new(array_t(expression_t) expression_s);
 
-void         statement_free(statement_t statement);
 
 statement_kind_t  statement_kind(statement_t statement);
 bool              statement_all_path_return_value(statement_t statement);
@@ -31,7 +30,9 @@ void         return_set_expression(return_t ret, expression_t expression);
 expression_t if_condition(if_t ifelse);
 void         if_set_condition(if_t ifelse, expression_t condition);
 statement_t  if_then_branch(if_t ifelse);
+void         if_set_then_branch(if_t ifelse, statement_t then_branch);
 statement_t  if_else_branch(if_t ifelse);
+void         if_set_else_branch(if_t ifelse, statement_t else_branch);
 
 array_t(declaration_t) var_variable_s(var_t var);
 
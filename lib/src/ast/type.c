@@ -1,6 +1,9 @@
 #include "ast/type.h"
 #include "common/mem.h"
 
+#include <pthread.h>
+#include <string.h>
+
 struct callable_t
 {
     type_t          return_type;
@@ -15,6 +18,7 @@ struct pointer_t
 struct type_t
 {
     type_kind_t kind;
+    uint32_t    hash;
     union
     {
         struct callable_t callable;
@@ -46,142 +50,196 @@ type_t type_void()
     return &struct_type_void;
 }
 
-static
-type_t type_new(type_kind_t kind)
+// Pointer and callable types are hash-consed: a structurally equal type
+// always comes back as the same node, so types compare by address. Nodes
+// and parameter lists live as long as the process, like symbols, since
+// every unit of a compilation must share them. The table is locked so
+// units can be parsed on several threads.
+#define TYPE_CHUNK_SIZE 16384
+#define TYPE_INITIAL_CAPACITY 256
+
+static struct
 {
-    type_t type = mem_alloc(sizeof(struct type_t));
+    pthread_mutex_t lock;
 
-    type->kind = kind;
+    type_t    *slot_s;
+    uint32_t   mask;
+    uint32_t   size;
 
-    return type;
-}
+    char      *chunk;
+    size_t     chunk_left;
+} table = { .lock = PTHREAD_MUTEX_INITIALIZER };
 
-type_t type_bool_new()
+static
+void *table_alloc(size_t size)
 {
-    type_t type = type_new(TYPE_BOOL);
+    size = (size + 15) & ~(size_t)15;
+    if (size > table.chunk_left)
+    {
+        size_t chunk_size = size > TYPE_CHUNK_SIZE ? size : TYPE_CHUNK_SIZE;
+        table.chunk = mem_static_alloc(chunk_size);
+        table.chunk_left = chunk_size;
+    }
 
-    return type;
+    void *data = table.chunk;
+    table.chunk += size;
+    table.chunk_left -= size;
+    return data;
 }
 
-type_t type_int_new()
+static inline
+uint32_t hash_step(uint32_t hash, const void *value)
 {
-    type_t type = type_new(TYPE_INT);
-
-    return type;
+    uintptr_t bits = (uintptr_t)value;
+    return (hash ^ (uint32_t)(bits ^ bits >> 32)) * 16777619u;
 }
 
-type_t type_char_new()
+static
+uint32_t hash_type(type_kind_t kind, type_t inner, array_t(type_t) param_s)
 {
-    type_t type = type_new(TYPE_CHAR);
+    uint32_t hash = hash_step(2166136261u ^ kind, inner);
+    for (size_t i = 0; i < array_size(param_s); i++)
+        hash = hash_step(hash, param_s[i]);
 
-    return type;
+    return hash;
 }
 
-type_t type_void_new()
+static
+bool same_type(type_t type, type_kind_t kind, type_t inner, array_t(type_t) param_s)
 {
-    type_t type = type_new(TYPE_VOID);
+    if (type->kind != kind)
+        return false;
 
-    return type;
-}
+    if (kind == TYPE_POINTER)
+        return type->pointer.pointee == inner;
 
-type_t type_callable_new(type_t return_type, array_t(type_t) param_s)
-{
-    type_t type = type_new(TYPE_CALLABLE);
-    callable_t callable = CALLABLE(type);
+    callable_t callable = &type->callable;
+    size_t size = array_size(param_s);
+    if (callable->return_type != inner || array_size(callable->param_s) != size)
+        return false;
 
-    callable->return_type = return_type;
-    callable->param_s = param_s;
+    for (size_t i = 0; i < size; i++)
+        if (callable->param_s[i] != param_s[i])
+            return false;
 
-    return type;
+    return true;
 }
 
-type_t type_pointer_new(type_t pointee)
+static
+void grow_slot_s(void)
 {
-    type_t type = type_new(TYPE_POINTER);
-    pointer_t pointer = POINTER(type);
+    uint32_t capacity = table.slot_s == NULL ? TYPE_INITIAL_CAPACITY : (table.mask + 1) * 2;
 
-    pointer->pointee = pointee;
+    type_t *slot_s = mem_static_alloc(capacity * sizeof(type_t));
+    memset(slot_s, 0, capacity * sizeof(type_t));
 
-    return type;
-}
+    uint32_t mask = capacity - 1;
+    for (uint32_t i = 0; table.slot_s != NULL && i <= table.mask; i++)
+    {
+        type_t type = table.slot_s[i];
+        if (type == NULL)
+            continue;
+
+        uint32_t j = type->hash & mask;
+        while (slot_s[j] != NULL)
+            j = (j + 1) & mask;
+        slot_s[j] = type;
+    }
 
-void callable_free(callable_t callable)
-{
-    type_free(callable->return_type);
-    array_cleanup_free(callable->param_s, (release_t)type_free);
+    mem_static_free(table.slot_s);
+    table.slot_s = slot_s;
+    table.mask = mask;
 }
 
+// Returns the slot holding the type, or the empty slot it belongs in.
 static
-void pointer_free(pointer_t pointer)
+type_t *probe(uint32_t hash, type_kind_t kind, type_t inner, array_t(type_t) param_s)
 {
-    type_free(pointer->pointee);
-}
+    if (table.slot_s == NULL)
+        grow_slot_s();
 
-void type_free(type_t type)
-{
-    switch (type->kind) // LCOV_EXCL_LINE
+    uint32_t i = hash & table.mask;
+    while (true)
     {
-        case TYPE_BOOL:
-        case TYPE_INT:
-        case TYPE_CHAR:
-        case TYPE_VOID:
-            break;
-        case TYPE_CALLABLE:
-            callable_free(CALLABLE(type));
-            break;
-        case TYPE_POINTER:
-            pointer_free(POINTER(type));
-            break;
+        type_t *slot = &table.slot_s[i];
+        if (*slot == NULL)
+            return slot;
+
+        if ((*slot)->hash == hash && same_type(*slot, kind, inner, param_s))
+            return slot;
+
+        i = (i + 1) & table.mask;
     }
-    mem_free(type);
 }
 
 static
-type_t callable_clone(callable_t callable)
+type_t intern(type_t *slot, type_t type)
+{
+    *slot = type;
+    if (++table.size * 2 > table.mask + 1)
+        grow_slot_s();
+
+    return type;
+}
+
+// Takes ownership of param_s, which is released if the type already exists.
+type_t type_callable(type_t return_type, array_t(type_t) param_s)
 {
-    array_t(type_t) param_s = array_empty();
-    for (size_t i = 0; i < array_size(callable->param_s); ++i)
+    uint32_t hash = hash_type(TYPE_CALLABLE, return_type, param_s);
+
+    pthread_mutex_lock(&table.lock);
+    type_t *slot = probe(hash, TYPE_CALLABLE, return_type, param_s);
+    type_t type = *slot;
+    bool found = type != NULL;
+    if (!found)
     {
-        type_t param = type_clone(callable->param_s[i]);
-        param_s = array_add(param_s, param);
+        type = table_alloc(sizeof(struct type_t));
+        type->kind = TYPE_CALLABLE;
+        type->hash = hash;
+        type->callable.return_type = return_type;
+        type->callable.param_s = array_move(param_s, table_alloc);
+        intern(slot, type);
     }
+    pthread_mutex_unlock(&table.lock);
+
+    if (found)
+        array_free(param_s);
 
-    return type_callable_new(type_clone(callable->return_type), param_s);
+    return type;
 }
 
-type_t type_clone(type_t type)
+type_t type_pointer(type_t pointee)
 {
-    switch (type->kind) // LCOV_EXCL_LINE
+    uint32_t hash = hash_type(TYPE_POINTER, pointee, array_empty());
+
+    pthread_mutex_lock(&table.lock);
+    type_t *slot = probe(hash, TYPE_POINTER, pointee, array_empty());
+    type_t type = *slot;
+    if (type == NULL)
     {
-        case TYPE_BOOL:
-            return type_bool_new();
-        case TYPE_INT:
-            return type_int_new();
-        case TYPE_CHAR:
-            return type_char_new();
-        case TYPE_VOID:
-            return type_void_new();
-        case TYPE_CALLABLE:
-            return callable_clone(CALLABLE(type));
-        case TYPE_POINTER:
-            return type_pointer_new(type_clone(pointer_pointee(POINTER(type))));
+        type = table_alloc(sizeof(struct type_t));
+        type->kind = TYPE_POINTER;
+        type->hash = hash;
+        type->pointer.pointee = pointee;
+        intern(slot, type);
     }
+    pthread_mutex_unlock(&table.lock);
 
-    __builtin_unreachable();
+    return type;
 }
 
 bool type_eq(type_t lhs, type_t rhs)
 {
-    if (lhs == NULL || rhs == NULL)
-        return false;
-
-    if (lhs->kind != rhs->kind)
-        return false;
+    return lhs != NULL && lhs == rhs;
+}
 
-    if (lhs->kind == TYPE_POINTER)
-        return type_eq(pointer_pointee(POINTER(lhs)), pointer_pointee(POINTER(rhs)));
+size_t type_count(void)
+{
+    pthread_mutex_lock(&table.lock);
+    size_t count = table.size;
+    pthread_mutex_unlock(&table.lock);
 
-    return true;
+    return count;
 }
 
 type_t callable_return_type(callable_t callable)
@@ -18,18 +18,13 @@ type_t   type_int();
 type_t   type_char();
 type_t   type_void();
 
-type_t   type_bool_new();
-type_t   type_int_new();
-type_t   type_char_new();
-type_t   type_void_new();
-type_t   type_callable_new(type_t return_type, array_t(type_t) param_s);
-type_t   type_pointer_new(type_t pointee);
+// Types are interned: equal types are the same node, so type_eq is an
+// address compare. type_callable takes ownership of param_s.
+type_t   type_callable(type_t return_type, array_t(type_t) param_s);
+type_t   type_pointer(type_t pointee);
 
 bool     type_eq(type_t lhs, type_t rhs);
-
-void     type_free(type_t type);
-
-type_t   type_clone(type_t type);
+size_t   type_count(void);
 
 type_kind_t type_kind(type_t type);
 
@@ -5,13 +5,20 @@ struct unit_t
 {
     source_t source;
     array_t(declaration_t) declaration_s;
+    arena_t  arena;
 };
 
-unit_t unit_new(source_t source, array_t(declaration_t) declaration_s)
+// The unit takes ownership of the arena its nodes were allocated from, so
+// freeing it releases the whole tree chunk by chunk.
+unit_t unit_new(source_t source, array_t(declaration_t) declaration_s, arena_t arena)
 {
     unit_t unit = mem_alloc(sizeof(struct unit_t));
     unit->source = source;
-    unit->declaration_s = declaration_s;
+    unit->arena = arena;
+
+    arena_t previous = arena_use(arena);
+    unit->declaration_s = array_move(declaration_s, arena_push);
+    arena_use(previous);
 
     return unit;
 }
@@ -19,7 +26,7 @@ unit_t unit_new(source_t source, array_t(declaration_t) declaration_s)
 void unit_free(unit_t unit)
 {
     source_free(unit->source);
-    array_cleanup_free(unit->declaration_s, (release_t)declaration_free);
+    arena_free(unit->arena);
     mem_free(unit);
 }
 
@@ -32,3 +39,8 @@ source_t unit_source(unit_t unit)
 {
     return unit->source;
 }
+
+arena_t unit_arena(unit_t unit)
+{
+    return unit->arena;
+}
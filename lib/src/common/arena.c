@@ -0,0 +1,268 @@
+#include "common/arena.h"
+#include "common/array.h"
+#include "common/mem.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define ARENA_CHUNK_SIZE 65536
+#define ARENA_ALIGNMENT  16
+
+typedef struct chunk_t* chunk_t;
+struct chunk_t
+{
+    chunk_t previous;
+};
+
+// A reference packs the pool in its top bits, then the chunk within the
+// pool and the slot within the chunk. Pool 0 is reserved so that no
+// element ever gets the reference 0.
+#define POOL_CHUNK_SIZE  16384
+#define POOL_SLOT_BITS   11
+#define POOL_CHUNK_BITS  16
+#define POOL_SHIFT       (POOL_SLOT_BITS + POOL_CHUNK_BITS)
+
+typedef struct slab_t* slab_t;
+struct slab_t
+{
+    arena_t   arena;
+    void     *raw;
+    uint32_t  pool;
+    uint32_t  number;
+};
+
+typedef struct pool_t pool_t;
+struct pool_t
+{
+    array_t(slab_t) slab_s;
+    uint32_t        size;
+    uint32_t        used;
+    uint32_t        capacity;
+};
+
+struct arena_t
+{
+    chunk_t chunk;
+    char   *cursor;
+    char   *end;
+    size_t  chunks;
+    pool_t  pool_s[ARENA_POOLS];
+};
+
+static _Thread_local arena_t current;
+
+static inline
+size_t align_up(size_t size)
+{
+    return (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+}
+
+arena_t arena_new(void)
+{
+    arena_t arena = mem_alloc(sizeof(struct arena_t));
+    arena->chunk = NULL;
+    arena->cursor = NULL;
+    arena->end = NULL;
+    arena->chunks = 0;
+    for (unsigned i = 0; i < ARENA_POOLS; i++)
+        arena->pool_s[i] = (pool_t){ .slab_s = array_empty() };
+    return arena;
+}
+
+static void slab_free(slab_t slab);
+
+void arena_free(arena_t arena)
+{
+    if (current == arena)
+        current = NULL;
+
+    for (unsigned i = 0; i < ARENA_POOLS; i++)
+    {
+        array_t(slab_t) slab_s = arena->pool_s[i].slab_s;
+        for (size_t j = 0; j < array_size(slab_s); j++)
+            slab_free(slab_s[j]);
+        array_free(slab_s);
+    }
+
+    chunk_t chunk = arena->chunk;
+    while (chunk != NULL)
+    {
+        chunk_t previous = chunk->previous;
+        mem_free(chunk);
+        chunk = previous;
+    }
+
+    mem_free(arena);
+}
+
+// Requests larger than a chunk get a chunk of their own, linked behind the
+// current one so the space left in it is not wasted.
+static
+void *arena_grow(arena_t arena, size_t size)
+{
+    size_t header = align_up(sizeof(struct chunk_t));
+    size_t capacity = size > ARENA_CHUNK_SIZE - header ? size : ARENA_CHUNK_SIZE - header;
+
+    chunk_t chunk = mem_alloc(header + capacity);
+    arena->chunks++;
+
+    char *data = (char *)chunk + header;
+    if (capacity > size || arena->chunk == NULL)
+    {
+        chunk->previous = arena->chunk;
+        arena->chunk = chunk;
+        arena->cursor = data + size;
+        arena->end = data + capacity;
+    }
+    else
+    {
+        chunk->previous = arena->chunk->previous;
+        arena->chunk->previous = chunk;
+    }
+
+    return data;
+}
+
+void *arena_alloc(arena_t arena, size_t size)
+{
+    size = align_up(size);
+    if ((size_t)(arena->end - arena->cursor) < size)
+        return arena_grow(arena, size);
+
+    void *data = arena->cursor;
+    arena->cursor += size;
+    return data;
+}
+
+size_t arena_chunks(arena_t arena)
+{
+    return arena->chunks;
+}
+
+arena_t arena_use(arena_t arena)
+{
+    arena_t previous = current;
+    current = arena;
+    return previous;
+}
+
+arena_t arena_current(void)
+{
+    return current;
+}
+
+void *arena_push(size_t size)
+{
+    assert(current != NULL && "no arena in use");
+    return arena_alloc(current, size);
+}
+
+// test_malloc has no aligned variant, so unit tests over-allocate and
+// align by hand; raw keeps what has to be given back.
+static
+slab_t slab_new(arena_t arena, uint32_t pool, uint32_t number)
+{
+#ifdef UNIT_TESTING
+    void *raw = mem_alloc(2 * POOL_CHUNK_SIZE);
+    slab_t slab = (slab_t)(((uintptr_t)raw + POOL_CHUNK_SIZE - 1) & ~(uintptr_t)(POOL_CHUNK_SIZE - 1));
+#else
+    void *raw = aligned_alloc(POOL_CHUNK_SIZE, POOL_CHUNK_SIZE);
+    slab_t slab = raw;
+#endif
+    slab->arena = arena;
+    slab->raw = raw;
+    slab->pool = pool;
+    slab->number = number;
+    return slab;
+}
+
+static
+void slab_free(slab_t slab)
+{
+#ifdef UNIT_TESTING
+    mem_free(slab->raw);
+#else
+    free(slab->raw);
+#endif
+}
+
+static inline
+slab_t slab_of(const void *element)
+{
+    return (slab_t)((uintptr_t)element & ~(uintptr_t)(POOL_CHUNK_SIZE - 1));
+}
+
+static inline
+char *slab_data(slab_t slab)
+{
+    return (char *)slab + align_up(sizeof(struct slab_t));
+}
+
+void *arena_pool_alloc(arena_t arena, unsigned pool, size_t size)
+{
+    assert(pool > 0 && pool < ARENA_POOLS);
+
+    // at least 8 bytes keeps the slots of a chunk within POOL_SLOT_BITS
+    size = size < 8 ? 8 : (size + 3) & ~(size_t)3;
+
+    pool_t *p = &arena->pool_s[pool];
+    assert(p->size == 0 || p->size == size);
+
+    if (p->used == p->capacity)
+    {
+        // a reference has no room for more chunks; failing here, even
+        // without asserts, beats handing out references that alias
+        uint32_t number = array_size(p->slab_s);
+        if (number >= (1u << POOL_CHUNK_BITS)) // LCOV_EXCL_BR_LINE
+        {
+            fprintf(stderr, "out of memory: arena pool %u is full\n", pool); // LCOV_EXCL_LINE
+            abort();                                                         // LCOV_EXCL_LINE
+        }
+
+        slab_t slab = slab_new(arena, pool, number);
+        p->slab_s = array_add(p->slab_s, slab);
+        p->size = size;
+        p->used = 0;
+        p->capacity = (POOL_CHUNK_SIZE - align_up(sizeof(struct slab_t))) / size;
+    }
+
+    slab_t slab = p->slab_s[array_size(p->slab_s) - 1];
+    return slab_data(slab) + (size_t)p->used++ * p->size;
+}
+
+void *pool_push(unsigned pool, size_t size)
+{
+    assert(current != NULL && "no arena in use");
+    return arena_pool_alloc(current, pool, size);
+}
+
+unsigned pool_of(const void *element)
+{
+    return slab_of(element)->pool;
+}
+
+pool_ref_t pool_ref(const void *owner, const void *element)
+{
+    if (element == NULL)
+        return 0;
+
+    slab_t slab = slab_of(element);
+    assert(slab->arena == slab_of(owner)->arena && "reference across arenas");
+
+    uint32_t size = slab->arena->pool_s[slab->pool].size;
+    uint32_t slot = ((const char *)element - slab_data(slab)) / size;
+
+    return slab->pool << POOL_SHIFT | slab->number << POOL_SLOT_BITS | slot;
+}
+
+void *pool_deref(const void *owner, pool_ref_t ref)
+{
+    if (ref == 0)
+        return NULL;
+
+    pool_t *p = &slab_of(owner)->arena->pool_s[ref >> POOL_SHIFT];
+    slab_t slab = p->slab_s[(ref >> POOL_SLOT_BITS) & ((1u << POOL_CHUNK_BITS) - 1)];
+
+    return slab_data(slab) + (size_t)(ref & ((1u << POOL_SLOT_BITS) - 1)) * p->size;
+}
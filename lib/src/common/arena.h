@@ -0,0 +1,41 @@
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Bump allocator for nodes that all die together (the AST of a unit).
+// Memory comes in chunks from mem_alloc and is only released, all at
+// once, by arena_free.
+typedef struct arena_t* arena_t;
+
+arena_t  arena_new(void);
+void     arena_free(arena_t arena);
+
+void*    arena_alloc(arena_t arena, size_t size);
+size_t   arena_chunks(arena_t arena);
+
+// Node constructors allocate from the calling thread's current arena,
+// set with arena_use (which returns the previous one).
+arena_t  arena_use(arena_t arena);
+arena_t  arena_current(void);
+void*    arena_push(size_t size);
+
+// Pools segregate fixed-size elements by kind: every pool of an arena has
+// its own chunks, so elements of one kind sit next to each other. Chunks
+// are aligned to their size and never move, which lets an element's pool
+// (its kind) and its 32-bit reference be recovered from its address.
+// References are only meaningful within the arena that made them; 0
+// stands for NULL.
+#define ARENA_POOLS 32
+
+typedef uint32_t pool_ref_t;
+
+void*       arena_pool_alloc(arena_t arena, unsigned pool, size_t size);
+void*       pool_push(unsigned pool, size_t size);
+
+unsigned    pool_of(const void *element);
+pool_ref_t  pool_ref(const void *owner, const void *element);
+void*       pool_deref(const void *owner, pool_ref_t ref);
+
+#endif
@@ -141,6 +141,13 @@ array_t array_add_object(array_t array, address_t object, size_t object_size)
     return array;
 }
 
+void array_truncate(array_t array, size_t size)
+{
+    array_header_t header = array_header(array);
+    if (size < header->size)
+        header->size = size;
+}
+
 array_t array_shrink_object(array_t array, size_t object_size)
 {
     if (array_size(array) == 0)
@@ -154,3 +161,18 @@ array_t array_shrink_object(array_t array, size_t object_size)
 
     return array_realloc(array, array_size(array), object_size);
 }
+
+array_t array_move_object(array_t array, void *(*allocate)(size_t), size_t object_size)
+{
+    if (is_null_or_empty(array))
+        return array_empty();
+
+    size_t size = array_size(array);
+    array_header_t header = allocate(sizeof(struct array_header_t) + object_size * size);
+    header->capacity = size;
+    header->size = size;
+    memcpy(array_data(header), array, object_size * size);
+
+    array_free(array);
+    return array_data(header);
+}
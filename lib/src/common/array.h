@@ -27,7 +27,15 @@ size_t    array_size(array_t array);
 array_t   array_add_object(array_t array, address_t object, size_t object_size);
 #define   array_add(array, object) array_add_object(array, &object, sizeof(object))
 
+// Drops the elements past size and keeps the capacity for reuse.
+void      array_truncate(array_t array, size_t size);
+
 array_t   array_shrink_object(array_t array, size_t object_size);
 #define   array_shrink(array) array_shrink_object(array, sizeof(*array))
 
+// Copies the array into memory from allocate (e.g. arena_push) and frees
+// the original. The copy has no spare capacity and must not grow again.
+array_t   array_move_object(array_t array, void *(*allocate)(size_t), size_t object_size);
+#define   array_move(array, allocate) array_move_object(array, allocate, sizeof(*array))
+
 #endif
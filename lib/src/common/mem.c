@@ -0,0 +1,39 @@
+#include "common/mem.h"
+
+#ifdef UNIT_TESTING
+
+#include <pthread.h>
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+void* mem_test_alloc(size_t size, const char *file, int line)
+{
+    pthread_mutex_lock(&lock);
+    void *pointer = _test_malloc(size, file, line);
+    pthread_mutex_unlock(&lock);
+
+    return pointer;
+}
+
+void* mem_test_realloc(void *pointer, size_t size, const char *file, int line)
+{
+    pthread_mutex_lock(&lock);
+    pointer = _test_realloc(pointer, size, file, line);
+    pthread_mutex_unlock(&lock);
+
+    return pointer;
+}
+
+void mem_test_free(void *pointer, const char *file, int line)
+{
+    pthread_mutex_lock(&lock);
+    _test_free(pointer, file, line);
+    pthread_mutex_unlock(&lock);
+}
+
+void (mem_free)(void *pointer)
+{
+    mem_test_free(pointer, __FILE__, __LINE__);
+}
+
+#endif
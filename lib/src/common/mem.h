@@ -3,14 +3,29 @@
 
 #include <stdlib.h>
 
+// Process-lifetime tables (e.g. the symbol interner) are never released,
+// so they bypass the test allocator and its per-test leak accounting.
+#define  mem_static_alloc    malloc
+#define  mem_static_realloc  realloc
+#define  mem_static_free     free
+
 #ifdef UNIT_TESTING
 #include <stdarg.h>
 #include <setjmp.h>
 #include <cmocka.h>
 
-#define  mem_alloc      test_malloc
-#define  mem_realloc    test_realloc
-#define  mem_free       test_free
+// The test allocator keeps unguarded bookkeeping, so calls into it are
+// serialized for code running on the worker threads of a thread pool.
+void*    mem_test_alloc(size_t size, const char *file, int line);
+void*    mem_test_realloc(void *pointer, size_t size, const char *file, int line);
+void     mem_test_free(void *pointer, const char *file, int line);
+
+// also callable through a pointer, e.g. as a release_t
+void     (mem_free)(void *pointer);
+
+#define  mem_alloc(size)             mem_test_alloc(size, __FILE__, __LINE__)
+#define  mem_realloc(pointer, size)  mem_test_realloc(pointer, size, __FILE__, __LINE__)
+#define  mem_free(pointer)           mem_test_free(pointer, __FILE__, __LINE__)
 
 #else
 
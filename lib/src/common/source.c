@@ -1,73 +1,174 @@
+#include "common/arena.h"
 #include "common/mem.h"
 #include "common/source.h"
 #include "common/span.h"
 #include <unistd.h>
 #include <fcntl.h>
+#include <stdio.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define READ_CHUNK_SIZE 65536
 
 struct source_t
 {
-    span_t      code;
+    const char *code;
+    size_t      size;
     const char *path;
+    size_t      mapped;
 };
 
 struct source_t inline_source_object;
 
 source_t source_inline(const char *code, const char *path)
 {
-    inline_source_object.code = span_sz(code);
+    inline_source_object.code = code;
+    inline_source_object.size = strlen(code);
     inline_source_object.path = path;
+    inline_source_object.mapped = 0;
     return &inline_source_object;
 }
 
-source_t source_load(const char *path)
+// Maps the file read-only over an anonymous reservation of size + 1 bytes
+// rounded up to whole pages. The kernel zero-fills the rest of the file's
+// last page, and when the file ends exactly on a page boundary the extra
+// anonymous page is zero, so code[size] is always the '\0' sentinel the
+// lexer stops at, without copying a single byte of the file.
+static
+bool source_map(source_t source, int fd, size_t size)
+{
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t reserved = (size + page) & ~(page - 1);
+
+    char *code = mmap(NULL, reserved, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED) // LCOV_EXCL_LINE
+        return false;       // LCOV_EXCL_LINE
+
+    if (size > 0 && mmap(code, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) // LCOV_EXCL_BR_LINE
+    {
+        munmap(code, reserved); // LCOV_EXCL_LINE
+        return false;           // LCOV_EXCL_LINE
+    }
+
+    posix_madvise(code, reserved, POSIX_MADV_SEQUENTIAL);
+    posix_madvise(code, reserved, POSIX_MADV_WILLNEED);
+
+    source->code = code;
+    source->size = size;
+    source->mapped = reserved;
+    return true;
+}
+
+// Fallback for files that cannot be mapped (pipes, character devices):
+// reads until EOF, so short reads no longer truncate the input.
+static
+bool source_read(source_t source, int fd)
+{
+    size_t capacity = READ_CHUNK_SIZE;
+    size_t size = 0;
+    char *code = mem_alloc(capacity + 1);
+
+    while (true)
+    {
+        if (size == capacity)
+        {
+            capacity *= 2;
+            code = mem_realloc(code, capacity + 1);
+        }
+
+        ssize_t read_size = read(fd, code + size, capacity - size);
+        if (read_size == 0)
+            break;
+        if (read_size == -1) // LCOV_EXCL_LINE
+        {
+            mem_free(code); // LCOV_EXCL_LINE
+            return false;   // LCOV_EXCL_LINE
+        }
+
+        size += read_size;
+        if (size >= SOURCE_SIZE_MAX) // too large anyway
+            break;
+    }
+
+    code[size] = '\0';
+
+    source->code = code;
+    source->size = size;
+    source->mapped = 0;
+    return true;
+}
+
+source_t source_open(const char *path, source_mode_t mode)
 {
     int fd = open(path, O_RDONLY);
     if (fd == -1)
         goto leave_null;
 
-    off_t size = lseek(fd, 0, SEEK_END);
-    if (size == -1 || size >= __INT32_MAX__) // LCOV_EXCL_LINE
-        goto leave_fd;                       // LCOV_EXCL_LINE
+    struct stat info;
+    if (fstat(fd, &info) == -1) // LCOV_EXCL_LINE
+        goto leave_fd;          // LCOV_EXCL_LINE
 
-    lseek(fd, 0, SEEK_SET);
+    if (S_ISREG(info.st_mode) && (uint64_t)info.st_size >= SOURCE_SIZE_MAX)
+        goto leave_size;
 
-    char *code = mem_alloc(size + 100);
-    ssize_t read_size = read(fd, code, size);
+    source_t source = mem_alloc(sizeof(struct source_t));
+    source->path = path;
 
-    code[read_size] = '\0';
+    bool mapped = mode == SOURCE_MODE_MAP && S_ISREG(info.st_mode)
+        && source_map(source, fd, info.st_size);
 
-    close(fd);
+    if (!mapped && !source_read(source, fd)) // LCOV_EXCL_BR_LINE
+        goto leave_source;                   // LCOV_EXCL_LINE
 
-    source_t source = mem_alloc(sizeof(struct source_t));
-    source->path = path;
-    source->code.data = code;
-    source->code.size = size;
+    if (source->size >= SOURCE_SIZE_MAX) // LCOV_EXCL_BR_LINE
+    {
+        source_free(source); // LCOV_EXCL_LINE
+        goto leave_size;     // LCOV_EXCL_LINE
+    }
 
+    close(fd);
     return source;
 
-leave_fd:      // LCOV_EXCL_LINE
-    close(fd); // LCOV_EXCL_LINE
+leave_size:
+    fprintf(stderr, "%s: source exceeds 4 GiB\n", path);
+    close(fd);
+    return NULL;
+
+leave_source:             // LCOV_EXCL_LINE
+    mem_free(source);     // LCOV_EXCL_LINE
+leave_fd:                 // LCOV_EXCL_LINE
+    close(fd);            // LCOV_EXCL_LINE
 leave_null:;
     return NULL;
 }
 
+source_t source_load(const char *path)
+{
+    return source_open(path, SOURCE_MODE_MAP);
+}
+
 void source_free(source_t source)
 {
     if (source == &inline_source_object)
         return;
-    mem_free((void *)source->code.data);
+
+    if (source->mapped > 0)
+        munmap((void *)source->code, source->mapped);
+    else
+        mem_free((void *)source->code);
+
     mem_free(source);
 }
 
 const char* source_code(source_t source)
 {
-    return source->code.data;
+    return source->code;
 }
 
-int source_size(source_t source)
+size_t source_size(source_t source)
 {
-    return source->code.size;
+    return source->size;
 }
 
 const char* source_path(source_t source)
@@ -75,61 +176,32 @@ const char* source_path(source_t source)
     return source->path;
 }
 
-char* source_object_name(source_t source)
+char* source_output_name(source_t source, const char *extension)
 {
-    size_t len = strlen(source_path(source));
-    char *target = mem_alloc(len + 1);
-
-    strcpy(target, source_path(source));
+    const char *path = source_path(source);
+    const char *name = strrchr(path, '/');
+    const char *dot = strrchr(name == NULL ? path : name, '.');
+    size_t stem = dot == NULL ? strlen(path) : (size_t)(dot - path);
+    size_t size = strlen(extension);
 
-    target[len - 2] = 'o';
-    target[len - 1] = '\0';
-
-    return target;
-}
-
-char* source_assembly_name(source_t source)
-{
-    size_t len = strlen(source_path(source));
-    char *target = mem_alloc(len + 1);
-
-    strcpy(target, source_path(source));
-
-    target[len - 2] = 's';
-    target[len - 1] = '\0';
-
-    return target;
-}
-
-char *source_llvm_name(source_t source)
-{
-    size_t len = strlen(source_path(source));
-    char *target = mem_alloc(len + 1);
-
-    strcpy(target, source_path(source));
-
-    target[len - 2] = 'l';
-    target[len - 1] = 'l';
-    target[len] = '\0';
+    char *target = mem_alloc(stem + size + 1);
+    memcpy(target, path, stem);
+    memcpy(target + stem, extension, size + 1);
 
     return target;
 }
 
 location_t location_new(source_t source, span_t span, int line, int column)
 {
-    location_t location = mem_alloc(sizeof(struct location_t));
+    location_t location = arena_push(sizeof(struct location_t));
     location->source = source;
     location->span = span;
     location->line = line;
     location->column = column;
+    location->symbol = SYMBOL_NONE;
     return location;
 }
 
-void location_free(location_t location)
-{
-    mem_free(location);
-}
-
 source_t location_source(location_t location)
 {
     return location->source;
@@ -148,4 +220,14 @@ int location_line(location_t location)
 int location_column(location_t location)
 {
     return location->column;
+}
+
+// The parser fills symbol from the token stream; locations built by hand
+// are interned on first use.
+symbol_t location_symbol(location_t location)
+{
+    if (location->symbol == SYMBOL_NONE)
+        location->symbol = symbol_intern(location->span);
+
+    return location->symbol;
 }
\ No newline at end of file
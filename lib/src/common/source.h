@@ -2,6 +2,10 @@
 #define _SOURCE_H_
 
 #include "common/span.h"
+#include "common/symbol.h"
+
+#include <stddef.h>
+#include <stdint.h>
 
 typedef  struct source_t*   source_t;
 typedef  struct location_t* location_t;
@@ -12,27 +16,39 @@ struct location_t
     source_t source;
     int      line;
     int      column;
+    symbol_t symbol;
 };
 
+typedef enum source_mode_t source_mode_t;
+enum source_mode_t
+{
+    SOURCE_MODE_MAP,
+    SOURCE_MODE_READ,
+};
+
+// Token offsets are 32 bits: larger sources are rejected when loaded.
+#define SOURCE_SIZE_MAX UINT32_MAX
+
 source_t source_inline(const char *code, const char *path);
 
+source_t source_open(const char *path, source_mode_t mode);
 source_t source_load(const char *path);
 void     source_free(source_t source);
 
 const char* source_code(source_t source);
-int         source_size(source_t source);
+size_t      source_size(source_t source);
 const char* source_path(source_t source);
 
-char *source_object_name(source_t source);
-char *source_assembly_name(source_t source);
-char *source_llvm_name(source_t source);
+// Path of the source with its extension replaced by extension (".o",
+// ".ll", ...), or appended when the file name has none.
+char *source_output_name(source_t source, const char *extension);
 
 location_t location_new(source_t source, span_t span, int line, int column);
-void       location_free(location_t location);
 
 source_t location_source(location_t location);
 span_t   location_span(location_t location);
 int      location_line(location_t location);
 int      location_column(location_t location);
+symbol_t location_symbol(location_t location);
 
 #endif
\ No newline at end of file
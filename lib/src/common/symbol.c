@@ -0,0 +1,291 @@
+#include "common/symbol.h"
+#include "common/mem.h"
+#include "common/array.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define SYMBOL_CHUNK_SIZE 65536
+#define SYMBOL_INITIAL_CAPACITY 1024
+
+// Block b of entries holds 1024 << b of them; 22 blocks cover every id.
+#define SYMBOL_BLOCK_SHIFT 10
+#define SYMBOL_BLOCKS 22
+
+typedef struct entry_t entry_t;
+struct entry_t
+{
+    uint32_t    hash;
+    uint32_t    size;
+    const char *data;
+};
+
+// Entries are found by symbol id in blocks of doubling size, slot_s is an
+// open-addressing table of ids (0 = empty) probed linearly and kept at
+// most half full. Names are copied, NUL terminated, into chunks that live
+// as long as the process. Neither entries nor names ever move, so ids can
+// be read without the lock while other threads intern new names.
+static struct
+{
+    pthread_mutex_t lock;
+
+    entry_t   *block_s[SYMBOL_BLOCKS];
+    uint32_t   blocks;
+    uint32_t   size;
+    uint32_t   capacity;
+
+    symbol_t  *slot_s;
+    uint32_t   mask;
+
+    char      *chunk;
+    size_t     chunk_left;
+} interner = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static inline
+entry_t *entry_at(symbol_t symbol)
+{
+    uint32_t block = 31 - __builtin_clz((symbol >> SYMBOL_BLOCK_SHIFT) + 1);
+    uint32_t first = ((1u << block) - 1) << SYMBOL_BLOCK_SHIFT;
+    return &interner.block_s[block][symbol - first];
+}
+
+static inline
+uint32_t hash_name(span_t name)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < name.size; i++)
+        hash = (hash ^ (uint8_t)name.data[i]) * 16777619u;
+
+    return hash;
+}
+
+static
+const char *copy_name(span_t name)
+{
+    size_t size = name.size + 1;
+    if (size > interner.chunk_left)
+    {
+        size_t chunk_size = size > SYMBOL_CHUNK_SIZE ? size : SYMBOL_CHUNK_SIZE;
+        interner.chunk = mem_static_alloc(chunk_size);
+        interner.chunk_left = chunk_size;
+    }
+
+    char *data = interner.chunk;
+    memcpy(data, name.data, name.size);
+    data[name.size] = '\0';
+
+    interner.chunk += size;
+    interner.chunk_left -= size;
+    return data;
+}
+
+static
+void grow_slot_s(void)
+{
+    uint32_t capacity = interner.slot_s == NULL ? SYMBOL_INITIAL_CAPACITY : (interner.mask + 1) * 2;
+
+    symbol_t *slot_s = mem_static_alloc(capacity * sizeof(symbol_t));
+    memset(slot_s, 0, capacity * sizeof(symbol_t));
+
+    uint32_t mask = capacity - 1;
+    for (symbol_t symbol = 1; symbol < interner.size; symbol++)
+    {
+        uint32_t i = entry_at(symbol)->hash & mask;
+        while (slot_s[i] != SYMBOL_NONE)
+            i = (i + 1) & mask;
+        slot_s[i] = symbol;
+    }
+
+    mem_static_free(interner.slot_s);
+    interner.slot_s = slot_s;
+    interner.mask = mask;
+}
+
+static
+symbol_t *probe(span_t name, uint32_t hash)
+{
+    uint32_t i = hash & interner.mask;
+    while (true)
+    {
+        symbol_t *slot = &interner.slot_s[i];
+        if (*slot == SYMBOL_NONE)
+            return slot;
+
+        entry_t *entry = entry_at(*slot);
+        if (entry->hash == hash && entry->size == name.size && memcmp(entry->data, name.data, name.size) == 0)
+            return slot;
+
+        i = (i + 1) & interner.mask;
+    }
+}
+
+static
+symbol_t intern(span_t name, uint32_t hash)
+{
+    if (interner.slot_s == NULL)
+    {
+        grow_slot_s();
+        interner.size = 1; // id 0 is SYMBOL_NONE
+    }
+
+    symbol_t *slot = probe(name, hash);
+    if (*slot != SYMBOL_NONE)
+        return *slot;
+
+    if (interner.size >= interner.capacity)
+    {
+        size_t entries = (size_t)SYMBOL_INITIAL_CAPACITY << interner.blocks;
+        interner.block_s[interner.blocks++] = mem_static_alloc(entries * sizeof(entry_t));
+        interner.capacity += entries;
+    }
+
+    symbol_t symbol = interner.size++;
+    *entry_at(symbol) = (entry_t){ .hash = hash, .size = name.size, .data = copy_name(name) };
+    *slot = symbol;
+
+    if (interner.size * 2 > interner.mask + 1)
+        grow_slot_s();
+
+    return symbol;
+}
+
+symbol_t symbol_intern(span_t name)
+{
+    uint32_t hash = hash_name(name);
+
+    pthread_mutex_lock(&interner.lock);
+    symbol_t symbol = intern(name, hash);
+    pthread_mutex_unlock(&interner.lock);
+
+    return symbol;
+}
+
+symbol_t symbol_find(span_t name)
+{
+    pthread_mutex_lock(&interner.lock);
+    symbol_t symbol = interner.slot_s == NULL ? SYMBOL_NONE : *probe(name, hash_name(name));
+    pthread_mutex_unlock(&interner.lock);
+
+    return symbol;
+}
+
+span_t symbol_name(symbol_t symbol)
+{
+    entry_t *entry = entry_at(symbol);
+    return span_ctor(entry->size, entry->data);
+}
+
+const char* symbol_sz(symbol_t symbol)
+{
+    return entry_at(symbol)->data;
+}
+
+uint32_t symbol_hash(symbol_t symbol)
+{
+    return entry_at(symbol)->hash;
+}
+
+size_t symbol_count(void)
+{
+    pthread_mutex_lock(&interner.lock);
+    size_t count = interner.size == 0 ? 0 : interner.size - 1;
+    pthread_mutex_unlock(&interner.lock);
+
+    return count;
+}
+
+// The same open addressing as the interner, over local ids, but the
+// entries point into the names given instead of copies of them.
+struct symbol_table_t
+{
+    array_t(entry_t)   entry_s;
+    uint32_t          *slot_s;
+    uint32_t           mask;
+    symbol_t          *symbol_s;
+};
+
+symbol_table_t symbol_table_new(void)
+{
+    symbol_table_t table = mem_alloc(sizeof(struct symbol_table_t));
+    table->entry_s = array_empty();
+    table->mask = SYMBOL_INITIAL_CAPACITY - 1;
+    table->slot_s = mem_alloc(SYMBOL_INITIAL_CAPACITY * sizeof(uint32_t));
+    memset(table->slot_s, 0, SYMBOL_INITIAL_CAPACITY * sizeof(uint32_t));
+    table->symbol_s = NULL;
+    return table;
+}
+
+void symbol_table_free(symbol_table_t table)
+{
+    array_free(table->entry_s);
+    mem_free(table->slot_s);
+    if (table->symbol_s != NULL)
+        mem_free(table->symbol_s);
+    mem_free(table);
+}
+
+static
+void table_grow_slot_s(symbol_table_t table)
+{
+    uint32_t capacity = (table->mask + 1) * 2;
+    uint32_t *slot_s = mem_alloc(capacity * sizeof(uint32_t));
+    memset(slot_s, 0, capacity * sizeof(uint32_t));
+
+    uint32_t mask = capacity - 1;
+    for (uint32_t id = 1; id <= array_size(table->entry_s); id++)
+    {
+        uint32_t i = table->entry_s[id - 1].hash & mask;
+        while (slot_s[i] != 0)
+            i = (i + 1) & mask;
+        slot_s[i] = id;
+    }
+
+    mem_free(table->slot_s);
+    table->slot_s = slot_s;
+    table->mask = mask;
+}
+
+uint32_t symbol_table_intern(symbol_table_t table, span_t name)
+{
+    uint32_t hash = hash_name(name);
+    uint32_t i = hash & table->mask;
+    while (table->slot_s[i] != 0)
+    {
+        entry_t *entry = &table->entry_s[table->slot_s[i] - 1];
+        if (entry->hash == hash && entry->size == name.size && memcmp(entry->data, name.data, name.size) == 0)
+            return table->slot_s[i];
+
+        i = (i + 1) & table->mask;
+    }
+
+    entry_t entry = { .hash = hash, .size = name.size, .data = name.data };
+    table->entry_s = array_add(table->entry_s, entry);
+    uint32_t id = array_size(table->entry_s);
+    table->slot_s[i] = id;
+
+    if (id * 2 > table->mask + 1)
+        table_grow_slot_s(table);
+
+    return id;
+}
+
+const symbol_t *symbol_table_merge(symbol_table_t table)
+{
+    size_t size = array_size(table->entry_s);
+    if (table->symbol_s != NULL)
+        mem_free(table->symbol_s);
+    table->symbol_s = mem_alloc((size + 1) * sizeof(symbol_t));
+    table->symbol_s[0] = SYMBOL_NONE;
+
+    pthread_mutex_lock(&interner.lock);
+    for (size_t id = 1; id <= size; id++)
+    {
+        entry_t *entry = &table->entry_s[id - 1];
+        table->symbol_s[id] = intern(span_ctor(entry->size, entry->data), entry->hash);
+    }
+    pthread_mutex_unlock(&interner.lock);
+
+    return table->symbol_s;
+}
@@ -0,0 +1,37 @@
+#ifndef _SYMBOL_H_
+#define _SYMBOL_H_
+
+#include "common/span.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Dense id of an interned identifier: equal names always get the same id,
+// so names compare and hash as integers. Ids start at 1; SYMBOL_NONE marks
+// "not interned". Interning is thread safe, and the name of an id a thread
+// has seen can always be read.
+typedef uint32_t symbol_t;
+
+#define SYMBOL_NONE 0
+
+symbol_t     symbol_intern(span_t name);
+symbol_t     symbol_find(span_t name);
+
+span_t       symbol_name(symbol_t symbol);
+const char*  symbol_sz(symbol_t symbol);
+uint32_t     symbol_hash(symbol_t symbol);
+size_t       symbol_count(void);
+
+// Names private to one thread, such as the lexer of one file, so parallel
+// lexers do not contend on the interner's lock: names get local ids from
+// 1 without locking, and a merge interns them all under the lock at once.
+// The names must outlive the table.
+typedef struct symbol_table_t* symbol_table_t;
+
+symbol_table_t   symbol_table_new(void);
+void             symbol_table_free(symbol_table_t table);
+uint32_t         symbol_table_intern(symbol_table_t table, span_t name);
+// The symbol of every local id, index 0 being SYMBOL_NONE; owned by the table.
+const symbol_t*  symbol_table_merge(symbol_table_t table);
+
+#endif
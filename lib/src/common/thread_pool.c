@@ -0,0 +1,144 @@
+#include "common/thread_pool.h"
+#include "common/mem.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+struct thread_pool_t
+{
+    pthread_mutex_t  lock;
+    pthread_cond_t   wake;
+    pthread_cond_t   done;
+
+    pthread_t       *worker_s;
+    size_t           workers;
+
+    // current loop; generation tells workers a new one was posted
+    thread_task_t    task;
+    void            *context;
+    size_t           count;
+    atomic_size_t    next;
+    size_t           generation;
+    size_t           busy;
+    bool             stop;
+};
+
+static
+void drain(thread_pool_t pool)
+{
+    size_t index;
+    while ((index = atomic_fetch_add(&pool->next, 1)) < pool->count)
+        pool->task(pool->context, index);
+}
+
+static
+void* worker_run(void *arg)
+{
+    thread_pool_t pool = arg;
+    size_t seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    while (true)
+    {
+        while (pool->generation == seen && !pool->stop)
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        if (pool->stop)
+            break;
+
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        drain(pool);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->busy == 0)
+            pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+thread_pool_t thread_pool_new(size_t threads)
+{
+    if (threads == 0)
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 1 ? (size_t)cpus : 1;
+    }
+
+    thread_pool_t pool = mem_alloc(sizeof(struct thread_pool_t));
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    pool->task = NULL;
+    pool->context = NULL;
+    pool->count = 0;
+    atomic_init(&pool->next, 0);
+    pool->generation = 0;
+    pool->busy = 0;
+    pool->stop = false;
+
+    // a worker that cannot be started just leaves more work to the others
+    pool->worker_s = mem_alloc(sizeof(pthread_t) * threads);
+    pool->workers = 0;
+    while (pool->workers + 1 < threads &&
+           pthread_create(&pool->worker_s[pool->workers], NULL, worker_run, pool) == 0)
+        pool->workers++;
+
+    return pool;
+}
+
+void thread_pool_free(thread_pool_t pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = true;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (size_t i = 0; i < pool->workers; i++)
+        pthread_join(pool->worker_s[i], NULL);
+
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->wake);
+    pthread_mutex_destroy(&pool->lock);
+    mem_free(pool->worker_s);
+    mem_free(pool);
+}
+
+size_t thread_pool_threads(thread_pool_t pool)
+{
+    return pool->workers + 1;
+}
+
+void thread_pool_run(thread_pool_t pool, size_t count, thread_task_t task, void *context)
+{
+    if (count == 0)
+        return;
+
+    pool->task = task;
+    pool->context = context;
+    pool->count = count;
+    atomic_store(&pool->next, 0);
+
+    // a single index is not worth waking anybody for
+    if (pool->workers > 0 && count > 1)
+    {
+        pthread_mutex_lock(&pool->lock);
+        pool->busy = pool->workers;
+        pool->generation++;
+        pthread_cond_broadcast(&pool->wake);
+        pthread_mutex_unlock(&pool->lock);
+
+        drain(pool);
+
+        pthread_mutex_lock(&pool->lock);
+        while (pool->busy > 0)
+            pthread_cond_wait(&pool->done, &pool->lock);
+        pthread_mutex_unlock(&pool->lock);
+    }
+    else
+        drain(pool);
+}
@@ -0,0 +1,24 @@
+#ifndef _THREAD_POOL_H_
+#define _THREAD_POOL_H_
+
+#include <stddef.h>
+
+// Fixed set of worker threads that run index-parallel loops. The thread
+// calling thread_pool_run takes part in the loop, so a pool of one thread
+// has no workers and runs everything in place.
+typedef struct thread_pool_t* thread_pool_t;
+
+typedef void (*thread_task_t)(void *context, size_t index);
+
+// threads == 0 picks one thread per online CPU.
+thread_pool_t thread_pool_new(size_t threads);
+void          thread_pool_free(thread_pool_t pool);
+
+size_t        thread_pool_threads(thread_pool_t pool);
+
+// Calls task(context, index) once for every index below count, in any
+// order and on any thread, and returns when all calls have returned.
+// Tasks write their results by index, which keeps them deterministic.
+void          thread_pool_run(thread_pool_t pool, size_t count, thread_task_t task, void *context);
+
+#endif
@@ -0,0 +1,1023 @@
+#include "ir/ir.h"
+#include "common/mem.h"
+
+#include <string.h>
+
+// A definition of a local, and the value it replaced.
+typedef struct change_t change_t;
+struct change_t
+{
+    uint32_t    local;
+    uint32_t    value;
+};
+
+// SSA construction over the structured AST. The current definition of
+// every local is kept in def_s; every definition is logged, so the two
+// sides of an if or of && and || can be walked one after the other from
+// the same state, and a phi made at the join for each local they left
+// with different values.
+typedef struct builder_t builder_t;
+struct builder_t
+{
+    ir_t                    ir;
+    uint32_t                block;          // IR_NONE once the path returned
+    uint32_t                first;          // declaration ids of the locals
+    uint32_t                last;           // are within first .. last
+    uint32_t               *def_s;          // by local: value, or slot in memory
+    bool                   *memory_s;       // by local
+    array_t(change_t)       log_s;
+    array_t(declaration_t)  taken_s;        // locals whose address is taken
+
+    // scratch of join, by local
+    uint32_t               *stamp_s;
+    uint32_t               *path_s;
+    uint32_t                stamp;
+};
+
+static inline
+bool is_local(declaration_t declaration)
+{
+    return declaration_kind(declaration) != DECLARATION_FUNCTION;
+}
+
+static inline
+uint32_t local_index(builder_t *builder, declaration_t declaration)
+{
+    return declaration_id(declaration) - builder->first;
+}
+
+// ---------------------------------------------------------------------------
+// Scan: the range of local ids, and the locals whose address is taken.
+
+static
+void scan_local(builder_t *builder, declaration_t declaration)
+{
+    uint32_t id = declaration_id(declaration);
+    if (id < builder->first)
+        builder->first = id;
+    if (id > builder->last)
+        builder->last = id;
+}
+
+static
+void scan_expression(builder_t *builder, expression_t expression)
+{
+    switch (expression_kind(expression)) // LCOV_EXCL_LINE
+    {
+        case EXPRESSION_CONSTANT:
+            break;
+        case EXPRESSION_IDENTIFIER:
+        {
+            // anywhere but read or assigned, an identifier is an address
+            declaration_t declaration = identifier_declaration(IDENTIFIER(expression));
+            if (is_local(declaration))
+                builder->taken_s = array_add(builder->taken_s, declaration);
+            break;
+        }
+        case EXPRESSION_BINARY:
+            scan_expression(builder, binary_lhs(BINARY(expression)));
+            scan_expression(builder, binary_rhs(BINARY(expression)));
+            break;
+        case EXPRESSION_CALL:
+        {
+            call_t call = CALL(expression);
+            if (expression_kind(call_callee(call)) != EXPRESSION_IDENTIFIER)
+                scan_expression(builder, call_callee(call));
+
+            array_t(expression_t) argument_s = call_argument_s(call);
+            for (size_t i = 0; i < array_size(argument_s); i++)
+                scan_expression(builder, argument_s[i]);
+            break;
+        }
+        case EXPRESSION_ASSIGNMENT:
+        {
+            expression_t lvalue = assignment_lvalue(ASSIGNMENT(expression));
+            if (expression_kind(lvalue) != EXPRESSION_IDENTIFIER)
+                scan_expression(builder, lvalue);
+            scan_expression(builder, assignment_rvalue(ASSIGNMENT(expression)));
+            break;
+        }
+        case EXPRESSION_IMPLICIT_CAST:
+        {
+            expression_t inner = implicit_cast_expression(IMPLICIT_CAST(expression));
+            if (expression_kind(inner) != EXPRESSION_IDENTIFIER)
+                scan_expression(builder, inner);
+            break;
+        }
+        case EXPRESSION_CONDITIONAL:
+            scan_expression(builder, conditional_lhs(CONDITIONAL(expression)));
+            scan_expression(builder, conditional_rhs(CONDITIONAL(expression)));
+            break;
+        case EXPRESSION_UNARY:
+            scan_expression(builder, unary_expression(UNARY(expression)));
+            break;
+    }
+}
+
+static
+void scan_statement(builder_t *builder, statement_t statement)
+{
+    switch (statement_kind(statement)) // LCOV_EXCL_LINE
+    {
+        case STATEMENT_BLOCK:
+        {
+            array_t(statement_t) statement_s = block_statement_s(BLOCK(statement));
+            for (size_t i = 0; i < array_size(statement_s); i++)
+                scan_statement(builder, statement_s[i]);
+            break;
+        }
+        case STATEMENT_RETURN:
+            if (return_expression(RETURN(statement)) != NULL)
+                scan_expression(builder, return_expression(RETURN(statement)));
+            break;
+        case STATEMENT_IF:
+            scan_expression(builder, if_condition(IF(statement)));
+            scan_statement(builder, if_then_branch(IF(statement)));
+            if (if_else_branch(IF(statement)) != NULL)
+                scan_statement(builder, if_else_branch(IF(statement)));
+            break;
+        case STATEMENT_VAR:
+        {
+            array_t(declaration_t) variable_s = var_variable_s(VAR(statement));
+            for (size_t i = 0; i < array_size(variable_s); i++)
+            {
+                scan_local(builder, variable_s[i]);
+                expression_t initializer = variable_initializer(VARIABLE(variable_s[i]));
+                if (initializer != NULL)
+                    scan_expression(builder, initializer);
+            }
+            break;
+        }
+        case STATEMENT_ACT:
+        {
+            array_t(expression_t) expression_s = act_expression_s(ACT(statement));
+            for (size_t i = 0; i < array_size(expression_s); i++)
+                scan_expression(builder, expression_s[i]);
+            break;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Blocks and instructions.
+
+static
+uint32_t new_block(builder_t *builder, ir_label_t label)
+{
+    ir_block_t block = { label, array_empty(), array_empty() };
+    builder->ir->block_s = array_add(builder->ir->block_s, block);
+    return array_size(builder->ir->block_s) - 1;
+}
+
+static
+uint32_t emit_in(builder_t *builder, uint32_t block, ir_instruction_t instruction, uint32_t *operand_s, uint32_t operands)
+{
+    ir_t ir = builder->ir;
+    instruction.block = block;
+    instruction.operand = array_size(ir->operand_s);
+    instruction.operands = operands;
+    for (uint32_t i = 0; i < operands; i++)
+        ir->operand_s = array_add(ir->operand_s, operand_s[i]);
+
+    uint32_t value = array_size(ir->instruction_s);
+    ir->instruction_s = array_add(ir->instruction_s, instruction);
+    ir->block_s[block].instruction_s = array_add(ir->block_s[block].instruction_s, value);
+    return value;
+}
+
+static inline
+uint32_t emit(builder_t *builder, ir_instruction_t instruction, uint32_t *operand_s, uint32_t operands)
+{
+    return emit_in(builder, builder->block, instruction, operand_s, operands);
+}
+
+static
+uint32_t constant_value(builder_t *builder, type_kind_t type, int64_t imm)
+{
+    return emit(builder, (ir_instruction_t){ .op = IR_CONST, .type = type, .imm = imm }, NULL, 0);
+}
+
+static
+void add_pred(builder_t *builder, uint32_t block, uint32_t pred)
+{
+    ir_block_t *target = &builder->ir->block_s[block];
+    target->pred_s = array_add(target->pred_s, pred);
+}
+
+static
+void jump(builder_t *builder, uint32_t target)
+{
+    ir_instruction_t instruction = { .op = IR_JUMP, .type = TYPE_VOID, .target_s = { target, IR_NONE } };
+    emit(builder, instruction, NULL, 0);
+    add_pred(builder, target, builder->block);
+}
+
+static
+void branch(builder_t *builder, uint32_t condition, uint32_t on_true, uint32_t on_false)
+{
+    ir_instruction_t instruction = { .op = IR_BRANCH, .type = TYPE_VOID, .target_s = { on_true, on_false } };
+    emit(builder, instruction, &condition, 1);
+    add_pred(builder, on_true, builder->block);
+    add_pred(builder, on_false, builder->block);
+}
+
+// A phi in the join of the blocks a and b, taking the value each brings.
+static
+uint32_t phi(builder_t *builder, uint32_t join, type_kind_t type, uint32_t a, uint32_t a_value, uint32_t b_value)
+{
+    array_t(uint32_t) pred_s = builder->ir->block_s[join].pred_s;
+    uint32_t operand_s[2] = { a_value, b_value };
+    if (pred_s[0] != a)
+    {
+        operand_s[0] = b_value;
+        operand_s[1] = a_value;
+    }
+
+    return emit_in(builder, join, (ir_instruction_t){ .op = IR_PHI, .type = type }, operand_s, 2);
+}
+
+// ---------------------------------------------------------------------------
+// Definitions of locals.
+
+static
+void define(builder_t *builder, uint32_t local, uint32_t value)
+{
+    change_t change = { local, builder->def_s[local] };
+    builder->log_s = array_add(builder->log_s, change);
+    builder->def_s[local] = value;
+}
+
+// Restores the definitions as they were when the log had mark entries.
+static
+void undo(builder_t *builder, uint32_t mark)
+{
+    for (size_t i = array_size(builder->log_s); i-- > mark; )
+        builder->def_s[builder->log_s[i].local] = builder->log_s[i].value;
+    array_truncate(builder->log_s, mark);
+}
+
+// The locals a path defined since mark, with their values at its end.
+static
+array_t(change_t) collect(builder_t *builder, uint32_t mark)
+{
+    builder->stamp++;
+    array_t(change_t) change_s = array_empty();
+    for (size_t i = mark; i < array_size(builder->log_s); i++)
+    {
+        uint32_t local = builder->log_s[i].local;
+        if (builder->stamp_s[local] == builder->stamp)
+            continue;
+        builder->stamp_s[local] = builder->stamp;
+
+        change_t change = { local, builder->def_s[local] };
+        change_s = array_add(change_s, change);
+    }
+
+    return change_s;
+}
+
+// The value of a local at a join: the same on both paths, a phi, or
+// IR_NONE when a path is out of its scope.
+static
+uint32_t merge(builder_t *builder, uint32_t join, uint32_t a, uint32_t a_value, uint32_t b_value)
+{
+    if (a_value == b_value || a_value == IR_NONE || b_value == IR_NONE)
+        return a_value == b_value ? a_value : IR_NONE;
+
+    return phi(builder, join, builder->ir->instruction_s[a_value].type, a, a_value, b_value);
+}
+
+// Joins two paths that both reach join: a, whose definitions since mark
+// were collected in a_s and undone, and the current one. Locals the paths
+// left different get a phi; the definitions made at the join are logged
+// from mark, so enclosing joins see them.
+static
+void join_paths(builder_t *builder, uint32_t mark, uint32_t a, array_t(change_t) a_s, uint32_t join)
+{
+    array_t(change_t) b_s = collect(builder, mark);
+    undo(builder, mark);
+
+    builder->stamp++;
+    for (size_t i = 0; i < array_size(a_s); i++)
+    {
+        builder->stamp_s[a_s[i].local] = builder->stamp;
+        builder->path_s[a_s[i].local] = a_s[i].value;
+    }
+
+    // the definitions before either path are in def_s again
+    array_t(change_t) merged_s = array_empty();
+    for (size_t i = 0; i < array_size(b_s); i++)
+    {
+        uint32_t local = b_s[i].local;
+        uint32_t a_value = builder->stamp_s[local] == builder->stamp ? builder->path_s[local] : builder->def_s[local];
+        builder->stamp_s[local] = 0;
+
+        change_t change = { local, merge(builder, join, a, a_value, b_s[i].value) };
+        merged_s = array_add(merged_s, change);
+    }
+    for (size_t i = 0; i < array_size(a_s); i++)
+    {
+        uint32_t local = a_s[i].local;
+        if (builder->stamp_s[local] != builder->stamp)
+            continue;
+
+        change_t change = { local, merge(builder, join, a, a_s[i].value, builder->def_s[local]) };
+        merged_s = array_add(merged_s, change);
+    }
+
+    builder->block = join;
+    for (size_t i = 0; i < array_size(merged_s); i++)
+        if (merged_s[i].value != IR_NONE)
+            define(builder, merged_s[i].local, merged_s[i].value);
+
+    array_free(merged_s);
+    array_free(b_s);
+}
+
+// ---------------------------------------------------------------------------
+// Expressions.
+
+static
+uint32_t build_expression(builder_t *builder, expression_t expression);
+
+#define CHEAP_BUDGET 8
+
+// Whether evaluating the expression unconditionally is as good as
+// branching around it: no side effects, nothing that can trap (calls,
+// division, loads through pointers) and at most CHEAP_BUDGET nodes.
+// Reads of locals are fine, even from a slot.
+static
+bool is_cheap(expression_t expression, int *budget)
+{
+    if (--*budget < 0)
+        return false;
+
+    switch (expression_kind(expression)) // LCOV_EXCL_LINE
+    {
+        case EXPRESSION_CONSTANT:
+        case EXPRESSION_IDENTIFIER:
+            return true;
+        case EXPRESSION_BINARY:
+        {
+            binary_t binary = BINARY(expression);
+            if (binary_op(binary) == BINARY_DIV || binary_op(binary) == BINARY_REM)
+                return false;
+            return is_cheap(binary_lhs(binary), budget) && is_cheap(binary_rhs(binary), budget);
+        }
+        case EXPRESSION_IMPLICIT_CAST:
+            return expression_kind(implicit_cast_expression(IMPLICIT_CAST(expression))) == EXPRESSION_IDENTIFIER;
+        case EXPRESSION_CONDITIONAL:
+        {
+            conditional_t conditional = CONDITIONAL(expression);
+            return is_cheap(conditional_lhs(conditional), budget) && is_cheap(conditional_rhs(conditional), budget);
+        }
+        case EXPRESSION_UNARY:
+        {
+            unary_t unary = UNARY(expression);
+            return unary_op(unary) == UNARY_ADDRESS_OF
+                && expression_kind(unary_expression(unary)) == EXPRESSION_IDENTIFIER;
+        }
+        case EXPRESSION_CALL:
+        case EXPRESSION_ASSIGNMENT:
+            return false;
+    }
+    return false; // LCOV_EXCL_LINE
+}
+
+static
+uint32_t build_constant(builder_t *builder, constant_t constant)
+{
+    switch (constant_kind(constant)) // LCOV_EXCL_LINE
+    {
+        case CONSTANT_BOOL:
+            return constant_value(builder, TYPE_BOOL, constant_bool(constant));
+        case CONSTANT_U64:
+            return constant_value(builder, TYPE_INT, (int32_t)constant_u64(constant));
+        case CONSTANT_CHAR:
+            return constant_value(builder, TYPE_CHAR, (int8_t)constant_char(constant));
+    }
+    return IR_NONE; // LCOV_EXCL_LINE
+}
+
+// The address an lvalue designates: the slot of a local, the pointer under
+// *, or a function.
+static
+uint32_t build_address(builder_t *builder, expression_t lvalue)
+{
+    if (expression_kind(lvalue) == EXPRESSION_UNARY)
+        return build_expression(builder, unary_expression(UNARY(lvalue)));
+
+    declaration_t declaration = identifier_declaration(IDENTIFIER(lvalue));
+    if (is_local(declaration))
+        return builder->def_s[local_index(builder, declaration)];
+
+    ir_instruction_t instruction = { .op = IR_FUNCTION, .type = TYPE_CALLABLE, .function = FUNCTION(declaration) };
+    return emit(builder, instruction, NULL, 0);
+}
+
+static
+uint32_t build_read(builder_t *builder, implicit_cast_t cast)
+{
+    expression_t inner = implicit_cast_expression(cast);
+    if (implicit_cast_kind(cast) != IMPLICIT_CAST_LVALUE_TO_RVALUE)
+        return build_expression(builder, inner);                  // LCOV_EXCL_LINE
+
+    if (expression_kind(inner) == EXPRESSION_IDENTIFIER)
+    {
+        declaration_t declaration = identifier_declaration(IDENTIFIER(inner));
+        if (is_local(declaration) && !builder->memory_s[local_index(builder, declaration)])
+            return builder->def_s[local_index(builder, declaration)];
+    }
+
+    // a function is read through its address, as memory
+
+    uint32_t address = build_address(builder, inner);
+    ir_instruction_t instruction = { .op = IR_LOAD, .type = type_kind(implicit_cast_type(cast)) };
+    return emit(builder, instruction, &address, 1);
+}
+
+static
+uint32_t build_binary(builder_t *builder, expression_t expression)
+{
+    binary_t binary = BINARY(expression);
+    uint32_t operand_s[2];
+    operand_s[0] = build_expression(builder, binary_lhs(binary));
+    operand_s[1] = build_expression(builder, binary_rhs(binary));
+
+    ir_instruction_t instruction = { .op = IR_BINARY, .kind = binary_op(binary), .type = type_kind(expression_type(expression)) };
+    return emit(builder, instruction, operand_s, 2);
+}
+
+static
+uint32_t build_call(builder_t *builder, expression_t expression)
+{
+    call_t call = CALL(expression);
+    array_t(expression_t) argument_s = call_argument_s(call);
+    size_t arguments = array_size(argument_s);
+
+    uint32_t operand_s[arguments + 1];
+    for (size_t i = 0; i < arguments; i++)
+        operand_s[i] = build_expression(builder, argument_s[i]);
+
+    // sema only lets functions be called, and only by name
+    declaration_t callee = identifier_declaration(IDENTIFIER(call_callee(call)));
+    ir_instruction_t instruction = { .op = IR_CALL, .type = type_kind(expression_type(expression)), .function = FUNCTION(callee) };
+    return emit(builder, instruction, operand_s, arguments);
+}
+
+// The value of an assignment is what was stored.
+static
+uint32_t build_assignment(builder_t *builder, assignment_t assignment)
+{
+    expression_t lvalue = assignment_lvalue(assignment);
+    declaration_t declaration = expression_kind(lvalue) == EXPRESSION_IDENTIFIER ?
+                                identifier_declaration(IDENTIFIER(lvalue)) : NULL;
+    if (declaration != NULL && is_local(declaration))
+    {
+        uint32_t local = local_index(builder, declaration);
+        if (!builder->memory_s[local])
+        {
+            uint32_t value = build_expression(builder, assignment_rvalue(assignment));
+            define(builder, local, value);
+            return value;
+        }
+    }
+
+    // the address first, then the value
+    uint32_t operand_s[2];
+    operand_s[0] = build_address(builder, lvalue);
+    operand_s[1] = build_expression(builder, assignment_rvalue(assignment));
+    emit(builder, (ir_instruction_t){ .op = IR_STORE, .type = TYPE_VOID }, operand_s, 2);
+    return operand_s[1];
+}
+
+// The lhs is always evaluated, so only the rhs decides the lowering: a
+// cheap one is computed unconditionally and combined with and/or, any
+// other is evaluated in its own block only when the lhs does not already
+// decide the result, and the two paths meet in a phi.
+static
+uint32_t build_conditional(builder_t *builder, conditional_t conditional)
+{
+    bool is_and = conditional_op(conditional) == CONDITIONAL_AND;
+    expression_t rhs = conditional_rhs(conditional);
+
+    uint32_t operand_s[2];
+    operand_s[0] = build_expression(builder, conditional_lhs(conditional));
+
+    int budget = CHEAP_BUDGET;
+    if (is_cheap(rhs, &budget))
+    {
+        operand_s[1] = build_expression(builder, rhs);
+        return emit(builder, (ir_instruction_t){ .op = is_and ? IR_AND : IR_OR, .type = TYPE_BOOL }, operand_s, 2);
+    }
+
+    // what the lhs alone decides
+    uint32_t decided = constant_value(builder, TYPE_BOOL, !is_and);
+    uint32_t lhs_block = builder->block;
+    uint32_t rhs_block = new_block(builder, IR_COND_RHS);
+    uint32_t merge_block = new_block(builder, IR_COND_MERGE);
+    if (is_and)
+        branch(builder, operand_s[0], rhs_block, merge_block);
+    else
+        branch(builder, operand_s[0], merge_block, rhs_block);
+
+    // the rhs may assign locals in the arguments of a call
+    uint32_t mark = array_size(builder->log_s);
+    builder->block = rhs_block;
+    uint32_t rhs_value = build_expression(builder, rhs);
+    jump(builder, merge_block);
+    rhs_block = builder->block;
+
+    array_t(change_t) rhs_s = collect(builder, mark);
+    undo(builder, mark);
+    builder->block = lhs_block;
+    join_paths(builder, mark, rhs_block, rhs_s, merge_block);
+    array_free(rhs_s);
+
+    return phi(builder, merge_block, TYPE_BOOL, rhs_block, rhs_value, decided);
+}
+
+static
+uint32_t build_expression(builder_t *builder, expression_t expression)
+{
+    switch (expression_kind(expression)) // LCOV_EXCL_LINE
+    {
+        case EXPRESSION_CONSTANT:
+            return build_constant(builder, CONSTANT(expression));
+        case EXPRESSION_IDENTIFIER:
+            return build_address(builder, expression);
+        case EXPRESSION_BINARY:
+            return build_binary(builder, expression);
+        case EXPRESSION_CALL:
+            return build_call(builder, expression);
+        case EXPRESSION_ASSIGNMENT:
+            return build_assignment(builder, ASSIGNMENT(expression));
+        case EXPRESSION_IMPLICIT_CAST:
+            return build_read(builder, IMPLICIT_CAST(expression));
+        case EXPRESSION_CONDITIONAL:
+            return build_conditional(builder, CONDITIONAL(expression));
+        case EXPRESSION_UNARY:
+            if (unary_op(UNARY(expression)) == UNARY_ADDRESS_OF)
+                return build_address(builder, unary_expression(UNARY(expression)));
+            return build_address(builder, expression);
+    }
+    return IR_NONE; // LCOV_EXCL_LINE
+}
+
+// ---------------------------------------------------------------------------
+// Statements.
+
+static
+void build_statement(builder_t *builder, statement_t statement);
+
+static
+void build_if(builder_t *builder, if_t ifelse)
+{
+    uint32_t condition = build_expression(builder, if_condition(ifelse));
+    statement_t else_branch = if_else_branch(ifelse);
+
+    uint32_t then_block = new_block(builder, IR_IF_THEN);
+    uint32_t else_block = new_block(builder, else_branch != NULL ? IR_IF_ELSE : IR_IF_JOIN);
+    uint32_t before = builder->block;
+    branch(builder, condition, then_block, else_block);
+
+    uint32_t mark = array_size(builder->log_s);
+    builder->block = then_block;
+    build_statement(builder, if_then_branch(ifelse));
+    uint32_t then_end = builder->block;
+    array_t(change_t) then_s = collect(builder, mark);
+    undo(builder, mark);
+
+    uint32_t join;
+    if (else_branch == NULL)
+    {
+        // the else path is the edge from the condition to the join
+        join = else_block;
+        builder->block = before;
+    }
+    else
+    {
+        builder->block = else_block;
+        build_statement(builder, else_branch);
+        join = IR_NONE;
+    }
+    uint32_t else_end = builder->block;
+
+    if (then_end == IR_NONE)
+    {
+        // only the else path goes on, in its own block or in the join
+        if (join != IR_NONE)
+            builder->block = join;
+    }
+    else if (else_end == IR_NONE)
+    {
+        // only the then path goes on, with its definitions
+        undo(builder, mark);
+        for (size_t i = 0; i < array_size(then_s); i++)
+            define(builder, then_s[i].local, then_s[i].value);
+        builder->block = then_end;
+        if (join != IR_NONE)
+        {
+            jump(builder, join);
+            builder->block = join;
+        }
+    }
+    else
+    {
+        if (join == IR_NONE)
+        {
+            join = new_block(builder, IR_IF_JOIN);
+            jump(builder, join);
+        }
+        builder->block = then_end;
+        jump(builder, join);
+        builder->block = else_end;
+        join_paths(builder, mark, then_end, then_s, join);
+    }
+
+    array_free(then_s);
+}
+
+static
+void build_var(builder_t *builder, var_t var)
+{
+    array_t(declaration_t) variable_s = var_variable_s(var);
+    for (size_t i = 0; i < array_size(variable_s); i++)
+    {
+        declaration_t declaration = variable_s[i];
+        uint32_t local = local_index(builder, declaration);
+        expression_t initializer = variable_initializer(VARIABLE(declaration));
+        type_kind_t type = type_kind(declaration_type(declaration));
+
+        if (builder->memory_s[local])
+        {
+            if (initializer == NULL)
+                continue;
+
+            uint32_t operand_s[2] = { builder->def_s[local], build_expression(builder, initializer) };
+            emit(builder, (ir_instruction_t){ .op = IR_STORE, .type = TYPE_VOID }, operand_s, 2);
+            continue;
+        }
+
+        // a local without an initializer reads as zero
+        uint32_t value = initializer != NULL ? build_expression(builder, initializer) : constant_value(builder, type, 0);
+        define(builder, local, value);
+    }
+}
+
+static
+void build_statement(builder_t *builder, statement_t statement)
+{
+    // nothing after a return is reachable
+    if (builder->block == IR_NONE)
+        return;
+
+    switch (statement_kind(statement)) // LCOV_EXCL_LINE
+    {
+        case STATEMENT_BLOCK:
+        {
+            array_t(statement_t) statement_s = block_statement_s(BLOCK(statement));
+            for (size_t i = 0; i < array_size(statement_s); i++)
+                build_statement(builder, statement_s[i]);
+            break;
+        }
+        case STATEMENT_RETURN:
+        {
+            expression_t expression = return_expression(RETURN(statement));
+            uint32_t value = expression != NULL ? build_expression(builder, expression) : IR_NONE;
+            emit(builder, (ir_instruction_t){ .op = IR_RETURN, .type = TYPE_VOID }, &value, value != IR_NONE);
+            builder->block = IR_NONE;
+            break;
+        }
+        case STATEMENT_IF:
+            build_if(builder, IF(statement));
+            break;
+        case STATEMENT_VAR:
+            build_var(builder, VAR(statement));
+            break;
+        case STATEMENT_ACT:
+        {
+            array_t(expression_t) expression_s = act_expression_s(ACT(statement));
+            for (size_t i = 0; i < array_size(expression_s); i++)
+                build_expression(builder, expression_s[i]);
+            break;
+        }
+    }
+}
+
+ir_t ir_build(function_t function)
+{
+    ir_t ir = mem_alloc(sizeof(struct ir_t));
+    ir->function = function;
+    ir->instruction_s = array_empty();
+    ir->operand_s = array_empty();
+    ir->block_s = array_empty();
+
+    builder_t builder = { .ir = ir, .first = UINT32_MAX, .last = 0 };
+    builder.log_s = array_empty();
+    builder.taken_s = array_empty();
+
+    array_t(declaration_t) argument_s = function_argument_s(function);
+    for (size_t i = 0; i < array_size(argument_s); i++)
+        scan_local(&builder, argument_s[i]);
+    scan_statement(&builder, function_statement(function));
+
+    size_t locals = builder.first <= builder.last ? builder.last - builder.first + 1 : 0;
+    builder.def_s = mem_alloc(sizeof(uint32_t) * (locals + 1));
+    builder.memory_s = mem_alloc(sizeof(bool) * (locals + 1));
+    builder.stamp_s = mem_alloc(sizeof(uint32_t) * (locals + 1));
+    builder.path_s = mem_alloc(sizeof(uint32_t) * (locals + 1));
+    memset(builder.memory_s, 0, sizeof(bool) * (locals + 1));
+    memset(builder.stamp_s, 0, sizeof(uint32_t) * (locals + 1));
+    for (size_t i = 0; i < locals; i++)
+        builder.def_s[i] = IR_NONE;
+
+    builder.block = new_block(&builder, IR_ENTRY);
+
+    // locals whose address is taken get their slot up front
+    for (size_t i = 0; i < array_size(builder.taken_s); i++)
+    {
+        declaration_t declaration = builder.taken_s[i];
+        uint32_t local = local_index(&builder, declaration);
+        if (builder.memory_s[local])
+            continue;
+
+        builder.memory_s[local] = true;
+        ir_instruction_t slot = { .op = IR_SLOT, .kind = type_kind(declaration_type(declaration)), .type = TYPE_POINTER };
+        builder.def_s[local] = emit(&builder, slot, NULL, 0);
+    }
+
+    for (size_t i = 0; i < array_size(argument_s); i++)
+    {
+        uint32_t local = local_index(&builder, argument_s[i]);
+        ir_instruction_t argument = { .op = IR_ARGUMENT, .type = type_kind(declaration_type(argument_s[i])), .imm = i };
+        uint32_t value = emit(&builder, argument, NULL, 0);
+        if (!builder.memory_s[local])
+        {
+            builder.def_s[local] = value;
+            continue;
+        }
+
+        uint32_t operand_s[2] = { builder.def_s[local], value };
+        emit(&builder, (ir_instruction_t){ .op = IR_STORE, .type = TYPE_VOID }, operand_s, 2);
+    }
+
+    build_statement(&builder, function_statement(function));
+
+    // only a void function falls off its end
+    if (builder.block != IR_NONE)
+        emit(&builder, (ir_instruction_t){ .op = IR_RETURN, .type = TYPE_VOID }, NULL, 0);
+
+    mem_free(builder.def_s);
+    mem_free(builder.memory_s);
+    mem_free(builder.stamp_s);
+    mem_free(builder.path_s);
+    array_free(builder.log_s);
+    array_free(builder.taken_s);
+
+    return ir;
+}
+
+void ir_free(ir_t ir)
+{
+    for (size_t i = 0; i < array_size(ir->block_s); i++)
+    {
+        array_free(ir->block_s[i].instruction_s);
+        array_free(ir->block_s[i].pred_s);
+    }
+
+    array_free(ir->block_s);
+    array_free(ir->operand_s);
+    array_free(ir->instruction_s);
+    mem_free(ir);
+}
+
+// ---------------------------------------------------------------------------
+// Graph.
+
+ir_instruction_t* ir_terminator(ir_t ir, uint32_t block)
+{
+    array_t(uint32_t) instruction_s = ir->block_s[block].instruction_s;
+    return &ir->instruction_s[instruction_s[array_size(instruction_s) - 1]];
+}
+
+uint32_t ir_successors(const ir_instruction_t *terminator)
+{
+    switch (terminator->op)
+    {
+        case IR_JUMP:
+            return 1;
+        case IR_BRANCH:
+            return 2;
+        default:
+            return 0;
+    }
+}
+
+static
+void visit(ir_t ir, uint32_t block, bool *visited_s, uint32_t *order, uint32_t *count)
+{
+    visited_s[block] = true;
+    ir_instruction_t *terminator = ir_terminator(ir, block);
+    for (uint32_t i = ir_successors(terminator); i-- > 0; )
+        if (!visited_s[terminator->target_s[i]])
+            visit(ir, terminator->target_s[i], visited_s, order, count);
+
+    order[(*count)++] = block;
+}
+
+// Reverse postorder: with no cycles, every block comes after all of its
+// predecessors.
+uint32_t ir_order(ir_t ir, uint32_t *order)
+{
+    size_t blocks = array_size(ir->block_s);
+    bool *visited_s = mem_alloc(sizeof(bool) * (blocks + 1));
+    memset(visited_s, 0, sizeof(bool) * (blocks + 1));
+
+    uint32_t count = 0;
+    visit(ir, 0, visited_s, order, &count);
+    mem_free(visited_s);
+
+    for (uint32_t i = 0; i < count / 2; i++)
+    {
+        uint32_t block = order[i];
+        order[i] = order[count - 1 - i];
+        order[count - 1 - i] = block;
+    }
+
+    return count;
+}
+
+void ir_compact(ir_t ir)
+{
+    size_t blocks = array_size(ir->block_s);
+    uint32_t *order = mem_alloc(sizeof(uint32_t) * (blocks + 1));
+    uint32_t *number_s = mem_alloc(sizeof(uint32_t) * (blocks + 1));
+    uint32_t count = ir_order(ir, order);
+
+    for (size_t i = 0; i < blocks; i++)
+        number_s[i] = IR_NONE;
+    for (uint32_t i = 0; i < count; i++)
+        number_s[order[i]] = i;
+
+    // blocks are kept in order, so the entry stays first
+    array_t(ir_block_t) block_s = array_new(count, sizeof(ir_block_t));
+    for (uint32_t i = 0; i < count; i++)
+    {
+        ir_block_t block = ir->block_s[order[i]];
+
+        size_t kept = 0;
+        for (size_t j = 0; j < array_size(block.instruction_s); j++)
+        {
+            ir_instruction_t *instruction = &ir->instruction_s[block.instruction_s[j]];
+            if (instruction->op == IR_NOP)
+                continue;
+
+            instruction->block = i;
+            for (uint32_t k = 0; k < ir_successors(instruction); k++)
+                instruction->target_s[k] = number_s[instruction->target_s[k]];
+            block.instruction_s[kept++] = block.instruction_s[j];
+        }
+        array_truncate(block.instruction_s, kept);
+
+        for (size_t j = 0; j < array_size(block.pred_s); j++)
+            block.pred_s[j] = number_s[block.pred_s[j]];
+
+        block_s = array_add(block_s, block);
+    }
+
+    for (size_t i = 0; i < blocks; i++)
+        if (number_s[i] == IR_NONE)
+        {
+            array_free(ir->block_s[i].instruction_s);
+            array_free(ir->block_s[i].pred_s);
+        }
+
+    array_free(ir->block_s);
+    ir->block_s = block_s;
+    mem_free(number_s);
+    mem_free(order);
+}
+
+// ---------------------------------------------------------------------------
+// Printing.
+
+const char* ir_label_string(ir_label_t label)
+{
+    switch (label) // LCOV_EXCL_LINE
+    {
+        case IR_ENTRY: return "entry";
+        case IR_IF_THEN: return "if.then";
+        case IR_IF_ELSE: return "if.else";
+        case IR_IF_JOIN: return "if.join";
+        case IR_COND_RHS: return "cond.rhs";
+        case IR_COND_MERGE: return "cond.merge";
+    }
+    return ""; // LCOV_EXCL_LINE
+}
+
+static
+const char* type_name(uint8_t type)
+{
+    switch (type)
+    {
+        case TYPE_BOOL: return "bool";
+        case TYPE_INT: return "int";
+        case TYPE_CHAR: return "char";
+        case TYPE_POINTER: return "ptr";
+        case TYPE_CALLABLE: return "fn";
+        default: return "void";
+    }
+}
+
+static
+void print_operands(ir_t ir, const ir_instruction_t *instruction, FILE *file)
+{
+    for (uint32_t i = 0; i < instruction->operands; i++)
+        fprintf(file, "%s v%u", i > 0 ? "," : "", ir_operand(ir, instruction, i));
+}
+
+void ir_print(ir_t ir, FILE *file)
+{
+    fprintf(file, "%s:\n", symbol_sz(declaration_symbol((declaration_t)ir->function)));
+
+    for (size_t i = 0; i < array_size(ir->block_s); i++)
+    {
+        ir_block_t *block = &ir->block_s[i];
+        fprintf(file, "  b%zu %s:", i, ir_label_string(block->label));
+        for (size_t j = 0; j < array_size(block->pred_s); j++)
+            fprintf(file, "%s b%u", j > 0 ? "," : " <-", block->pred_s[j]);
+        fprintf(file, "\n");
+
+        for (size_t j = 0; j < array_size(block->instruction_s); j++)
+        {
+            uint32_t value = block->instruction_s[j];
+            ir_instruction_t *instruction = &ir->instruction_s[value];
+            fprintf(file, "    ");
+            if (instruction->type != TYPE_VOID)
+                fprintf(file, "v%u %s = ", value, type_name(instruction->type));
+
+            switch (instruction->op) // LCOV_EXCL_LINE
+            {
+                case IR_NOP:
+                    fprintf(file, "nop");
+                    break;
+                case IR_CONST:
+                    fprintf(file, "const %lld", (long long)instruction->imm);
+                    break;
+                case IR_ARGUMENT:
+                    fprintf(file, "argument %lld", (long long)instruction->imm);
+                    break;
+                case IR_FUNCTION:
+                    fprintf(file, "function %s", symbol_sz(declaration_symbol((declaration_t)instruction->function)));
+                    break;
+                case IR_PHI:
+                    fprintf(file, "phi");
+                    print_operands(ir, instruction, file);
+                    break;
+                case IR_COPY:
+                    fprintf(file, "copy");
+                    print_operands(ir, instruction, file);
+                    break;
+                case IR_BINARY:
+                    fprintf(file, "%s", binary_kind_string(instruction->kind));
+                    print_operands(ir, instruction, file);
+                    break;
+                case IR_AND:
+                    fprintf(file, "and");
+                    print_operands(ir, instruction, file);
+                    break;
+                case IR_OR:
+                    fprintf(file, "or");
+                    print_operands(ir, instruction, file);
+                    break;
+                case IR_SLOT:
+                    fprintf(file, "slot %s", type_name(instruction->kind));
+                    break;
+                case IR_LOAD:
+                    fprintf(file, "load");
+                    print_operands(ir, instruction, file);
+                    break;
+                case IR_STORE:
+                    fprintf(file, "store");
+                    print_operands(ir, instruction, file);
+                    break;
+                case IR_CALL:
+                    fprintf(file, "call %s", symbol_sz(declaration_symbol((declaration_t)instruction->function)));
+                    print_operands(ir, instruction, file);
+                    break;
+                case IR_JUMP:
+                    fprintf(file, "jump b%u", instruction->target_s[0]);
+                    break;
+                case IR_BRANCH:
+                    fprintf(file, "branch v%u, b%u, b%u", ir_operand(ir, instruction, 0), instruction->target_s[0], instruction->target_s[1]);
+                    break;
+                case IR_RETURN:
+                    fprintf(file, "return");
+                    print_operands(ir, instruction, file);
+                    break;
+            }
+            fprintf(file, "\n");
+        }
+    }
+}
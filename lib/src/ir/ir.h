@@ -0,0 +1,108 @@
+#ifndef _IR_H_
+#define _IR_H_
+
+#include "ast/ast.h"
+
+#include <stdio.h>
+
+// Mid-level IR of a function, in SSA form: a control flow graph of basic
+// blocks whose instructions each define at most one value, named by the
+// instruction's index. Locals are SSA values, except those whose address
+// is taken, which live in slots. Values have the type kinds of the AST;
+// constants are kept normalized to their type (int sign extended from 32
+// bits, char from 8, bool 0 or 1).
+//
+// iz has no loops, so every edge goes forward: the graph is acyclic and
+// each block's predecessors are known before its first instruction.
+#define IR_NONE UINT32_MAX
+
+typedef enum ir_op_t ir_op_t;
+enum ir_op_t
+{
+    IR_NOP,             // removed
+    IR_CONST,           // imm
+    IR_ARGUMENT,        // the argument at imm
+    IR_FUNCTION,        // address of function
+    IR_PHI,             // one operand per predecessor, in their order
+    IR_COPY,            // operand 0
+    IR_BINARY,          // operand 0 kind operand 1, kind a binary_kind_t
+    IR_AND,             // operand 0 & operand 1, both evaluated
+    IR_OR,              // operand 0 | operand 1, both evaluated
+    IR_SLOT,            // address of a local of type kind, in memory
+    IR_LOAD,            // *operand 0
+    IR_STORE,           // *operand 0 = operand 1
+    IR_CALL,            // function, with the operands as arguments
+    IR_JUMP,            // to target 0
+    IR_BRANCH,          // to target 0 if operand 0, else to target 1
+    IR_RETURN,          // operand 0, or nothing without operands
+};
+
+typedef struct ir_instruction_t ir_instruction_t;
+struct ir_instruction_t
+{
+    uint8_t     op;
+    uint8_t     kind;
+    uint8_t     type;           // type_kind_t of the value, TYPE_VOID for none
+    uint32_t    block;
+    uint32_t    operand;        // the first, in operand_s
+    uint32_t    operands;
+    uint32_t    target_s[2];
+    int64_t     imm;
+    function_t  function;
+};
+
+// What a block was made for; only names it.
+typedef enum ir_label_t ir_label_t;
+enum ir_label_t
+{
+    IR_ENTRY,
+    IR_IF_THEN,
+    IR_IF_ELSE,
+    IR_IF_JOIN,
+    IR_COND_RHS,
+    IR_COND_MERGE,
+};
+
+typedef struct ir_block_t ir_block_t;
+struct ir_block_t
+{
+    ir_label_t          label;
+    array_t(uint32_t)   instruction_s;  // phis first, the terminator last
+    array_t(uint32_t)   pred_s;         // one per incoming edge
+};
+
+typedef struct ir_t* ir_t;
+struct ir_t
+{
+    function_t                  function;
+    array_t(ir_instruction_t)   instruction_s;
+    array_t(uint32_t)           operand_s;
+    array_t(ir_block_t)         block_s;        // the entry first
+};
+
+// Builds the function's IR from its checked AST.
+ir_t        ir_build(function_t function);
+void        ir_free(ir_t ir);
+
+static inline
+uint32_t ir_operand(ir_t ir, const ir_instruction_t *instruction, uint32_t index)
+{
+    return ir->operand_s[instruction->operand + index];
+}
+
+// The terminator of the block and the number of its successors.
+ir_instruction_t*   ir_terminator(ir_t ir, uint32_t block);
+uint32_t            ir_successors(const ir_instruction_t *terminator);
+
+// Fills order with the blocks reachable from the entry, each after all of
+// its reachable predecessors, and returns how many there are.
+uint32_t    ir_order(ir_t ir, uint32_t *order);
+
+// Drops removed instructions and blocks that are no longer reachable,
+// renumbering the blocks; values keep their names.
+void        ir_compact(ir_t ir);
+
+const char* ir_label_string(ir_label_t label);
+void        ir_print(ir_t ir, FILE *file);
+
+#endif
@@ -0,0 +1,572 @@
+#include "ir/pass.h"
+#include "common/mem.h"
+
+#include <string.h>
+
+static inline
+ir_instruction_t* at(ir_t ir, uint32_t value)
+{
+    return &ir->instruction_s[value];
+}
+
+static
+int64_t normalize(uint8_t type, int64_t value)
+{
+    switch (type)
+    {
+        case TYPE_BOOL:
+            return value & 1;
+        case TYPE_CHAR:
+            return (int8_t)(uint8_t)value;
+        default:
+            return (int32_t)(uint32_t)value;
+    }
+}
+
+static
+void make_constant(ir_instruction_t *instruction, int64_t imm)
+{
+    instruction->op = IR_CONST;
+    instruction->operands = 0;
+    instruction->imm = imm;
+}
+
+static
+void make_copy(ir_t ir, ir_instruction_t *instruction, uint32_t source)
+{
+    instruction->op = IR_COPY;
+    ir->operand_s[instruction->operand] = source;
+    instruction->operands = 1;
+}
+
+// Drops the edge from pred, with the operand the phis took from it.
+static
+void remove_pred(ir_t ir, uint32_t block, uint32_t pred)
+{
+    ir_block_t *target = &ir->block_s[block];
+    size_t preds = array_size(target->pred_s);
+    size_t index = 0;
+    while (target->pred_s[index] != pred)
+        index++;
+
+    memmove(&target->pred_s[index], &target->pred_s[index + 1], sizeof(uint32_t) * (preds - index - 1));
+    array_truncate(target->pred_s, preds - 1);
+
+    for (size_t i = 0; i < array_size(target->instruction_s); i++)
+    {
+        ir_instruction_t *instruction = at(ir, target->instruction_s[i]);
+        if (instruction->op != IR_PHI)
+            continue;
+
+        uint32_t *operand_s = &ir->operand_s[instruction->operand];
+        memmove(&operand_s[index], &operand_s[index + 1], sizeof(uint32_t) * (instruction->operands - index - 1));
+        instruction->operands--;
+    }
+}
+
+static
+uint32_t* reachable_order(ir_t ir, uint32_t *count)
+{
+    uint32_t *order = mem_alloc(sizeof(uint32_t) * (array_size(ir->block_s) + 1));
+    *count = ir_order(ir, order);
+    return order;
+}
+
+// ---------------------------------------------------------------------------
+// Constant propagation.
+
+static
+bool fold_binary(ir_t ir, ir_instruction_t *instruction, int64_t *result)
+{
+    ir_instruction_t *lhs = at(ir, ir_operand(ir, instruction, 0));
+    ir_instruction_t *rhs = at(ir, ir_operand(ir, instruction, 1));
+    if (lhs->op != IR_CONST || rhs->op != IR_CONST)
+        return false;
+
+    uint8_t type = lhs->type;
+    int64_t a = lhs->imm;
+    int64_t b = rhs->imm;
+    // bool compares as a signed i1: true is -1
+    if (type == TYPE_BOOL)
+    {
+        a = -a;
+        b = -b;
+    }
+
+    switch (instruction->kind) // LCOV_EXCL_LINE
+    {
+        case BINARY_LT: *result = a < b; return true;
+        case BINARY_LE: *result = a <= b; return true;
+        case BINARY_GT: *result = a > b; return true;
+        case BINARY_GE: *result = a >= b; return true;
+        case BINARY_EQ: *result = a == b; return true;
+        case BINARY_NE: *result = a != b; return true;
+        case BINARY_ADD: *result = a + b; break;
+        case BINARY_SUB: *result = a - b; break;
+        case BINARY_MUL: *result = a * b; break;
+        default: // BINARY_DIV, BINARY_REM
+        {
+            // what traps or is undefined is left to run
+            int64_t minimum = type == TYPE_CHAR ? INT8_MIN : INT32_MIN;
+            if (type == TYPE_BOOL || b == 0 || (b == -1 && a == minimum))
+                return false;
+            *result = instruction->kind == BINARY_DIV ? a / b : a % b;
+            break;
+        }
+    }
+
+    *result = normalize(instruction->type, *result);
+    return true;
+}
+
+// x + 0, x - 0, x * 1 and x * 0, with either side constant.
+static
+bool fold_identity(ir_t ir, ir_instruction_t *instruction)
+{
+    uint32_t lhs = ir_operand(ir, instruction, 0);
+    uint32_t rhs = ir_operand(ir, instruction, 1);
+    bool constant_lhs = at(ir, lhs)->op == IR_CONST;
+    bool constant_rhs = at(ir, rhs)->op == IR_CONST;
+    if (!constant_lhs && !constant_rhs)
+        return false;
+
+    uint32_t other = constant_rhs ? lhs : rhs;
+    int64_t imm = at(ir, constant_rhs ? rhs : lhs)->imm;
+
+    switch (instruction->kind)
+    {
+        case BINARY_ADD:
+            if (imm != 0)
+                return false;
+            make_copy(ir, instruction, other);
+            return true;
+        case BINARY_SUB:
+            if (!constant_rhs || imm != 0)
+                return false;
+            make_copy(ir, instruction, lhs);
+            return true;
+        case BINARY_MUL:
+            if (imm == 0)
+                make_constant(instruction, 0);
+            else if (imm == 1)
+                make_copy(ir, instruction, other);
+            else
+                return false;
+            return true;
+        default:
+            return false;
+    }
+}
+
+// and/or of bools: the constant side decides the result or drops out.
+static
+bool fold_logic(ir_t ir, ir_instruction_t *instruction)
+{
+    uint32_t lhs = ir_operand(ir, instruction, 0);
+    uint32_t rhs = ir_operand(ir, instruction, 1);
+    bool constant_lhs = at(ir, lhs)->op == IR_CONST;
+    bool constant_rhs = at(ir, rhs)->op == IR_CONST;
+    if (!constant_lhs && !constant_rhs)
+        return false;
+
+    bool is_and = instruction->op == IR_AND;
+    if (constant_lhs && constant_rhs)
+    {
+        int64_t a = at(ir, lhs)->imm;
+        int64_t b = at(ir, rhs)->imm;
+        make_constant(instruction, is_and ? a & b : a | b);
+        return true;
+    }
+
+    uint32_t other = constant_rhs ? lhs : rhs;
+    int64_t imm = at(ir, constant_rhs ? rhs : lhs)->imm;
+    if (imm == is_and)
+        make_copy(ir, instruction, other);
+    else
+        make_constant(instruction, imm);
+    return true;
+}
+
+static
+bool fold_phi(ir_t ir, ir_instruction_t *instruction)
+{
+    uint32_t first = ir_operand(ir, instruction, 0);
+    bool same = true;
+    bool constant = at(ir, first)->op == IR_CONST;
+    for (uint32_t i = 1; i < instruction->operands; i++)
+    {
+        ir_instruction_t *operand = at(ir, ir_operand(ir, instruction, i));
+        same = same && ir_operand(ir, instruction, i) == first;
+        constant = constant && operand->op == IR_CONST && operand->imm == at(ir, first)->imm;
+    }
+
+    if (constant)
+        make_constant(instruction, at(ir, first)->imm);
+    else if (same)
+        make_copy(ir, instruction, first);
+    return constant || same;
+}
+
+static
+bool fold_branch(ir_t ir, ir_instruction_t *instruction)
+{
+    ir_instruction_t *condition = at(ir, ir_operand(ir, instruction, 0));
+    if (condition->op != IR_CONST)
+        return false;
+
+    uint32_t taken = instruction->target_s[condition->imm ? 0 : 1];
+    uint32_t dropped = instruction->target_s[condition->imm ? 1 : 0];
+    instruction->op = IR_JUMP;
+    instruction->operands = 0;
+    instruction->target_s[0] = taken;
+    instruction->target_s[1] = IR_NONE;
+    remove_pred(ir, dropped, instruction->block);
+    return true;
+}
+
+bool ir_propagate_constants(ir_t ir)
+{
+    uint32_t count;
+    uint32_t *order = reachable_order(ir, &count);
+
+    // definitions come before their uses, so one pass folds whole chains
+    bool changed = false;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        array_t(uint32_t) instruction_s = ir->block_s[order[i]].instruction_s;
+        for (size_t j = 0; j < array_size(instruction_s); j++)
+        {
+            ir_instruction_t *instruction = at(ir, instruction_s[j]);
+            switch (instruction->op)
+            {
+                case IR_BINARY:
+                {
+                    int64_t result;
+                    if (fold_binary(ir, instruction, &result))
+                    {
+                        make_constant(instruction, result);
+                        changed = true;
+                    }
+                    else
+                        changed |= fold_identity(ir, instruction);
+                    break;
+                }
+                case IR_AND:
+                case IR_OR:
+                    changed |= fold_logic(ir, instruction);
+                    break;
+                case IR_PHI:
+                    changed |= fold_phi(ir, instruction);
+                    break;
+                case IR_BRANCH:
+                    changed |= fold_branch(ir, instruction);
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+
+    mem_free(order);
+    return changed;
+}
+
+// ---------------------------------------------------------------------------
+// Copy propagation.
+
+static
+uint32_t source(ir_t ir, uint32_t value)
+{
+    while (at(ir, value)->op == IR_COPY)
+        value = ir_operand(ir, at(ir, value), 0);
+    return value;
+}
+
+bool ir_propagate_copies(ir_t ir)
+{
+    uint32_t count;
+    uint32_t *order = reachable_order(ir, &count);
+
+    // a phi is seen before its uses, so it can still turn into a copy
+    bool changed = false;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        array_t(uint32_t) instruction_s = ir->block_s[order[i]].instruction_s;
+        for (size_t j = 0; j < array_size(instruction_s); j++)
+        {
+            ir_instruction_t *instruction = at(ir, instruction_s[j]);
+            for (uint32_t k = 0; k < instruction->operands; k++)
+                ir->operand_s[instruction->operand + k] = source(ir, ir_operand(ir, instruction, k));
+
+            if (instruction->op == IR_PHI)
+                fold_phi(ir, instruction);
+        }
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        array_t(uint32_t) instruction_s = ir->block_s[order[i]].instruction_s;
+        for (size_t j = 0; j < array_size(instruction_s); j++)
+            if (at(ir, instruction_s[j])->op == IR_COPY)
+            {
+                at(ir, instruction_s[j])->op = IR_NOP;
+                changed = true;
+            }
+    }
+
+    mem_free(order);
+    return changed;
+}
+
+// ---------------------------------------------------------------------------
+// Dead code elimination.
+
+static inline
+bool has_effect(const ir_instruction_t *instruction)
+{
+    switch (instruction->op)
+    {
+        case IR_STORE:
+        case IR_CALL:
+        case IR_JUMP:
+        case IR_BRANCH:
+        case IR_RETURN:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool ir_eliminate_dead_code(ir_t ir)
+{
+    uint32_t count;
+    uint32_t *order = reachable_order(ir, &count);
+
+    size_t instructions = array_size(ir->instruction_s);
+    bool *live_s = mem_alloc(sizeof(bool) * (instructions + 1));
+    memset(live_s, 0, sizeof(bool) * (instructions + 1));
+
+    array_t(uint32_t) work_s = array_empty();
+    for (uint32_t i = 0; i < count; i++)
+    {
+        array_t(uint32_t) instruction_s = ir->block_s[order[i]].instruction_s;
+        for (size_t j = 0; j < array_size(instruction_s); j++)
+            if (has_effect(at(ir, instruction_s[j])))
+            {
+                live_s[instruction_s[j]] = true;
+                work_s = array_add(work_s, instruction_s[j]);
+            }
+    }
+
+    while (array_size(work_s) > 0)
+    {
+        ir_instruction_t *instruction = at(ir, work_s[array_size(work_s) - 1]);
+        array_truncate(work_s, array_size(work_s) - 1);
+        for (uint32_t i = 0; i < instruction->operands; i++)
+        {
+            uint32_t operand = ir_operand(ir, instruction, i);
+            if (live_s[operand])
+                continue;
+
+            live_s[operand] = true;
+            work_s = array_add(work_s, operand);
+        }
+    }
+
+    bool changed = false;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        array_t(uint32_t) instruction_s = ir->block_s[order[i]].instruction_s;
+        for (size_t j = 0; j < array_size(instruction_s); j++)
+        {
+            ir_instruction_t *instruction = at(ir, instruction_s[j]);
+            if (live_s[instruction_s[j]] || instruction->op == IR_NOP)
+                continue;
+
+            instruction->op = IR_NOP;
+            changed = true;
+        }
+    }
+
+    array_free(work_s);
+    mem_free(live_s);
+    mem_free(order);
+    return changed;
+}
+
+// ---------------------------------------------------------------------------
+// CFG simplification.
+
+static inline
+bool is_dropped(ir_t ir, uint32_t block)
+{
+    return array_size(ir->block_s[block].instruction_s) == 0;
+}
+
+static
+void drop_block(ir_t ir, uint32_t block)
+{
+    array_t(uint32_t) instruction_s = ir->block_s[block].instruction_s;
+    for (size_t i = 0; i < array_size(instruction_s); i++)
+        at(ir, instruction_s[i])->op = IR_NOP;
+    array_truncate(ir->block_s[block].instruction_s, 0);
+}
+
+static
+void replace_pred(ir_t ir, uint32_t block, uint32_t from, uint32_t to)
+{
+    array_t(uint32_t) pred_s = ir->block_s[block].pred_s;
+    for (size_t i = 0; i < array_size(pred_s); i++)
+        if (pred_s[i] == from)
+            pred_s[i] = to;
+}
+
+// Moves the instructions of successor, whose only predecessor is block,
+// to the end of block in place of its jump.
+static
+void merge_blocks(ir_t ir, uint32_t block, uint32_t successor)
+{
+    ir_block_t *into = &ir->block_s[block];
+    size_t size = array_size(into->instruction_s);
+    at(ir, into->instruction_s[size - 1])->op = IR_NOP;
+    array_truncate(into->instruction_s, size - 1);
+
+    array_t(uint32_t) instruction_s = ir->block_s[successor].instruction_s;
+    for (size_t i = 0; i < array_size(instruction_s); i++)
+    {
+        ir_instruction_t *instruction = at(ir, instruction_s[i]);
+        instruction->block = block;
+        // with one predecessor, a phi is its only operand
+        if (instruction->op == IR_PHI)
+            instruction->op = IR_COPY;
+        into->instruction_s = array_add(into->instruction_s, instruction_s[i]);
+    }
+    array_truncate(ir->block_s[successor].instruction_s, 0);
+
+    ir_instruction_t *terminator = ir_terminator(ir, block);
+    for (uint32_t i = 0; i < ir_successors(terminator); i++)
+        replace_pred(ir, terminator->target_s[i], successor, block);
+}
+
+static
+bool has_phi(ir_t ir, uint32_t block)
+{
+    array_t(uint32_t) instruction_s = ir->block_s[block].instruction_s;
+    for (size_t i = 0; i < array_size(instruction_s); i++)
+        if (at(ir, instruction_s[i])->op == IR_PHI)
+            return true;
+    return false;
+}
+
+static
+bool only_jumps(ir_t ir, uint32_t block)
+{
+    array_t(uint32_t) instruction_s = ir->block_s[block].instruction_s;
+    for (size_t i = 0; i + 1 < array_size(instruction_s); i++)
+        if (at(ir, instruction_s[i])->op != IR_NOP)
+            return false;
+    return ir_terminator(ir, block)->op == IR_JUMP;
+}
+
+// Sends the predecessors of a block that only jumps to target straight
+// there; target has no phis, so the order of its edges does not matter.
+static
+void bypass_block(ir_t ir, uint32_t block, uint32_t target)
+{
+    remove_pred(ir, target, block);
+
+    array_t(uint32_t) pred_s = ir->block_s[block].pred_s;
+    for (size_t i = 0; i < array_size(pred_s); i++)
+    {
+        ir_instruction_t *terminator = ir_terminator(ir, pred_s[i]);
+        for (uint32_t j = 0; j < ir_successors(terminator); j++)
+            if (terminator->target_s[j] == block)
+            {
+                terminator->target_s[j] = target;
+                ir->block_s[target].pred_s = array_add(ir->block_s[target].pred_s, pred_s[i]);
+            }
+
+        // both ways lead to target now
+        if (terminator->op == IR_BRANCH && terminator->target_s[0] == terminator->target_s[1])
+        {
+            terminator->op = IR_JUMP;
+            terminator->operands = 0;
+            terminator->target_s[1] = IR_NONE;
+            remove_pred(ir, target, pred_s[i]);
+        }
+    }
+
+    drop_block(ir, block);
+    array_truncate(ir->block_s[block].pred_s, 0);
+}
+
+bool ir_simplify_cfg(ir_t ir)
+{
+    size_t blocks = array_size(ir->block_s);
+    uint32_t count;
+    uint32_t *order = reachable_order(ir, &count);
+    bool *reached_s = mem_alloc(sizeof(bool) * (blocks + 1));
+    memset(reached_s, 0, sizeof(bool) * (blocks + 1));
+    for (uint32_t i = 0; i < count; i++)
+        reached_s[order[i]] = true;
+
+    bool changed = false;
+    for (uint32_t block = 0; block < blocks; block++)
+    {
+        if (reached_s[block] || is_dropped(ir, block))
+            continue;
+
+        ir_instruction_t *terminator = ir_terminator(ir, block);
+        for (uint32_t i = 0; i < ir_successors(terminator); i++)
+            remove_pred(ir, terminator->target_s[i], block);
+        drop_block(ir, block);
+        changed = true;
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t block = order[i];
+        while (!is_dropped(ir, block))
+        {
+            ir_instruction_t *terminator = ir_terminator(ir, block);
+            if (terminator->op != IR_JUMP || array_size(ir->block_s[terminator->target_s[0]].pred_s) != 1)
+                break;
+
+            merge_blocks(ir, block, terminator->target_s[0]);
+            changed = true;
+        }
+    }
+
+    // the entry has no predecessors to send on
+    for (uint32_t i = 1; i < count; i++)
+    {
+        uint32_t block = order[i];
+        if (is_dropped(ir, block) || !only_jumps(ir, block))
+            continue;
+
+        uint32_t target = ir_terminator(ir, block)->target_s[0];
+        if (has_phi(ir, target))
+            continue;
+
+        bypass_block(ir, block, target);
+        changed = true;
+    }
+
+    mem_free(reached_s);
+    mem_free(order);
+    return changed;
+}
+
+void ir_optimize(ir_t ir)
+{
+    bool changed = true;
+    while (changed)
+    {
+        changed = ir_propagate_constants(ir);
+        changed |= ir_propagate_copies(ir);
+        changed |= ir_simplify_cfg(ir);
+        changed |= ir_eliminate_dead_code(ir);
+    }
+
+    ir_compact(ir);
+}
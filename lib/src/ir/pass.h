@@ -0,0 +1,24 @@
+#ifndef _PASS_H_
+#define _PASS_H_
+
+#include "ir/ir.h"
+
+// Cheap passes over the IR. Each returns whether it changed anything and
+// leaves removed instructions as IR_NOP and dropped blocks empty, for
+// ir_compact to clear.
+
+// Folds instructions whose operands are constants, phis whose operands
+// agree and branches on a constant, whose dead edge is removed.
+bool    ir_propagate_constants(ir_t ir);
+// Replaces uses of copies, and of phis of a single value, by their source.
+bool    ir_propagate_copies(ir_t ir);
+// Removes instructions whose value is unused and that have no effect.
+bool    ir_eliminate_dead_code(ir_t ir);
+// Removes unreachable blocks, merges a block into its only predecessor
+// when that jumps to it, and bypasses blocks that only jump.
+bool    ir_simplify_cfg(ir_t ir);
+
+// Runs the passes until none changes anything, then compacts the IR.
+void    ir_optimize(ir_t ir);
+
+#endif
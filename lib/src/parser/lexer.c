@@ -1,6 +1,7 @@
 #include "parser/lexer.h"
+#include "parser/scan.h"
 
-#include <ctype.h>
+#include <string.h>
 
 #define keywords_len 9
 const char *keywords[keywords_len] = { "bool", "int", "return", "if", "else", "true", "false", "char", "void" };
@@ -10,365 +11,161 @@ struct lexer_t lexer_ctor(source_t source)
     return (struct lexer_t)
     {
         .source = source,
-        .cursor = (char *)source_code(source),
-        .line_start = (char *)source_code(source),
-        .line = 0,
-        .column = 0,
-        .offset = 0,
-        .location = { .source = source, .span = { .data = NULL, .size = 0 }, .line = 0, .column = 0 },
-        .span = { .data = NULL, .size = 0 }
+        .cursor = source_code(source),
+        .span = { .data = NULL, .size = 0 },
+        .keyword = KEYWORD_NONE,
+        .symbol = SYMBOL_NONE,
+        .table = NULL
     };
 }
 
 static inline
-void advance(lexer_t lexer, const size_t size)
+void skip_whitespaces(lexer_t lexer)
 {
-    lexer->cursor += size;
-    lexer->column += size;
-    lexer->offset += size;
+    lexer->cursor += scan_whitespace_run(lexer->cursor);
 }
 
 static inline
-void newline(lexer_t lexer)
+token_kind_t token(lexer_t lexer, token_kind_t token_kind, int size)
 {
-    lexer->cursor++;
-    lexer->column = 0;
-    lexer->offset++;
-    lexer->line++;
-    lexer->line_start = lexer->cursor;
+    lexer->span.data = lexer->cursor;
+    lexer->span.size = size;
+    lexer->cursor += size;
+    return token_kind;
 }
 
-static inline
-char skip_whitespaces(lexer_t lexer)
+// Keywords are told apart by length and first character; only the one
+// candidate left is compared in full.
+keyword_t keyword_lookup(span_t span)
 {
-    while (true)
+    keyword_t keyword = KEYWORD_NONE;
+    switch (span.size)
     {
-        char c = lexer->cursor[0];
-        switch (c)
-        {
-            case ' ': advance(lexer, 1); break;
-            case '\n': newline(lexer);   break;
-        default:
-            return c;
-        }
+        case 2:
+            if (span.data[0] == 'i') keyword = KEYWORD_IF;
+            break;
+        case 3:
+            if (span.data[0] == 'i') keyword = KEYWORD_INT;
+            break;
+        case 4:
+            switch (span.data[0])
+            {
+                case 'b': keyword = KEYWORD_BOOL; break;
+                case 'c': keyword = KEYWORD_CHAR; break;
+                case 'e': keyword = KEYWORD_ELSE; break;
+                case 't': keyword = KEYWORD_TRUE; break;
+                case 'v': keyword = KEYWORD_VOID; break;
+            }
+            break;
+        case 5:
+            if (span.data[0] == 'f') keyword = KEYWORD_FALSE;
+            break;
+        case 6:
+            if (span.data[0] == 'r') keyword = KEYWORD_RETURN;
+            break;
     }
-}
-
-bool is_eof(lexer_t lexer)
-{
-    return skip_whitespaces(lexer) == '\0';
-}
-
-span_t keyword_or_identifier(lexer_t lexer)
-{
-    char c = skip_whitespaces(lexer);
-
-    if (!isalpha(c))
-        return (span_t){ .data = NULL, .size = 0 };
-
-    size_t size = 1;
-    while (isalnum(lexer->cursor[size]) || lexer->cursor[size] == '_')
-        size++;
-
-    return (span_t){ .data = lexer->cursor, .size = size };
-}
-
-bool is_keyword(lexer_t lexer, keyword_t keyword)
-{
-    span_t kw = keyword_or_identifier(lexer);
-
-    if (!span_eq(kw, span_sz(keywords[keyword])))
-        return false;
-
-    advance(lexer, kw.size);
-    return true;
-}
-
-bool is_keyword_bool(lexer_t lexer)
-{
-    return is_keyword(lexer, KEYWORD_BOOL);
-}
-
-bool is_keyword_int(lexer_t lexer)
-{
-    return is_keyword(lexer, KEYWORD_INT);
-}
-
-bool is_keyword_return(lexer_t lexer)
-{
-    return is_keyword(lexer, KEYWORD_RETURN);
-}
-
-bool is_keyword_if(lexer_t lexer)
-{
-    return is_keyword(lexer, KEYWORD_IF);
-}
-
-bool is_keyword_else(lexer_t lexer)
-{
-    return is_keyword(lexer, KEYWORD_ELSE);
-}
-
-bool is_keyword_true(lexer_t lexer)
-{
-    return is_keyword(lexer, KEYWORD_TRUE);
-}
-
-bool is_keyword_false(lexer_t lexer)
-{
-    return is_keyword(lexer, KEYWORD_FALSE);
-}
-
-bool is_keyword_char(lexer_t lexer)
-{
-    return is_keyword(lexer, KEYWORD_CHAR);
-}
-
-bool is_keyword_void(lexer_t lexer)
-{
-    return is_keyword(lexer, KEYWORD_VOID);
-}
-
-bool is_identifier(lexer_t lexer)
-{
-    lexer->span.data = NULL;
-    lexer->span.size = 0;
-
-    span_t span = keyword_or_identifier(lexer);
-
-    if (span.data == NULL)
-        return false;
-
-    for (int i = 0; i < keywords_len; i++)
-        if (span_eq(span, span_sz(keywords[i])))
-            return false;
-
-    lexer->location.span = span;
-    lexer->location.line = lexer->line;
-    lexer->location.column = lexer->column;
-    advance(lexer, span.size);
-    lexer->span = span;
-    return true;
-}
-
-bool is_open_paren(lexer_t lexer)
-{
-    if (skip_whitespaces(lexer) != '(')
-        return false;
-
-    advance(lexer, 1);
-    return true;
-}
-
-bool is_close_paren(lexer_t lexer)
-{
-    if (skip_whitespaces(lexer) != ')')
-        return false;
-
-    advance(lexer, 1);
-    return true;
-}
-
-bool is_open_brace(lexer_t lexer)
-{
-    if (skip_whitespaces(lexer) != '{')
-        return false;
 
-    advance(lexer, 1);
-    return true;
-}
-
-bool is_close_brace(lexer_t lexer)
-{
-    if (skip_whitespaces(lexer) != '}')
-        return false;
-
-    advance(lexer, 1);
-    return true;
-}
-
-bool is_semicolon(lexer_t lexer)
-{
-    if (skip_whitespaces(lexer) != ';')
-        return false;
-
-    advance(lexer, 1);
-    return true;
-}
-
-bool is_comma(lexer_t lexer)
-{
-    if (skip_whitespaces(lexer) != ',')
-        return false;
-
-    advance(lexer, 1);
-    return true;
-}
-
-bool is_eq(lexer_t lexer)
-{
-    if (skip_whitespaces(lexer) != '=')
-        return false;
-
-    if (lexer->cursor[1] == '=')
-        return false;
-
-    advance(lexer, 1);
-    return true;
-}
-
-bool is_star(lexer_t lexer)
-{
-    if (skip_whitespaces(lexer) != '*')
-        return false;
-
-    advance(lexer, 1);
-    return true;
-}
-
-bool is_amp(lexer_t lexer)
-{
-    if (skip_whitespaces(lexer) != '&')
-        return false;
-
-    if (lexer->cursor[1] == '&')
-        return false;
-
-    advance(lexer, 1);
-    return true;
-}
-
-bool is_integer_literal(lexer_t lexer)
-{
-    char c = skip_whitespaces(lexer);
-
-    if (!isdigit(c))
-        return false;
-
-    char *data = lexer->cursor;
-    size_t size = 1;
-    while (isdigit(data[size]))
-        size++;
-
-    lexer->span.data = data;
-    lexer->span.size = size;
-
-    advance(lexer, size);
-    return true;
-}
-
-bool is_char_literal(lexer_t lexer)
-{
-    if (skip_whitespaces(lexer) != '\'')
-        return false;
-
-    char *data = lexer->cursor;
-
-    if (data[1] == '\'' || data[1] == '\0' || data[2] != '\'')
-        return false;
-
-    lexer->char_value = data[1];
-    lexer->span.data = data;
-    lexer->span.size = 3;
+    if (keyword == KEYWORD_NONE || memcmp(span.data + 1, keywords[keyword] + 1, span.size - 1) != 0)
+        return KEYWORD_NONE;
 
-    advance(lexer, 3);
-    return true;
+    return keyword;
 }
 
-token_kind_t match_found(lexer_t lexer, token_kind_t token_kind, char *data, size_t size)
+bool is_keyword(span_t span, keyword_t keyword)
 {
-    lexer->span.data = data;
-    lexer->span.size = size;
-    advance(lexer, size);
-    return token_kind;
-}
-
-token_kind_t match_assignment(lexer_t lexer)
-{
-    skip_whitespaces(lexer);
-    char *cursor = lexer->cursor;
-
-    if (cursor[0] == '=' && cursor[1] != '=')
-        return match_found(lexer, TOKEN_EQ, cursor, 1);
-
-    return TOKEN_UNEXPECTED;
+    return keyword_lookup(span) == keyword;
 }
 
-token_kind_t match_equality(lexer_t lexer)
+static
+token_kind_t keyword_or_identifier(lexer_t lexer)
 {
-    skip_whitespaces(lexer);
-    char *cursor = lexer->cursor;
+    cursor_t cursor = lexer->cursor;
 
-    if (cursor[0] == '=' && cursor[1] == '=')
-        return match_found(lexer, TOKEN_EQ_EQ, cursor, 2);
+    int size = 1 + scan_identifier_run(cursor + 1);
 
-    if (cursor[0] == '!' && cursor[1] == '=')
-        return match_found(lexer, TOKEN_NO_EQ, cursor, 2);
+    span_t span = span_ctor(size, cursor);
+    lexer->keyword = keyword_lookup(span);
+    if (lexer->keyword != KEYWORD_NONE)
+        return token(lexer, TOKEN_KEYWORD, size);
 
-    return TOKEN_UNEXPECTED;
+    lexer->symbol = lexer->table == NULL ? symbol_intern(span) : symbol_table_intern(lexer->table, span);
+    return token(lexer, TOKEN_IDENTIFIER, size);
 }
 
-token_kind_t match_comparison(lexer_t lexer)
+static
+token_kind_t integer_literal(lexer_t lexer)
 {
-    skip_whitespaces(lexer);
-    char *cursor = lexer->cursor;
-
-    if (cursor[0] == '<' && cursor[1] == '=')
-        return match_found(lexer, TOKEN_LT_EQ, cursor, 2);
-
-    if (cursor[0] == '>' && cursor[1] == '=')
-        return match_found(lexer, TOKEN_GT_EQ, cursor, 2);
+    cursor_t cursor = lexer->cursor;
 
-    if (cursor[0] == '<')
-        return match_found(lexer, TOKEN_LT, cursor, 1);
+    int size = 1 + scan_digits_run(cursor + 1);
 
-    if (cursor[0] == '>')
-        return match_found(lexer, TOKEN_GT, cursor, 1);
-
-    return TOKEN_UNEXPECTED;
+    return token(lexer, TOKEN_INTEGER, size);
 }
 
-token_kind_t match_additive(lexer_t lexer)
+static
+token_kind_t char_literal(lexer_t lexer)
 {
-    skip_whitespaces(lexer);
-    char *cursor = lexer->cursor;
+    cursor_t cursor = lexer->cursor;
 
-    if (cursor[0] == '+')
-        return match_found(lexer, TOKEN_PLUS, cursor, 1);
+    if (cursor[1] == '\'' || cursor[1] == '\0' || cursor[2] != '\'')
+        return token(lexer, TOKEN_UNEXPECTED, 1);
 
-    if (cursor[0] == '-')
-        return match_found(lexer, TOKEN_MINUS, cursor, 1);
-
-    return TOKEN_UNEXPECTED;
+    return token(lexer, TOKEN_CHAR, 3);
 }
 
-token_kind_t match_multiplicative(lexer_t lexer)
+token_kind_t lexer_scan(lexer_t lexer)
 {
     skip_whitespaces(lexer);
-    char *cursor = lexer->cursor;
-
-    if (cursor[0] == '*')
-        return match_found(lexer, TOKEN_STAR, cursor, 1);
+    lexer->keyword = KEYWORD_NONE;
+    lexer->symbol = SYMBOL_NONE;
+    cursor_t cursor = lexer->cursor;
 
-    if (cursor[0] == '/')
-        return match_found(lexer, TOKEN_SLASH, cursor, 1);
+    if (char_is(cursor[0], CHAR_ALPHA))
+        return keyword_or_identifier(lexer);
 
-    if (cursor[0] == '%')
-        return match_found(lexer, TOKEN_PERCENT, cursor, 1);
+    if (char_is(cursor[0], CHAR_DIGIT))
+        return integer_literal(lexer);
 
-    return TOKEN_UNEXPECTED;
-}
-
-token_kind_t match_conditional(lexer_t lexer)
-{
-    skip_whitespaces(lexer);
-    char *cursor = lexer->cursor;
-
-    if (cursor[0] == '&' && cursor[1] == '&')
-        return match_found(lexer, TOKEN_AND_AND, cursor, 2);
-
-    if (cursor[0] == '|' && cursor[1] == '|')
-        return match_found(lexer, TOKEN_OR_OR, cursor, 2);
+    switch (cursor[0])
+    {
+        case '\0': return token(lexer, TOKEN_EOF, 0);
+        case '\'': return char_literal(lexer);
+        case ',':  return token(lexer, TOKEN_COMMA, 1);
+        case ';':  return token(lexer, TOKEN_SEMICOLON, 1);
+        case '(':  return token(lexer, TOKEN_OPEN_PAREN, 1);
+        case ')':  return token(lexer, TOKEN_CLOSE_PAREN, 1);
+        case '{':  return token(lexer, TOKEN_OPEN_BRACE, 1);
+        case '}':  return token(lexer, TOKEN_CLOSE_BRACE, 1);
+        case '+':  return token(lexer, TOKEN_PLUS, 1);
+        case '-':  return token(lexer, TOKEN_MINUS, 1);
+        case '*':  return token(lexer, TOKEN_STAR, 1);
+        case '/':  return token(lexer, TOKEN_SLASH, 1);
+        case '%':  return token(lexer, TOKEN_PERCENT, 1);
+        case '=':
+            if (cursor[1] == '=')
+                return token(lexer, TOKEN_EQ_EQ, 2);
+            return token(lexer, TOKEN_EQ, 1);
+        case '!':
+            if (cursor[1] == '=')
+                return token(lexer, TOKEN_NO_EQ, 2);
+            break;
+        case '<':
+            if (cursor[1] == '=')
+                return token(lexer, TOKEN_LT_EQ, 2);
+            return token(lexer, TOKEN_LT, 1);
+        case '>':
+            if (cursor[1] == '=')
+                return token(lexer, TOKEN_GT_EQ, 2);
+            return token(lexer, TOKEN_GT, 1);
+        case '&':
+            if (cursor[1] == '&')
+                return token(lexer, TOKEN_AND_AND, 2);
+            return token(lexer, TOKEN_AMP, 1);
+        case '|':
+            if (cursor[1] == '|')
+                return token(lexer, TOKEN_OR_OR, 2);
+            break;
+    }
 
-    return TOKEN_UNEXPECTED;
+    return token(lexer, TOKEN_UNEXPECTED, 1);
 }
@@ -1,4 +1,5 @@
 #include "parser/parser.h"
+#include "common/arena.h"
 #include "common/mem.h"
 
 #include <ast/ast.h>
@@ -8,8 +9,10 @@
 typedef struct parser_t* parser_t;
 struct parser_t
 {
-    struct lexer_t lexer;
+    token_stream_t tokens;
+    size_t         current;
     source_t       source;
+    arena_t        arena;
 };
 
 static
@@ -27,24 +30,143 @@ unit_t parse_unit(parser_t parser);
 array_t(expression_t) scan_expression_s(parser_t parser);
 
 static inline
-lexer_t lexer(parser_t parser)
+token_kind_t peek(parser_t parser)
 {
-    return &parser->lexer;
+    return token_kind(parser->tokens, parser->current);
+}
+
+// Consumes the current token if it is of the given kind. TOKEN_EOF is
+// never accepted, so the cursor cannot run past the end of the stream.
+static inline
+bool accept(parser_t parser, token_kind_t kind)
+{
+    if (peek(parser) != kind)
+        return false;
+
+    parser->current++;
+    return true;
+}
+
+static inline
+bool accept_keyword(parser_t parser, keyword_t keyword)
+{
+    if (!token_is_keyword(parser->tokens, parser->current, keyword))
+        return false;
+
+    parser->current++;
+    return true;
+}
+
+// Consumes the current token if its kind lies in [first, last]: every
+// precedence level's operators are contiguous in token_kind_t.
+static inline
+token_kind_t accept_between(parser_t parser, token_kind_t first, token_kind_t last)
+{
+    token_kind_t kind = peek(parser);
+    if (kind < first || kind > last)
+        return TOKEN_UNEXPECTED;
+
+    parser->current++;
+    return kind;
+}
+
+static inline
+span_t accepted_span(parser_t parser)
+{
+    return token_span(parser->tokens, parser->current - 1);
+}
+
+static
+struct location_t accepted_location(parser_t parser)
+{
+    size_t index = parser->current - 1;
+    return (struct location_t)
+    {
+        .span = token_span(parser->tokens, index),
+        .source = parser->source,
+        .line = token_line(parser->tokens, index),
+        .column = token_column(parser->tokens, index),
+        .symbol = token_symbol(parser->tokens, index)
+    };
 }
 
 unit_t syntax_analysis(source_t source)
 {
-    struct parser_t parser = { .source = source, .lexer = lexer_ctor(source) };
+    if (source_size(source) >= SOURCE_SIZE_MAX)
+    {
+        fprintf(stderr, "%s: source exceeds 4 GiB\n", source_path(source));
+        return NULL;
+    }
+
+    struct parser_t parser = { .source = source, .tokens = token_stream_new(source), .current = 0, .arena = arena_new() };
 
+    // Every node of the unit comes from its arena; on a syntax error the
+    // partial tree is dropped with it.
+    arena_t previous = arena_use(parser.arena);
     unit_t unit = parse_unit(&parser);
+    arena_use(previous);
+
+    if (unit == NULL)
+        arena_free(parser.arena);
+
+    token_stream_free(parser.tokens);
 
     return unit;
 }
 
+typedef struct batch_t batch_t;
+struct batch_t
+{
+    array_t(source_t) source_s;
+    array_t(unit_t)   unit_s;
+};
+
+static
+void parse_task(void *context, size_t index)
+{
+    batch_t *batch = context;
+    batch->unit_s[index] = syntax_analysis(batch->source_s[index]);
+}
+
+array_t(unit_t) syntax_analysis_s(array_t(source_t) source_s, thread_pool_t pool)
+{
+    size_t size = array_size(source_s);
+
+    array_t(unit_t) unit_s = array_empty();
+    for (size_t i = 0; i < size; i++)
+    {
+        unit_t unit = NULL;
+        unit_s = array_add(unit_s, unit);
+    }
+
+    batch_t batch = { source_s, unit_s };
+    thread_pool_run(pool, size, parse_task, &batch);
+
+    bool failed = false;
+    for (size_t i = 0; i < size; i++)
+        failed = failed || unit_s[i] == NULL;
+
+    if (failed)
+    {
+        for (size_t i = 0; i < size; i++)
+            if (unit_s[i] != NULL)
+                unit_free(unit_s[i]);
+            else
+                source_free(source_s[i]);
+
+        array_free(unit_s);
+        unit_s = NULL;
+    }
+
+    array_free(source_s);
+
+    return unit_s;
+}
+
 unit_t parse_unit(parser_t parser)
 {
     array_t(declaration_t) declaration_s = array_empty();
-    while (!is_eof(lexer(parser)))
+    while (peek(parser) != TOKEN_EOF)
     {
         declaration_t declaration = parse_function(parser);
         if (declaration == NULL)
@@ -53,10 +175,10 @@ unit_t parse_unit(parser_t parser)
         declaration_s = array_add(declaration_s, declaration);
     }
 
-    return unit_new(parser->source, declaration_s);
+    return unit_new(parser->source, declaration_s, parser->arena);
 
 cleanup_declaration_s:
-    array_cleanup_free(declaration_s, (release_t)declaration_free);
+    array_free(declaration_s);
     return NULL;
 }
 
@@ -64,7 +186,7 @@ statement_t scan_block(parser_t parser)
 {
     array_t(statement_t) statements = array_empty();
 
-    while (!is_close_brace(lexer(parser)))
+    while (!accept(parser, TOKEN_CLOSE_BRACE))
     {
         statement_t statement = parse_statement(parser);
         if (statement == NULL)
@@ -76,7 +198,7 @@ statement_t scan_block(parser_t parser)
     return block_new(statements);
 
 cleanup_statement_s:
-    array_cleanup_free(statements, (release_t)statement_free);
+    array_free(statements);
     return NULL;
 }
 
@@ -84,60 +206,48 @@ statement_t finish_return(parser_t parser)
 {
     expression_t expression = parse_expression(parser);
     if (expression == NULL)
-        goto leave_null;
+        return NULL;
 
-    if (!is_semicolon(lexer(parser)))
+    if (!accept(parser, TOKEN_SEMICOLON))
     {
         display_error(parser, "expected ';'");
-        goto leave_expression;
+        return NULL;
     }
 
     return return_new(expression);
-
-leave_expression:;
-    expression_free(expression);
-leave_null:;
-    return NULL;
 }
 
 statement_t finish_if(parser_t parser)
 {
-    if (!is_open_paren(lexer(parser)))
+    if (!accept(parser, TOKEN_OPEN_PAREN))
     {
         display_error(parser, "expected '('");
-        goto leave_null;
+        return NULL;
     }
 
     expression_t condition = parse_expression(parser);
     if (condition == NULL)
-        goto leave_null;
+        return NULL;
 
-    if (!is_close_paren(lexer(parser)))
+    if (!accept(parser, TOKEN_CLOSE_PAREN))
     {
         display_error(parser, "expected ')'");
-        goto leave_condition;
+        return NULL;
     }
 
     statement_t then_branch = parse_statement(parser);
     if (then_branch == NULL)
-        goto leave_condition;
+        return NULL;
 
     statement_t else_branch = NULL;
-    if (is_keyword_else(lexer(parser)))
+    if (accept_keyword(parser, KEYWORD_ELSE))
     {
         else_branch = parse_statement(parser);
         if (else_branch == NULL)
-            goto leave_then_branch;
+            return NULL;
     }
 
     return if_new(condition, then_branch, else_branch);
-
-leave_then_branch:;
-    statement_free(then_branch);
-leave_condition:;
-    expression_free(condition);
-leave_null:;
-    return NULL;
 }
 
 static
@@ -147,7 +257,7 @@ statement_t scan_act(parser_t parser, bool require_semicolon)
     if (expression_s == NULL)
         goto leave_null;
 
-    if (require_semicolon && !is_semicolon(lexer(parser))) // LCOV_EXCL_BR_LINE (only caller always passes true)
+    if (require_semicolon && !accept(parser, TOKEN_SEMICOLON)) // LCOV_EXCL_BR_LINE (only caller always passes true)
     {
         display_error(parser, "expected ';'");
         goto leave_expression_s;
@@ -156,7 +266,7 @@ statement_t scan_act(parser_t parser, bool require_semicolon)
     return act_new(expression_s);
 
 leave_expression_s:;
-    array_cleanup_free(expression_s, (release_t)expression_free);
+    array_free(expression_s);
 leave_null:;
     return NULL;
 }
@@ -179,23 +289,20 @@ statement_t scan_var_or_expression_s(parser_t parser)
         }
 
         expression_t initializer = NULL;
-        if (is_eq(lexer(parser)))
+        if (accept(parser, TOKEN_EQ))
         {
             initializer = parse_expression(parser);
             if (initializer == NULL)
                 goto leave_variable_s;
         }
 
-        declaration_t variable = variable_new(type_clone(type), identifier, initializer);
+        declaration_t variable = variable_new(type, identifier, initializer);
         variable_s = array_add(variable_s, variable);
 
-        if (is_semicolon(lexer(parser)))
-        {
-            type_free(type);
+        if (accept(parser, TOKEN_SEMICOLON))
             return var_new(variable_s);
-        }
 
-        if (!is_comma(lexer(parser)))
+        if (!accept(parser, TOKEN_COMMA))
         {
             display_error(parser, "expected ',' or ';'");
             goto leave_variable_s;
@@ -203,22 +310,19 @@ statement_t scan_var_or_expression_s(parser_t parser)
     }
 
 leave_variable_s:
-    array_cleanup_free(variable_s, (release_t)declaration_free);
-    type_free(type);
+    array_free(variable_s);
     return NULL;
 }
 
 statement_t parse_statement(parser_t parser)
 {
-    lexer_t lex = lexer(parser);
-
-    if (is_open_brace(lex))
+    if (accept(parser, TOKEN_OPEN_BRACE))
         return scan_block(parser);
 
-    if (is_keyword_return(lex))
+    if (accept_keyword(parser, KEYWORD_RETURN))
         return finish_return(parser);
 
-    if (is_keyword_if(lex))
+    if (accept_keyword(parser, KEYWORD_IF))
         return finish_if(parser);
 
     return scan_var_or_expression_s(parser);
@@ -230,42 +334,30 @@ declaration_t parse_argument(parser_t parser)
     if (ret_type == NULL)
     {
         display_error(parser, "expected type");
-        goto leave_null;
+        return NULL;
     }
 
     struct location_t identifier = parse_name(parser);
     if (identifier.span.data == NULL)
     {
         display_error(parser, "expected identifier");
-        goto leave_ret_type;
+        return NULL;
     }
 
     return argument_new(ret_type, identifier);
-
-leave_ret_type:;
-    type_free(ret_type);
-leave_null:;
-    return NULL;
-}
-
-void argument_free(declaration_t declaration)
-{
-    argument_t argument = ARGUMENT(declaration);
-    type_free(argument_type(argument));
-    mem_free(declaration);
 }
 
 array_t(declaration_t) scan_argument_s(parser_t parser)
 {
     array_t(declaration_t) argument_s = array_empty();
 
-    if (!is_open_paren(lexer(parser)))
+    if (!accept(parser, TOKEN_OPEN_PAREN))
     {
         display_error(parser, "expected '('");
         goto leave_null;
     }
 
-    if (is_close_paren(lexer(parser)))
+    if (accept(parser, TOKEN_CLOSE_PAREN))
         return argument_s;
 
     while (true)
@@ -276,10 +368,10 @@ array_t(declaration_t) scan_argument_s(parser_t parser)
 
         argument_s = array_add(argument_s, argument);
 
-        if (is_close_paren(lexer(parser)))
+        if (accept(parser, TOKEN_CLOSE_PAREN))
             break;
 
-        if (!is_comma(lexer(parser)))
+        if (!accept(parser, TOKEN_COMMA))
         {
             display_error(parser, "expected ',' or ')'");
             goto leave_null;
@@ -289,7 +381,7 @@ array_t(declaration_t) scan_argument_s(parser_t parser)
     return argument_s;
 
 leave_null:;
-    array_cleanup_free(argument_s, (release_t)argument_free);
+    array_free(argument_s);
     return NULL;
 }
 
@@ -299,19 +391,19 @@ declaration_t parse_function(parser_t parser)
     if (ret_type == NULL)
     {
         display_error(parser, "expected type");
-        goto leave_null;
+        return NULL;
     }
 
     struct location_t identifier = parse_name(parser);
     if (identifier.span.data == NULL)
     {
         display_error(parser, "expected identifier");
-        goto leave_ret_type;
+        return NULL;
     }
 
     array_t(declaration_t) argument_s = scan_argument_s(parser);
     if (argument_s == NULL)
-        goto leave_ret_type;
+        return NULL;
 
     statement_t statement = parse_statement(parser);
     if (statement == NULL)
@@ -320,43 +412,34 @@ declaration_t parse_function(parser_t parser)
     return function_new(ret_type, identifier, argument_s, statement);
 
 leave_argument_s:;
-    array_cleanup_free(argument_s, (release_t)argument_free);
-leave_ret_type:;
-    type_free(ret_type);
-leave_null:;
+    array_free(argument_s);
     return NULL;
 }
 
 struct location_t parse_name(parser_t parser)
 {
-    lexer_t lex = lexer(parser);
-
-    if (is_identifier(lex))
-        return (struct location_t){ .span = lex->span, .source = parser->source, .line = lex->line, .column = lex->column };
+    if (accept(parser, TOKEN_IDENTIFIER))
+        return accepted_location(parser);
 
     return (struct location_t){ .span = { .data = NULL, .size = 0 } };
 }
 
 type_t parse_type(parser_t parser)
 {
-    lexer_t lex = lexer(parser);
-
     type_t type = NULL;
 
-    if (is_keyword_bool(lex))
-        type = type_bool_new();
-    else if (is_keyword_int(lex))
-        type = type_int_new();
-    else if (is_keyword_char(lex))
-        type = type_char_new();
-    else if (is_keyword_void(lex))
-        type = type_void_new();
-
-    if (type == NULL)
-        return NULL;
+    switch (token_keyword(parser->tokens, parser->current))
+    {
+        case KEYWORD_BOOL: type = type_bool(); break;
+        case KEYWORD_INT:  type = type_int();  break;
+        case KEYWORD_CHAR: type = type_char(); break;
+        case KEYWORD_VOID: type = type_void(); break;
+        default: return NULL;
+    }
+    parser->current++;
 
-    while (is_star(lex))
-        type = type_pointer_new(type);
+    while (accept(parser, TOKEN_STAR))
+        type = type_pointer(type);
 
     return type;
 }
@@ -373,46 +456,44 @@ array_t(expression_t) scan_expression_s(parser_t parser)
 
         expression_s = array_add(expression_s, expression);
     }
-    while (is_comma(lexer(parser)));
+    while (accept(parser, TOKEN_COMMA));
 
     return expression_s;
 leave_null:;
-    array_cleanup_free(expression_s, (release_t)expression_free);
+    array_free(expression_s);
     return NULL;
 }
 
 expression_t scan_constant(parser_t parser)
 {
-    lexer_t lex = lexer(parser);
-
-    if (is_keyword_true(lex))
+    if (accept_keyword(parser, KEYWORD_TRUE))
         return constant_bool_new(true);
-    if (is_keyword_false(lex))
+    if (accept_keyword(parser, KEYWORD_FALSE))
         return constant_bool_new(false);
 
-    if (is_integer_literal(lex))
+    if (accept(parser, TOKEN_INTEGER))
     {
         char *end = NULL;
-        uint64_t u64 = strtoull(lex->span.data, &end, 10);
+        uint64_t u64 = strtoull(accepted_span(parser).data, &end, 10);
         return constant_u64_new(u64);
     }
 
-    if (is_char_literal(lex))
-        return constant_char_new(lex->char_value);
+    if (accept(parser, TOKEN_CHAR))
+        return constant_char_new(accepted_span(parser).data[1]);
 
     return NULL;
 }
 
 expression_t finish_call(parser_t parser, expression_t callee)
 {
-    if (is_close_paren(lexer(parser)))
+    if (accept(parser, TOKEN_CLOSE_PAREN))
         return call_new(callee, array_empty());
 
     array_t(expression_t) argument_s = scan_expression_s(parser);
     if (argument_s == NULL)
         goto leave_null;
 
-    if (!is_close_paren(lexer(parser)))
+    if (!accept(parser, TOKEN_CLOSE_PAREN))
     {
         display_error(parser, "expected ')'");
         goto leave_argument_s;
@@ -421,9 +502,8 @@ expression_t finish_call(parser_t parser, expression_t callee)
     return call_new(callee, argument_s);
 
 leave_argument_s:;
-    array_cleanup_free(argument_s, (release_t)expression_free);
+    array_free(argument_s);
 leave_null:;
-    expression_free(callee);
     return NULL;
 }
 
@@ -431,21 +511,18 @@ expression_t finish_assignment(parser_t parser, expression_t lvalue)
 {
     expression_t rvalue = parse_expression(parser);
     if (rvalue == NULL)
-        goto leave_lvalue;
+        return NULL;
 
     return assignment_new(lvalue, rvalue);
-
-leave_lvalue:;
-    expression_free(lvalue);
-    return NULL;
 }
 
 expression_t suffix(parser_t parser, expression_t expression)
 {
-    lexer_t lex = lexer(parser);
-    if (is_open_paren(lex))
+    if (accept(parser, TOKEN_OPEN_PAREN))
     {
         expression = finish_call(parser, expression);
+        if (expression == NULL)
+            return NULL;
         return suffix(parser, expression);
     }
 
@@ -454,14 +531,13 @@ expression_t suffix(parser_t parser, expression_t expression)
 
 expression_t scan_identifier(parser_t parser)
 {
-    lexer_t lex = lexer(parser);
-    if (!is_identifier(lex))
+    if (!accept(parser, TOKEN_IDENTIFIER))
     {
         display_error(parser, "expected expression");
         return NULL;
     }
 
-    struct location_t location = { .span = lex->span, .source = parser->source, .line = lex->line, .column = lex->column };
+    struct location_t location = accepted_location(parser);
     expression_t identifier = identifier_new(location);
     return suffix(parser, identifier);
 }
@@ -481,9 +557,7 @@ expression_t parse_primary(parser_t parser)
 
 expression_t parse_unary(parser_t parser)
 {
-    lexer_t lex = lexer(parser);
-
-    if (is_star(lex))
+    if (accept(parser, TOKEN_STAR))
     {
         expression_t operand = parse_unary(parser);
         if (operand == NULL)
@@ -491,7 +565,7 @@ expression_t parse_unary(parser_t parser)
         return unary_new(UNARY_DEREF, operand);
     }
 
-    if (is_amp(lex))
+    if (accept(parser, TOKEN_AMP))
     {
         expression_t operand = parse_unary(parser);
         if (operand == NULL)
@@ -505,29 +579,32 @@ expression_t parse_unary(parser_t parser)
 expression_t scan_multiplicative(parser_t parser)
 {
     expression_t lhs = parse_unary(parser);
+    if (lhs == NULL)
+        return NULL;
+
     while (true)
     {
-        token_kind_t token_kind = match_multiplicative(lexer(parser));
+        token_kind_t token_kind = accept_between(parser, TOKEN_STAR, TOKEN_PERCENT);
         switch (token_kind)
         {
             case TOKEN_STAR:
             {
                 expression_t rhs = parse_unary(parser);
-                if (rhs == NULL) { expression_free(lhs); return NULL; }
+                if (rhs == NULL) return NULL;
                 lhs = binary_new(lhs, BINARY_MUL, rhs);
                 break;
             }
             case TOKEN_SLASH:
             {
                 expression_t rhs = parse_unary(parser);
-                if (rhs == NULL) { expression_free(lhs); return NULL; }
+                if (rhs == NULL) return NULL;
                 lhs = binary_new(lhs, BINARY_DIV, rhs);
                 break;
             }
             case TOKEN_PERCENT:
             {
                 expression_t rhs = parse_unary(parser);
-                if (rhs == NULL) { expression_free(lhs); return NULL; }
+                if (rhs == NULL) return NULL;
                 lhs = binary_new(lhs, BINARY_REM, rhs);
                 break;
             }
@@ -540,22 +617,25 @@ expression_t scan_multiplicative(parser_t parser)
 expression_t scan_additive(parser_t parser)
 {
     expression_t lhs = scan_multiplicative(parser);
+    if (lhs == NULL)
+        return NULL;
+
     while (true)
     {
-        token_kind_t token_kind = match_additive(lexer(parser));
+        token_kind_t token_kind = accept_between(parser, TOKEN_PLUS, TOKEN_MINUS);
         switch (token_kind)
         {
             case TOKEN_PLUS:
             {
                 expression_t rhs = scan_multiplicative(parser);
-                if (rhs == NULL) { expression_free(lhs); return NULL; }
+                if (rhs == NULL) return NULL;
                 lhs = binary_new(lhs, BINARY_ADD, rhs);
                 break;
             }
             case TOKEN_MINUS:
             {
                 expression_t rhs = scan_multiplicative(parser);
-                if (rhs == NULL) { expression_free(lhs); return NULL; }
+                if (rhs == NULL) return NULL;
                 lhs = binary_new(lhs, BINARY_SUB, rhs);
                 break;
             }
@@ -568,36 +648,39 @@ expression_t scan_additive(parser_t parser)
 expression_t scan_comparition(parser_t parser)
 {
     expression_t lhs = scan_additive(parser);
+    if (lhs == NULL)
+        return NULL;
+
     while (true)
     {
-        token_kind_t token_kind = match_comparison(lexer(parser));
+        token_kind_t token_kind = accept_between(parser, TOKEN_LT, TOKEN_GT_EQ);
         switch (token_kind)
         {
             case TOKEN_LT:
             {
                 expression_t rhs = scan_additive(parser);
-                if (rhs == NULL) { expression_free(lhs); return NULL; }
+                if (rhs == NULL) return NULL;
                 lhs = binary_new(lhs, BINARY_LT, rhs);
                 break;
             }
             case TOKEN_GT:
             {
                 expression_t rhs = scan_additive(parser);
-                if (rhs == NULL) { expression_free(lhs); return NULL; }
+                if (rhs == NULL) return NULL;
                 lhs = binary_new(lhs, BINARY_GT, rhs);
                 break;
             }
             case TOKEN_LT_EQ:
             {
                 expression_t rhs = scan_additive(parser);
-                if (rhs == NULL) { expression_free(lhs); return NULL; }
+                if (rhs == NULL) return NULL;
                 lhs = binary_new(lhs, BINARY_LE, rhs);
                 break;
             }
             case TOKEN_GT_EQ:
             {
                 expression_t rhs = scan_additive(parser);
-                if (rhs == NULL) { expression_free(lhs); return NULL; }
+                if (rhs == NULL) return NULL;
                 lhs = binary_new(lhs, BINARY_GE, rhs);
                 break;
             }
@@ -610,22 +693,25 @@ expression_t scan_comparition(parser_t parser)
 expression_t scan_equality(parser_t parser)
 {
     expression_t lhs = scan_comparition(parser);
+    if (lhs == NULL)
+        return NULL;
+
     while (true)
     {
-        token_kind_t token_kind = match_equality(lexer(parser));
+        token_kind_t token_kind = accept_between(parser, TOKEN_EQ_EQ, TOKEN_NO_EQ);
         switch (token_kind)
         {
             case TOKEN_EQ_EQ:
             {
                 expression_t rhs = scan_comparition(parser);
-                if (rhs == NULL) { expression_free(lhs); return NULL; }
+                if (rhs == NULL) return NULL;
                 lhs = binary_new(lhs, BINARY_EQ, rhs);
                 break;
             }
             case TOKEN_NO_EQ:
             {
                 expression_t rhs = scan_comparition(parser);
-                if (rhs == NULL) { expression_free(lhs); return NULL; }
+                if (rhs == NULL) return NULL;
                 lhs = binary_new(lhs, BINARY_NE, rhs);
                 break;
             }
@@ -638,22 +724,25 @@ expression_t scan_equality(parser_t parser)
 expression_t scan_conditional(parser_t parser)
 {
     expression_t lhs = scan_equality(parser);
+    if (lhs == NULL)
+        return NULL;
+
     while (true)
     {
-        token_kind_t token_kind = match_conditional(lexer(parser));
+        token_kind_t token_kind = accept_between(parser, TOKEN_AND_AND, TOKEN_OR_OR);
         switch (token_kind)
         {
             case TOKEN_AND_AND:
             {
                 expression_t rhs = scan_equality(parser);
-                if (rhs == NULL) { expression_free(lhs); return NULL; }
+                if (rhs == NULL) return NULL;
                 lhs = conditional_new(lhs, CONDITIONAL_AND, rhs);
                 break;
             }
             case TOKEN_OR_OR:
             {
                 expression_t rhs = scan_equality(parser);
-                if (rhs == NULL) { expression_free(lhs); return NULL; }
+                if (rhs == NULL) return NULL;
                 lhs = conditional_new(lhs, CONDITIONAL_OR, rhs);
                 break;
             }
@@ -669,7 +758,7 @@ expression_t parse_expression(parser_t parser)
     if (lhs == NULL)
         return NULL;
 
-    if (is_eq(lexer(parser)))
+    if (accept(parser, TOKEN_EQ))
         return finish_assignment(parser, lhs);
 
     return lhs;
@@ -694,7 +783,7 @@ expression_t parse_expression(parser_t parser)
 #define BOLDWHITE   "\033[1m\033[37m"
 
 static
-int get_line_size(cursor_t line_start)
+int get_line_size(const char *line_start)
 {
     int size = 0;
     while (line_start[size] != '\n' && line_start[size] != '\0')
@@ -706,18 +795,23 @@ int get_line_size(cursor_t line_start)
 static
 void display_error(parser_t parser, const char *msg)
 {
-    lexer_t lex = lexer(parser);
-    fprintf(stderr, BOLDWHITE "%s:%d:%d: ", source_path(parser->source), lex->line + 1, lex->column + 1);
+    token_stream_t tokens = parser->tokens;
+    size_t current = parser->current;
+    int line = token_line(tokens, current);
+    int column = token_column(tokens, current);
+    const char *line_start = token_line_start(tokens, current);
+
+    fprintf(stderr, BOLDWHITE "%s:%d:%d: ", source_path(parser->source), line + 1, column + 1);
     fprintf(stderr, BOLDRED "error: " BOLDWHITE "%s\n" RESET, msg);
 
     char line_counter[20] = { 0 };
-    int line_counter_len = snprintf(line_counter, sizeof(line_counter), "%5u | ", lex->line + 1);
+    int line_counter_len = snprintf(line_counter, sizeof(line_counter), "%5u | ", line + 1);
     fprintf(stderr, "%s", line_counter);
 
-    int line_size = get_line_size(lex->line_start);
-    fprintf(stderr, "%.*s\n", line_size, lex->line_start);
+    int line_size = get_line_size(line_start);
+    fprintf(stderr, "%.*s\n", line_size, line_start);
 
-    int size = lex->cursor - lex->line_start + line_counter_len;
+    int size = column + line_counter_len;
     for (size_t i = 0; i < size; i++)
         fputc(' ', stderr);
     fprintf(stderr, BOLDGREEN "^\n" RESET);
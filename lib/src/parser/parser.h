@@ -4,7 +4,13 @@
 #include "ast/ast.h"
 #include "parser/lexer.h"
 #include "common/source.h"
+#include "common/thread_pool.h"
 
 unit_t syntax_analysis(source_t source);
 
+// Parses every source on the pool and returns the units in source order.
+// Takes ownership of the sources: if any of them fails to parse, all are
+// released and NULL is returned.
+array_t(unit_t) syntax_analysis_s(array_t(source_t) source_s, thread_pool_t pool);
+
 #endif
@@ -0,0 +1,216 @@
+#include "parser/scan.h"
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define SCAN_X86
+#include <immintrin.h>
+#endif
+
+const uint8_t char_class[256] =
+{
+    [' ']  = CHAR_SPACE,
+    ['\n'] = CHAR_SPACE,
+    ['0' ... '9'] = CHAR_DIGIT | CHAR_IDENTIFIER,
+    ['A' ... 'Z'] = CHAR_ALPHA | CHAR_IDENTIFIER,
+    ['a' ... 'z'] = CHAR_ALPHA | CHAR_IDENTIFIER,
+    ['_']  = CHAR_IDENTIFIER,
+};
+
+static inline
+size_t scalar_run(const char *cursor, uint8_t mask)
+{
+    size_t size = 0;
+    while (char_is(cursor[size], mask))
+        size++;
+
+    return size;
+}
+
+static size_t scalar_whitespace(const char *cursor) { return scalar_run(cursor, CHAR_SPACE); }
+static size_t scalar_identifier(const char *cursor) { return scalar_run(cursor, CHAR_IDENTIFIER); }
+static size_t scalar_digits(const char *cursor)     { return scalar_run(cursor, CHAR_DIGIT); }
+
+#ifdef SCAN_X86
+
+// Each kernel classifies a whole block into a byte mask, then finds the
+// first byte outside the class. The first load is aligned down to the
+// block size and the bytes before cursor are shifted out of the mask.
+// Signed byte compares are fine: every class is ASCII and bytes >= 0x80
+// compare below all of them. The aligned loads may read past the end of
+// the buffer within its page, which AddressSanitizer would flag.
+
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define NO_ASAN __attribute__((no_sanitize_address))
+#endif
+#endif
+#if !defined(NO_ASAN) && defined(__SANITIZE_ADDRESS__)
+#define NO_ASAN __attribute__((no_sanitize_address))
+#endif
+#ifndef NO_ASAN
+#define NO_ASAN
+#endif
+
+static inline __attribute__((always_inline))
+__m128i sse2_in_range(__m128i block, char low, char high)
+{
+    return _mm_and_si128(
+        _mm_cmpgt_epi8(block, _mm_set1_epi8(low - 1)),
+        _mm_cmplt_epi8(block, _mm_set1_epi8(high + 1)));
+}
+
+static inline __attribute__((always_inline))
+uint32_t sse2_mask(__m128i block, uint8_t mask)
+{
+    __m128i in;
+    if (mask == CHAR_SPACE)
+        in = _mm_or_si128(
+            _mm_cmpeq_epi8(block, _mm_set1_epi8(' ')),
+            _mm_cmpeq_epi8(block, _mm_set1_epi8('\n')));
+    else if (mask == CHAR_DIGIT)
+        in = sse2_in_range(block, '0', '9');
+    else
+        in = _mm_or_si128(
+            _mm_or_si128(
+                sse2_in_range(_mm_or_si128(block, _mm_set1_epi8(0x20)), 'a', 'z'),
+                sse2_in_range(block, '0', '9')),
+            _mm_cmpeq_epi8(block, _mm_set1_epi8('_')));
+
+    return _mm_movemask_epi8(in);
+}
+
+static inline __attribute__((always_inline)) NO_ASAN
+size_t sse2_run(const char *cursor, uint8_t mask)
+{
+    size_t misalign = (uintptr_t)cursor & 15;
+    const __m128i *block = (const __m128i*)(cursor - misalign);
+
+    uint32_t stop = (~sse2_mask(_mm_load_si128(block), mask) & 0xffff) >> misalign;
+    if (stop != 0)
+        return __builtin_ctz(stop);
+
+    size_t size = 16 - misalign;
+    while (true)
+    {
+        stop = ~sse2_mask(_mm_load_si128(++block), mask) & 0xffff;
+        if (stop != 0)
+            return size + __builtin_ctz(stop);
+        size += 16;
+    }
+}
+
+static NO_ASAN size_t sse2_whitespace(const char *cursor) { return sse2_run(cursor, CHAR_SPACE); }
+static NO_ASAN size_t sse2_identifier(const char *cursor) { return sse2_run(cursor, CHAR_IDENTIFIER); }
+static NO_ASAN size_t sse2_digits(const char *cursor)     { return sse2_run(cursor, CHAR_DIGIT); }
+
+#define AVX2 __attribute__((target("avx2")))
+
+static inline __attribute__((always_inline)) AVX2
+__m256i avx2_in_range(__m256i block, char low, char high)
+{
+    return _mm256_and_si256(
+        _mm256_cmpgt_epi8(block, _mm256_set1_epi8(low - 1)),
+        _mm256_cmpgt_epi8(_mm256_set1_epi8(high + 1), block));
+}
+
+static inline __attribute__((always_inline)) AVX2
+uint32_t avx2_mask(__m256i block, uint8_t mask)
+{
+    __m256i in;
+    if (mask == CHAR_SPACE)
+        in = _mm256_or_si256(
+            _mm256_cmpeq_epi8(block, _mm256_set1_epi8(' ')),
+            _mm256_cmpeq_epi8(block, _mm256_set1_epi8('\n')));
+    else if (mask == CHAR_DIGIT)
+        in = avx2_in_range(block, '0', '9');
+    else
+        in = _mm256_or_si256(
+            _mm256_or_si256(
+                avx2_in_range(_mm256_or_si256(block, _mm256_set1_epi8(0x20)), 'a', 'z'),
+                avx2_in_range(block, '0', '9')),
+            _mm256_cmpeq_epi8(block, _mm256_set1_epi8('_')));
+
+    return _mm256_movemask_epi8(in);
+}
+
+static inline __attribute__((always_inline)) AVX2 NO_ASAN
+size_t avx2_run(const char *cursor, uint8_t mask)
+{
+    size_t misalign = (uintptr_t)cursor & 31;
+    const __m256i *block = (const __m256i*)(cursor - misalign);
+
+    uint32_t stop = ~avx2_mask(_mm256_load_si256(block), mask) >> misalign;
+    if (stop != 0)
+        return __builtin_ctz(stop);
+
+    size_t size = 32 - misalign;
+    while (true)
+    {
+        stop = ~avx2_mask(_mm256_load_si256(++block), mask);
+        if (stop != 0)
+            return size + __builtin_ctz(stop);
+        size += 32;
+    }
+}
+
+static AVX2 NO_ASAN size_t avx2_whitespace(const char *cursor) { return avx2_run(cursor, CHAR_SPACE); }
+static AVX2 NO_ASAN size_t avx2_identifier(const char *cursor) { return avx2_run(cursor, CHAR_IDENTIFIER); }
+static AVX2 NO_ASAN size_t avx2_digits(const char *cursor)     { return avx2_run(cursor, CHAR_DIGIT); }
+
+#endif
+
+typedef size_t (*scan_run_t)(const char *cursor);
+
+static scan_kernel_t kernel = SCAN_KERNEL_SCALAR;
+static scan_run_t whitespace_kernel = scalar_whitespace;
+static scan_run_t identifier_kernel = scalar_identifier;
+static scan_run_t digits_kernel = scalar_digits;
+
+size_t scan_whitespace_run(const char *cursor) { return whitespace_kernel(cursor); }
+size_t scan_identifier_run(const char *cursor) { return identifier_kernel(cursor); }
+size_t scan_digits_run(const char *cursor)     { return digits_kernel(cursor); }
+
+scan_kernel_t scan_kernel(void)
+{
+    return kernel;
+}
+
+bool scan_select(scan_kernel_t selected)
+{
+    switch (selected)
+    {
+        case SCAN_KERNEL_SCALAR:
+            whitespace_kernel = scalar_whitespace;
+            identifier_kernel = scalar_identifier;
+            digits_kernel = scalar_digits;
+            break;
+#ifdef SCAN_X86
+        case SCAN_KERNEL_SSE2:
+            whitespace_kernel = sse2_whitespace;
+            identifier_kernel = sse2_identifier;
+            digits_kernel = sse2_digits;
+            break;
+        case SCAN_KERNEL_AVX2:
+            if (!__builtin_cpu_supports("avx2"))
+                return false;                                       // LCOV_EXCL_LINE
+            whitespace_kernel = avx2_whitespace;
+            identifier_kernel = avx2_identifier;
+            digits_kernel = avx2_digits;
+            break;
+#endif
+        default:
+            return false;                                           // LCOV_EXCL_LINE
+    }
+
+    kernel = selected;
+    return true;
+}
+
+__attribute__((constructor))
+static void scan_dispatch(void)
+{
+#ifdef SCAN_X86
+    __builtin_cpu_init();
+    if (!scan_select(SCAN_KERNEL_AVX2))
+        scan_select(SCAN_KERNEL_SSE2);                              // LCOV_EXCL_LINE
+#endif
+}
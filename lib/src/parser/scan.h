@@ -0,0 +1,46 @@
+#ifndef _SCAN_H_
+#define _SCAN_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Character classes of the lexer, one bit each in char_class.
+enum
+{
+    CHAR_SPACE      = 1 << 0,   // ' ' '\n'
+    CHAR_ALPHA      = 1 << 1,   // [A-Za-z]
+    CHAR_DIGIT      = 1 << 2,   // [0-9]
+    CHAR_IDENTIFIER = 1 << 3,   // [A-Za-z0-9_]
+};
+
+extern const uint8_t char_class[256];
+
+static inline
+bool char_is(char c, uint8_t mask)
+{
+    return char_class[(uint8_t)c] & mask;
+}
+
+typedef enum scan_kernel_t scan_kernel_t;
+enum scan_kernel_t
+{
+    SCAN_KERNEL_SCALAR,
+    SCAN_KERNEL_SSE2,
+    SCAN_KERNEL_AVX2,
+};
+
+// Length of the run of whitespace, identifier or digit characters starting
+// at cursor. The run must be terminated by a character outside the class,
+// which the '\0' sentinel of every source guarantees. Vector kernels only
+// issue aligned loads, so they never touch a page the terminator is not on.
+size_t        scan_whitespace_run(const char *cursor);
+size_t        scan_identifier_run(const char *cursor);
+size_t        scan_digits_run(const char *cursor);
+
+// The best kernel for the running CPU is picked at startup; scan_select
+// forces another one and fails if the CPU lacks it.
+scan_kernel_t scan_kernel(void);
+bool          scan_select(scan_kernel_t kernel);
+
+#endif
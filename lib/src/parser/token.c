@@ -0,0 +1,166 @@
+#include "parser/token.h"
+#include "parser/lexer.h"
+#include "common/array.h"
+#include "common/mem.h"
+
+#include <string.h>
+
+struct token_stream_t
+{
+    source_t           source;
+    array_t(uint8_t)   kind_s;
+    array_t(uint8_t)   keyword_s;
+    array_t(symbol_t)  symbol_s;
+    array_t(uint32_t)  offset_s;
+    array_t(uint32_t)  length_s;
+    array_t(uint32_t)  line_s;
+};
+
+// Offsets of the first character of every line, for mapping a token
+// offset back to its line and column. memchr does the scanning so the
+// lexer itself does not have to track lines.
+static
+array_t(uint32_t) scan_line_s(source_t source)
+{
+    const char *code = source_code(source);
+    const char *end = code + source_size(source);
+
+    uint32_t offset = 0;
+    array_t(uint32_t) line_s = array_add(array_empty(), offset);
+
+    for (const char *cursor = code; (cursor = memchr(cursor, '\n', end - cursor)) != NULL; )
+    {
+        cursor++;
+        offset = cursor - code;
+        line_s = array_add(line_s, offset);
+    }
+
+    return line_s;
+}
+
+token_stream_t token_stream_new(source_t source)
+{
+    token_stream_t stream = mem_alloc(sizeof(struct token_stream_t));
+    stream->source = source;
+    stream->kind_s = array_empty();
+    stream->keyword_s = array_empty();
+    stream->symbol_s = array_empty();
+    stream->offset_s = array_empty();
+    stream->length_s = array_empty();
+    stream->line_s = scan_line_s(source);
+
+    const char *code = source_code(source);
+    struct lexer_t lexer = lexer_ctor(source);
+    // files are lexed in parallel; intern their names once per file
+    lexer.table = symbol_table_new();
+
+    while (true)
+    {
+        uint8_t kind = lexer_scan(&lexer);
+        uint8_t keyword = lexer.keyword;
+        symbol_t symbol = lexer.symbol;
+        uint32_t offset = lexer.span.data - code;
+        uint32_t length = lexer.span.size;
+
+        stream->kind_s = array_add(stream->kind_s, kind);
+        stream->keyword_s = array_add(stream->keyword_s, keyword);
+        stream->symbol_s = array_add(stream->symbol_s, symbol);
+        stream->offset_s = array_add(stream->offset_s, offset);
+        stream->length_s = array_add(stream->length_s, length);
+
+        if (kind == TOKEN_EOF)
+            break;
+    }
+
+    const symbol_t *symbol_s = symbol_table_merge(lexer.table);
+    for (size_t i = 0; i < array_size(stream->symbol_s); i++)
+        stream->symbol_s[i] = symbol_s[stream->symbol_s[i]];
+    symbol_table_free(lexer.table);
+
+    return stream;
+}
+
+void token_stream_free(token_stream_t stream)
+{
+    array_free(stream->kind_s);
+    array_free(stream->keyword_s);
+    array_free(stream->symbol_s);
+    array_free(stream->offset_s);
+    array_free(stream->length_s);
+    array_free(stream->line_s);
+    mem_free(stream);
+}
+
+source_t token_stream_source(token_stream_t stream)
+{
+    return stream->source;
+}
+
+size_t token_stream_size(token_stream_t stream)
+{
+    return array_size(stream->kind_s);
+}
+
+token_kind_t token_kind(token_stream_t stream, size_t index)
+{
+    return stream->kind_s[index];
+}
+
+uint32_t token_offset(token_stream_t stream, size_t index)
+{
+    return stream->offset_s[index];
+}
+
+uint32_t token_length(token_stream_t stream, size_t index)
+{
+    return stream->length_s[index];
+}
+
+span_t token_span(token_stream_t stream, size_t index)
+{
+    const char *data = source_code(stream->source) + stream->offset_s[index];
+    return span_ctor(stream->length_s[index], data);
+}
+
+keyword_t token_keyword(token_stream_t stream, size_t index)
+{
+    return stream->keyword_s[index];
+}
+
+symbol_t token_symbol(token_stream_t stream, size_t index)
+{
+    return stream->symbol_s[index];
+}
+
+bool token_is_keyword(token_stream_t stream, size_t index, keyword_t keyword)
+{
+    return stream->keyword_s[index] == keyword;
+}
+
+int token_line(token_stream_t stream, size_t index)
+{
+    uint32_t offset = stream->offset_s[index];
+
+    // last line starting at or before offset; line_s[0] is always 0
+    size_t lo = 0, hi = array_size(stream->line_s);
+    while (hi - lo > 1)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (stream->line_s[mid] <= offset)
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+int token_column(token_stream_t stream, size_t index)
+{
+    return stream->offset_s[index] - stream->line_s[token_line(stream, index)];
+}
+
+const char* token_line_start(token_stream_t stream, size_t index)
+{
+    return source_code(stream->source) + stream->line_s[token_line(stream, index)];
+}
@@ -0,0 +1,84 @@
+#ifndef _TOKEN_H_
+#define _TOKEN_H_
+
+#include "common/source.h"
+#include "common/symbol.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum token_kind_t token_kind_t;
+enum token_kind_t
+{
+    TOKEN_UNEXPECTED,
+    TOKEN_EOF,
+    TOKEN_IDENTIFIER,
+    TOKEN_LT,
+    TOKEN_LT_EQ,
+    TOKEN_GT,
+    TOKEN_GT_EQ,
+    TOKEN_EQ_EQ,
+    TOKEN_NO_EQ,
+    TOKEN_PLUS,
+    TOKEN_MINUS,
+    TOKEN_STAR,
+    TOKEN_SLASH,
+    TOKEN_PERCENT,
+    TOKEN_EQ,
+
+    TOKEN_AND_AND,
+    TOKEN_OR_OR,
+
+    TOKEN_KEYWORD,
+    TOKEN_INTEGER,
+    TOKEN_CHAR,
+    TOKEN_AMP,
+    TOKEN_COMMA,
+    TOKEN_SEMICOLON,
+    TOKEN_OPEN_PAREN,
+    TOKEN_CLOSE_PAREN,
+    TOKEN_OPEN_BRACE,
+    TOKEN_CLOSE_BRACE,
+};
+
+typedef enum keyword_t keyword_t;
+enum keyword_t
+{
+    KEYWORD_BOOL,
+    KEYWORD_INT,
+    KEYWORD_RETURN,
+    KEYWORD_IF,
+    KEYWORD_ELSE,
+    KEYWORD_TRUE,
+    KEYWORD_FALSE,
+    KEYWORD_CHAR,
+    KEYWORD_VOID,
+
+    KEYWORD_NONE,
+};
+
+// Every token of a source, lexed once up front and stored as parallel
+// arrays (kind, keyword, symbol, offset, length) so the parser can peek and look ahead by
+// index instead of rescanning bytes. The last token is always TOKEN_EOF.
+typedef struct token_stream_t* token_stream_t;
+
+token_stream_t token_stream_new(source_t source);
+void           token_stream_free(token_stream_t stream);
+
+source_t       token_stream_source(token_stream_t stream);
+size_t         token_stream_size(token_stream_t stream);
+
+token_kind_t   token_kind(token_stream_t stream, size_t index);
+uint32_t       token_offset(token_stream_t stream, size_t index);
+uint32_t       token_length(token_stream_t stream, size_t index);
+span_t         token_span(token_stream_t stream, size_t index);
+keyword_t      token_keyword(token_stream_t stream, size_t index);
+symbol_t       token_symbol(token_stream_t stream, size_t index);
+bool           token_is_keyword(token_stream_t stream, size_t index, keyword_t keyword);
+
+int            token_line(token_stream_t stream, size_t index);
+int            token_column(token_stream_t stream, size_t index);
+const char*    token_line_start(token_stream_t stream, size_t index);
+
+#endif
@@ -0,0 +1,424 @@
+#include "sema/eval.h"
+#include "common/mem.h"
+
+#include <string.h>
+
+// A call runs in a frame of its function's locals, which sema numbered
+// with consecutive ids; frames stack up in value_s. Statements report
+// whether the run goes on, returned, or gave up.
+typedef enum outcome_t outcome_t;
+enum outcome_t
+{
+    OUTCOME_NEXT,
+    OUTCOME_RETURN,
+    OUTCOME_FAIL,
+};
+
+typedef struct range_t range_t;
+struct range_t
+{
+    uint32_t    first;
+    uint32_t    size;       // UINT32_MAX until scanned
+};
+
+struct eval_t
+{
+    range_t    *range_s;    // locals of each function, by its id
+    int64_t    *value_s;
+    bool       *known_s;    // whether the local holds a value
+    size_t      capacity;
+    size_t      top;
+    size_t      base;       // value_s index of id 0 in the running frame
+
+    int64_t     result;
+    int         steps;
+    int         depth;
+};
+
+eval_t eval_new(uint32_t declarations)
+{
+    eval_t eval = mem_alloc(sizeof(struct eval_t));
+
+    eval->range_s = mem_alloc((declarations + 1) * sizeof(range_t));
+    for (uint32_t i = 0; i <= declarations; i++)
+        eval->range_s[i].size = UINT32_MAX;
+
+    eval->capacity = 64;
+    eval->value_s = mem_alloc(eval->capacity * sizeof(int64_t));
+    eval->known_s = mem_alloc(eval->capacity * sizeof(bool));
+    eval->top = 0;
+
+    return eval;
+}
+
+void eval_free(eval_t eval)
+{
+    mem_free(eval->range_s);
+    mem_free(eval->value_s);
+    mem_free(eval->known_s);
+    mem_free(eval);
+}
+
+int64_t eval_constant(constant_t constant)
+{
+    switch (constant_kind(constant)) // LCOV_EXCL_LINE
+    {
+        case CONSTANT_BOOL:
+            return -(int64_t)constant_bool(constant);
+        case CONSTANT_U64:
+            return (int32_t)constant_u64(constant);
+        case CONSTANT_CHAR:
+            return (int8_t)constant_char(constant);
+    }
+    __builtin_unreachable();
+}
+
+int64_t eval_normalize(type_kind_t kind, int64_t value)
+{
+    switch (kind)
+    {
+        case TYPE_BOOL:
+            return -(value & 1);
+        case TYPE_INT:
+            return (int32_t)value;
+        case TYPE_CHAR:
+            return (int8_t)value;
+        default: // LCOV_EXCL_LINE
+            return value; // LCOV_EXCL_LINE
+    }
+}
+
+bool eval_binary(binary_kind_t op, type_kind_t kind, int64_t a, int64_t b, int64_t *value)
+{
+    switch (op) // LCOV_EXCL_LINE
+    {
+        case BINARY_LT: *value = -(a < b); return true;
+        case BINARY_LE: *value = -(a <= b); return true;
+        case BINARY_GT: *value = -(a > b); return true;
+        case BINARY_GE: *value = -(a >= b); return true;
+        case BINARY_EQ: *value = -(a == b); return true;
+        case BINARY_NE: *value = -(a != b); return true;
+        case BINARY_ADD: *value = eval_normalize(kind, a + b); return true;
+        case BINARY_SUB: *value = eval_normalize(kind, a - b); return true;
+        case BINARY_MUL: *value = eval_normalize(kind, a * b); return true;
+        case BINARY_DIV:
+        case BINARY_REM:
+        {
+            int64_t minimum = kind == TYPE_CHAR ? INT8_MIN : INT32_MIN;
+            if (kind == TYPE_BOOL || b == 0 || (b == -1 && a == minimum))
+                return false;
+            *value = op == BINARY_DIV ? a / b : a % b;
+            return true;
+        }
+    }
+    __builtin_unreachable();
+}
+
+// ---------------------------------------------------------------------------
+// Frames
+
+static
+void scan_range(range_t *range, declaration_t declaration)
+{
+    uint32_t id = declaration_id(declaration);
+    if (range->size == 0 || id < range->first)
+    {
+        range->size = range->size == 0 ? 1 : range->size + range->first - id;
+        range->first = id;
+    }
+    else if (id >= range->first + range->size)
+        range->size = id - range->first + 1;
+}
+
+static
+void scan_statement(range_t *range, statement_t statement)
+{
+    switch (statement_kind(statement)) // LCOV_EXCL_LINE
+    {
+        case STATEMENT_BLOCK:
+        {
+            array_t(statement_t) statement_s = block_statement_s(BLOCK(statement));
+            for (size_t i = 0; i < array_size(statement_s); i++)
+                scan_statement(range, statement_s[i]);
+            break;
+        }
+        case STATEMENT_IF:
+            scan_statement(range, if_then_branch(IF(statement)));
+            if (if_else_branch(IF(statement)) != NULL)
+                scan_statement(range, if_else_branch(IF(statement)));
+            break;
+        case STATEMENT_VAR:
+        {
+            array_t(declaration_t) variable_s = var_variable_s(VAR(statement));
+            for (size_t i = 0; i < array_size(variable_s); i++)
+                scan_range(range, variable_s[i]);
+            break;
+        }
+        case STATEMENT_RETURN:
+        case STATEMENT_ACT:
+            break;
+    }
+}
+
+static
+range_t function_range(eval_t eval, function_t function)
+{
+    range_t *range = &eval->range_s[declaration_id((declaration_t)function)];
+    if (range->size == UINT32_MAX)
+    {
+        range->first = 0;
+        range->size = 0;
+
+        array_t(declaration_t) argument_s = function_argument_s(function);
+        for (size_t i = 0; i < array_size(argument_s); i++)
+            scan_range(range, argument_s[i]);
+        scan_statement(range, function_statement(function));
+    }
+
+    return *range;
+}
+
+static
+void reserve(eval_t eval, size_t size)
+{
+    if (eval->top + size <= eval->capacity)
+        return;
+
+    while (eval->top + size > eval->capacity)
+        eval->capacity *= 2;
+    eval->value_s = mem_realloc(eval->value_s, eval->capacity * sizeof(int64_t));
+    eval->known_s = mem_realloc(eval->known_s, eval->capacity * sizeof(bool));
+}
+
+// Any identifier that is not a function names a local of the frame.
+static
+bool is_local(expression_t expression)
+{
+    return expression_kind(expression) == EXPRESSION_IDENTIFIER &&
+           declaration_kind(identifier_declaration(IDENTIFIER(expression))) != DECLARATION_FUNCTION;
+}
+
+static inline
+void store(eval_t eval, declaration_t declaration, int64_t value)
+{
+    size_t index = eval->base + declaration_id(declaration);
+    eval->value_s[index] = value;
+    eval->known_s[index] = true;
+}
+
+// ---------------------------------------------------------------------------
+// Run
+
+static
+bool run_expression(eval_t eval, expression_t expression, int64_t *value);
+
+static
+outcome_t run_statement(eval_t eval, statement_t statement);
+
+// The arguments are the count values on top of the stack, which the
+// frame replaces.
+static
+bool run_function(eval_t eval, function_t function, size_t count, int64_t *value)
+{
+    if (eval->depth == EVAL_DEPTH)
+        return false;
+
+    range_t range = function_range(eval, function);
+    size_t argument = eval->top - count;
+    reserve(eval, range.size);
+    memset(eval->known_s + eval->top, 0, range.size * sizeof(bool));
+
+    size_t base = eval->base;
+    eval->base = eval->top - range.first;
+    eval->top += range.size;
+    eval->depth++;
+
+    array_t(declaration_t) argument_s = function_argument_s(function);
+    for (size_t i = 0; i < count; i++)
+        store(eval, argument_s[i], eval->value_s[argument + i]);
+
+    outcome_t outcome = run_statement(eval, function_statement(function));
+    *value = eval->result;
+
+    eval->depth--;
+    eval->top = argument;
+    eval->base = base;
+
+    return outcome != OUTCOME_FAIL;
+}
+
+static
+bool run_call(eval_t eval, call_t call, int64_t *value)
+{
+    expression_t callee = call_callee(call);
+    if (expression_kind(callee) != EXPRESSION_IDENTIFIER)
+        return false;
+
+    declaration_t declaration = identifier_declaration(IDENTIFIER(callee));
+    if (declaration_kind(declaration) != DECLARATION_FUNCTION)
+        return false;
+
+    // each argument waits on the stack while the next runs
+    array_t(expression_t) argument_s = call_argument_s(call);
+    size_t top = eval->top;
+    for (size_t i = 0; i < array_size(argument_s); i++)
+    {
+        int64_t argument;
+        if (!run_expression(eval, argument_s[i], &argument))
+        {
+            eval->top = top;
+            return false;
+        }
+
+        reserve(eval, 1);
+        eval->value_s[eval->top++] = argument;
+    }
+
+    return run_function(eval, FUNCTION(declaration), array_size(argument_s), value);
+}
+
+static
+bool run_expression(eval_t eval, expression_t expression, int64_t *value)
+{
+    if (--eval->steps < 0)
+        return false;
+
+    switch (expression_kind(expression)) // LCOV_EXCL_LINE
+    {
+        case EXPRESSION_CONSTANT:
+            *value = eval_constant(CONSTANT(expression));
+            return true;
+        case EXPRESSION_BINARY:
+        {
+            binary_t binary = BINARY(expression);
+            int64_t a, b;
+            if (!run_expression(eval, binary_lhs(binary), &a) || !run_expression(eval, binary_rhs(binary), &b))
+                return false;
+            type_kind_t kind = type_kind(expression_type(binary_lhs(binary)));
+            return eval_binary(binary_op(binary), kind, a, b, value);
+        }
+        case EXPRESSION_CALL:
+            return run_call(eval, CALL(expression), value);
+        case EXPRESSION_ASSIGNMENT:
+        {
+            // only to a local, never through a pointer or to a function
+            assignment_t assignment = ASSIGNMENT(expression);
+            expression_t lvalue = assignment_lvalue(assignment);
+            if (!is_local(lvalue))
+                return false;
+            if (!run_expression(eval, assignment_rvalue(assignment), value))
+                return false;
+            store(eval, identifier_declaration(IDENTIFIER(lvalue)), *value);
+            return true;
+        }
+        case EXPRESSION_IMPLICIT_CAST:
+        {
+            implicit_cast_t cast = IMPLICIT_CAST(expression);
+            expression_t inner = implicit_cast_expression(cast);
+            if (implicit_cast_kind(cast) != IMPLICIT_CAST_LVALUE_TO_RVALUE || !is_local(inner))
+                return false;
+
+            size_t index = eval->base + declaration_id(identifier_declaration(IDENTIFIER(inner)));
+            if (!eval->known_s[index])
+                return false;
+            *value = eval->value_s[index];
+            return true;
+        }
+        case EXPRESSION_CONDITIONAL:
+        {
+            conditional_t conditional = CONDITIONAL(expression);
+            if (!run_expression(eval, conditional_lhs(conditional), value))
+                return false;
+            if ((*value != 0) != (conditional_op(conditional) == CONDITIONAL_AND))
+                return true;
+            return run_expression(eval, conditional_rhs(conditional), value);
+        }
+        case EXPRESSION_IDENTIFIER:
+        case EXPRESSION_UNARY:
+            // a function value or an address
+            return false;
+    }
+    __builtin_unreachable();
+}
+
+static
+outcome_t run_statement(eval_t eval, statement_t statement)
+{
+    if (--eval->steps < 0)
+        return OUTCOME_FAIL;
+
+    switch (statement_kind(statement)) // LCOV_EXCL_LINE
+    {
+        case STATEMENT_BLOCK:
+        {
+            array_t(statement_t) statement_s = block_statement_s(BLOCK(statement));
+            for (size_t i = 0; i < array_size(statement_s); i++)
+            {
+                outcome_t outcome = run_statement(eval, statement_s[i]);
+                if (outcome != OUTCOME_NEXT)
+                    return outcome;
+            }
+            return OUTCOME_NEXT;
+        }
+        case STATEMENT_RETURN:
+        {
+            expression_t expression = return_expression(RETURN(statement));
+            if (expression != NULL && !run_expression(eval, expression, &eval->result))
+                return OUTCOME_FAIL;
+            return OUTCOME_RETURN;
+        }
+        case STATEMENT_IF:
+        {
+            if_t ifelse = IF(statement);
+            int64_t condition;
+            if (!run_expression(eval, if_condition(ifelse), &condition))
+                return OUTCOME_FAIL;
+            if (condition != 0)
+                return run_statement(eval, if_then_branch(ifelse));
+            if (if_else_branch(ifelse) != NULL)
+                return run_statement(eval, if_else_branch(ifelse));
+            return OUTCOME_NEXT;
+        }
+        case STATEMENT_VAR:
+        {
+            array_t(declaration_t) variable_s = var_variable_s(VAR(statement));
+            for (size_t i = 0; i < array_size(variable_s); i++)
+            {
+                expression_t initializer = variable_initializer(VARIABLE(variable_s[i]));
+                int64_t value;
+                if (initializer == NULL)
+                    continue;
+                if (!run_expression(eval, initializer, &value))
+                    return OUTCOME_FAIL;
+                store(eval, variable_s[i], value);
+            }
+            return OUTCOME_NEXT;
+        }
+        case STATEMENT_ACT:
+        {
+            array_t(expression_t) expression_s = act_expression_s(ACT(statement));
+            for (size_t i = 0; i < array_size(expression_s); i++)
+            {
+                int64_t value;
+                if (!run_expression(eval, expression_s[i], &value))
+                    return OUTCOME_FAIL;
+            }
+            return OUTCOME_NEXT;
+        }
+    }
+    __builtin_unreachable();
+}
+
+bool eval_call(eval_t eval, function_t function, array_t(expression_t) argument_s, int64_t *value)
+{
+    eval->steps = EVAL_STEPS;
+    eval->depth = 0;
+    eval->top = 0;
+    eval->base = 0;
+
+    reserve(eval, array_size(argument_s));
+    for (size_t i = 0; i < array_size(argument_s); i++)
+        eval->value_s[eval->top++] = eval_constant(CONSTANT(argument_s[i]));
+
+    return run_function(eval, function, array_size(argument_s), value);
+}
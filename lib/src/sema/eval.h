@@ -0,0 +1,32 @@
+#ifndef _EVAL_H_
+#define _EVAL_H_
+
+#include "ast/ast.h"
+
+// Compile-time evaluation of calls. Values are int64_t normalized to their
+// type, as the backends compute: int and char sign extended from 32 and 8
+// bits, and bool a signed i1, so true is -1.
+typedef  struct eval_t*  eval_t;
+
+// Steps, each an expression or statement run, one eval_call may take, and
+// how deep its calls may nest.
+#define EVAL_STEPS  (1 << 16)
+#define EVAL_DEPTH  256
+
+// An evaluator for the checked functions of a compilation with the given
+// number of declarations.
+eval_t      eval_new(uint32_t declarations);
+void        eval_free(eval_t eval);
+
+// Runs the function on constant arguments and stores its result. Only
+// what cannot be told apart from the result is run: it gives up, leaving
+// the call to run time, on pointers and function values, on a division
+// that would trap, and past the budget.
+bool        eval_call(eval_t eval, function_t function, array_t(expression_t) argument_s, int64_t *value);
+
+int64_t     eval_constant(constant_t constant);
+int64_t     eval_normalize(type_kind_t kind, int64_t value);
+// Operands are of kind; false where the operation would trap.
+bool        eval_binary(binary_kind_t op, type_kind_t kind, int64_t a, int64_t b, int64_t *value);
+
+#endif
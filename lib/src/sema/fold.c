@@ -0,0 +1,257 @@
+#include "sema/fold.h"
+
+// Constants compute as the backends do, through eval. A fold that would
+// trap or be undefined at run time, as a division by zero, is left for
+// run time.
+
+static inline
+bool is_constant(expression_t expression)
+{
+    return expression_kind(expression) == EXPRESSION_CONSTANT;
+}
+
+static
+expression_t constant_new(type_kind_t kind, int64_t value)
+{
+    expression_t constant = NULL;
+    switch (kind) // LCOV_EXCL_LINE
+    {
+        case TYPE_BOOL:
+            constant = constant_bool_new(value & 1);
+            break;
+        case TYPE_INT:
+            constant = constant_u64_new((uint32_t)value);
+            break;
+        case TYPE_CHAR:
+            constant = constant_char_new((char)(uint8_t)value);
+            break;
+        default: // LCOV_EXCL_LINE
+            __builtin_unreachable(); // LCOV_EXCL_LINE
+    }
+
+    expression_set_type(constant, expression_type(constant));
+    return constant;
+}
+
+static
+expression_t fold_expression(eval_t eval, expression_t expression);
+
+static
+expression_t fold_binary(eval_t eval, expression_t expression)
+{
+    binary_t binary = BINARY(expression);
+    binary_set_lhs(binary, fold_expression(eval, binary_lhs(binary)));
+    binary_set_rhs(binary, fold_expression(eval, binary_rhs(binary)));
+
+    expression_t lhs = binary_lhs(binary);
+    expression_t rhs = binary_rhs(binary);
+    if (!is_constant(lhs) || !is_constant(rhs))
+        return expression;
+
+    type_kind_t kind = type_kind(expression_type(lhs));
+    int64_t value;
+    if (!eval_binary(binary_op(binary), kind, eval_constant(CONSTANT(lhs)), eval_constant(CONSTANT(rhs)), &value))
+        return expression;
+
+    return constant_new(type_kind(expression_type(expression)), value);
+}
+
+// A constant lhs decides the result or leaves the rhs as it; a constant
+// rhs that cannot change the result drops out. Otherwise the rhs may only
+// be dropped if it has no effects, so it stays.
+static
+expression_t fold_conditional(eval_t eval, expression_t expression)
+{
+    conditional_t conditional = CONDITIONAL(expression);
+    conditional_set_lhs(conditional, fold_expression(eval, conditional_lhs(conditional)));
+    conditional_set_rhs(conditional, fold_expression(eval, conditional_rhs(conditional)));
+
+    expression_t lhs = conditional_lhs(conditional);
+    expression_t rhs = conditional_rhs(conditional);
+    bool is_and = conditional_op(conditional) == CONDITIONAL_AND;
+
+    if (is_constant(lhs))
+        return constant_bool(CONSTANT(lhs)) == is_and ? rhs : lhs;
+    if (is_constant(rhs) && constant_bool(CONSTANT(rhs)) == is_and)
+        return lhs;
+
+    return expression;
+}
+
+// A call of a function with constant arguments stands for its result when
+// that can be run now.
+static
+expression_t fold_call(eval_t eval, expression_t expression)
+{
+    call_t call = CALL(expression);
+    array_t(expression_t) argument_s = call_argument_s(call);
+    bool constant = true;
+    for (size_t i = 0; i < array_size(argument_s); i++)
+    {
+        argument_s[i] = fold_expression(eval, argument_s[i]);
+        constant = constant && is_constant(argument_s[i]);
+    }
+
+    expression_t callee = call_callee(call);
+    type_kind_t kind = type_kind(expression_type(expression));
+    if (!constant || expression_kind(callee) != EXPRESSION_IDENTIFIER ||
+        (kind != TYPE_BOOL && kind != TYPE_INT && kind != TYPE_CHAR))
+        return expression;
+
+    declaration_t declaration = identifier_declaration(IDENTIFIER(callee));
+    int64_t value;
+    if (declaration_kind(declaration) != DECLARATION_FUNCTION ||
+        !eval_call(eval, FUNCTION(declaration), argument_s, &value))
+        return expression;
+
+    return constant_new(kind, value);
+}
+
+static
+expression_t fold_expression(eval_t eval, expression_t expression)
+{
+    switch (expression_kind(expression)) // LCOV_EXCL_LINE
+    {
+        case EXPRESSION_CONSTANT:
+        case EXPRESSION_IDENTIFIER:
+            return expression;
+        case EXPRESSION_BINARY:
+            return fold_binary(eval, expression);
+        case EXPRESSION_CALL:
+            return fold_call(eval, expression);
+        case EXPRESSION_ASSIGNMENT:
+        {
+            // an lvalue is never replaced, only what it holds folded
+            assignment_t assignment = ASSIGNMENT(expression);
+            fold_expression(eval, assignment_lvalue(assignment));
+            assignment_set_rvalue(assignment, fold_expression(eval, assignment_rvalue(assignment)));
+            return expression;
+        }
+        case EXPRESSION_IMPLICIT_CAST:
+            fold_expression(eval, implicit_cast_expression(IMPLICIT_CAST(expression)));
+            return expression;
+        case EXPRESSION_CONDITIONAL:
+            return fold_conditional(eval, expression);
+        case EXPRESSION_UNARY:
+        {
+            // & and * never apply to a constant
+            unary_t unary = UNARY(expression);
+            unary_set_expression(unary, fold_expression(eval, unary_expression(unary)));
+            return expression;
+        }
+    }
+    __builtin_unreachable();
+}
+
+// Returns what stands for the statement once folded, NULL for nothing.
+static
+statement_t fold_statement(eval_t eval, statement_t statement);
+
+static
+statement_t fold_branch(eval_t eval, statement_t statement)
+{
+    statement_t folded = fold_statement(eval, statement);
+    return folded != NULL ? folded : block_new(array_empty());
+}
+
+// Statements that fold to nothing stand as empty blocks until the block is
+// done, so that a function being folded can still be run meanwhile.
+static
+statement_t fold_block(eval_t eval, statement_t statement)
+{
+    array_t(statement_t) statement_s = block_statement_s(BLOCK(statement));
+    size_t end = array_size(statement_s);
+    for (size_t i = 0; i < end; i++)
+    {
+        statement_s[i] = fold_branch(eval, statement_s[i]);
+        // nothing after it runs
+        if (statement_all_path_return_value(statement_s[i]))
+            end = i + 1;
+    }
+
+    size_t size = 0;
+    for (size_t i = 0; i < end; i++)
+        if (statement_kind(statement_s[i]) != STATEMENT_BLOCK ||
+            array_size(block_statement_s(BLOCK(statement_s[i]))) > 0)
+            statement_s[size++] = statement_s[i];
+    array_truncate(statement_s, size);
+
+    return statement;
+}
+
+static
+statement_t fold_if(eval_t eval, statement_t statement)
+{
+    if_t ifelse = IF(statement);
+    if_set_condition(ifelse, fold_expression(eval, if_condition(ifelse)));
+
+    expression_t condition = if_condition(ifelse);
+    statement_t else_branch = if_else_branch(ifelse);
+    if (is_constant(condition))
+    {
+        if (constant_bool(CONSTANT(condition)))
+            return fold_statement(eval, if_then_branch(ifelse));
+        return else_branch != NULL ? fold_statement(eval, else_branch) : NULL;
+    }
+
+    if_set_then_branch(ifelse, fold_branch(eval, if_then_branch(ifelse)));
+    if (else_branch != NULL)
+        if_set_else_branch(ifelse, fold_statement(eval, else_branch));
+
+    return statement;
+}
+
+static
+statement_t fold_statement(eval_t eval, statement_t statement)
+{
+    switch (statement_kind(statement)) // LCOV_EXCL_LINE
+    {
+        case STATEMENT_BLOCK:
+            return fold_block(eval, statement);
+        case STATEMENT_RETURN:
+        {
+            return_t ret = RETURN(statement);
+            if (return_expression(ret) != NULL)
+                return_set_expression(ret, fold_expression(eval, return_expression(ret)));
+            return statement;
+        }
+        case STATEMENT_IF:
+            return fold_if(eval, statement);
+        case STATEMENT_VAR:
+        {
+            array_t(declaration_t) variable_s = var_variable_s(VAR(statement));
+            for (size_t i = 0; i < array_size(variable_s); i++)
+            {
+                variable_t variable = VARIABLE(variable_s[i]);
+                if (variable_initializer(variable) != NULL)
+                    variable_set_initializer(variable, fold_expression(eval, variable_initializer(variable)));
+            }
+            return statement;
+        }
+        case STATEMENT_ACT:
+        {
+            // a call that folded to its result has no effect left
+            array_t(expression_t) expression_s = act_expression_s(ACT(statement));
+            for (size_t i = 0; i < array_size(expression_s); i++)
+                expression_s[i] = fold_expression(eval, expression_s[i]);
+
+            size_t size = 0;
+            for (size_t i = 0; i < array_size(expression_s); i++)
+                if (!is_constant(expression_s[i]))
+                    expression_s[size++] = expression_s[i];
+            array_truncate(expression_s, size);
+            return size > 0 ? statement : NULL;
+        }
+    }
+    __builtin_unreachable();
+}
+
+void fold_unit(unit_t unit, eval_t eval)
+{
+    array_t(declaration_t) declaration_s = unit_declaration_s(unit);
+    for (size_t i = 0; i < array_size(declaration_s); i++)
+    {
+        function_t function = FUNCTION(declaration_s[i]);
+        function_set_statement(function, fold_branch(eval, function_statement(function)));
+    }
+}
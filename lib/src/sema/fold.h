@@ -0,0 +1,14 @@
+#ifndef _FOLD_H_
+#define _FOLD_H_
+
+#include "sema/eval.h"
+
+// Folds the expressions of a checked unit whose operands are constants and
+// drops the statements that can never run: the branch an if with a
+// constant condition does not take, and whatever follows a return in a
+// block. Calls of functions with constant arguments are run by eval and
+// replaced by their result. New nodes come from the current arena, which
+// must be the unit's.
+void fold_unit(unit_t unit, eval_t eval);
+
+#endif
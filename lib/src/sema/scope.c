@@ -1,163 +1,109 @@
 #include "sema/scope.h"
 #include "common/mem.h"
 
-typedef struct node_t *node_t;
-struct node_t
+#include <string.h>
+
+// entry_s is the undo log: every declaration added, in order, with the
+// entry it shadows. head_s maps a symbol id to its innermost entry, both
+// as index + 1 so that 0 means none. Symbol ids are dense, so head_s is a
+// plain array rather than a hash table. mark_s holds the size of entry_s
+// when each open scope was entered.
+typedef struct entry_t entry_t;
+struct entry_t
 {
-    bool is_red;
-    node_t lhs, rhs, parent;
     declaration_t declaration;
+    symbol_t      symbol;
+    uint32_t      shadowed;
+    uint32_t      depth;
 };
 
 struct scope_t
 {
-    scope_t parent;
-    node_t root;
-};
+    array_t(entry_t)   entry_s;
+    array_t(uint32_t)  mark_s;
 
-node_t node_new(declaration_t declaration, bool is_red, node_t lhs, node_t rhs)
-{
-    node_t node = mem_alloc(sizeof(struct node_t));
-    node->is_red = is_red;
-    node->lhs = lhs;
-    node->rhs = rhs;
-    node->parent = NULL;
-    node->declaration = declaration;
-    return node;
-}
+    uint32_t          *head_s;
+    size_t             head_capacity;
+};
 
-scope_t scope_new(scope_t parent)
+scope_t scope_new(void)
 {
     scope_t scope = mem_alloc(sizeof(struct scope_t));
-    scope->parent = parent;
-    scope->root = NULL;
+    scope->entry_s = array_empty();
+    scope->mark_s = array_empty();
+    scope->head_s = NULL;
+    scope->head_capacity = 0;
     return scope;
 }
 
-void free_node(node_t node)
-{
-    if (node == NULL)
-        return;
-    free_node(node->lhs);
-    free_node(node->rhs);
-    mem_free(node);
-}
-
 void scope_free(scope_t scope)
 {
-    free_node(scope->root);
+    array_free(scope->entry_s);
+    array_free(scope->mark_s);
+    mem_free(scope->head_s);
     mem_free(scope);
 }
 
-static inline node_t rotate_left(node_t node)
+void scope_enter(scope_t scope)
 {
-    node_t x = node->rhs;
-    node->rhs = x->lhs;
-    if (x->lhs != NULL)
-        x->lhs->parent = node;
-    x->parent = node->parent;
-    node->parent = x;
-    x->lhs = node;
-    x->is_red = node->is_red;
-    node->is_red = true;
-    return x;
+    uint32_t mark = array_size(scope->entry_s);
+    scope->mark_s = array_add(scope->mark_s, mark);
 }
 
-static inline node_t rotate_right(node_t node)
+void scope_leave(scope_t scope)
 {
-    node_t x = node->lhs;
-    node->lhs = x->rhs;
-    if (x->rhs != NULL)
-        x->rhs->parent = node;
-    x->parent = node->parent;
-    node->parent = x;
-    x->rhs = node;
-    x->is_red = node->is_red;
-    node->is_red = true;
-    return x;
-}
+    size_t depth = array_size(scope->mark_s);
+    uint32_t mark = scope->mark_s[depth - 1];
 
-static node_t fix_up(node_t root)
-{
-    if (root->rhs && root->rhs->is_red)
-    {
-        if (root->lhs && root->lhs->is_red)
-        {
-            root->is_red = true;
-            root->lhs->is_red = false;
-            root->rhs->is_red = false;
-        }
-        else
-        {
-            root = rotate_left(root);
-        }
-    }
-    else if (root->lhs && root->lhs->is_red && root->lhs->lhs && root->lhs->lhs->is_red)
+    for (size_t i = array_size(scope->entry_s); i > mark; i--)
     {
-        root = rotate_right(root);
+        entry_t *entry = &scope->entry_s[i - 1];
+        scope->head_s[entry->symbol] = entry->shadowed;
     }
-    return root;
+
+    array_truncate(scope->entry_s, mark);
+    array_truncate(scope->mark_s, depth - 1);
 }
 
-static node_t insert_node(node_t root, declaration_t declaration, node_t parent)
+size_t scope_depth(scope_t scope)
 {
-    if (root == NULL)
-    {
-        node_t node = node_new(declaration, true, NULL, NULL);
-        node->parent = parent;
-        return node;
-    }
-
-    span_t decl_name = location_span(declaration_name(declaration));
-    span_t root_name = location_span(declaration_name(root->declaration));
-    int cmp = span_cmp(decl_name, root_name);
-
-    if (cmp == 0) // LCOV_EXCL_LINE
-        return root; // LCOV_EXCL_LINE
+    return array_size(scope->mark_s);
+}
 
-    if (cmp < 0)
-        root->lhs = insert_node(root->lhs, declaration, root);
-    else
-        root->rhs = insert_node(root->rhs, declaration, root);
+static
+void grow_head_s(scope_t scope, symbol_t symbol)
+{
+    size_t capacity = scope->head_capacity == 0 ? 256 : scope->head_capacity;
+    while (capacity <= symbol)
+        capacity *= 2;
 
-    return fix_up(root);
+    scope->head_s = mem_realloc(scope->head_s, capacity * sizeof(uint32_t));
+    memset(scope->head_s + scope->head_capacity, 0, (capacity - scope->head_capacity) * sizeof(uint32_t));
+    scope->head_capacity = capacity;
 }
 
 bool scope_add(scope_t scope, declaration_t declaration)
 {
-    span_t name = location_span(declaration_name(declaration));
+    symbol_t symbol = declaration_symbol(declaration);
+    if (symbol >= scope->head_capacity)
+        grow_head_s(scope, symbol);
 
-    node_t current = scope->root;
-    while (current != NULL)
-    {
-        int cmp = span_cmp(name, location_span(declaration_name(current->declaration)));
-        if (cmp == 0) return false;
-        current = cmp < 0 ? current->lhs : current->rhs;
-    }
+    uint32_t depth = array_size(scope->mark_s);
+    uint32_t head = scope->head_s[symbol];
+    if (head != 0 && scope->entry_s[head - 1].depth == depth)
+        return false;
+
+    entry_t entry = { .declaration = declaration, .symbol = symbol, .shadowed = head, .depth = depth };
+    scope->entry_s = array_add(scope->entry_s, entry);
+    scope->head_s[symbol] = array_size(scope->entry_s);
 
-    scope->root = insert_node(scope->root, declaration, NULL);
-    if (scope->root) // LCOV_EXCL_BR_LINE (insert_node never returns NULL)
-        scope->root->is_red = false;
     return true;
 }
 
-declaration_t scope_find(scope_t scope, span_t name) 
+declaration_t scope_find(scope_t scope, symbol_t name)
 {
-    if (scope == NULL)
+    if (name >= scope->head_capacity || scope->head_s[name] == 0)
         return NULL;
 
-    node_t current = scope->root;
-    while (current != NULL)
-    {
-        int cmp = span_cmp(name, location_span(declaration_name(current->declaration)));
-        if (cmp == 0) return current->declaration;
-        current = cmp < 0 ? current->lhs : current->rhs;
-    }
-
-    return scope_find(scope->parent, name);
-}
-
-scope_t scope_parent(scope_t scope)
-{
-    return scope->parent;
+    return scope->entry_s[scope->head_s[name] - 1].declaration;
 }
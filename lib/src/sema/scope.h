@@ -3,13 +3,19 @@
 
 #include "ast/declaration.h"
 
+// One table for all the nested scopes of an analysis. Every name has a
+// stack of the declarations that shadow each other, and an undo log of
+// the additions lets scope_leave pop just what the innermost scope added.
 typedef  struct scope_t*  scope_t;
 
-scope_t        scope_new(scope_t parent);
+scope_t        scope_new(void);
 void           scope_free(scope_t scope);
 
+void           scope_enter(scope_t scope);
+void           scope_leave(scope_t scope);
+size_t         scope_depth(scope_t scope);
+
 bool           scope_add(scope_t scope, declaration_t declaration);
-declaration_t  scope_find(scope_t scope, span_t name);
-scope_t        scope_parent(scope_t scope);
+declaration_t  scope_find(scope_t scope, symbol_t name);
 
 #endif
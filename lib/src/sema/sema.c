@@ -1,6 +1,7 @@
 
 #include "sema/sema.h"
 #include "sema/scope.h"
+#include "sema/fold.h"
 #include "common/mem.h"
 
 #include <stdio.h>
@@ -25,6 +26,7 @@ struct sema_t
     declaration_t declaration;
     function_t function;
 
+    uint32_t declarations;
     size_t errors;
 };
 
@@ -42,7 +44,18 @@ compilation_t semantic_analysis(array_t(unit_t) unit_s)
         return NULL;
     }
 
-    compilation_t compilation_unit = compilation_new(unit_s);
+    // once checked, each unit is folded in its own arena; calls run
+    // across units
+    eval_t eval = eval_new(sema->declarations);
+    for (size_t i = 0; i < array_size(unit_s); i++)
+    {
+        arena_t previous = arena_use(unit_arena(unit_s[i]));
+        fold_unit(unit_s[i], eval);
+        arena_use(previous);
+    }
+    eval_free(eval);
+
+    compilation_t compilation_unit = compilation_new(unit_s, sema->declarations);
     sema_free(sema);
 
     return compilation_unit;
@@ -53,7 +66,8 @@ sema_t sema_new(array_t(unit_t) unit_s)
     sema_t sema = mem_alloc(sizeof(struct sema_t));
 
     sema->unit_s = unit_s;
-    sema->scope = scope_new(NULL);
+    sema->scope = scope_new();
+    sema->declarations = 0;
     sema->errors = 0;
 
     return sema;
@@ -73,15 +87,20 @@ size_t sema_errors(sema_t sema)
 static inline
 void enter_scope(sema_t sema)
 {
-    sema->scope = scope_new(sema->scope);
+    scope_enter(sema->scope);
 }
 
 static inline
 void leave_scope(sema_t sema)
 {
-    scope_t parent = scope_parent(sema->scope);
-    scope_free(sema->scope);
-    sema->scope = parent;
+    scope_leave(sema->scope);
+}
+
+// Gives the declaration the next dense id of the compilation.
+static inline
+void number_declaration(sema_t sema, declaration_t declaration)
+{
+    declaration_set_id(declaration, ++sema->declarations);
 }
 
 void unit_map_functions(sema_t sema, unit_t unit)
@@ -90,6 +109,7 @@ void unit_map_functions(sema_t sema, unit_t unit)
     for (int i = 0; i < size; i++)
     {
         declaration_t declaration = unit_declaration_s(unit)[i];
+        number_declaration(sema, declaration);
         if (!scope_add(sema->scope, declaration))
         {
             display_error(declaration_name(declaration), "redefinition of");
@@ -100,12 +120,10 @@ void unit_map_functions(sema_t sema, unit_t unit)
 
 void resolve_identifier(sema_t sema, identifier_t identifier)
 {
-    span_t name = identifier_name(identifier);
-
-    declaration_t declaration = scope_find(sema->scope, name);
+    declaration_t declaration = scope_find(sema->scope, identifier_symbol(identifier));
     if (declaration == NULL)
     {
-        struct location_t loc = { .span = name, .source = unit_source(sema->unit) };
+        struct location_t loc = { .span = identifier_name(identifier), .source = unit_source(sema->unit) };
         display_error(&loc, "undeclared identifier");
 
         sema->errors++;
@@ -135,10 +153,12 @@ expression_t implicit_cast(sema_t sema, expression_t expression)
 {
     (void) sema;
 
-    if (is_lvalue(expression))
-        return implicit_cast_new(IMPLICIT_CAST_LVALUE_TO_RVALUE, expression);
+    if (!is_lvalue(expression))
+        return expression;
 
-    return expression;
+    expression_t cast = implicit_cast_new(IMPLICIT_CAST_LVALUE_TO_RVALUE, expression);
+    expression_set_type(cast, expression_type(expression));
+    return cast;
 }
 
 static
@@ -335,6 +355,9 @@ void expression_analysis(sema_t sema, expression_t expression)
             unary_analysis(sema, UNARY(expression));
             break;
     }
+
+    // the children are typed by now, so this is derived in O(1)
+    expression_set_type(expression, expression_type(expression));
 }
 
 void statement_analysis(sema_t sema, statement_t statement);
@@ -399,6 +422,7 @@ void var_analysis(sema_t sema, var_t var)
     for (int i = 0; i < size; i++)
     {
         declaration_t declaration = declaration_s[i];
+        number_declaration(sema, declaration);
 
         variable_t variable = VARIABLE(declaration);
 
@@ -471,6 +495,7 @@ void map_argument_s(sema_t sema, array_t(declaration_t) argument_s)
     for (size_t i = 0; i < size; i++)
     {
         declaration_t argument = argument_s[i];
+        number_declaration(sema, argument);
 
         if (type_eq(declaration_type(argument), type_void()))
         {
@@ -539,8 +564,11 @@ void sema_analysis(sema_t sema)
 
     for (int i = 0; i < size; i++)
     {
+        // nodes sema inserts (implicit casts) belong to the unit's arena
         sema->unit = sema->unit_s[i];
+        arena_t previous = arena_use(unit_arena(sema->unit));
         unit_analysis(sema, sema->unit);
+        arena_use(previous);
         sema->unit = NULL;
     }
 }
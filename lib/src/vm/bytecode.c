@@ -0,0 +1,633 @@
+#include "vm/bytecode.h"
+#include "common/mem.h"
+
+#include <string.h>
+
+struct bytecode_t
+{
+    array_t(instruction_t)        code_s;
+    array_t(bytecode_function_t)  function_s;
+};
+
+#define REGISTER_NONE UINT32_MAX
+
+typedef struct compiler_t compiler_t;
+struct compiler_t
+{
+    bytecode_t      bytecode;
+    uint32_t       *index_s;        // by declaration id: function index or register
+    uint32_t        locals;         // registers of arguments and variables in scope
+    uint32_t        top;            // first free register
+    uint32_t        registers;      // most used at once by the function
+    bool            failed;
+};
+
+static
+void unsupported(compiler_t *compiler, const char *what)
+{
+    if (!compiler->failed)
+        fprintf(stderr, "bytecode: %s is not supported\n", what);
+    compiler->failed = true;
+}
+
+static
+uint32_t emit(compiler_t *compiler, instruction_t instruction)
+{
+    uint32_t at = array_size(compiler->bytecode->code_s);
+    compiler->bytecode->code_s = array_add(compiler->bytecode->code_s, instruction);
+    return at;
+}
+
+static
+uint32_t emit_abc(compiler_t *compiler, opcode_t op, uint32_t a, uint32_t b, uint32_t c)
+{
+    instruction_t instruction = { .op = op, .a = a, .b = b, .c = c };
+    return emit(compiler, instruction);
+}
+
+static
+uint32_t emit_imm(compiler_t *compiler, opcode_t op, uint32_t a, int32_t imm)
+{
+    instruction_t instruction = { .op = op, .a = a, .imm = imm };
+    return emit(compiler, instruction);
+}
+
+// Points the jump at the next instruction.
+static
+void patch(compiler_t *compiler, uint32_t jump)
+{
+    compiler->bytecode->code_s[jump].imm = array_size(compiler->bytecode->code_s);
+}
+
+static
+void set_top(compiler_t *compiler, uint32_t top)
+{
+    compiler->top = top;
+    if (top > compiler->registers)
+        compiler->registers = top;
+}
+
+static
+uint32_t temporary(compiler_t *compiler)
+{
+    uint32_t temporary = compiler->top;
+    set_top(compiler, temporary + 1);
+    return temporary;
+}
+
+static
+uint32_t local(compiler_t *compiler, identifier_t identifier)
+{
+    return compiler->index_s[declaration_id(identifier_declaration(identifier))];
+}
+
+static
+bool is_local(identifier_t identifier)
+{
+    return declaration_kind(identifier_declaration(identifier)) != DECLARATION_FUNCTION;
+}
+
+static
+void emit_expression(compiler_t *compiler, expression_t expression, uint32_t dst);
+
+// A register holding the value: a local read as is, anything else
+// evaluated into a new temporary.
+static
+uint32_t operand(compiler_t *compiler, expression_t expression)
+{
+    if (expression_kind(expression) == EXPRESSION_IMPLICIT_CAST)
+    {
+        implicit_cast_t cast = IMPLICIT_CAST(expression);
+        expression_t inner = implicit_cast_expression(cast);
+        if (implicit_cast_kind(cast) == IMPLICIT_CAST_LVALUE_TO_RVALUE
+            && expression_kind(inner) == EXPRESSION_IDENTIFIER && is_local(IDENTIFIER(inner)))
+            return local(compiler, IDENTIFIER(inner));
+    }
+
+    uint32_t dst = temporary(compiler);
+    emit_expression(compiler, expression, dst);
+    return dst;
+}
+
+static
+void emit_constant(compiler_t *compiler, constant_t constant, uint32_t dst)
+{
+    switch (constant_kind(constant)) // LCOV_EXCL_LINE
+    {
+        case CONSTANT_BOOL:
+            emit_imm(compiler, OP_CONST, dst, constant_bool(constant));
+            break;
+        case CONSTANT_U64:
+            emit_imm(compiler, OP_CONST, dst, (int32_t)constant_u64(constant));
+            break;
+        case CONSTANT_CHAR:
+            emit_imm(compiler, OP_CONST, dst, (int8_t)constant_char(constant));
+            break;
+    }
+}
+
+static
+void emit_binary(compiler_t *compiler, binary_t binary, uint32_t dst)
+{
+    static const opcode_t op_s[] =
+    {
+        [BINARY_LT] = OP_LT,
+        [BINARY_LE] = OP_LE,
+        [BINARY_GT] = OP_GT,
+        [BINARY_GE] = OP_GE,
+        [BINARY_EQ] = OP_EQ,
+        [BINARY_NE] = OP_NE,
+        [BINARY_ADD] = OP_ADD,
+        [BINARY_SUB] = OP_SUB,
+        [BINARY_MUL] = OP_MUL,
+        [BINARY_DIV] = OP_DIV,
+        [BINARY_REM] = OP_REM,
+    };
+
+    uint32_t mark = compiler->top;
+    uint32_t lhs = operand(compiler, binary_lhs(binary));
+    uint32_t rhs = operand(compiler, binary_rhs(binary));
+    type_kind_t kind = type_kind(expression_type(binary_lhs(binary)));
+    binary_kind_t op = binary_op(binary);
+
+    // bools order as signed one bit integers, where true is -1
+    bool ordering = op == BINARY_LT || op == BINARY_LE || op == BINARY_GT || op == BINARY_GE;
+    if (kind == TYPE_BOOL && ordering)
+    {
+        uint32_t swap = lhs;
+        lhs = rhs;
+        rhs = swap;
+    }
+
+    emit_abc(compiler, op_s[op], dst, lhs, rhs);
+
+    // arithmetic is done as int, then narrowed
+    bool arithmetic = op >= BINARY_ADD;
+    if (arithmetic && kind == TYPE_CHAR)
+        emit_abc(compiler, OP_TRUNC8, dst, 0, 0);
+    if (arithmetic && kind == TYPE_BOOL)
+        emit_abc(compiler, OP_TRUNC1, dst, 0, 0);
+
+    set_top(compiler, mark);
+}
+
+// The arguments are evaluated into consecutive registers, which become the
+// start of the callee's frame. A fresh temporary destination can be the
+// first of them, which saves moving the result.
+static
+void emit_call(compiler_t *compiler, call_t call, uint32_t dst)
+{
+    expression_t callee = call_callee(call);
+    if (expression_kind(callee) != EXPRESSION_IDENTIFIER || is_local(IDENTIFIER(callee)))
+    {
+        unsupported(compiler, "calling a function value");
+        return;
+    }
+    uint32_t function = local(compiler, IDENTIFIER(callee));
+
+    uint32_t mark = compiler->top;
+    bool in_place = dst != REGISTER_NONE && dst >= compiler->locals && dst + 1 == compiler->top;
+    uint32_t base = in_place ? dst : compiler->top;
+
+    array_t(expression_t) argument_s = call_argument_s(call);
+    for (size_t i = 0; i < array_size(argument_s); i++)
+    {
+        set_top(compiler, base + i + 1);
+        emit_expression(compiler, argument_s[i], base + i);
+    }
+    set_top(compiler, base + (array_size(argument_s) > 0 ? array_size(argument_s) : 1));
+
+    emit_imm(compiler, OP_CALL, base, function);
+    if (dst != REGISTER_NONE && dst != base)
+        emit_abc(compiler, OP_MOVE, dst, base, 0);
+
+    set_top(compiler, mark);
+}
+
+static
+void emit_assignment(compiler_t *compiler, assignment_t assignment, uint32_t dst)
+{
+    expression_t lvalue = assignment_lvalue(assignment);
+    expression_t rvalue = assignment_rvalue(assignment);
+    uint32_t mark = compiler->top;
+
+    if (expression_kind(lvalue) == EXPRESSION_IDENTIFIER)
+    {
+        if (!is_local(IDENTIFIER(lvalue)))
+        {
+            unsupported(compiler, "a function value");
+            return;
+        }
+
+        // a conditional writes its lhs before its rhs runs, and the rhs
+        // may still read the local
+        uint32_t target = local(compiler, IDENTIFIER(lvalue));
+        uint32_t value = target;
+        if (expression_kind(rvalue) == EXPRESSION_CONDITIONAL)
+            value = temporary(compiler);
+
+        emit_expression(compiler, rvalue, value);
+        if (value != target)
+            emit_abc(compiler, OP_MOVE, target, value, 0);
+        if (dst != REGISTER_NONE && dst != target)
+            emit_abc(compiler, OP_MOVE, dst, target, 0);
+    }
+    else
+    {
+        uint32_t pointer = operand(compiler, unary_expression(UNARY(lvalue)));
+        uint32_t value = dst;
+        if (value == REGISTER_NONE)
+            value = operand(compiler, rvalue);
+        else
+            emit_expression(compiler, rvalue, value);
+        emit_abc(compiler, OP_STORE, pointer, value, 0);
+    }
+
+    set_top(compiler, mark);
+}
+
+static
+void emit_implicit_cast(compiler_t *compiler, implicit_cast_t implicit_cast, uint32_t dst)
+{
+    expression_t inner = implicit_cast_expression(implicit_cast);
+    if (implicit_cast_kind(implicit_cast) != IMPLICIT_CAST_LVALUE_TO_RVALUE)
+    {
+        unsupported(compiler, "function to pointer decay");
+        return;
+    }
+
+    if (expression_kind(inner) == EXPRESSION_IDENTIFIER && !is_local(IDENTIFIER(inner)))
+    {
+        unsupported(compiler, "a function value");
+        return;
+    }
+
+    uint32_t mark = compiler->top;
+    if (expression_kind(inner) == EXPRESSION_IDENTIFIER)
+        emit_abc(compiler, OP_MOVE, dst, local(compiler, IDENTIFIER(inner)), 0);
+    else
+        emit_abc(compiler, OP_LOAD, dst, operand(compiler, unary_expression(UNARY(inner))), 0);
+    set_top(compiler, mark);
+}
+
+static
+void emit_conditional(compiler_t *compiler, conditional_t conditional, uint32_t dst)
+{
+    opcode_t op = conditional_op(conditional) == CONDITIONAL_AND ? OP_JUMP_IF_FALSE : OP_JUMP_IF_TRUE;
+
+    emit_expression(compiler, conditional_lhs(conditional), dst);
+    uint32_t jump = emit_imm(compiler, op, dst, 0);
+    emit_expression(compiler, conditional_rhs(conditional), dst);
+    patch(compiler, jump);
+}
+
+// An lvalue is its address, as in the LLVM backend: &x and *p both end
+// up as the pointer they designate.
+static
+void emit_address(compiler_t *compiler, expression_t lvalue, uint32_t dst)
+{
+    if (expression_kind(lvalue) == EXPRESSION_IDENTIFIER)
+        emit_abc(compiler, OP_ADDRESS, dst, local(compiler, IDENTIFIER(lvalue)), 0);
+    else
+        emit_expression(compiler, unary_expression(UNARY(lvalue)), dst);
+}
+
+static
+void emit_expression(compiler_t *compiler, expression_t expression, uint32_t dst)
+{
+    switch (expression_kind(expression)) // LCOV_EXCL_LINE
+    {
+        case EXPRESSION_CONSTANT:
+            emit_constant(compiler, CONSTANT(expression), dst);
+            break;
+        case EXPRESSION_IDENTIFIER:
+            if (is_local(IDENTIFIER(expression)))
+                emit_address(compiler, expression, dst);
+            else
+                unsupported(compiler, "a function value");
+            break;
+        case EXPRESSION_BINARY:
+            emit_binary(compiler, BINARY(expression), dst);
+            break;
+        case EXPRESSION_CALL:
+            emit_call(compiler, CALL(expression), dst);
+            break;
+        case EXPRESSION_ASSIGNMENT:
+            emit_assignment(compiler, ASSIGNMENT(expression), dst);
+            break;
+        case EXPRESSION_IMPLICIT_CAST:
+            emit_implicit_cast(compiler, IMPLICIT_CAST(expression), dst);
+            break;
+        case EXPRESSION_CONDITIONAL:
+            emit_conditional(compiler, CONDITIONAL(expression), dst);
+            break;
+        case EXPRESSION_UNARY:
+            if (unary_op(UNARY(expression)) == UNARY_ADDRESS_OF)
+                emit_address(compiler, unary_expression(UNARY(expression)), dst);
+            else
+                emit_address(compiler, expression, dst);
+            break;
+    }
+}
+
+// An expression statement: assignments and calls need no result register.
+static
+void emit_effect(compiler_t *compiler, expression_t expression)
+{
+    if (expression_kind(expression) == EXPRESSION_ASSIGNMENT)
+        emit_assignment(compiler, ASSIGNMENT(expression), REGISTER_NONE);
+    else if (expression_kind(expression) == EXPRESSION_CALL)
+        emit_call(compiler, CALL(expression), REGISTER_NONE);
+    else
+        emit_expression(compiler, expression, temporary(compiler));
+}
+
+static
+void emit_statement(compiler_t *compiler, statement_t statement);
+
+static
+void emit_block(compiler_t *compiler, block_t block)
+{
+    uint32_t locals = compiler->locals;
+
+    array_t(statement_t) statement_s = block_statement_s(block);
+    for (size_t i = 0; i < array_size(statement_s); i++)
+        emit_statement(compiler, statement_s[i]);
+
+    compiler->locals = locals;
+}
+
+static
+void emit_return(compiler_t *compiler, return_t ret)
+{
+    expression_t expression = return_expression(ret);
+    if (expression == NULL)
+        emit_abc(compiler, OP_RET_VOID, 0, 0, 0);
+    else
+        emit_abc(compiler, OP_RET, operand(compiler, expression), 0, 0);
+}
+
+static
+void emit_if(compiler_t *compiler, if_t ifelse)
+{
+    uint32_t condition = operand(compiler, if_condition(ifelse));
+    set_top(compiler, compiler->locals);
+    uint32_t skip_then = emit_imm(compiler, OP_JUMP_IF_FALSE, condition, 0);
+
+    emit_statement(compiler, if_then_branch(ifelse));
+
+    statement_t else_branch = if_else_branch(ifelse);
+    if (else_branch == NULL)
+    {
+        patch(compiler, skip_then);
+        return;
+    }
+
+    uint32_t skip_else = emit_imm(compiler, OP_JUMP, 0, 0);
+    patch(compiler, skip_then);
+    emit_statement(compiler, else_branch);
+    patch(compiler, skip_else);
+}
+
+static
+void emit_var(compiler_t *compiler, var_t var)
+{
+    array_t(declaration_t) variable_s = var_variable_s(var);
+    for (size_t i = 0; i < array_size(variable_s); i++)
+    {
+        uint32_t reg = compiler->locals;
+        set_top(compiler, reg + 1);
+        compiler->index_s[declaration_id(variable_s[i])] = reg;
+
+        // the variable's register is free until initialized, so a call
+        // can put its frame there
+        expression_t initializer = variable_initializer(VARIABLE(variable_s[i]));
+        if (initializer != NULL)
+            emit_expression(compiler, initializer, reg);
+        compiler->locals = reg + 1;
+    }
+}
+
+static
+void emit_act(compiler_t *compiler, act_t act)
+{
+    array_t(expression_t) expression_s = act_expression_s(act);
+    for (size_t i = 0; i < array_size(expression_s); i++)
+    {
+        emit_effect(compiler, expression_s[i]);
+        set_top(compiler, compiler->locals);
+    }
+}
+
+static
+void emit_statement(compiler_t *compiler, statement_t statement)
+{
+    switch (statement_kind(statement)) // LCOV_EXCL_LINE
+    {
+        case STATEMENT_BLOCK:
+            emit_block(compiler, BLOCK(statement));
+            break;
+        case STATEMENT_RETURN:
+            emit_return(compiler, RETURN(statement));
+            break;
+        case STATEMENT_IF:
+            emit_if(compiler, IF(statement));
+            break;
+        case STATEMENT_VAR:
+            emit_var(compiler, VAR(statement));
+            break;
+        case STATEMENT_ACT:
+            emit_act(compiler, ACT(statement));
+            break;
+    }
+
+    // temporaries never outlive their statement
+    set_top(compiler, compiler->locals);
+}
+
+static
+void emit_function(compiler_t *compiler, function_t function, bytecode_function_t *entry)
+{
+    array_t(declaration_t) argument_s = function_argument_s(function);
+    for (size_t i = 0; i < array_size(argument_s); i++)
+        compiler->index_s[declaration_id(argument_s[i])] = i;
+
+    compiler->locals = array_size(argument_s);
+    compiler->registers = 0;
+    // the caller reads the result from the first register
+    set_top(compiler, compiler->locals > 0 ? compiler->locals : 1);
+    set_top(compiler, compiler->locals);
+
+    entry->entry = array_size(compiler->bytecode->code_s);
+    emit_statement(compiler, function_statement(function));
+
+    // a void function falls off its end
+    if (type_kind(function_return_type(function)) == TYPE_VOID)
+        emit_abc(compiler, OP_RET_VOID, 0, 0, 0);
+
+    if (compiler->registers > UINT16_MAX)
+        unsupported(compiler, "a function with more than 65535 registers");
+    entry->registers = compiler->registers;
+}
+
+bytecode_t bytecode_compile(compilation_t compilation)
+{
+    bytecode_t bytecode = mem_alloc(sizeof(struct bytecode_t));
+    bytecode->code_s = array_empty();
+    bytecode->function_s = array_empty();
+
+    uint32_t declarations = compilation_declarations(compilation) + 1;
+    compiler_t compiler = { .bytecode = bytecode, .failed = false };
+    compiler.index_s = mem_alloc(sizeof(uint32_t) * declarations);
+
+    // every function is numbered first, so calls can precede definitions
+    array_t(unit_t) unit_s = compilation_unit_s(compilation);
+    for (size_t i = 0; i < array_size(unit_s); i++)
+    {
+        array_t(declaration_t) declaration_s = unit_declaration_s(unit_s[i]);
+        for (size_t j = 0; j < array_size(declaration_s); j++)
+        {
+            function_t function = FUNCTION(declaration_s[j]);
+            compiler.index_s[declaration_id(declaration_s[j])] = array_size(bytecode->function_s);
+
+            bytecode_function_t entry =
+            {
+                .name = symbol_sz(declaration_symbol(declaration_s[j])),
+                .arguments = array_size(function_argument_s(function)),
+            };
+            bytecode->function_s = array_add(bytecode->function_s, entry);
+        }
+    }
+
+    size_t index = 0;
+    for (size_t i = 0; i < array_size(unit_s); i++)
+    {
+        array_t(declaration_t) declaration_s = unit_declaration_s(unit_s[i]);
+        for (size_t j = 0; j < array_size(declaration_s); j++, index++)
+            emit_function(&compiler, FUNCTION(declaration_s[j]), &bytecode->function_s[index]);
+    }
+
+    mem_free(compiler.index_s);
+
+    if (compiler.failed)
+    {
+        bytecode_free(bytecode);
+        return NULL;
+    }
+
+    return bytecode;
+}
+
+void bytecode_free(bytecode_t bytecode)
+{
+    array_free(bytecode->code_s);
+    array_free(bytecode->function_s);
+    mem_free(bytecode);
+}
+
+const instruction_t* bytecode_code(bytecode_t bytecode)
+{
+    return bytecode->code_s;
+}
+
+size_t bytecode_size(bytecode_t bytecode)
+{
+    return array_size(bytecode->code_s);
+}
+
+const bytecode_function_t* bytecode_function(bytecode_t bytecode, size_t index)
+{
+    return &bytecode->function_s[index];
+}
+
+size_t bytecode_functions(bytecode_t bytecode)
+{
+    return array_size(bytecode->function_s);
+}
+
+int bytecode_find(bytecode_t bytecode, const char *name)
+{
+    for (size_t i = 0; i < array_size(bytecode->function_s); i++)
+        if (strcmp(bytecode->function_s[i].name, name) == 0)
+            return i;
+
+    return -1;
+}
+
+void bytecode_print(bytecode_t bytecode, FILE *file)
+{
+    static const char *const name_s[] =
+    {
+        [OP_CONST] = "const",
+        [OP_MOVE] = "move",
+        [OP_ADD] = "add",
+        [OP_SUB] = "sub",
+        [OP_MUL] = "mul",
+        [OP_DIV] = "div",
+        [OP_REM] = "rem",
+        [OP_TRUNC8] = "trunc8",
+        [OP_TRUNC1] = "trunc1",
+        [OP_LT] = "lt",
+        [OP_LE] = "le",
+        [OP_GT] = "gt",
+        [OP_GE] = "ge",
+        [OP_EQ] = "eq",
+        [OP_NE] = "ne",
+        [OP_JUMP] = "jump",
+        [OP_JUMP_IF_FALSE] = "jump_if_false",
+        [OP_JUMP_IF_TRUE] = "jump_if_true",
+        [OP_ADDRESS] = "address",
+        [OP_LOAD] = "load",
+        [OP_STORE] = "store",
+        [OP_CALL] = "call",
+        [OP_RET] = "ret",
+        [OP_RET_VOID] = "ret_void",
+    };
+
+    for (size_t i = 0; i < array_size(bytecode->function_s); i++)
+    {
+        bytecode_function_t *function = &bytecode->function_s[i];
+        fprintf(file, "%s: %u arguments, %u registers\n", function->name, function->arguments, function->registers);
+
+        size_t end = i + 1 < array_size(bytecode->function_s) ? bytecode->function_s[i + 1].entry : array_size(bytecode->code_s);
+        for (size_t at = function->entry; at < end; at++)
+        {
+            instruction_t *instruction = &bytecode->code_s[at];
+            fprintf(file, "  %4zu  %-14s", at, name_s[instruction->op]);
+
+            switch (instruction->op) // LCOV_EXCL_LINE
+            {
+                case OP_CONST:
+                    fprintf(file, "r%u, %d\n", instruction->a, instruction->imm);
+                    break;
+                case OP_MOVE:
+                case OP_ADDRESS:
+                case OP_LOAD:
+                case OP_STORE:
+                    fprintf(file, "r%u, r%u\n", instruction->a, instruction->b);
+                    break;
+                case OP_TRUNC8:
+                case OP_TRUNC1:
+                case OP_RET:
+                    fprintf(file, "r%u\n", instruction->a);
+                    break;
+                case OP_JUMP:
+                    fprintf(file, "%d\n", instruction->imm);
+                    break;
+                case OP_JUMP_IF_FALSE:
+                case OP_JUMP_IF_TRUE:
+                    fprintf(file, "r%u, %d\n", instruction->a, instruction->imm);
+                    break;
+                case OP_CALL:
+                    fprintf(file, "r%u, %s\n", instruction->a, bytecode->function_s[instruction->imm].name);
+                    break;
+                case OP_RET_VOID:
+                    fprintf(file, "\n");
+                    break;
+                default:
+                    fprintf(file, "r%u, r%u, r%u\n", instruction->a, instruction->b, instruction->c);
+                    break;
+            }
+        }
+    }
+}
@@ -0,0 +1,87 @@
+#ifndef _BYTECODE_H_
+#define _BYTECODE_H_
+
+#include "ast/ast.h"
+
+#include <stdio.h>
+
+// Register based bytecode for the checked AST. Every function has a frame
+// of 64 bit registers: its arguments first, then its locals, then the
+// temporaries of the statement being run. Values are kept normalized to
+// their type (int sign extended from 32 bits, char from 8, bool 0 or 1), so
+// comparisons work on whole registers; a pointer is the address of a
+// register.
+typedef enum opcode_t opcode_t;
+enum opcode_t
+{
+    OP_CONST,           // a = imm
+    OP_MOVE,            // a = b
+    OP_ADD,             // a = b + c, as int
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,             // traps on a zero divisor
+    OP_REM,
+    OP_TRUNC8,          // a = a as char
+    OP_TRUNC1,          // a = a as bool
+    OP_LT,              // a = b < c
+    OP_LE,
+    OP_GT,
+    OP_GE,
+    OP_EQ,
+    OP_NE,
+    OP_JUMP,            // to imm
+    OP_JUMP_IF_FALSE,   // to imm unless a
+    OP_JUMP_IF_TRUE,    // to imm if a
+    OP_ADDRESS,         // a = &b
+    OP_LOAD,            // a = *b
+    OP_STORE,           // *a = b
+    OP_CALL,            // function imm with a frame starting at register a;
+                        // the arguments are there and so is the result
+    OP_RET,             // return a
+    OP_RET_VOID,
+    OPCODES,
+};
+
+typedef struct instruction_t instruction_t;
+struct instruction_t
+{
+    uint8_t     op;
+    uint16_t    a;
+    union
+    {
+        struct
+        {
+            uint16_t    b;
+            uint16_t    c;
+        };
+        int32_t     imm;
+    };
+};
+
+typedef struct bytecode_function_t bytecode_function_t;
+struct bytecode_function_t
+{
+    const char *name;
+    uint32_t    entry;          // index of the first instruction
+    uint16_t    arguments;
+    uint16_t    registers;
+};
+
+typedef  struct bytecode_t*  bytecode_t;
+
+// Compiles every function of the compilation. Returns NULL, with the
+// reason on stderr, for what the bytecode cannot express, e.g. a function
+// needing more than 65535 registers.
+bytecode_t  bytecode_compile(compilation_t compilation);
+void        bytecode_free(bytecode_t bytecode);
+
+const instruction_t*        bytecode_code(bytecode_t bytecode);
+size_t                      bytecode_size(bytecode_t bytecode);
+const bytecode_function_t*  bytecode_function(bytecode_t bytecode, size_t index);
+size_t                      bytecode_functions(bytecode_t bytecode);
+
+// Index of the function with the name, or -1.
+int         bytecode_find(bytecode_t bytecode, const char *name);
+void        bytecode_print(bytecode_t bytecode, FILE *file);
+
+#endif
@@ -0,0 +1,196 @@
+#include "vm/vm.h"
+#include "common/mem.h"
+
+#include <string.h>
+
+typedef struct frame_t frame_t;
+struct frame_t
+{
+    const instruction_t *pc;    // where the caller resumes
+    int64_t             *r;     // the caller's registers
+};
+
+// Threaded dispatch: every handler jumps straight to the handler of the
+// next instruction through the label table, so each opcode gets its own
+// indirect branch for the predictor instead of sharing a switch.
+vm_status_t vm_call(bytecode_t bytecode, size_t function, const int64_t *argument_s, int64_t *result)
+{
+    static void *const label_s[OPCODES] =
+    {
+        [OP_CONST] = &&op_const,
+        [OP_MOVE] = &&op_move,
+        [OP_ADD] = &&op_add,
+        [OP_SUB] = &&op_sub,
+        [OP_MUL] = &&op_mul,
+        [OP_DIV] = &&op_div,
+        [OP_REM] = &&op_rem,
+        [OP_TRUNC8] = &&op_trunc8,
+        [OP_TRUNC1] = &&op_trunc1,
+        [OP_LT] = &&op_lt,
+        [OP_LE] = &&op_le,
+        [OP_GT] = &&op_gt,
+        [OP_GE] = &&op_ge,
+        [OP_EQ] = &&op_eq,
+        [OP_NE] = &&op_ne,
+        [OP_JUMP] = &&op_jump,
+        [OP_JUMP_IF_FALSE] = &&op_jump_if_false,
+        [OP_JUMP_IF_TRUE] = &&op_jump_if_true,
+        [OP_ADDRESS] = &&op_address,
+        [OP_LOAD] = &&op_load,
+        [OP_STORE] = &&op_store,
+        [OP_CALL] = &&op_call,
+        [OP_RET] = &&op_ret,
+        [OP_RET_VOID] = &&op_ret_void,
+    };
+
+    const instruction_t *code = bytecode_code(bytecode);
+    const bytecode_function_t *function_s = bytecode_function(bytecode, 0);
+    const bytecode_function_t *entry = &function_s[function];
+
+    vm_status_t status = VM_OK;
+    int64_t *stack = mem_alloc(sizeof(int64_t) * VM_STACK);
+    frame_t *frame_s = mem_alloc(sizeof(frame_t) * VM_DEPTH);
+    int64_t *end = stack + VM_STACK;
+    size_t depth = 0;
+
+    int64_t *r = stack;
+    memcpy(r, argument_s, sizeof(int64_t) * entry->arguments);
+    const instruction_t *pc = code + entry->entry;
+
+#define DISPATCH() goto *label_s[pc->op]
+#define NEXT()     do { pc++; DISPATCH(); } while (0)
+#define INT(x)     ((int64_t)(int32_t)(uint32_t)(x))
+
+    DISPATCH();
+
+op_const:
+    r[pc->a] = pc->imm;
+    NEXT();
+op_move:
+    r[pc->a] = r[pc->b];
+    NEXT();
+op_add:
+    r[pc->a] = INT((uint64_t)r[pc->b] + (uint64_t)r[pc->c]);
+    NEXT();
+op_sub:
+    r[pc->a] = INT((uint64_t)r[pc->b] - (uint64_t)r[pc->c]);
+    NEXT();
+op_mul:
+    r[pc->a] = INT((uint64_t)r[pc->b] * (uint64_t)r[pc->c]);
+    NEXT();
+op_div:
+    if (r[pc->c] == 0)
+    {
+        status = VM_DIVISION_BY_ZERO;
+        goto leave;
+    }
+    r[pc->a] = INT(r[pc->b] / r[pc->c]);
+    NEXT();
+op_rem:
+    if (r[pc->c] == 0)
+    {
+        status = VM_DIVISION_BY_ZERO;
+        goto leave;
+    }
+    r[pc->a] = INT(r[pc->b] % r[pc->c]);
+    NEXT();
+op_trunc8:
+    r[pc->a] = (int8_t)r[pc->a];
+    NEXT();
+op_trunc1:
+    r[pc->a] &= 1;
+    NEXT();
+op_lt:
+    r[pc->a] = r[pc->b] < r[pc->c];
+    NEXT();
+op_le:
+    r[pc->a] = r[pc->b] <= r[pc->c];
+    NEXT();
+op_gt:
+    r[pc->a] = r[pc->b] > r[pc->c];
+    NEXT();
+op_ge:
+    r[pc->a] = r[pc->b] >= r[pc->c];
+    NEXT();
+op_eq:
+    r[pc->a] = r[pc->b] == r[pc->c];
+    NEXT();
+op_ne:
+    r[pc->a] = r[pc->b] != r[pc->c];
+    NEXT();
+op_jump:
+    pc = code + pc->imm;
+    DISPATCH();
+op_jump_if_false:
+    pc = r[pc->a] ? pc + 1 : code + pc->imm;
+    DISPATCH();
+op_jump_if_true:
+    pc = r[pc->a] ? code + pc->imm : pc + 1;
+    DISPATCH();
+op_address:
+    r[pc->a] = (int64_t)(intptr_t)&r[pc->b];
+    NEXT();
+op_load:
+    r[pc->a] = *(int64_t*)(intptr_t)r[pc->b];
+    NEXT();
+op_store:
+    *(int64_t*)(intptr_t)r[pc->a] = r[pc->b];
+    NEXT();
+op_call:
+    {
+        const bytecode_function_t *callee = &function_s[pc->imm];
+        int64_t *frame = r + pc->a;
+        if (depth == VM_DEPTH || frame + callee->registers > end)
+        {
+            status = VM_STACK_OVERFLOW;
+            goto leave;
+        }
+
+        frame_s[depth].pc = pc + 1;
+        frame_s[depth].r = r;
+        depth++;
+
+        r = frame;
+        pc = code + callee->entry;
+        DISPATCH();
+    }
+op_ret:
+    if (depth == 0)
+    {
+        *result = r[pc->a];
+        goto leave;
+    }
+    r[0] = r[pc->a];
+    // fall through
+op_ret_void:
+    if (depth == 0)
+        goto leave;
+    depth--;
+    pc = frame_s[depth].pc;
+    r = frame_s[depth].r;
+    DISPATCH();
+
+#undef DISPATCH
+#undef NEXT
+#undef INT
+
+leave:
+    mem_free(frame_s);
+    mem_free(stack);
+    return status;
+}
+
+const char* vm_status_string(vm_status_t status)
+{
+    switch (status) // LCOV_EXCL_LINE
+    {
+        case VM_OK:
+            return "ok";
+        case VM_DIVISION_BY_ZERO:
+            return "division by zero";
+        case VM_STACK_OVERFLOW:
+            return "stack overflow";
+    }
+
+    return "unknown"; // LCOV_EXCL_LINE
+}
@@ -0,0 +1,23 @@
+#ifndef _VM_H_
+#define _VM_H_
+
+#include "vm/bytecode.h"
+
+typedef enum vm_status_t vm_status_t;
+enum vm_status_t
+{
+    VM_OK,
+    VM_DIVISION_BY_ZERO,
+    VM_STACK_OVERFLOW,
+};
+
+// Registers of all frames together, and calls in progress, of one vm_call.
+#define VM_STACK  (1 << 20)
+#define VM_DEPTH  (1 << 16)
+
+// Runs the function with its arguments, normalized to their types, and
+// stores its result, unless it is void. Execution stops at the first trap.
+vm_status_t  vm_call(bytecode_t bytecode, size_t function, const int64_t *argument_s, int64_t *result);
+const char*  vm_status_string(vm_status_t status);
+
+#endif
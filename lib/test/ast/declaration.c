@@ -10,15 +10,19 @@
 #include "ast/statement.h"
 #include "common/array.h"
 #include "common/mem.h"
+#include "common/arena.h"
 
 static void test_data(void **arg)
 {
     (void) arg;
 
+    arena_t arena = arena_new();
+    arena_use(arena);
+
     {
         //  u64 one()
         //      return 1;
-        type_t u64_ty = type_int_new();
+        type_t u64_ty = type_int();
         span_t name = span_sz("one");
 
         array_t(declaration_t) argument_s = array_empty();
@@ -44,19 +48,17 @@ static void test_data(void **arg)
 
         array_t(type_t) param_s = callable_param_s(callable);
         assert_int_equal(0, array_size(param_s));
-
-        declaration_free(declaration);
     }
 
     {
         //  u64 num(u64 n)
         //      return n;
-        type_t u64_ty = type_int_new();
+        type_t u64_ty = type_int();
 
         span_t name = span_sz("num");
 
         array_t(declaration_t) argument_s = array_empty();
-        type_t arg0_ty = type_int_new();
+        type_t arg0_ty = type_int();
         declaration_t arg0 = argument_new(arg0_ty, (struct location_t){ .span = span_sz("n") });
         argument_s = array_add(argument_s, arg0);
         assert_int_equal(arg0_ty, declaration_type(arg0));
@@ -85,7 +87,9 @@ static void test_data(void **arg)
         function_t function = FUNCTION(declaration);
         assert_int_equal(u64_ty, function_return_type(function));
         assert_true(span_eq(name, location_span(function_name(function))));
-        assert_int_equal(argument_s, function_argument_s(function));
+        // the constructor moves the arguments into the arena
+        assert_int_equal(1, array_size(function_argument_s(function)));
+        assert_int_equal(arg0, function_argument_s(function)[0]);
 
         assert_int_equal(statement, function_statement(function));
 
@@ -98,12 +102,10 @@ static void test_data(void **arg)
 
         array_t(type_t) param_s = callable_param_s(callable);
         assert_int_equal(1, array_size(param_s));
-
-        declaration_free(declaration);
     }
 
     {
-        type_t int_ty = type_int_new();
+        type_t int_ty = type_int();
         span_t name = span_sz("n");
 
         declaration_t n = variable_new(int_ty, (struct location_t){ .span = name }, NULL);
@@ -112,22 +114,20 @@ static void test_data(void **arg)
         assert_true(type_eq(variable_type(var_n), int_ty));
         assert_true(span_eq(location_span(variable_name(var_n)), name));
         assert_null(variable_initializer(var_n));
-
-        declaration_free(n);
     }
 
     {
-        type_t int_ty = type_int_new();
+        type_t int_ty = type_int();
         span_t name = span_sz("n");
 
         uint64_t two = 2;
         expression_t two_expr = constant_u64_new(two);
 
         declaration_t n = variable_new(int_ty, (struct location_t){ .span = name }, two_expr);
-
-        declaration_free(n);
+        assert_int_equal(two_expr, variable_initializer(VARIABLE(n)));
     }
 
+    arena_free(arena);
 }
 
 int main()
@@ -6,11 +6,15 @@
 
 #include "ast/expression.h"
 #include "common/span.h"
+#include "common/arena.h"
 
 static void test_data(void **arg)
 {
     (void) arg;
 
+    arena_t arena = arena_new();
+    arena_use(arena);
+
     {
         uint64_t one = 1;
         expression_t expression = constant_u64_new(one);
@@ -20,8 +24,6 @@ static void test_data(void **arg)
         assert_non_null(constant);
         assert_int_equal(constant_kind(constant), CONSTANT_U64);
         assert_int_equal(constant_u64(constant), one);
-
-        expression_free(expression);
     }
 
     {
@@ -35,8 +37,6 @@ static void test_data(void **arg)
 
         type_t type_actual = expression_type(expression);
         assert_int_equal(type_char(), type_actual);
-
-        expression_free(expression);
     }
 
     {
@@ -50,8 +50,6 @@ static void test_data(void **arg)
         assert_true(span_eq(name, identifier_name(identifier)));
 
         assert_null(identifier_declaration(identifier));
-
-        expression_free(expression);
     }
 
     {
@@ -70,8 +68,6 @@ static void test_data(void **arg)
         assert_int_equal(n_expr, binary_lhs(binary));
         assert_int_equal(one_expr, binary_rhs(binary));
         assert_int_equal(BINARY_ADD, binary_op(binary));
-
-        expression_free(expression);
     }
 
     {
@@ -91,9 +87,8 @@ static void test_data(void **arg)
         assert_non_null(call);
 
         assert_int_equal(fib_expr, call_callee(call));
-        assert_int_equal(argument_s, call_argument_s(call));
-
-        expression_free(call_expr);
+        assert_int_equal(1, array_size(call_argument_s(call)));
+        assert_int_equal(one_expr, call_argument_s(call)[0]);
     }
 
     {
@@ -111,8 +106,6 @@ static void test_data(void **arg)
 
         assert_int_equal(n_expr, assignment_lvalue(assignment));
         assert_int_equal(one_expr, assignment_rvalue(assignment));
-
-        expression_free(assignment_expr);
     }
 
     {
@@ -135,8 +128,6 @@ static void test_data(void **arg)
         assert_int_equal(n_expr, conditional_lhs(conditional));
         assert_int_equal(one_expr, conditional_rhs(conditional));
         assert_int_equal(CONDITIONAL_AND, conditional_op(conditional));
-
-        expression_free(expression);
     }
 
     {
@@ -151,15 +142,13 @@ static void test_data(void **arg)
         type_t type_actual = expression_type(assignment_expr);
         type_t type_expected = type_int();
         assert_int_equal(type_expected, type_actual);
-
-        expression_free(assignment_expr);
     }
 
     {
         // & on an identifier: address-of yields a pointer to the operand's
         // type. Call expression_type() twice to exercise both the "compute
         // and memoize" and the "return cached" branches.
-        type_t int_ty = type_int_new();
+        type_t int_ty = type_int();
         declaration_t declaration = argument_new(int_ty, (struct location_t){ .span = span_sz("n") });
 
         span_t name = span_sz("n");
@@ -177,13 +166,9 @@ static void test_data(void **arg)
 
         type_t type_first = expression_type(address_of);
         type_t type_second = expression_type(address_of);
-        assert_int_equal(type_first, type_second); // memoized, same pointer both times
+        assert_ptr_equal(type_first, type_second); // interned, same pointer both times
         assert_int_equal(TYPE_POINTER, type_kind(type_first));
         assert_int_equal(TYPE_INT, type_kind(pointer_pointee(POINTER(type_first))));
-
-        expression_free(address_of);
-        declaration_free(declaration);
-        type_free(int_ty); // argument_free() does not release the argument's type
     }
 
     {
@@ -195,13 +180,11 @@ static void test_data(void **arg)
 
         expression_t address_of = unary_new(UNARY_ADDRESS_OF, unresolved);
         assert_null(expression_type(address_of));
-
-        expression_free(address_of);
     }
 
     {
         // * on a pointer: dereference yields the pointee's type.
-        type_t pointer_ty = type_pointer_new(type_int_new());
+        type_t pointer_ty = type_pointer(type_int());
         declaration_t declaration = argument_new(pointer_ty, (struct location_t){ .span = span_sz("p") });
 
         span_t name = span_sz("p");
@@ -214,10 +197,6 @@ static void test_data(void **arg)
 
         type_t type_actual = expression_type(deref);
         assert_int_equal(TYPE_INT, type_kind(type_actual));
-
-        expression_free(deref);
-        declaration_free(declaration);
-        type_free(pointer_ty); // argument_free() does not release the argument's type
     }
 
     {
@@ -232,11 +211,8 @@ static void test_data(void **arg)
         // its lvalue-to-rvalue-cast version)
         uint64_t two = 2;
         expression_t replacement = constant_u64_new(two);
-        expression_free(constant);
         unary_set_expression(UNARY(deref), replacement);
         assert_int_equal(replacement, unary_expression(UNARY(deref)));
-
-        expression_free(deref);
     }
 
     {
@@ -252,13 +228,54 @@ static void test_data(void **arg)
         assert_string_equal(">", binary_kind_string(BINARY_GT));
         assert_string_equal(">=", binary_kind_string(BINARY_GE));
     }
+
+    arena_free(arena);
+}
+
+static void test_type(void **arg)
+{
+    (void) arg;
+
+    arena_t arena = arena_new();
+    arena_use(arena);
+
+    {
+        // derived while unset, stored once set
+        expression_t lhs = constant_u64_new(1);
+        expression_t sum = binary_new(lhs, BINARY_ADD, constant_u64_new(2));
+        assert_ptr_equal(type_int(), expression_type(sum));
+
+        expression_set_type(lhs, type_int());
+        expression_set_type(sum, expression_type(sum));
+        expression_set_type(sum, type_int()); // setting the same type again is fine
+        assert_ptr_equal(type_int(), expression_type(sum));
+    }
+
+    {
+        // typed bottom up, as sema does, a deep left-leaning tree answers
+        // every query without walking down to its leaves
+        expression_t expression = constant_u64_new(0);
+        expression_set_type(expression, expression_type(expression));
+        for (int i = 0; i < 100000; i++)
+        {
+            expression = binary_new(expression, BINARY_SUB, constant_u64_new(i));
+            expression_set_type(expression, expression_type(expression));
+            assert_ptr_equal(type_int(), expression_type(expression));
+        }
+
+        expression_t compare = binary_new(expression, BINARY_LT, constant_u64_new(0));
+        assert_ptr_equal(type_bool(), expression_type(compare));
+    }
+
+    arena_free(arena);
 }
 
 int main()
 {
     const struct CMUnitTest tests[] =
     {
-        cmocka_unit_test(test_data)
+        cmocka_unit_test(test_data),
+        cmocka_unit_test(test_type),
     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
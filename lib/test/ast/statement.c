@@ -5,11 +5,15 @@
 #include <cmocka.h>
 
 #include "ast/statement.h"
+#include "common/arena.h"
 
 static void test_data(void **arg)
 {
     (void) arg;
 
+    arena_t arena = arena_new();
+    arena_use(arena);
+
     {
         uint64_t one = 1;
         expression_t expression = constant_u64_new(one);
@@ -20,8 +24,6 @@ static void test_data(void **arg)
 
         assert_non_null(ret);
         assert_int_equal(return_expression(ret), expression);
-
-        statement_free(statement);
     }
 
     {
@@ -44,8 +46,6 @@ static void test_data(void **arg)
         assert_int_equal(condition, if_condition(ifelse));
         assert_int_equal(then_branch, if_then_branch(ifelse));
         assert_int_equal(else_branch, if_else_branch(ifelse));
-
-        statement_free(statement);
     }
 
 
@@ -74,12 +74,10 @@ static void test_data(void **arg)
         block_t block = BLOCK(else_branch);
         assert_non_null(block);
         assert_int_equal(array_empty(), block_statement_s(block));
-
-        statement_free(statement);
     }
 
     {
-        type_t int_ty = type_int_new();
+        type_t int_ty = type_int();
         span_t name = span_sz("n");
 
         uint64_t two = 2;
@@ -93,9 +91,8 @@ static void test_data(void **arg)
         statement_t var_stmt = var_new(var_s);
         var_t var = VAR(var_stmt);
 
-        assert_int_equal(var_variable_s(var), var_s);
-
-        statement_free(var_stmt);
+        assert_int_equal(1, array_size(var_variable_s(var)));
+        assert_int_equal(n, var_variable_s(var)[0]);
     }
 
     {
@@ -115,10 +112,11 @@ static void test_data(void **arg)
         expression_s = array_add(expression_s, call_expr);
 
         statement_t statement = act_new(expression_s);
-
-        statement_free(statement);
+        assert_int_equal(STATEMENT_ACT, statement_kind(statement));
+        assert_int_equal(call_expr, act_expression_s(ACT(statement))[0]);
     }
 
+    arena_free(arena);
 }
 
 int main()
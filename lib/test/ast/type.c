@@ -18,151 +18,97 @@ static void test_data(void **arg)
     }
 
     {
-        type_t bool_ty = type_bool_new();
-
-        assert_int_equal(type_kind(bool_ty), TYPE_BOOL);
-
-        type_free(bool_ty);
-    }
-
-    {
-        type_t int_ty = type_int_new();
-
-        assert_int_equal(type_kind(int_ty), TYPE_INT);
-
-        type_free(int_ty);
-    }
-
-    {
-        type_t char_ty = type_char_new();
-
-        assert_int_equal(type_kind(char_ty), TYPE_CHAR);
-
-        type_free(char_ty);
-    }
-
-    {
-        type_t void_ty = type_void_new();
-
-        assert_int_equal(type_kind(void_ty), TYPE_VOID);
-
-        type_free(void_ty);
-    }
-
-    {
-        type_t int_ty = type_int_new();
+        type_t int_ty = type_int();
         array_t(type_t) param_s = array_empty();
 
-        type_t type_callable = type_callable_new(int_ty, param_s);
-
-        assert_int_equal(type_kind(type_callable), TYPE_CALLABLE);
+        type_t type_callable_ty = type_callable(int_ty, param_s);
 
-        type_free(type_callable);
+        assert_int_equal(type_kind(type_callable_ty), TYPE_CALLABLE);
+        assert_ptr_equal(int_ty, callable_return_type(CALLABLE(type_callable_ty)));
     }
 
     {
-        type_t int_ty = type_int_new();
-        type_t pointer_ty = type_pointer_new(int_ty);
+        type_t int_ty = type_int();
+        type_t pointer_ty = type_pointer(int_ty);
 
         assert_int_equal(type_kind(pointer_ty), TYPE_POINTER);
-        assert_int_equal(pointer_pointee(POINTER(pointer_ty)), int_ty);
-
-        type_free(pointer_ty);
+        assert_ptr_equal(pointer_pointee(POINTER(pointer_ty)), int_ty);
     }
 
     {
         assert_false(type_eq(type_bool(), type_int()));
         assert_false(type_eq(NULL, type_int()));
         assert_false(type_eq(type_bool(), NULL));
+        assert_false(type_eq(NULL, NULL));
         assert_false(type_eq(type_char(), type_int()));
         assert_true(type_eq(type_char(), type_char()));
     }
+}
 
-    {
-        type_t int_ptr = type_pointer_new(type_int_new());
-        type_t bool_ptr = type_pointer_new(type_bool_new());
-        type_t another_int_ptr = type_pointer_new(type_int_new());
-
-        assert_false(type_eq(int_ptr, bool_ptr));
-        assert_true(type_eq(int_ptr, another_int_ptr));
-
-        type_free(int_ptr);
-        type_free(bool_ptr);
-        type_free(another_int_ptr);
-    }
-
-    {
-        type_t int_ty = type_int_new();
-        type_t cloned = type_clone(int_ty);
-
-        assert_int_equal(type_kind(cloned), TYPE_INT);
-        assert_true(type_eq(int_ty, cloned));
-
-        type_free(int_ty);
-        type_free(cloned);
-    }
-
-    {
-        type_t bool_ty = type_bool_new();
-        type_t cloned = type_clone(bool_ty);
-
-        assert_int_equal(type_kind(cloned), TYPE_BOOL);
-        assert_true(type_eq(bool_ty, cloned));
-
-        type_free(bool_ty);
-        type_free(cloned);
-    }
-
-    {
-        type_t char_ty = type_char_new();
-        type_t cloned = type_clone(char_ty);
-
-        assert_int_equal(type_kind(cloned), TYPE_CHAR);
-        assert_true(type_eq(char_ty, cloned));
-
-        type_free(char_ty);
-        type_free(cloned);
-    }
+static void test_intern(void **arg)
+{
+    (void) arg;
 
     {
-        type_t void_ty = type_void_new();
-        type_t cloned = type_clone(void_ty);
+        type_t int_ptr = type_pointer(type_int());
+        type_t bool_ptr = type_pointer(type_bool());
+        size_t count = type_count();
 
-        assert_int_equal(type_kind(cloned), TYPE_VOID);
-        assert_true(type_eq(void_ty, cloned));
+        assert_ptr_equal(int_ptr, type_pointer(type_int()));
+        assert_ptr_not_equal(int_ptr, bool_ptr);
+        assert_ptr_equal(type_pointer(int_ptr), type_pointer(type_pointer(type_int())));
+        assert_int_equal(count + 1, type_count());
 
-        type_free(void_ty);
-        type_free(cloned);
+        assert_false(type_eq(int_ptr, bool_ptr));
+        assert_false(type_eq(int_ptr, type_pointer(int_ptr)));
     }
 
     {
-        type_t pointer_ty = type_pointer_new(type_int_new());
-        type_t cloned = type_clone(pointer_ty);
-
-        assert_int_equal(type_kind(cloned), TYPE_POINTER);
-        assert_true(type_eq(pointer_ty, cloned));
-        assert_int_not_equal(pointer_pointee(POINTER(pointer_ty)), pointer_pointee(POINTER(cloned)));
-
-        type_free(pointer_ty);
-        type_free(cloned);
+        array_t(type_t) param_s = array_empty();
+        param_s = array_add(param_s, (type_t){ type_int() });
+        param_s = array_add(param_s, (type_t){ type_pointer(type_char()) });
+        type_t callable = type_callable(type_void(), param_s);
+
+        // equal parameter lists are released in favour of the interned one
+        array_t(type_t) same_s = array_empty();
+        same_s = array_add(same_s, (type_t){ type_int() });
+        same_s = array_add(same_s, (type_t){ type_pointer(type_char()) });
+        assert_ptr_equal(callable, type_callable(type_void(), same_s));
+
+        array_t(type_t) interned_s = callable_param_s(CALLABLE(callable));
+        assert_int_equal(2, array_size(interned_s));
+        assert_ptr_equal(type_int(), interned_s[0]);
+        assert_ptr_equal(type_pointer(type_char()), interned_s[1]);
+
+        // same parameters, other return type
+        array_t(type_t) other_s = array_empty();
+        other_s = array_add(other_s, (type_t){ type_int() });
+        other_s = array_add(other_s, (type_t){ type_pointer(type_char()) });
+        assert_ptr_not_equal(callable, type_callable(type_int(), other_s));
+
+        // prefix of the parameters
+        array_t(type_t) prefix_s = array_empty();
+        prefix_s = array_add(prefix_s, (type_t){ type_int() });
+        assert_ptr_not_equal(callable, type_callable(type_void(), prefix_s));
     }
 
     {
-        type_t int_ty = type_int_new();
-        array_t(type_t) param_s = array_empty();
-
-        type_t arg_ty = type_int_new();
-        param_s = array_add(param_s, arg_ty);
-
-        type_t type_callable = type_callable_new(int_ty, param_s);
-
-        type_t cloned = type_clone(type_callable);
-
-        assert_int_equal(type_kind(callable_return_type(CALLABLE(cloned))), TYPE_INT);
-        assert_int_equal(array_size(callable_param_s(CALLABLE(cloned))), 1);
-
-        type_free(type_callable);
-        type_free(cloned);
+        // the table grows past its initial capacity without losing types
+        type_t type = type_int();
+        array_t(type_t) chain_s = array_empty();
+        for (int i = 0; i < 1000; i++)
+        {
+            type = type_pointer(type);
+            chain_s = array_add(chain_s, type);
+        }
+
+        type = type_int();
+        for (int i = 0; i < 1000; i++)
+        {
+            type = type_pointer(type);
+            assert_ptr_equal(chain_s[i], type);
+        }
+        array_free(chain_s);
     }
 }
 
@@ -170,7 +116,8 @@ int main()
 {
     const struct CMUnitTest tests[] =
     {
-        cmocka_unit_test(test_data)
+        cmocka_unit_test(test_data),
+        cmocka_unit_test(test_intern),
     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
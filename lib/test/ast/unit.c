@@ -10,6 +10,7 @@
 #include "ast/statement.h"
 #include "common/array.h"
 #include "common/mem.h"
+#include "common/arena.h"
 
 #define LF "\n"
 
@@ -17,6 +18,9 @@ static void test_data(void **arg)
 {
     (void) arg;
 
+    arena_t arena = arena_new();
+    arena_use(arena);
+
     {
         char *code_a001 =
             "u64 one()"      LF
@@ -30,7 +34,7 @@ static void test_data(void **arg)
         {
             //  u64 one()
             //      return 1;
-            type_t u64_ty = type_int_new();
+            type_t u64_ty = type_int();
 
             span_t name = span_sz("one");
 
@@ -47,12 +51,12 @@ static void test_data(void **arg)
         {
             //  u64 num(u64 n)
             //      return n;
-            type_t int_ty = type_int_new();
+            type_t int_ty = type_int();
 
             span_t name = span_sz("num");
 
             array_t(declaration_t) argument_s = array_empty();
-            type_t arg0_ty = type_int_new();
+            type_t arg0_ty = type_int();
             declaration_t arg0 = argument_new(arg0_ty, (struct location_t){ .span = span_sz("n") });
             argument_s = array_add(argument_s, arg0);
 
@@ -66,7 +70,8 @@ static void test_data(void **arg)
             declaration_s = array_add(declaration_s, num_fn);
         }
 
-        unit_t unit = unit_new(source_inline(code_a001, ""), declaration_s);
+        unit_t unit = unit_new(source_inline(code_a001, ""), declaration_s, arena);
+        assert_int_equal(arena, unit_arena(unit));
 
         array_t(declaration_t) unit_decl_s = unit_declaration_s(unit);
         assert_int_equal(2, array_size(unit_decl_s));
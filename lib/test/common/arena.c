@@ -0,0 +1,147 @@
+#include <stdlib.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include <string.h>
+#include <stdint.h>
+#include <cmocka.h>
+
+#include "common/arena.h"
+#include "common/array.h"
+
+static void test_alloc(void **arg)
+{
+    (void) arg;
+
+    arena_t arena = arena_new();
+    assert_int_equal(0, arena_chunks(arena));
+
+    char *first = arena_alloc(arena, 1);
+    char *second = arena_alloc(arena, 24);
+    assert_int_equal(1, arena_chunks(arena));
+    assert_int_equal(0, (uintptr_t)first % 16);
+    assert_int_equal(0, (uintptr_t)second % 16);
+    assert_ptr_equal(first + 16, second);
+
+    // fills the first chunk until a second one is needed
+    size_t allocations = 0;
+    while (arena_chunks(arena) == 1)
+    {
+        memset(arena_alloc(arena, 1000), 0xab, 1000);
+        allocations++;
+    }
+    assert_true(allocations > 50);
+
+    // an oversized request gets its own chunk and does not waste the
+    // space left in the current one
+    char *large = arena_alloc(arena, 1 << 20);
+    memset(large, 0, 1 << 20);
+    assert_int_equal(3, arena_chunks(arena));
+
+    char *next = arena_alloc(arena, 16);
+    assert_int_equal(3, arena_chunks(arena));
+    assert_true(next < large || next >= large + (1 << 20));
+
+    arena_free(arena);
+}
+
+static void test_current(void **arg)
+{
+    (void) arg;
+
+    assert_null(arena_current());
+
+    arena_t outer = arena_new();
+    arena_t inner = arena_new();
+
+    assert_null(arena_use(outer));
+    assert_ptr_equal(outer, arena_current());
+    assert_non_null(arena_push(8));
+
+    assert_ptr_equal(outer, arena_use(inner));
+    assert_ptr_equal(inner, arena_current());
+    arena_push(8);
+    assert_int_equal(1, arena_chunks(inner));
+
+    // freeing the arena in use leaves no dangling current arena
+    arena_free(inner);
+    assert_null(arena_current());
+
+    arena_use(outer);
+    array_t(int) int_s = array_empty();
+    for (int i = 0; i < 100; i++)
+        int_s = array_add(int_s, i);
+
+    int_s = array_move(int_s, arena_push);
+    assert_int_equal(100, array_size(int_s));
+    assert_int_equal(100, array_capacity(int_s));
+    for (int i = 0; i < 100; i++)
+        assert_int_equal(i, int_s[i]);
+
+    assert_ptr_equal(array_empty(), array_move(array_empty(), arena_push));
+
+    arena_free(outer);
+}
+
+static void test_pool(void **arg)
+{
+    (void) arg;
+
+    arena_t arena = arena_new();
+    arena_t other = arena_new();
+    arena_use(arena);
+
+    // elements of a pool are packed at their own size, kind by kind
+    int *first = pool_push(1, sizeof(int) * 3);
+    int *second = pool_push(1, sizeof(int) * 3);
+    char *byte = pool_push(2, 1);
+    assert_ptr_equal((char *)first + 12, second);
+    assert_int_equal(1, pool_of(first));
+    assert_int_equal(2, pool_of(byte));
+    assert_int_equal(0, arena_chunks(arena));
+
+    assert_int_equal(0, pool_ref(first, NULL));
+    assert_null(pool_deref(first, 0));
+
+    // references survive growing the pool over many chunks
+    array_t(int *) element_s = array_empty();
+    array_t(pool_ref_t) ref_s = array_empty();
+    for (int i = 0; i < 10000; i++)
+    {
+        int *element = pool_push(1, sizeof(int) * 3);
+        element[0] = i;
+        pool_ref_t ref = pool_ref(first, element);
+        assert_int_not_equal(0, ref);
+
+        element_s = array_add(element_s, element);
+        ref_s = array_add(ref_s, ref);
+    }
+
+    for (int i = 0; i < 10000; i++)
+    {
+        int *element = pool_deref(byte, ref_s[i]);
+        assert_ptr_equal(element_s[i], element);
+        assert_int_equal(i, element[0]);
+        assert_int_equal(1, pool_of(element));
+    }
+
+    int *foreign = arena_pool_alloc(other, 1, sizeof(int) * 3);
+    assert_int_equal(1, pool_of(foreign));
+    assert_ptr_equal(foreign, pool_deref(foreign, pool_ref(foreign, foreign)));
+
+    array_free(element_s);
+    array_free(ref_s);
+    arena_free(other);
+    arena_free(arena);
+}
+
+int main()
+{
+    const struct CMUnitTest tests[] =
+    {
+        cmocka_unit_test(test_alloc),
+        cmocka_unit_test(test_current),
+        cmocka_unit_test(test_pool),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -114,6 +114,26 @@ static void test_data(void **arg)
         assert_int_equal(array_shrink(ints), array_empty());
     }
 
+    {
+        array_t(int) ints = array_empty();
+        array_truncate(ints, 0);
+        assert_int_equal(0, array_size(ints));
+
+        for (int i = 0; i < 10; i++)
+            ints = array_add(ints, i);
+
+        size_t capacity = array_capacity(ints);
+        array_truncate(ints, 20);
+        assert_int_equal(10, array_size(ints));
+
+        array_truncate(ints, 3);
+        assert_int_equal(3, array_size(ints));
+        assert_int_equal(capacity, array_capacity(ints));
+        assert_int_equal(2, ints[2]);
+
+        array_free(ints);
+    }
+
     {
         array_t(int*) numbers_ptr = array_empty();
 
@@ -7,8 +7,30 @@
 #include <unistd.h>
 
 #include "common/source.h"
+#include "common/arena.h"
+#include "common/mem.h"
 #include "common/span.h"
 
+// Writes size bytes of 'x' to a fresh temporary file; the caller unlinks it.
+static char* temporary_file(char *path, size_t size)
+{
+    int fd = mkstemp(path);
+    assert_true(fd != -1);
+
+    char chunk[512];
+    memset(chunk, 'x', sizeof(chunk));
+    for (size_t written = 0; written < size; )
+    {
+        size_t left = size - written;
+        size_t count = left < sizeof(chunk) ? left : sizeof(chunk);
+        assert_int_equal(count, write(fd, chunk, count));
+        written += count;
+    }
+
+    close(fd);
+    return path;
+}
+
 static void test_data(void **arg)
 {
     (void) arg;
@@ -53,10 +75,87 @@ static void test_data(void **arg)
         source_free(source);
     }
 
+    {
+        // A file ending exactly on a page boundary has no zero-filled tail
+        // in its own mapping: the sentinel must come from the reserved page.
+        size_t page = sysconf(_SC_PAGESIZE);
+        char path[] = "/tmp/iz_source_XXXXXX";
+        temporary_file(path, page);
+
+        source_t source = source_load(path);
+        assert_non_null(source);
+        assert_int_equal(page, source_size(source));
+        assert_int_equal('x', source_code(source)[page - 1]);
+        assert_int_equal('\0', source_code(source)[page]);
+        source_free(source);
+
+        source = source_open(path, SOURCE_MODE_READ);
+        assert_non_null(source);
+        assert_int_equal(page, source_size(source));
+        assert_int_equal('x', source_code(source)[page - 1]);
+        assert_int_equal('\0', source_code(source)[page]);
+        source_free(source);
+
+        unlink(path);
+    }
+
+    {
+        char path[] = "/tmp/iz_source_XXXXXX";
+        temporary_file(path, 0);
+
+        source_t source = source_load(path);
+        assert_non_null(source);
+        assert_int_equal(0, source_size(source));
+        assert_int_equal('\0', source_code(source)[0]);
+        source_free(source);
+
+        unlink(path);
+    }
+
+    {
+        // Larger than one read chunk: the read fallback must not stop at
+        // the first (possibly short) read.
+        size_t size = 200000;
+        char path[] = "/tmp/iz_source_XXXXXX";
+        temporary_file(path, size);
+
+        source_t source = source_open(path, SOURCE_MODE_READ);
+        assert_non_null(source);
+        assert_int_equal(size, source_size(source));
+        assert_int_equal('\0', source_code(source)[size]);
+        source_free(source);
+
+        unlink(path);
+    }
+
+    {
+        // Token offsets are 32 bits; a sparse file is enough to be refused.
+        char path[] = "/tmp/iz_source_XXXXXX";
+        temporary_file(path, 0);
+        assert_int_equal(0, truncate(path, (off_t)SOURCE_SIZE_MAX));
+
+        assert_null(source_load(path));
+        assert_null(source_open(path, SOURCE_MODE_READ));
+
+        unlink(path);
+    }
+
+    {
+        // Not a regular file: falls back to reading even in map mode.
+        source_t source = source_load("/dev/null");
+        assert_non_null(source);
+        assert_int_equal(0, source_size(source));
+        assert_int_equal('\0', source_code(source)[0]);
+        source_free(source);
+    }
+
     {
         source_t source = source_inline("int n;", "location.iz");
         span_t span = span_sz("n");
 
+        arena_t arena = arena_new();
+        arena_use(arena);
+
         location_t location = location_new(source, span, 1, 5);
 
         assert_int_equal(source, location_source(location));
@@ -64,9 +163,25 @@ static void test_data(void **arg)
         assert_int_equal(1, location_line(location));
         assert_int_equal(5, location_column(location));
 
-        location_free(location);
+        arena_free(arena);
     }
 
+    {
+        const char *path_s[][3] =
+        {
+            { "main.iz",        ".o",  "main.o" },
+            { "docs/v0.0.1.iz", ".ll", "docs/v0.0.1.ll" },
+            { "dir.d/main",     ".s",  "dir.d/main.s" },
+            { "main",           ".bc", "main.bc" },
+        };
+
+        for (size_t i = 0; i < sizeof(path_s) / sizeof(path_s[0]); i++)
+        {
+            char *name = source_output_name(source_inline("", path_s[i][0]), path_s[i][1]);
+            assert_string_equal(path_s[i][2], name);
+            mem_free(name);
+        }
+    }
 }
 
 int main()
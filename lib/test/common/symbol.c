@@ -0,0 +1,152 @@
+#include <stdlib.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include <string.h>
+#include <stdio.h>
+#include <cmocka.h>
+
+#include "common/symbol.h"
+#include "common/thread_pool.h"
+
+static void test_intern(void **arg)
+{
+    (void) arg;
+
+    assert_int_equal(0, symbol_count());
+    assert_int_equal(SYMBOL_NONE, symbol_find(span_sz("main")));
+
+    // names come from different buffers, and a span of a longer buffer
+    char buffer[] = "main_loop";
+    symbol_t main = symbol_intern(span_sz("main"));
+    assert_int_not_equal(SYMBOL_NONE, main);
+    assert_int_equal(main, symbol_intern(span_ctor(4, buffer)));
+    assert_int_equal(main, symbol_find(span_sz("main")));
+    assert_int_equal(1, symbol_count());
+
+    symbol_t loop = symbol_intern(span_sz(buffer));
+    assert_int_not_equal(main, loop);
+    assert_int_equal(main + 1, loop);
+
+    assert_true(span_eq(span_sz("main"), symbol_name(main)));
+    assert_string_equal("main", symbol_sz(main));
+    assert_string_equal("main_loop", symbol_sz(loop));
+    assert_int_not_equal(symbol_hash(main), symbol_hash(loop));
+
+    // the empty name is a valid symbol too
+    symbol_t empty = symbol_intern(span_sz(""));
+    assert_int_not_equal(SYMBOL_NONE, empty);
+    assert_int_equal(0, symbol_name(empty).size);
+}
+
+static void test_growth(void **arg)
+{
+    (void) arg;
+
+    // enough names to rehash the table and span several string chunks
+    enum { count = 20000 };
+    static symbol_t symbol_s[count];
+    char name[32];
+
+    size_t before = symbol_count();
+    for (int i = 0; i < count; i++)
+    {
+        snprintf(name, sizeof(name), "identifier_%d_xxxxxxxx", i);
+        symbol_s[i] = symbol_intern(span_sz(name));
+    }
+    assert_int_equal(before + count, symbol_count());
+
+    for (int i = 0; i < count; i++)
+    {
+        snprintf(name, sizeof(name), "identifier_%d_xxxxxxxx", i);
+        assert_int_equal(symbol_s[i], symbol_find(span_sz(name)));
+        assert_string_equal(name, symbol_sz(symbol_s[i]));
+    }
+
+    // a name longer than a chunk
+    size_t size = 100000;
+    char *long_name = malloc(size + 1);
+    memset(long_name, 'x', size);
+    long_name[size] = '\0';
+
+    symbol_t symbol = symbol_intern(span_sz(long_name));
+    assert_int_equal(size, symbol_name(symbol).size);
+    assert_int_equal(symbol, symbol_intern(span_sz(long_name)));
+    free(long_name);
+}
+
+static void intern_shared(void *context, size_t index)
+{
+    symbol_t *symbol_s = context;
+    char name[32];
+    snprintf(name, sizeof(name), "shared_%zu", index % 500);
+    symbol_s[index] = symbol_intern(span_sz(name));
+}
+
+static void test_threads(void **arg)
+{
+    (void) arg;
+
+    // threads racing to intern the same names must agree on their ids
+    enum { count = 8000 };
+    static symbol_t symbol_s[count];
+
+    thread_pool_t pool = thread_pool_new(4);
+    size_t before = symbol_count();
+    thread_pool_run(pool, count, intern_shared, symbol_s);
+    thread_pool_free(pool);
+
+    assert_int_equal(before + 500, symbol_count());
+    char name[32];
+    for (size_t i = 0; i < count; i++)
+    {
+        assert_int_equal(symbol_s[i % 500], symbol_s[i]);
+        snprintf(name, sizeof(name), "shared_%zu", i % 500);
+        assert_string_equal(name, symbol_sz(symbol_s[i]));
+    }
+}
+
+static void test_table(void **arg)
+{
+    (void) arg;
+
+    symbol_table_t table = symbol_table_new();
+    size_t before = symbol_count();
+
+    // local ids are dense from 1 and leave the interner alone
+    char buffer[] = "table_a table_b";
+    assert_int_equal(1, symbol_table_intern(table, span_ctor(7, buffer)));
+    assert_int_equal(2, symbol_table_intern(table, span_ctor(7, buffer + 8)));
+    assert_int_equal(1, symbol_table_intern(table, span_sz("table_a")));
+    assert_int_equal(before, symbol_count());
+
+    // enough names to grow the table
+    enum { count = 3000 };
+    static char name_s[count][16];
+    for (int i = 0; i < count; i++)
+    {
+        snprintf(name_s[i], sizeof(name_s[i]), "table_%d", i);
+        assert_int_equal(i + 3, symbol_table_intern(table, span_sz(name_s[i])));
+    }
+
+    const symbol_t *symbol_s = symbol_table_merge(table);
+    assert_int_equal(SYMBOL_NONE, symbol_s[0]);
+    assert_int_equal(symbol_intern(span_sz("table_a")), symbol_s[1]);
+    assert_string_equal("table_b", symbol_sz(symbol_s[2]));
+    for (int i = 0; i < count; i++)
+        assert_true(span_eq(span_sz(name_s[i]), symbol_name(symbol_s[i + 3])));
+    assert_int_equal(before + count + 2, symbol_count());
+    symbol_table_free(table);
+}
+
+int main()
+{
+    const struct CMUnitTest tests[] =
+    {
+        cmocka_unit_test(test_intern),
+        cmocka_unit_test(test_growth),
+        cmocka_unit_test(test_threads),
+        cmocka_unit_test(test_table),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
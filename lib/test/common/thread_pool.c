@@ -0,0 +1,82 @@
+#include <stdlib.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include <stdatomic.h>
+
+#include "common/mem.h"
+#include "common/thread_pool.h"
+
+typedef struct square_t square_t;
+struct square_t
+{
+    size_t        *result_s;
+    atomic_size_t  calls;
+};
+
+static void square(void *context, size_t index)
+{
+    square_t *square = context;
+    square->result_s[index] = index * index;
+    atomic_fetch_add(&square->calls, 1);
+}
+
+// allocates from worker threads, which must not corrupt the test allocator
+static void allocate(void *context, size_t index)
+{
+    void **block_s = context;
+    block_s[index] = mem_alloc(index + 1);
+    memset(block_s[index], 0, index + 1);
+}
+
+static void test_run(void **arg)
+{
+    (void) arg;
+
+    size_t threads_s[] = { 1, 2, 4, 0 };
+    for (size_t t = 0; t < sizeof(threads_s) / sizeof(threads_s[0]); t++)
+    {
+        thread_pool_t pool = thread_pool_new(threads_s[t]);
+        if (threads_s[t] != 0)
+            assert_int_equal(threads_s[t], thread_pool_threads(pool));
+        else
+            assert_true(thread_pool_threads(pool) >= 1);
+
+        // the pool is reused across runs of different sizes
+        size_t count_s[] = { 0, 1, 3, 1000 };
+        for (size_t c = 0; c < sizeof(count_s) / sizeof(count_s[0]); c++)
+        {
+            size_t count = count_s[c];
+            size_t result_s[count + 1];
+            memset(result_s, 0xff, sizeof(result_s));
+
+            square_t context = { .result_s = result_s };
+            atomic_init(&context.calls, 0);
+            thread_pool_run(pool, count, square, &context);
+
+            assert_int_equal(count, atomic_load(&context.calls));
+            for (size_t i = 0; i < count; i++)
+                assert_int_equal(i * i, result_s[i]);
+            assert_int_equal(SIZE_MAX, result_s[count]);
+        }
+
+        void *block_s[256];
+        thread_pool_run(pool, 256, allocate, block_s);
+        for (size_t i = 0; i < 256; i++)
+            mem_free(block_s[i]);
+
+        thread_pool_free(pool);
+    }
+}
+
+int main()
+{
+    const struct CMUnitTest tests[] =
+    {
+        cmocka_unit_test(test_run)
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,365 @@
+#include <stdlib.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include "parser/parser.h"
+#include "sema/sema.h"
+#include "ir/ir.h"
+
+#define LF "\n"
+
+static compilation_t compile(const char *code)
+{
+    unit_t unit = syntax_analysis(source_inline(code, "unit.iz"));
+    assert_non_null(unit);
+
+    compilation_t compilation = semantic_analysis(array_add(array_empty(), unit));
+    assert_non_null(compilation);
+
+    return compilation;
+}
+
+static function_t function_at(compilation_t compilation, size_t index)
+{
+    unit_t unit = compilation_unit_s(compilation)[0];
+    return FUNCTION(unit_declaration_s(unit)[index]);
+}
+
+// Every block ends in its only terminator, phis come first with one
+// operand per predecessor, and the predecessors are the edges.
+static void verify(ir_t ir)
+{
+    size_t blocks = array_size(ir->block_s);
+    size_t edge_s[blocks + 1];
+    memset(edge_s, 0, sizeof(edge_s));
+
+    for (size_t i = 0; i < blocks; i++)
+    {
+        array_t(uint32_t) instruction_s = ir->block_s[i].instruction_s;
+        assert_true(array_size(instruction_s) > 0);
+
+        bool phis = true;
+        for (size_t j = 0; j < array_size(instruction_s); j++)
+        {
+            ir_instruction_t *instruction = &ir->instruction_s[instruction_s[j]];
+            assert_int_equal(i, instruction->block);
+
+            bool is_terminator = instruction->op == IR_JUMP || instruction->op == IR_BRANCH || instruction->op == IR_RETURN;
+            assert_int_equal(j + 1 == array_size(instruction_s), is_terminator);
+
+            if (instruction->op == IR_PHI)
+            {
+                assert_true(phis);
+                assert_int_equal(array_size(ir->block_s[i].pred_s), instruction->operands);
+            }
+            else if (instruction->op != IR_NOP)
+                phis = false;
+        }
+
+        ir_instruction_t *terminator = ir_terminator(ir, i);
+        for (uint32_t j = 0; j < ir_successors(terminator); j++)
+            edge_s[terminator->target_s[j]]++;
+    }
+
+    for (size_t i = 0; i < blocks; i++)
+        assert_int_equal(array_size(ir->block_s[i].pred_s), edge_s[i]);
+}
+
+static size_t count(ir_t ir, ir_op_t op)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < array_size(ir->block_s); i++)
+    {
+        array_t(uint32_t) instruction_s = ir->block_s[i].instruction_s;
+        for (size_t j = 0; j < array_size(instruction_s); j++)
+            count += ir->instruction_s[instruction_s[j]].op == op;
+    }
+    return count;
+}
+
+static void samples(void **arg)
+{
+    (void) arg;
+
+    const char *path_s[] =
+    {
+        "../docs/samples/v0.0.1.iz",
+        "../docs/samples/v0.0.2.iz",
+        "../docs/samples/v0.0.3.iz",
+        "../docs/samples/v0.0.4.iz",
+        "../docs/samples/v0.0.5.iz",
+        "../docs/samples/v0.0.6.iz",
+    };
+
+    for (size_t i = 0; i < sizeof(path_s) / sizeof(path_s[0]); i++)
+    {
+        unit_t unit = syntax_analysis(source_load(path_s[i]));
+        compilation_t compilation = semantic_analysis(array_add(array_empty(), unit));
+        assert_non_null(compilation);
+
+        array_t(declaration_t) declaration_s = unit_declaration_s(unit);
+        for (size_t j = 0; j < array_size(declaration_s); j++)
+        {
+            ir_t ir = ir_build(FUNCTION(declaration_s[j]));
+            verify(ir);
+            ir_print(ir, stdout);
+            ir_free(ir);
+        }
+
+        compilation_free(compilation);
+    }
+}
+
+static void ssa(void **arg)
+{
+    (void) arg;
+
+    compilation_t compilation = compile(
+        "int pick(bool c, int a)" LF
+        "{" LF
+        "    int x = a;" LF
+        "    int y;" LF
+        "    if (c)" LF
+        "        x = x + 1;" LF
+        "    else" LF
+        "        y = 2;" LF
+        "    return x + y;" LF
+        "}" LF);
+
+    ir_t ir = ir_build(function_at(compilation, 0));
+    verify(ir);
+
+    // locals are values: x and y both differ at the join
+    assert_int_equal(0, count(ir, IR_SLOT));
+    assert_int_equal(0, count(ir, IR_LOAD));
+    assert_int_equal(0, count(ir, IR_STORE));
+    assert_int_equal(2, count(ir, IR_PHI));
+    assert_int_equal(2, count(ir, IR_ARGUMENT));
+
+    assert_int_equal(4, array_size(ir->block_s));
+    assert_int_equal(IR_ENTRY, ir->block_s[0].label);
+    assert_string_equal("if.then", ir_label_string(ir->block_s[1].label));
+    assert_string_equal("if.else", ir_label_string(ir->block_s[2].label));
+    assert_string_equal("if.join", ir_label_string(ir->block_s[3].label));
+    assert_int_equal(2, array_size(ir->block_s[3].pred_s));
+
+    ir_free(ir);
+    compilation_free(compilation);
+}
+
+static void slots(void **arg)
+{
+    (void) arg;
+
+    compilation_t compilation = compile(
+        "void set(int* p, int v)" LF
+        "    *p = v;" LF
+        "int main(int a)" LF
+        "{" LF
+        "    int b = 1;" LF
+        "    set(&a, 2);" LF
+        "    set(&b, a);" LF
+        "    return a + b;" LF
+        "}" LF);
+
+    ir_t set = ir_build(function_at(compilation, 0));
+    verify(set);
+    assert_int_equal(0, count(set, IR_SLOT));
+    assert_int_equal(1, count(set, IR_STORE));
+    assert_int_equal(1, count(set, IR_RETURN));
+    ir_free(set);
+
+    // a and b have their address taken, so they live in memory
+    ir_t main = ir_build(function_at(compilation, 1));
+    verify(main);
+    assert_int_equal(2, count(main, IR_SLOT));
+    assert_int_equal(2, count(main, IR_STORE));
+    assert_int_equal(3, count(main, IR_LOAD));
+    assert_int_equal(2, count(main, IR_CALL));
+    assert_int_equal(1, array_size(main->block_s));
+    ir_free(main);
+
+    compilation_free(compilation);
+}
+
+static void functions(void **arg)
+{
+    (void) arg;
+
+    compilation_t compilation = compile(
+        "int f()" LF
+        "    return 1;" LF
+        "bool g()" LF
+        "    return f == f;" LF
+        "void h()" LF
+        "    f = f;" LF);
+
+    // a function read or assigned as a value goes through its address
+    ir_t g = ir_build(function_at(compilation, 1));
+    verify(g);
+    assert_int_equal(2, count(g, IR_FUNCTION));
+    assert_int_equal(2, count(g, IR_LOAD));
+    assert_int_equal(0, count(g, IR_SLOT));
+    ir_free(g);
+
+    ir_t h = ir_build(function_at(compilation, 2));
+    verify(h);
+    assert_int_equal(2, count(h, IR_FUNCTION));
+    assert_int_equal(1, count(h, IR_LOAD));
+    assert_int_equal(1, count(h, IR_STORE));
+    ir_free(h);
+
+    compilation_free(compilation);
+}
+
+static void conditionals(void **arg)
+{
+    (void) arg;
+
+    compilation_t compilation = compile(
+        "bool check(int n)" LF
+        "    return n > 10;" LF
+        "bool both(int n)" LF
+        "    return n > 0 && check(n);" LF
+        "bool cheap(bool a, int n)" LF
+        "    return a && n != 3 || n < 2;" LF
+        "int assign(int x)" LF
+        "{" LF
+        "    bool b = x > 0 || check(x = 5);" LF
+        "    return x;" LF
+        "}" LF);
+
+    ir_t both = ir_build(function_at(compilation, 1));
+    verify(both);
+    assert_int_equal(3, array_size(both->block_s));
+    assert_string_equal("cond.rhs", ir_label_string(both->block_s[1].label));
+    assert_string_equal("cond.merge", ir_label_string(both->block_s[2].label));
+    assert_int_equal(1, count(both, IR_PHI));
+    assert_int_equal(1, count(both, IR_BRANCH));
+    ir_free(both);
+
+    ir_t cheap = ir_build(function_at(compilation, 2));
+    verify(cheap);
+    assert_int_equal(1, array_size(cheap->block_s));
+    assert_int_equal(1, count(cheap, IR_AND));
+    assert_int_equal(1, count(cheap, IR_OR));
+    ir_free(cheap);
+
+    // x is assigned on the rhs only, so it is a phi in the merge
+    ir_t assign = ir_build(function_at(compilation, 3));
+    verify(assign);
+    assert_int_equal(2, count(assign, IR_PHI));
+    ir_free(assign);
+
+    compilation_free(compilation);
+}
+
+static void returns(void **arg)
+{
+    (void) arg;
+
+    compilation_t compilation = compile(
+        "int early(int a)" LF
+        "{" LF
+        "    if (a > 3)" LF
+        "        return 1;" LF
+        "    a = a + 1;" LF
+        "    return a;" LF
+        "}" LF
+        "int both(bool c)" LF
+        "{" LF
+        "    if (c)" LF
+        "        return 1;" LF
+        "    else" LF
+        "        return 2;" LF
+        "}" LF
+        "void nothing()" LF
+        "{" LF
+        "}" LF);
+
+    ir_t early = ir_build(function_at(compilation, 0));
+    verify(early);
+    assert_int_equal(3, array_size(early->block_s));
+    assert_int_equal(0, count(early, IR_PHI));
+    assert_int_equal(2, count(early, IR_RETURN));
+    ir_free(early);
+
+    // no join when both sides return
+    ir_t both = ir_build(function_at(compilation, 1));
+    verify(both);
+    assert_int_equal(3, array_size(both->block_s));
+    assert_int_equal(2, count(both, IR_RETURN));
+    ir_free(both);
+
+    ir_t nothing = ir_build(function_at(compilation, 2));
+    verify(nothing);
+    assert_int_equal(1, count(nothing, IR_RETURN));
+    assert_int_equal(0, ir_terminator(nothing, 0)->operands);
+    ir_free(nothing);
+
+    compilation_free(compilation);
+}
+
+static void order(void **arg)
+{
+    (void) arg;
+
+    compilation_t compilation = compile(
+        "int f(bool c, bool d)" LF
+        "{" LF
+        "    int x = 1;" LF
+        "    if (c)" LF
+        "    {" LF
+        "        if (d)" LF
+        "            x = 2;" LF
+        "    }" LF
+        "    else" LF
+        "        x = 3;" LF
+        "    return x;" LF
+        "}" LF);
+
+    ir_t ir = ir_build(function_at(compilation, 0));
+    verify(ir);
+
+    size_t blocks = array_size(ir->block_s);
+    uint32_t order[blocks];
+    assert_int_equal(blocks, ir_order(ir, order));
+    assert_int_equal(0, order[0]);
+
+    // every block comes after its predecessors
+    uint32_t position_s[blocks];
+    for (size_t i = 0; i < blocks; i++)
+        position_s[order[i]] = i;
+    for (size_t i = 0; i < blocks; i++)
+        for (size_t j = 0; j < array_size(ir->block_s[i].pred_s); j++)
+            assert_true(position_s[ir->block_s[i].pred_s[j]] < position_s[i]);
+
+    ir_compact(ir);
+    verify(ir);
+    assert_int_equal(blocks, array_size(ir->block_s));
+    for (size_t i = 0; i < blocks; i++)
+        for (size_t j = 0; j < array_size(ir->block_s[i].pred_s); j++)
+            assert_true(ir->block_s[i].pred_s[j] < i);
+
+    ir_print(ir, stdout);
+    ir_free(ir);
+    compilation_free(compilation);
+}
+
+int main()
+{
+    const struct CMUnitTest tests[] =
+    {
+        cmocka_unit_test(samples),
+        cmocka_unit_test(ssa),
+        cmocka_unit_test(slots),
+        cmocka_unit_test(functions),
+        cmocka_unit_test(conditionals),
+        cmocka_unit_test(returns),
+        cmocka_unit_test(order),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,310 @@
+#include <stdlib.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include "parser/parser.h"
+#include "sema/sema.h"
+#include "ir/pass.h"
+
+#define LF "\n"
+
+static compilation_t compile(const char *code)
+{
+    unit_t unit = syntax_analysis(source_inline(code, "unit.iz"));
+    assert_non_null(unit);
+
+    compilation_t compilation = semantic_analysis(array_add(array_empty(), unit));
+    assert_non_null(compilation);
+
+    return compilation;
+}
+
+// The optimized IR of the function at index.
+static ir_t optimize(compilation_t compilation, size_t index)
+{
+    unit_t unit = compilation_unit_s(compilation)[0];
+    ir_t ir = ir_build(FUNCTION(unit_declaration_s(unit)[index]));
+    ir_optimize(ir);
+    ir_print(ir, stdout);
+    return ir;
+}
+
+static size_t count(ir_t ir, ir_op_t op)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < array_size(ir->block_s); i++)
+    {
+        array_t(uint32_t) instruction_s = ir->block_s[i].instruction_s;
+        for (size_t j = 0; j < array_size(instruction_s); j++)
+            count += ir->instruction_s[instruction_s[j]].op == op;
+    }
+    return count;
+}
+
+// The instruction a single block function returns.
+static ir_instruction_t* returned(ir_t ir)
+{
+    assert_int_equal(1, array_size(ir->block_s));
+    ir_instruction_t *terminator = ir_terminator(ir, 0);
+    assert_int_equal(IR_RETURN, terminator->op);
+    return &ir->instruction_s[ir_operand(ir, terminator, 0)];
+}
+
+static void constants(void **arg)
+{
+    (void) arg;
+
+    compilation_t compilation = compile(
+        "int chain()" LF
+        "{" LF
+        "    int x = 2;" LF
+        "    int y = x * 3 + 1;" LF
+        "    return y - x;" LF
+        "}" LF
+        "bool signed_bool()" LF
+        "{" LF
+        "    bool t = true;" LF
+        "    return t < false;" LF
+        "}" LF
+        "int wrap()" LF
+        "{" LF
+        "    int x = 2147483647;" LF
+        "    return x + 1;" LF
+        "}" LF
+        "char wrap_char()" LF
+        "{" LF
+        "    char c = 'a';" LF
+        "    return c * c;" LF
+        "}" LF
+        "int trap()" LF
+        "{" LF
+        "    int x = 1;" LF
+        "    return x / 0;" LF
+        "}" LF
+        "int remainder()" LF
+        "{" LF
+        "    int x = 7;" LF
+        "    return x % 3 - x / 2;" LF
+        "}" LF
+        "bool logic(bool a)" LF
+        "{" LF
+        "    bool t = true;" LF
+        "    bool f = false;" LF
+        "    return a && t || f;" LF
+        "}" LF
+        "bool decided(bool a)" LF
+        "    return a && false;" LF);
+
+    ir_t chain = optimize(compilation, 0);
+    ir_instruction_t *value = returned(chain);
+    assert_int_equal(IR_CONST, value->op);
+    assert_int_equal(5, value->imm);
+    ir_free(chain);
+
+    // true is -1 as a signed i1
+    ir_t signed_bool = optimize(compilation, 1);
+    assert_int_equal(1, returned(signed_bool)->imm);
+    ir_free(signed_bool);
+
+    ir_t wrap = optimize(compilation, 2);
+    assert_int_equal(INT32_MIN, returned(wrap)->imm);
+    ir_free(wrap);
+
+    ir_t wrap_char = optimize(compilation, 3);
+    assert_int_equal((int8_t)('a' * 'a'), returned(wrap_char)->imm);
+    ir_free(wrap_char);
+
+    // left to trap at run time
+    ir_t trap = optimize(compilation, 4);
+    assert_int_equal(IR_BINARY, returned(trap)->op);
+    ir_free(trap);
+
+    ir_t remainder = optimize(compilation, 5);
+    assert_int_equal(-2, returned(remainder)->imm);
+    ir_free(remainder);
+
+    ir_t logic = optimize(compilation, 6);
+    assert_int_equal(IR_ARGUMENT, returned(logic)->op);
+    ir_free(logic);
+
+    ir_t decided = optimize(compilation, 7);
+    assert_int_equal(IR_CONST, returned(decided)->op);
+    assert_int_equal(0, returned(decided)->imm);
+    ir_free(decided);
+
+    compilation_free(compilation);
+}
+
+static void copies(void **arg)
+{
+    (void) arg;
+
+    compilation_t compilation = compile(
+        "int forward(int a)" LF
+        "{" LF
+        "    int b = a;" LF
+        "    int c = b + 0;" LF
+        "    return c * 1;" LF
+        "}" LF
+        "int same(bool c, int a)" LF
+        "{" LF
+        "    int x = a;" LF
+        "    if (c)" LF
+        "        x = a;" LF
+        "    return x;" LF
+        "}" LF);
+
+    ir_t forward = optimize(compilation, 0);
+    assert_int_equal(IR_ARGUMENT, returned(forward)->op);
+    assert_int_equal(0, count(forward, IR_COPY));
+    ir_free(forward);
+
+    // both paths bring a, so the if is gone with the phi
+    ir_t same = optimize(compilation, 1);
+    assert_int_equal(IR_ARGUMENT, returned(same)->op);
+    assert_int_equal(1, returned(same)->imm);
+    ir_free(same);
+
+    compilation_free(compilation);
+}
+
+static void dead_code(void **arg)
+{
+    (void) arg;
+
+    compilation_t compilation = compile(
+        "int touch(int* p)" LF
+        "    return *p;" LF
+        "int unused(int a)" LF
+        "{" LF
+        "    int b = a * 2;" LF
+        "    b == 3 || a < 2;" LF
+        "    touch(&a);" LF
+        "    return a;" LF
+        "}" LF);
+
+    // the call and the stores stay, the arithmetic goes
+    ir_t unused = optimize(compilation, 1);
+    assert_int_equal(0, count(unused, IR_BINARY));
+    assert_int_equal(0, count(unused, IR_OR));
+    assert_int_equal(1, count(unused, IR_CALL));
+    assert_int_equal(1, count(unused, IR_SLOT));
+    assert_int_equal(1, count(unused, IR_STORE));
+    assert_int_equal(IR_LOAD, returned(unused)->op);
+    ir_free(unused);
+
+    compilation_free(compilation);
+}
+
+static void cfg(void **arg)
+{
+    (void) arg;
+
+    compilation_t compilation = compile(
+        "int check(int n)" LF
+        "    return n;" LF
+        "int folded(int a)" LF
+        "{" LF
+        "    int one = 1;" LF
+        "    if (one < 2)" LF
+        "        return a;" LF
+        "    return check(a);" LF
+        "}" LF
+        "int joined(bool c, int a)" LF
+        "{" LF
+        "    int x = 1;" LF
+        "    if (c)" LF
+        "        x = a;" LF
+        "    else" LF
+        "    {" LF
+        "    }" LF
+        "    return x;" LF
+        "}" LF
+        "int empty(bool c, int a)" LF
+        "{" LF
+        "    if (c)" LF
+        "    {" LF
+        "    }" LF
+        "    return a;" LF
+        "}" LF
+        "bool rhs(int n)" LF
+        "    return n > 0 && check(n) > 1;" LF);
+
+    // the branch is decided, the other side is unreachable
+    ir_t folded = optimize(compilation, 1);
+    assert_int_equal(IR_ARGUMENT, returned(folded)->op);
+    assert_int_equal(0, count(folded, IR_CALL));
+    ir_free(folded);
+
+    // the empty else only jumps, but the join needs its edge for the phi
+    ir_t joined = optimize(compilation, 2);
+    assert_int_equal(1, count(joined, IR_PHI));
+    assert_int_equal(4, array_size(joined->block_s));
+    ir_free(joined);
+
+    // an if with nothing in it is a branch to the same place
+    ir_t empty = optimize(compilation, 3);
+    assert_int_equal(IR_ARGUMENT, returned(empty)->op);
+    assert_int_equal(0, count(empty, IR_BRANCH));
+    ir_free(empty);
+
+    ir_t rhs = optimize(compilation, 4);
+    assert_int_equal(3, array_size(rhs->block_s));
+    assert_int_equal(IR_COND_RHS, rhs->block_s[1].label);
+    assert_int_equal(IR_COND_MERGE, rhs->block_s[2].label);
+    assert_int_equal(1, count(rhs, IR_PHI));
+    ir_free(rhs);
+
+    compilation_free(compilation);
+}
+
+static void passes(void **arg)
+{
+    (void) arg;
+
+    compilation_t compilation = compile(
+        "int f(int a)" LF
+        "{" LF
+        "    int b = a + 0;" LF
+        "    bool t = true;" LF
+        "    if (t)" LF
+        "        b = b * 1;" LF
+        "    return b;" LF
+        "}" LF);
+
+    unit_t unit = compilation_unit_s(compilation)[0];
+    ir_t ir = ir_build(FUNCTION(unit_declaration_s(unit)[0]));
+
+    // each pass reports whether it did anything
+    assert_true(ir_propagate_constants(ir));
+    assert_true(ir_propagate_copies(ir));
+    assert_true(ir_simplify_cfg(ir));
+    assert_true(ir_eliminate_dead_code(ir));
+    assert_false(ir_propagate_constants(ir));
+    assert_false(ir_propagate_copies(ir));
+    assert_false(ir_simplify_cfg(ir));
+    assert_false(ir_eliminate_dead_code(ir));
+
+    ir_compact(ir);
+    ir_print(ir, stdout);
+    assert_int_equal(IR_ARGUMENT, returned(ir)->op);
+
+    ir_free(ir);
+    compilation_free(compilation);
+}
+
+int main()
+{
+    const struct CMUnitTest tests[] =
+    {
+        cmocka_unit_test(constants),
+        cmocka_unit_test(copies),
+        cmocka_unit_test(dead_code),
+        cmocka_unit_test(cfg),
+        cmocka_unit_test(passes),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
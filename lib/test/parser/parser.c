@@ -4,6 +4,9 @@
 #include <string.h>
 #include <cmocka.h>
 
+#include <stdio.h>
+#include <unistd.h>
+
 #include "parser/parser.h"
 #include "common/source.h"
 
@@ -450,12 +453,64 @@ static void failure_branch(void **arg)
 
 }
 
+static void batch(void **arg)
+{
+    (void) arg;
+
+    const char *path_s[] =
+    {
+        "../docs/samples/v0.0.1.iz", "../docs/samples/v0.0.2.iz", "../docs/samples/v0.0.3.iz",
+        "../docs/samples/v0.0.4.iz", "../docs/samples/v0.0.5.iz", "../docs/samples/v0.0.6.iz",
+    };
+    size_t size = sizeof(path_s) / sizeof(path_s[0]);
+
+    thread_pool_t pool = thread_pool_new(4);
+
+    {
+        array_t(source_t) source_s = array_empty();
+        for (size_t i = 0; i < size; i++)
+        {
+            source_t source = source_load(path_s[i]);
+            source_s = array_add(source_s, source);
+        }
+
+        // units come back in source order
+        array_t(unit_t) unit_s = syntax_analysis_s(source_s, pool);
+        assert_non_null(unit_s);
+        assert_int_equal(size, array_size(unit_s));
+        for (size_t i = 0; i < size; i++)
+            assert_string_equal(path_s[i], source_path(unit_source(unit_s[i])));
+
+        array_cleanup_free(unit_s, (release_t)unit_free);
+    }
+
+    {
+        FILE *file = fopen("batch_error.iz", "w");
+        assert_non_null(file);
+        fputs("int f(", file);
+        fclose(file);
+
+        array_t(source_t) source_s = array_empty();
+        for (size_t i = 0; i < size; i++)
+        {
+            source_t source = source_load(i == 3 ? "batch_error.iz" : path_s[i]);
+            source_s = array_add(source_s, source);
+        }
+
+        assert_null(syntax_analysis_s(source_s, pool));
+        unlink("batch_error.iz");
+    }
+
+    thread_pool_free(pool);
+}
+
 int main()
 {
     const struct CMUnitTest tests[] =
     {
         cmocka_unit_test(success_branch),
         cmocka_unit_test(failure_branch),
+        cmocka_unit_test(batch),
     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
@@ -0,0 +1,80 @@
+#include <stdlib.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include <string.h>
+#include <ctype.h>
+#include <cmocka.h>
+
+#include "parser/scan.h"
+
+static void test_char_class(void **arg)
+{
+    (void) arg;
+
+    for (int c = 0; c < 256; c++)
+    {
+        bool ascii = c < 128;
+        assert_int_equal(c == ' ' || c == '\n', char_is(c, CHAR_SPACE));
+        assert_int_equal(ascii && isalpha(c), char_is(c, CHAR_ALPHA));
+        assert_int_equal(ascii && isdigit(c), char_is(c, CHAR_DIGIT));
+        assert_int_equal(ascii && (isalnum(c) || c == '_'), char_is(c, CHAR_IDENTIFIER));
+    }
+}
+
+// Runs of every length at every alignment, stopped by each kind of
+// terminator, must measure the same on every kernel the CPU supports.
+static void check_runs(char run, size_t (*scan)(const char*))
+{
+    const char stops[] = { '\0', '@', '[', '`', '{', '/', ':', '\t', (char)0x80, (char)0xff };
+    _Alignas(64) char buffer[256];
+
+    for (size_t offset = 0; offset < 64; offset++)
+        for (size_t size = 0; size < 100; size++)
+            for (size_t i = 0; i < sizeof(stops); i++)
+            {
+                memset(buffer, run, sizeof(buffer));
+                buffer[offset + size] = stops[i];
+                assert_int_equal(size, scan(buffer + offset));
+            }
+}
+
+static void test_kernels(void **arg)
+{
+    (void) arg;
+
+    scan_kernel_t selected = scan_kernel();
+
+    for (scan_kernel_t kernel = SCAN_KERNEL_SCALAR; kernel <= SCAN_KERNEL_AVX2; kernel++)
+    {
+        if (!scan_select(kernel))
+            continue;                                               // LCOV_EXCL_LINE
+
+        assert_int_equal(kernel, scan_kernel());
+
+        check_runs(' ', scan_whitespace_run);
+        check_runs('\n', scan_whitespace_run);
+        check_runs('7', scan_digits_run);
+        check_runs('a', scan_identifier_run);
+        check_runs('Z', scan_identifier_run);
+        check_runs('_', scan_identifier_run);
+        check_runs('0', scan_identifier_run);
+
+        assert_int_equal(3, scan_whitespace_run(" \n x"));
+        assert_int_equal(5, scan_identifier_run("a_B9z+1"));
+        assert_int_equal(2, scan_digits_run("12a"));
+        assert_int_equal(0, scan_digits_run(""));
+    }
+
+    assert_true(scan_select(selected));
+}
+
+int main()
+{
+    const struct CMUnitTest tests[] =
+    {
+        cmocka_unit_test(test_char_class),
+        cmocka_unit_test(test_kernels),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
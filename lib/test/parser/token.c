@@ -0,0 +1,79 @@
+#include <stdlib.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include "parser/token.h"
+
+static void test_stream(void **arg)
+{
+    (void) arg;
+
+    {
+        token_stream_t stream = token_stream_new(source_inline("", ""));
+        assert_int_equal(1, token_stream_size(stream));
+        assert_int_equal(TOKEN_EOF, token_kind(stream, 0));
+        assert_int_equal(0, token_offset(stream, 0));
+        assert_int_equal(0, token_length(stream, 0));
+        token_stream_free(stream);
+    }
+
+    {
+        const char *code = "int main()\n{\n    return 0;\n}\n";
+        token_stream_t stream = token_stream_new(source_inline(code, ""));
+
+        token_kind_t kinds[] =
+        {
+            TOKEN_KEYWORD, TOKEN_IDENTIFIER, TOKEN_OPEN_PAREN, TOKEN_CLOSE_PAREN,
+            TOKEN_OPEN_BRACE,
+            TOKEN_KEYWORD, TOKEN_INTEGER, TOKEN_SEMICOLON,
+            TOKEN_CLOSE_BRACE,
+            TOKEN_EOF
+        };
+        size_t size = sizeof(kinds) / sizeof(kinds[0]);
+
+        assert_int_equal(size, token_stream_size(stream));
+        for (size_t i = 0; i < size; i++)
+            assert_int_equal(kinds[i], token_kind(stream, i));
+
+        assert_true(token_is_keyword(stream, 0, KEYWORD_INT));
+        assert_false(token_is_keyword(stream, 0, KEYWORD_RETURN));
+        assert_false(token_is_keyword(stream, 1, KEYWORD_INT));
+        assert_true(token_is_keyword(stream, 5, KEYWORD_RETURN));
+        assert_int_equal(KEYWORD_INT, token_keyword(stream, 0));
+        assert_int_equal(KEYWORD_NONE, token_keyword(stream, 1));
+        assert_int_equal(KEYWORD_NONE, token_keyword(stream, 9));
+
+        assert_true(span_eq(span_sz("main"), token_span(stream, 1)));
+        assert_int_equal(4, token_offset(stream, 1));
+        assert_int_equal(4, token_length(stream, 1));
+
+        // "return" on the third line, indented by four spaces
+        assert_int_equal(2, token_line(stream, 5));
+        assert_int_equal(4, token_column(stream, 5));
+        assert_ptr_equal(code + 13, token_line_start(stream, 5));
+
+        assert_int_equal(0, token_line(stream, 0));
+        assert_int_equal(0, token_column(stream, 0));
+        assert_int_equal(3, token_line(stream, 8));
+
+        // EOF sits after the last newline
+        assert_int_equal(4, token_line(stream, 9));
+        assert_int_equal(0, token_column(stream, 9));
+
+        assert_ptr_equal(code, source_code(token_stream_source(stream)));
+
+        token_stream_free(stream);
+    }
+}
+
+int main()
+{
+    const struct CMUnitTest tests[] =
+    {
+        cmocka_unit_test(test_stream)
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,223 @@
+#include <stdlib.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include "ast/ast_print.h"
+#include "parser/parser.h"
+#include "sema/sema.h"
+#include "sema/eval.h"
+
+#define LF "\n"
+
+static compilation_t compile(const char *code)
+{
+    unit_t unit = syntax_analysis(source_inline(code, "eval.iz"));
+    assert_non_null(unit);
+
+    compilation_t compilation = semantic_analysis(array_add(array_empty(), unit));
+    assert_non_null(compilation);
+    compilation_print(compilation, stdout);
+
+    return compilation;
+}
+
+static function_t function_at(compilation_t compilation, size_t index)
+{
+    unit_t unit = compilation_unit_s(compilation)[0];
+    return FUNCTION(unit_declaration_s(unit)[index]);
+}
+
+// The expression the function returns, as the only statement of its body.
+static expression_t returned(compilation_t compilation, size_t index)
+{
+    statement_t statement = function_statement(function_at(compilation, index));
+    if (statement_kind(statement) == STATEMENT_BLOCK)
+    {
+        array_t(statement_t) statement_s = block_statement_s(BLOCK(statement));
+        assert_int_equal(1, array_size(statement_s));
+        statement = statement_s[0];
+    }
+
+    assert_int_equal(STATEMENT_RETURN, statement_kind(statement));
+    return return_expression(RETURN(statement));
+}
+
+static constant_t constant(expression_t expression)
+{
+    assert_int_equal(EXPRESSION_CONSTANT, expression_kind(expression));
+    return CONSTANT(expression);
+}
+
+static void binaries(void **arg)
+{
+    (void) arg;
+
+    int64_t value;
+    assert_true(eval_binary(BINARY_ADD, TYPE_INT, INT32_MAX, 1, &value));
+    assert_true(value == INT32_MIN);
+    assert_true(eval_binary(BINARY_MUL, TYPE_CHAR, 16, 8, &value));
+    assert_true(value == INT8_MIN);
+    assert_true(eval_binary(BINARY_LT, TYPE_BOOL, -1, 0, &value));
+    assert_true(value == -1);
+    assert_true(eval_binary(BINARY_REM, TYPE_INT, -7, 2, &value));
+    assert_true(value == -1);
+
+    assert_false(eval_binary(BINARY_DIV, TYPE_INT, 1, 0, &value));
+    assert_false(eval_binary(BINARY_DIV, TYPE_INT, INT32_MIN, -1, &value));
+    assert_false(eval_binary(BINARY_REM, TYPE_CHAR, INT8_MIN, -1, &value));
+
+    assert_true(eval_normalize(TYPE_BOOL, 1) == -1);
+    assert_true(eval_normalize(TYPE_CHAR, 200) == -56);
+}
+
+static void calls(void **arg)
+{
+    (void) arg;
+
+    compilation_t compilation = compile(
+        "bool is_leap_year(int year)" LF
+        "    return year % 4 == 0 && year % 100 != 0 || year % 400 == 0;" LF
+        "int fib(int n)" LF
+        "{" LF
+        "    if (n < 2)" LF
+        "        return n;" LF
+        "    return fib(n - 1) + fib(n - 2);" LF
+        "}" LF
+        "int days(int year)" LF
+        "{" LF
+        "    int d;" LF
+        "    if (is_leap_year(year))" LF
+        "        d = 366;" LF
+        "    else" LF
+        "        d = 365;" LF
+        "    return d;" LF
+        "}" LF
+        "char twice(char c)" LF
+        "    return c + c;" LF
+        "int leap()" LF
+        "    if (is_leap_year(2024))" LF
+        "        return 1;" LF
+        "    else" LF
+        "        return 0;" LF
+        "int main()" LF
+        "    return fib(15) + days(1900) - days(2000);" LF
+        "char wrap()" LF
+        "    return twice('a');" LF);
+
+    assert_int_equal(1, constant_u64(constant(returned(compilation, 4))));
+    assert_int_equal(609, constant_u64(constant(returned(compilation, 5))));
+    assert_int_equal((char)('a' + 'a'), constant_char(constant(returned(compilation, 6))));
+
+    compilation_free(compilation);
+}
+
+static void locals(void **arg)
+{
+    (void) arg;
+
+    compilation_t compilation = compile(
+        "int add(int a, int b)" LF
+        "    return a + b;" LF
+        "int twice(int n)" LF
+        "{" LF
+        "    int m = n;" LF
+        "    {" LF
+        "        int k = add(m, m = n + 1);" LF
+        "        n = k;" LF
+        "    }" LF
+        "    return n * 2;" LF
+        "}" LF
+        "void nothing(int n)" LF
+        "{" LF
+        "    n = n + 1;" LF
+        "}" LF
+        "int main()" LF
+        "{" LF
+        "    nothing(1);" LF
+        "    twice(1);" LF
+        "    return twice(20);" LF
+        "}" LF);
+
+    // the call's results are dropped with the calls, a void one stays
+    statement_t body = function_statement(function_at(compilation, 3));
+    array_t(statement_t) statement_s = block_statement_s(BLOCK(body));
+    assert_int_equal(2, array_size(statement_s));
+    assert_int_equal(STATEMENT_ACT, statement_kind(statement_s[0]));
+    assert_int_equal(82, constant_u64(constant(return_expression(RETURN(statement_s[1])))));
+
+    compilation_free(compilation);
+}
+
+static void impure(void **arg)
+{
+    (void) arg;
+
+    compilation_t compilation = compile(
+        "int load(int* p)" LF
+        "    return *p;" LF
+        "int store(int n)" LF
+        "{" LF
+        "    int x;" LF
+        "    int* p = &x;" LF
+        "    *p = n;" LF
+        "    return x;" LF
+        "}" LF
+        "int forever(int n)" LF
+        "    return forever(n + 1);" LF
+        "int trap(int n)" LF
+        "    return 10 / n;" LF
+        "int unset(bool c)" LF
+        "{" LF
+        "    int x;" LF
+        "    if (c)" LF
+        "        x = 1;" LF
+        "    return x;" LF
+        "}" LF
+        "int a()" LF
+        "    return store(1);" LF
+        "int b()" LF
+        "    return forever(0);" LF
+        "int c()" LF
+        "    return trap(0);" LF
+        "int d()" LF
+        "    return unset(false);" LF
+        "int f()" LF
+        "    return trap(5) + unset(true);" LF
+        "bool compare(int n)" LF
+        "    return load == load;" LF
+        "int assign(int n)" LF
+        "{" LF
+        "    load = load;" LF
+        "    return n;" LF
+        "}" LF
+        "bool g()" LF
+        "    return compare(1);" LF
+        "int h()" LF
+        "    return assign(1);" LF);
+
+    // left to run time
+    for (size_t i = 5; i < 9; i++)
+        assert_int_equal(EXPRESSION_CALL, expression_kind(returned(compilation, i)));
+    assert_int_equal(3, constant_u64(constant(returned(compilation, 9))));
+
+    // a function read or assigned as a value is left to run time
+    assert_int_equal(EXPRESSION_CALL, expression_kind(returned(compilation, 12)));
+    assert_int_equal(EXPRESSION_CALL, expression_kind(returned(compilation, 13)));
+
+    compilation_free(compilation);
+}
+
+int main()
+{
+    const struct CMUnitTest tests[] =
+    {
+        cmocka_unit_test(binaries),
+        cmocka_unit_test(calls),
+        cmocka_unit_test(locals),
+        cmocka_unit_test(impure),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,272 @@
+#include <stdlib.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include "ast/ast_print.h"
+#include "parser/parser.h"
+#include "sema/sema.h"
+
+#define LF "\n"
+
+static compilation_t compile(const char *code)
+{
+    unit_t unit = syntax_analysis(source_inline(code, "fold.iz"));
+    assert_non_null(unit);
+
+    compilation_t compilation = semantic_analysis(array_add(array_empty(), unit));
+    assert_non_null(compilation);
+    compilation_print(compilation, stdout);
+
+    return compilation;
+}
+
+static function_t function_at(compilation_t compilation, size_t index)
+{
+    unit_t unit = compilation_unit_s(compilation)[0];
+    return FUNCTION(unit_declaration_s(unit)[index]);
+}
+
+// The statements of the function's body, which is a block.
+static array_t(statement_t) body(compilation_t compilation, size_t index)
+{
+    statement_t statement = function_statement(function_at(compilation, index));
+    assert_int_equal(STATEMENT_BLOCK, statement_kind(statement));
+    return block_statement_s(BLOCK(statement));
+}
+
+// The expression the function returns, as the only statement of its body.
+static expression_t returned(compilation_t compilation, size_t index)
+{
+    statement_t statement = function_statement(function_at(compilation, index));
+    if (statement_kind(statement) == STATEMENT_BLOCK)
+    {
+        array_t(statement_t) statement_s = block_statement_s(BLOCK(statement));
+        assert_int_equal(1, array_size(statement_s));
+        statement = statement_s[0];
+    }
+
+    assert_int_equal(STATEMENT_RETURN, statement_kind(statement));
+    return return_expression(RETURN(statement));
+}
+
+static constant_t constant(expression_t expression)
+{
+    assert_int_equal(EXPRESSION_CONSTANT, expression_kind(expression));
+    return CONSTANT(expression);
+}
+
+static void binaries(void **arg)
+{
+    (void) arg;
+
+    compilation_t compilation = compile(
+        "int arithmetic()" LF
+        "    return 1 + 2 * 3 - 10 / 3 % 2;" LF
+        "bool leap()" LF
+        "    return 2024 % 4 == 0 && 2024 % 100 != 0 || 2024 % 400 == 0;" LF
+        "int wrap()" LF
+        "    return 2147483647 + 1;" LF
+        "bool signed_bool()" LF
+        "    return true < false;" LF
+        "bool signed_char()" LF
+        "    return 'a' + 'a' < 'a';" LF
+        "char wrap_char()" LF
+        "    return 'a' * 'b';" LF
+        "int trap()" LF
+        "    return 1 / 0;" LF
+        "int overflow()" LF
+        "    return 2147483647 + 1 / 0 - 1;" LF);
+
+    assert_int_equal(6, constant_u64(constant(returned(compilation, 0))));
+    assert_true(constant_bool(constant(returned(compilation, 1))));
+    assert_int_equal(0x80000000, constant_u64(constant(returned(compilation, 2))));
+
+    // true is -1 as a signed i1, and chars are signed
+    assert_true(constant_bool(constant(returned(compilation, 3))));
+    assert_true(constant_bool(constant(returned(compilation, 4))));
+    assert_int_equal((char)('a' * 'b'), constant_char(constant(returned(compilation, 5))));
+
+    // a division by zero is left to run
+    assert_int_equal(EXPRESSION_BINARY, expression_kind(returned(compilation, 6)));
+    expression_t overflow = returned(compilation, 7);
+    assert_int_equal(EXPRESSION_BINARY, expression_kind(overflow));
+    assert_int_equal(EXPRESSION_CONSTANT, expression_kind(binary_rhs(BINARY(overflow))));
+
+    compilation_free(compilation);
+}
+
+static void conditionals(void **arg)
+{
+    (void) arg;
+
+    compilation_t compilation = compile(
+        "bool f(bool a)" LF
+        "    return false && a;" LF
+        "bool g(bool a)" LF
+        "    return true && a;" LF
+        "bool h(bool a)" LF
+        "    return a || false;" LF
+        "bool effect(bool a)" LF
+        "    return f(a) && false;" LF
+        "bool all(bool a)" LF
+        "    return 1 < 2 || a;" LF);
+
+    assert_false(constant_bool(constant(returned(compilation, 0))));
+    assert_int_equal(EXPRESSION_IMPLICIT_CAST, expression_kind(returned(compilation, 1)));
+    assert_int_equal(EXPRESSION_IMPLICIT_CAST, expression_kind(returned(compilation, 2)));
+
+    // the call still has to run
+    assert_int_equal(EXPRESSION_CONDITIONAL, expression_kind(returned(compilation, 3)));
+    assert_true(constant_bool(constant(returned(compilation, 4))));
+
+    compilation_free(compilation);
+}
+
+static void nested(void **arg)
+{
+    (void) arg;
+
+    compilation_t compilation = compile(
+        "int id(int n)" LF
+        "{" LF
+        "    int* p = &n;" LF
+        "    return *p;" LF
+        "}" LF
+        "void store(int* p, bool b)" LF
+        "{" LF
+        "    int x = 2 * 21;" LF
+        "    *p = id(x + 0 * 5) + id(3 - 1);" LF
+        "    b = 'a' == 'a';" LF
+        "    id(1 + 1);" LF
+        "}" LF);
+
+    array_t(statement_t) statement_s = body(compilation, 1);
+    assert_int_equal(4, array_size(statement_s));
+
+    declaration_t x = var_variable_s(VAR(statement_s[0]))[0];
+    assert_int_equal(42, constant_u64(constant(variable_initializer(VARIABLE(x)))));
+
+    expression_t store = act_expression_s(ACT(statement_s[1]))[0];
+    expression_t sum = assignment_rvalue(ASSIGNMENT(store));
+    expression_t first = call_argument_s(CALL(binary_lhs(BINARY(sum))))[0];
+    expression_t second = call_argument_s(CALL(binary_rhs(BINARY(sum))))[0];
+    assert_int_equal(0, constant_u64(constant(binary_rhs(BINARY(first)))));
+    assert_int_equal(2, constant_u64(constant(second)));
+
+    expression_t assign = act_expression_s(ACT(statement_s[2]))[0];
+    assert_true(constant_bool(constant(assignment_rvalue(ASSIGNMENT(assign)))));
+
+    expression_t call = act_expression_s(ACT(statement_s[3]))[0];
+    assert_int_equal(2, constant_u64(constant(call_argument_s(CALL(call))[0])));
+
+    compilation_free(compilation);
+}
+
+static void branches(void **arg)
+{
+    (void) arg;
+
+    compilation_t compilation = compile(
+        "int taken()" LF
+        "{" LF
+        "    if (1 > 2)" LF
+        "        return 1;" LF
+        "    else" LF
+        "        return 2;" LF
+        "}" LF
+        "int then(int a)" LF
+        "{" LF
+        "    if (true)" LF
+        "    {" LF
+        "        a = a + 1;" LF
+        "    }" LF
+        "    if (false)" LF
+        "        a = 0;" LF
+        "    return a;" LF
+        "}" LF
+        "int inner(bool c, int a)" LF
+        "{" LF
+        "    if (c)" LF
+        "        if (false)" LF
+        "            a = 0;" LF
+        "    else" LF
+        "        if (false)" LF
+        "            a = 1;" LF
+        "    return a;" LF
+        "}" LF
+        "int body()" LF
+        "    if (true)" LF
+        "        return 1;" LF
+        "    else" LF
+        "        return 0;" LF);
+
+    assert_int_equal(2, constant_u64(constant(returned(compilation, 0))));
+
+    // the taken branch stays, the other is gone
+    array_t(statement_t) then = body(compilation, 1);
+    assert_int_equal(2, array_size(then));
+    assert_int_equal(STATEMENT_BLOCK, statement_kind(then[0]));
+    assert_int_equal(STATEMENT_RETURN, statement_kind(then[1]));
+
+    // a branch that folds away leaves an empty block or no else
+    array_t(statement_t) inner = body(compilation, 2);
+    assert_int_equal(2, array_size(inner));
+    if_t ifelse = IF(inner[0]);
+    statement_t then_branch = if_then_branch(ifelse);
+    assert_int_equal(STATEMENT_BLOCK, statement_kind(then_branch));
+    assert_int_equal(0, array_size(block_statement_s(BLOCK(then_branch))));
+    assert_null(if_else_branch(ifelse));
+
+    assert_int_equal(1, constant_u64(constant(returned(compilation, 3))));
+
+    compilation_free(compilation);
+}
+
+static void after_return(void **arg)
+{
+    (void) arg;
+
+    compilation_t compilation = compile(
+        "int early(int a)" LF
+        "{" LF
+        "    if (true)" LF
+        "        return a;" LF
+        "    a = a + 1;" LF
+        "    return a;" LF
+        "}" LF
+        "int both(bool c)" LF
+        "{" LF
+        "    {" LF
+        "        if (c)" LF
+        "            return 1;" LF
+        "        else" LF
+        "            return 2;" LF
+        "        c = true;" LF
+        "    }" LF
+        "    return 3;" LF
+        "}" LF);
+
+    assert_int_equal(EXPRESSION_IMPLICIT_CAST, expression_kind(returned(compilation, 0)));
+
+    array_t(statement_t) both = body(compilation, 1);
+    assert_int_equal(1, array_size(both));
+    assert_int_equal(1, array_size(block_statement_s(BLOCK(both[0]))));
+
+    compilation_free(compilation);
+}
+
+int main()
+{
+    const struct CMUnitTest tests[] =
+    {
+        cmocka_unit_test(binaries),
+        cmocka_unit_test(conditionals),
+        cmocka_unit_test(nested),
+        cmocka_unit_test(branches),
+        cmocka_unit_test(after_return),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
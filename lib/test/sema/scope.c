@@ -5,10 +5,11 @@
 #include <cmocka.h>
 
 #include "sema/scope.h"
+#include "common/arena.h"
 
 static declaration_t create_declaration_one()
 {
-    type_t int_ty = type_int_new();
+    type_t int_ty = type_int();
     span_t name = span_sz("one");
     array_t(declaration_t) argument_s = array_empty();
 
@@ -22,21 +23,25 @@ static void success_branch(void **arg)
 {
     (void) arg;
 
+    arena_t arena = arena_new();
+    arena_use(arena);
+
     {
-        scope_t global = scope_new(NULL);
+        scope_t scope = scope_new();
+        assert_int_equal(0, scope_depth(scope));
 
         declaration_t fn_one = create_declaration_one();
-        assert_true(scope_add(global, fn_one));
+        assert_true(scope_add(scope, fn_one));
 
         declaration_t fn_another_one = create_declaration_one();
-        assert_false(scope_add(global, fn_another_one));
+        assert_false(scope_add(scope, fn_another_one));
 
         // This is creation of function num, this is importante create here
         // because we gonna test insertion on argument 'n' in inner scope
-        type_t int_ty = type_int_new();
+        type_t int_ty = type_int();
         span_t name = span_sz("num");
         array_t(declaration_t) argument_s = array_empty();
-        type_t arg0_ty = type_int_new();
+        type_t arg0_ty = type_int();
         declaration_t arg0 = argument_new(arg0_ty, (struct location_t){ .span = span_sz("n") });
         argument_s = array_add(argument_s, arg0);
         span_t n = span_sz("n");
@@ -46,65 +51,95 @@ static void success_branch(void **arg)
         statement_t statement = return_new(expression);
         declaration_t fn_num = function_new(int_ty, (struct location_t){ .span = name }, argument_s, statement);
 
-        assert_true(scope_add(global, fn_num));
+        assert_true(scope_add(scope, fn_num));
 
-        scope_t fn_num_scope = scope_new(global);
-        assert_true(scope_add(fn_num_scope, arg0));
-        assert_int_equal(global, scope_parent(fn_num_scope));
+        scope_enter(scope);
+        assert_int_equal(1, scope_depth(scope));
+        assert_true(scope_add(scope, arg0));
 
-        declaration_t arg_n = scope_find(fn_num_scope, span_sz("n"));
+        declaration_t arg_n = scope_find(scope, symbol_intern(span_sz("n")));
         assert_int_equal(arg0, arg_n);
 
-        declaration_t fn_one_find = scope_find(fn_num_scope, span_sz("one"));
+        declaration_t fn_one_find = scope_find(scope, symbol_intern(span_sz("one")));
         assert_int_equal(fn_one, fn_one_find);
 
-        assert_null(scope_find(global, span_sz("n")));
+        scope_leave(scope);
+        assert_int_equal(0, scope_depth(scope));
+        assert_null(scope_find(scope, symbol_intern(span_sz("n"))));
+        assert_int_equal(fn_num, scope_find(scope, symbol_intern(span_sz("num"))));
+
+        // never declared, and not even interned yet
+        assert_null(scope_find(scope, symbol_intern(span_sz("scope_test_unknown"))));
+        assert_null(scope_find(scope, symbol_count() + 1000));
 
-        scope_free(fn_num_scope);
-        declaration_free(fn_num);
-        declaration_free(fn_another_one);
-        declaration_free(fn_one);
-        scope_free(global);
+        scope_free(scope);
     }
 
     {
-        // Insertion order found (by simulating insert_node/fix_up offline) to
-        // drive the red-black tree through rotate_left, rotate_right -
-        // including the case where the rotated node already has a right
-        // child - and the color-flip branch inside fix_up.
+        // inner declarations shadow outer ones until their scope is left
         const char *names[] = { "a", "b", "c", "f", "g", "d", "e" };
         size_t size = sizeof(names) / sizeof(names[0]);
 
-        scope_t scope = scope_new(NULL);
-        declaration_t declaration_s[size];
-        type_t type_s[size];
+        scope_t scope = scope_new();
+        declaration_t outer_s[size];
+        declaration_t inner_s[size];
 
         for (size_t i = 0; i < size; i++)
         {
-            // argument_free() does not release the argument's type (that is
-            // normally done through the owning function's callable type), so
-            // since these arguments have no owning function here, the types
-            // are tracked and released separately below.
-            type_s[i] = type_int_new();
-            declaration_t argument = argument_new(type_s[i], (struct location_t){ .span = span_sz(names[i]) });
-            declaration_s[i] = argument;
+            outer_s[i] = argument_new(type_int(), (struct location_t){ .span = span_sz(names[i]) });
+            assert_true(scope_add(scope, outer_s[i]));
+        }
 
-            assert_true(scope_add(scope, argument));
+        scope_enter(scope);
+        for (size_t i = 0; i < size; i += 2)
+        {
+            inner_s[i] = argument_new(type_int(), (struct location_t){ .span = span_sz(names[i]) });
+            assert_true(scope_add(scope, inner_s[i]));
+            assert_false(scope_add(scope, inner_s[i]));
         }
 
+        scope_enter(scope);
+        scope_enter(scope);
+        declaration_t innermost = argument_new(type_int(), (struct location_t){ .span = span_sz("a") });
+        assert_true(scope_add(scope, innermost));
+        assert_int_equal(innermost, scope_find(scope, symbol_intern(span_sz("a"))));
+        scope_leave(scope);
+        scope_leave(scope);
+
         for (size_t i = 0; i < size; i++)
         {
-            declaration_t found = scope_find(scope, span_sz(names[i]));
-            assert_int_equal(declaration_s[i], found);
+            declaration_t found = scope_find(scope, symbol_intern(span_sz(names[i])));
+            assert_int_equal(i % 2 == 0 ? inner_s[i] : outer_s[i], found);
         }
 
-        scope_free(scope);
+        scope_leave(scope);
         for (size_t i = 0; i < size; i++)
         {
-            declaration_free(declaration_s[i]);
-            type_free(type_s[i]);
+            declaration_t found = scope_find(scope, symbol_intern(span_sz(names[i])));
+            assert_int_equal(outer_s[i], found);
+        }
+
+        scope_free(scope);
+    }
+
+    {
+        // reentering after a leave reuses the log without new allocations
+        scope_t scope = scope_new();
+        declaration_t argument = argument_new(type_int(), (struct location_t){ .span = span_sz("x") });
+
+        for (int i = 0; i < 1000; i++)
+        {
+            scope_enter(scope);
+            assert_true(scope_add(scope, argument));
+            assert_int_equal(argument, scope_find(scope, symbol_intern(span_sz("x"))));
+            scope_leave(scope);
+            assert_null(scope_find(scope, symbol_intern(span_sz("x"))));
         }
+
+        scope_free(scope);
     }
+
+    arena_free(arena);
 }
 
 static void failure_branch(void **arg)
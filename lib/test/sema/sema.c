@@ -97,6 +97,36 @@ static void success_branch(void **arg)
 
         compilation_free(compilation);
     }
+
+    {
+        // functions, arguments and variables are numbered densely in the
+        // order sema meets them
+        char *code =
+        "int add(int a, int b)" LF
+        "{"                     LF
+        "    int c = a + b;"    LF
+        "    return c;"         LF
+        "}"                     LF
+        "int zero()"            LF
+        "    return 0;"         LF
+        ;
+        unit_t unit = syntax_analysis(source_inline(code, "ids.iz"));
+        compilation_t compilation = semantic_analysis(array_add(array_empty(), unit));
+        assert_non_null(compilation);
+        assert_int_equal(5, compilation_declarations(compilation));
+
+        array_t(declaration_t) declaration_s = unit_declaration_s(unit);
+        function_t add = FUNCTION(declaration_s[0]);
+        assert_int_equal(1, declaration_id(declaration_s[0]));
+        assert_int_equal(2, declaration_id(declaration_s[1]));
+        assert_int_equal(3, declaration_id(function_argument_s(add)[0]));
+        assert_int_equal(4, declaration_id(function_argument_s(add)[1]));
+
+        statement_t var = block_statement_s(BLOCK(function_statement(add)))[0];
+        assert_int_equal(5, declaration_id(var_variable_s(VAR(var))[0]));
+
+        compilation_free(compilation);
+    }
 }
 
 static void failure_branch(void **arg)
@@ -0,0 +1,183 @@
+#include <stdlib.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include "parser/parser.h"
+#include "sema/sema.h"
+#include "vm/bytecode.h"
+
+#define LF "\n"
+
+static compilation_t compile(const char *code)
+{
+    unit_t unit = syntax_analysis(source_inline(code, "unit.iz"));
+    assert_non_null(unit);
+
+    compilation_t compilation = semantic_analysis(array_add(array_empty(), unit));
+    assert_non_null(compilation);
+
+    return compilation;
+}
+
+static void samples(void **arg)
+{
+    (void) arg;
+
+    const char *path_s[] =
+    {
+        "../docs/samples/v0.0.1.iz",
+        "../docs/samples/v0.0.2.iz",
+        "../docs/samples/v0.0.3.iz",
+        "../docs/samples/v0.0.4.iz",
+        "../docs/samples/v0.0.5.iz",
+        "../docs/samples/v0.0.6.iz",
+    };
+
+    for (size_t i = 0; i < sizeof(path_s) / sizeof(path_s[0]); i++)
+    {
+        unit_t unit = syntax_analysis(source_load(path_s[i]));
+        compilation_t compilation = semantic_analysis(array_add(array_empty(), unit));
+        assert_non_null(compilation);
+
+        bytecode_t bytecode = bytecode_compile(compilation);
+        assert_non_null(bytecode);
+        assert_true(bytecode_size(bytecode) > 0);
+        bytecode_print(bytecode, stdout);
+
+        bytecode_free(bytecode);
+        compilation_free(compilation);
+    }
+}
+
+static void functions(void **arg)
+{
+    (void) arg;
+
+    compilation_t compilation = compile(
+        "int main(int a)" LF
+        "    return add(a, 2);" LF
+        "int add(int a, int b)" LF
+        "    return a + b;" LF
+        "void nothing()" LF
+        "{" LF
+        "}" LF);
+
+    bytecode_t bytecode = bytecode_compile(compilation);
+    assert_non_null(bytecode);
+    assert_int_equal(3, bytecode_functions(bytecode));
+
+    assert_int_equal(0, bytecode_find(bytecode, "main"));
+    assert_int_equal(1, bytecode_find(bytecode, "add"));
+    assert_int_equal(2, bytecode_find(bytecode, "nothing"));
+    assert_int_equal(-1, bytecode_find(bytecode, "missing"));
+
+    const bytecode_function_t *add = bytecode_function(bytecode, 1);
+    assert_string_equal("add", add->name);
+    assert_int_equal(2, add->arguments);
+    assert_int_equal(3, add->registers);
+
+    // arguments are read in place: add r2, r0, r1 then ret r2
+    const instruction_t *code = bytecode_code(bytecode) + add->entry;
+    assert_int_equal(OP_ADD, code[0].op);
+    assert_int_equal(2, code[0].a);
+    assert_int_equal(0, code[0].b);
+    assert_int_equal(1, code[0].c);
+    assert_int_equal(OP_RET, code[1].op);
+    assert_int_equal(2, code[1].a);
+
+    // the call's frame starts at the result register, so no move follows;
+    // an argument that is not constant keeps sema from running the call
+    const bytecode_function_t *main = bytecode_function(bytecode, 0);
+    code = bytecode_code(bytecode) + main->entry;
+    assert_int_equal(OP_MOVE, code[0].op);
+    assert_int_equal(OP_CONST, code[1].op);
+    assert_int_equal(OP_CALL, code[2].op);
+    assert_int_equal(1, code[2].a);
+    assert_int_equal(1, code[2].imm);
+    assert_int_equal(OP_RET, code[3].op);
+    assert_int_equal(1, code[3].a);
+
+    // void functions return at their end, and still have a register
+    const bytecode_function_t *nothing = bytecode_function(bytecode, 2);
+    assert_int_equal(OP_RET_VOID, bytecode_code(bytecode)[nothing->entry].op);
+    assert_int_equal(1, nothing->registers);
+
+    bytecode_free(bytecode);
+    compilation_free(compilation);
+}
+
+static void registers(void **arg)
+{
+    (void) arg;
+
+    // temporaries are released after each statement; sema folds the
+    // initializer to a constant
+    compilation_t compilation = compile(
+        "int main()" LF
+        "{" LF
+        "    int a = 1 + 2 * 3;" LF
+        "    a = a * 2 + a * 3;" LF
+        "    return a;" LF
+        "}" LF);
+
+    bytecode_t bytecode = bytecode_compile(compilation);
+    assert_non_null(bytecode);
+    assert_int_equal(4, bytecode_function(bytecode, 0)->registers);
+
+    bytecode_free(bytecode);
+    compilation_free(compilation);
+
+    // more locals than a register operand can name
+    size_t size = 70000 * 16 + 64;
+    char *code = test_malloc(size);
+    size_t at = snprintf(code, size, "int main()" LF "{" LF "    int v0 = 0");
+    for (int i = 1; i < 70000; i++)
+        at += snprintf(code + at, size - at, ", v%d = 0", i);
+    snprintf(code + at, size - at, ";" LF "    return v0;" LF "}" LF);
+
+    compilation = compile(code);
+    assert_null(bytecode_compile(compilation));
+    compilation_free(compilation);
+    test_free(code);
+}
+
+static void unsupported(void **arg)
+{
+    (void) arg;
+
+    // a function read or assigned as a value
+    compilation_t compilation = compile(
+        "int g()" LF
+        "    return 0;" LF
+        "int main()" LF
+        "{" LF
+        "    if (g == main)" LF
+        "        return 1;" LF
+        "    return 0;" LF
+        "}" LF);
+    assert_null(bytecode_compile(compilation));
+    compilation_free(compilation);
+
+    compilation = compile(
+        "int g()" LF
+        "    return 0;" LF
+        "void main()" LF
+        "    g = g;" LF);
+    assert_null(bytecode_compile(compilation));
+    compilation_free(compilation);
+}
+
+int main()
+{
+    const struct CMUnitTest tests[] =
+    {
+        cmocka_unit_test(samples),
+        cmocka_unit_test(functions),
+        cmocka_unit_test(registers),
+        cmocka_unit_test(unsupported),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
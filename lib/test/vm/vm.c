@@ -0,0 +1,210 @@
+#include <stdlib.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include "parser/parser.h"
+#include "sema/sema.h"
+#include "vm/vm.h"
+
+#define LF "\n"
+
+// Compiles the code and calls the function with the arguments.
+static vm_status_t call(const char *code, const char *name, const int64_t *argument_s, int64_t *result)
+{
+    unit_t unit = syntax_analysis(source_inline(code, "unit.iz"));
+    assert_non_null(unit);
+    compilation_t compilation = semantic_analysis(array_add(array_empty(), unit));
+    assert_non_null(compilation);
+    bytecode_t bytecode = bytecode_compile(compilation);
+    assert_non_null(bytecode);
+
+    int function = bytecode_find(bytecode, name);
+    assert_true(function >= 0);
+    vm_status_t status = vm_call(bytecode, function, argument_s, result);
+
+    bytecode_free(bytecode);
+    compilation_free(compilation);
+    return status;
+}
+
+static int64_t run(const char *code)
+{
+    int64_t result = -1;
+    assert_int_equal(VM_OK, call(code, "main", NULL, &result));
+    return result;
+}
+
+static void arithmetic(void **arg)
+{
+    (void) arg;
+
+    assert_int_equal(7, run("int main() return 1 + 2 * 3;"));
+    assert_int_equal(-3, run("int main() { int a = 0 - 7; return a / 2; }"));
+    assert_int_equal(-1, run("int main() { int a = 0 - 7; return a % 2; }"));
+    assert_int_equal(1, run("int main() return 10 - 3 * 3;"));
+
+    // int wraps at 32 bits
+    assert_int_equal(-2147483648LL, run("int main() return 2147483647 + 1;"));
+    assert_int_equal(0, run("int main() return 65536 * 65536;"));
+
+    // char wraps at 8 bits
+    assert_int_equal(-62, run("char main() return 'a' + 'a';"));
+    assert_int_equal(1, run("bool main() return '0' <= '5' && '5' <= '9';"));
+
+    // bool arithmetic is one bit, and true orders below false
+    assert_int_equal(0, run("bool main() return true + true;"));
+    assert_int_equal(1, run("bool main() return true < false;"));
+    assert_int_equal(0, run("bool main() return false < true;"));
+    assert_int_equal(1, run("bool main() return true != false;"));
+}
+
+static void control(void **arg)
+{
+    (void) arg;
+
+    const char *code =
+        "bool is_leap_year(int year)" LF
+        "    return year % 4 == 0 && year % 100 != 0 || year % 400 == 0;" LF;
+
+    int64_t year_s[][2] = { { 2024, 1 }, { 1900, 0 }, { 2000, 1 }, { 2023, 0 } };
+    for (size_t i = 0; i < sizeof(year_s) / sizeof(year_s[0]); i++)
+    {
+        int64_t result = -1;
+        assert_int_equal(VM_OK, call(code, "is_leap_year", &year_s[i][0], &result));
+        assert_int_equal(year_s[i][1], result);
+    }
+
+    assert_int_equal(3, run(
+        "int main()" LF
+        "{" LF
+        "    int a = 5;" LF
+        "    if (a > 3)" LF
+        "    {" LF
+        "        int b = a - 2;" LF
+        "        a = b;" LF
+        "    }" LF
+        "    else" LF
+        "        a = 0;" LF
+        "    if (a == 0)" LF
+        "        return 1;" LF
+        "    return a;" LF
+        "}" LF));
+
+    // the right side of && and || runs only when needed
+    assert_int_equal(1, run(
+        "bool fail()" LF
+        "    return 1 / 0 == 0;" LF
+        "bool main()" LF
+        "    return false && fail() || true || fail();" LF));
+
+    // the rhs reads the local before the assignment overwrites it
+    assert_int_equal(0, run(
+        "bool id(bool b)" LF
+        "    return b;" LF
+        "int main()" LF
+        "{" LF
+        "    bool b = false;" LF
+        "    bool c = true;" LF
+        "    b = c && id(b);" LF
+        "    if (b)" LF
+        "        return 1;" LF
+        "    return 0;" LF
+        "}" LF));
+}
+
+static void calls(void **arg)
+{
+    (void) arg;
+
+    assert_int_equal(55, run(
+        "int fib(int n)" LF
+        "{" LF
+        "    if (n < 2)" LF
+        "        return n;" LF
+        "    return fib(n - 1) + fib(n - 2);" LF
+        "}" LF
+        "int main()" LF
+        "    return fib(10);" LF));
+
+    // arguments may themselves be calls, and locals survive calls
+    assert_int_equal(46, run(
+        "int add(int a, int b)" LF
+        "    return a + b;" LF
+        "int main()" LF
+        "{" LF
+        "    int x = 4;" LF
+        "    int y = add(add(x, 10), add(20, x));" LF
+        "    x = add(x, y) + x;" LF
+        "    return x;" LF
+        "}" LF));
+}
+
+static void pointers(void **arg)
+{
+    (void) arg;
+
+    assert_int_equal(12, run(
+        "void swap_int(int* lhs, int* rhs)" LF
+        "{" LF
+        "    int tmp = *lhs;" LF
+        "    *lhs = *rhs;" LF
+        "    *rhs = tmp;" LF
+        "}" LF
+        "int main()" LF
+        "{" LF
+        "    int a = 2, b = 1;" LF
+        "    swap_int(&a, &b);" LF
+        "    return a * 10 + b;" LF
+        "}" LF));
+
+    assert_int_equal(9, run(
+        "int main()" LF
+        "{" LF
+        "    int a = 1;" LF
+        "    int* p = &a;" LF
+        "    int** q = &p;" LF
+        "    **q = *p + 8;" LF
+        "    return a;" LF
+        "}" LF));
+}
+
+static void traps(void **arg)
+{
+    (void) arg;
+
+    int64_t result = -1;
+    assert_int_equal(VM_DIVISION_BY_ZERO, call(
+        "int main()" LF
+        "{" LF
+        "    int zero = 0;" LF
+        "    return 1 / zero;" LF
+        "}" LF, "main", NULL, &result));
+    assert_int_equal(VM_DIVISION_BY_ZERO, call("int main() return 1 % 0;", "main", NULL, &result));
+    assert_int_equal(-1, result);
+
+    assert_int_equal(VM_STACK_OVERFLOW, call(
+        "int forever(int n)" LF
+        "    return forever(n + 1);" LF
+        "int main()" LF
+        "    return forever(0);" LF, "main", NULL, &result));
+
+    assert_string_equal("ok", vm_status_string(VM_OK));
+    assert_string_equal("division by zero", vm_status_string(VM_DIVISION_BY_ZERO));
+    assert_string_equal("stack overflow", vm_status_string(VM_STACK_OVERFLOW));
+}
+
+int main()
+{
+    const struct CMUnitTest tests[] =
+    {
+        cmocka_unit_test(arithmetic),
+        cmocka_unit_test(control),
+        cmocka_unit_test(calls),
+        cmocka_unit_test(pointers),
+        cmocka_unit_test(traps),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -1,44 +1,396 @@
+#include <ctype.h>
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
 
 #include "ast/ast.h"
 #include "ast/ast_print.h"
+#include "common/mem.h"
 #include "common/source.h"
+#include "common/thread_pool.h"
 #include "parser/parser.h"
 #include "sema/sema.h"
+#include "vm/vm.h"
 #include "llvm/backend.h"
+#include "llvm/jit.h"
+#include "x64/x64.h"
 
 // LCOV_EXCL_START
-int main(int argc, char *argv[])
+static
+void usage(const char *program)
 {
-    if (argc == 1)
-    {
-        fprintf(stderr, "Usage: %s <file>\n", argv[0]);
+    fprintf(stderr,
+        "Usage: %s [-O0|-O1|-O2|-O3|-Os|-Oz] [--passes=<pipeline>] [--lto[=full|thin]] [--export=<function>]\n"
+        "          [-c] [-S] [--emit-llvm] [--emit-bc] [-o <output>] <file>... [@<response file>]\n"
+        "       %s --backend=x64 [-c] [-o <output>] <file>... [@<response file>]\n"
+        "       %s run [--lazy|--tiered|--vm] [-O0|-O1|-O2|-O3|-Os|-Oz] [--passes=<pipeline>] <file>... [@<response file>]\n", program, program, program);
+}
+
+static
+double elapsed_ms(const struct timespec *start)
+{
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) * 1e3 + (end.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+// JIT compiles the compilation, runs main and reports where the time went.
+// The exit status is main's.
+static
+int run(compilation_t compilation, jit_mode_t mode, backend_level_t level, const char *pipeline, double frontend)
+{
+    jit_t jit = jit_compile(compilation, mode, level, pipeline);
+    if (jit == NULL)
         return 1;
+
+    int status = 1;
+    if (jit_run(jit, &status))
+    {
+        jit_stats_t stats = jit_stats(jit);
+        fprintf(stderr, "frontend %.3f ms, compile %.3f ms, run %.3f ms, %zu of %zu functions compiled\n",
+            frontend, stats.compile / 1e6, stats.run / 1e6, stats.compiled, stats.functions);
+
+        for (size_t i = 0; i < stats.tier_ups; i++)
+        {
+            jit_tier_up_t tier_up = jit_tier_up(jit, i);
+            fprintf(stderr, "tier-up %s at %.3f ms, recompiled in %.3f ms\n",
+                tier_up.function, tier_up.at / 1e6, tier_up.compile / 1e6);
+        }
     }
 
-    source_t source = source_load(argv[1]);
-    if (source == NULL)
-        return 1;
+    jit_free(jit);
+    return status;
+}
+
+// Runs main on the bytecode interpreter, without LLVM.
+static
+int interpret(compilation_t compilation, double frontend)
+{
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    int status = 1;
+    bytecode_t bytecode = bytecode_compile(compilation);
+    if (bytecode == NULL)
+        goto leave;
+    double compile = elapsed_ms(&start);
+
+    int entry = bytecode_find(bytecode, "main");
+    if (entry < 0)
+    {
+        fprintf(stderr, "run: no main function\n");
+        goto leave;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int64_t result = 0;
+    vm_status_t trap = vm_call(bytecode, entry, NULL, &result);
+    if (trap != VM_OK)
+    {
+        fprintf(stderr, "run: %s\n", vm_status_string(trap));
+        goto leave;
+    }
+    status = (int)result;
+
+    fprintf(stderr, "frontend %.3f ms, compile %.3f ms, run %.3f ms, %zu instructions\n",
+        frontend, compile, elapsed_ms(&start), bytecode_size(bytecode));
+
+leave:
+    if (bytecode != NULL)
+        bytecode_free(bytecode);
+    compilation_free(compilation);
+    return status;
+}
 
-    unit_t unit = syntax_analysis(source);
-    if (unit == NULL)
+// Writes an object per unit straight from the AST, without LLVM: a debug
+// build, with no optimization.
+static
+int compile_x64(compilation_t compilation, array_t(unit_t) unit_s, const char *output)
+{
+    x64_t x64 = x64_codegen(compilation);
+    if (x64 == NULL)
         return 1;
 
-    compilation_t compilation = semantic_analysis(array_add(array_empty(), unit));
+    int status = 0;
+    for (size_t i = 0; i < array_size(unit_s) && status == 0; i++)
+    {
+        char *path = output != NULL ? (char*)output : source_output_name(unit_source(unit_s[i]), ".o");
+        if (!x64_write(x64, i, path))
+            status = 1;
+        if (output == NULL)
+            mem_free(path);
+    }
+
+    x64_free(x64);
+    return status;
+}
+
+static
+bool parse_artifact(const char *flag, unsigned *artifacts)
+{
+    static const char *const flags[] = { "-c", "-S", "--emit-llvm", "--emit-bc" };
+
+    for (size_t i = 0; i < BACKEND_ARTIFACTS; i++)
+        if (strcmp(flag, flags[i]) == 0)
+        {
+            *artifacts |= 1u << i;
+            return true;
+        }
+
+    return false;
+}
+
+static
+bool parse_level(const char *flag, backend_level_t *level)
+{
+    static const char *const flags[] = { "-O0", "-O1", "-O2", "-O3", "-Os", "-Oz" };
+    static const backend_level_t levels[] = { BACKEND_O0, BACKEND_O1, BACKEND_O2, BACKEND_O3, BACKEND_OS, BACKEND_OZ };
+
+    for (size_t i = 0; i < sizeof(flags) / sizeof(flags[0]); i++)
+        if (strcmp(flag, flags[i]) == 0)
+        {
+            *level = levels[i];
+            return true;
+        }
+
+    return false;
+}
+
+// Appends the whitespace separated arguments of a response file to arg_s.
+// They point into the file's contents, which are kept in buffer_s.
+static
+bool expand_response(const char *path, array_t(char*) *arg_s, array_t(char*) *buffer_s)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        perror(path);
+        return false;
+    }
+
+    array_t(char) content = array_empty();
+    int c;
+    while ((c = fgetc(file)) != EOF)
+    {
+        char ch = c;
+        content = array_add(content, ch);
+    }
+    char end = '\0';
+    content = array_add(content, end);
+    fclose(file);
+
+    *buffer_s = array_add(*buffer_s, content);
+
+    for (char *cursor = content; *cursor != '\0'; )
+    {
+        if (isspace((unsigned char)*cursor))
+        {
+            *cursor++ = '\0';
+            continue;
+        }
+
+        char *arg = cursor;
+        *arg_s = array_add(*arg_s, arg);
+        while (*cursor != '\0' && !isspace((unsigned char)*cursor))
+            cursor++;
+    }
+
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    backend_level_t level = BACKEND_O3;
+    const char *pipeline = NULL;
+    const char *output = NULL;
+    unsigned artifacts = 0;
+    backend_lto_t lto = BACKEND_LTO_NONE;
+    jit_mode_t mode = JIT_EAGER;
+    bool vm = false;
+    bool x64 = false;
+
+    int status = 1;
+    array_t(char*) arg_s = array_empty();
+    array_t(char*) buffer_s = array_empty();
+    array_t(const char*) filename_s = array_empty();
+    array_t(backend_output_t) output_s = array_empty();
+    array_t(const char*) export_s = array_empty();
+    const char *entry = "main";
+    export_s = array_add(export_s, entry);
+    backend_t backend = NULL;
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    bool jit = argc > 1 && strcmp(argv[1], "run") == 0;
+    for (int i = jit ? 2 : 1; i < argc; i++)
+    {
+        if (argv[i][0] == '@')
+        {
+            if (!expand_response(argv[i] + 1, &arg_s, &buffer_s))
+                goto leave;
+        }
+        else
+            arg_s = array_add(arg_s, argv[i]);
+    }
+
+    size_t args = array_size(arg_s);
+    for (size_t i = 0; i < args; i++)
+    {
+        const char *arg = arg_s[i];
+        if (parse_level(arg, &level) || parse_artifact(arg, &artifacts))
+            continue;
+        if (strcmp(arg, "-o") == 0 && i + 1 < args)
+        {
+            output = arg_s[++i];
+            continue;
+        }
+        if (strncmp(arg, "--passes=", 9) == 0)
+        {
+            pipeline = arg + 9;
+            continue;
+        }
+        if (strcmp(arg, "--lto") == 0 || strcmp(arg, "--lto=full") == 0 || strcmp(arg, "--lto=thin") == 0)
+        {
+            lto = strcmp(arg, "--lto=thin") == 0 ? BACKEND_LTO_THIN : BACKEND_LTO_FULL;
+            continue;
+        }
+        if (jit && (strcmp(arg, "--lazy") == 0 || strcmp(arg, "--tiered") == 0))
+        {
+            mode = strcmp(arg, "--lazy") == 0 ? JIT_LAZY : JIT_TIERED;
+            continue;
+        }
+        if (jit && strcmp(arg, "--vm") == 0)
+        {
+            vm = true;
+            continue;
+        }
+        if (!jit && (strcmp(arg, "--backend=x64") == 0 || strcmp(arg, "--backend=llvm") == 0))
+        {
+            x64 = strcmp(arg, "--backend=x64") == 0;
+            continue;
+        }
+        if (strncmp(arg, "--export=", 9) == 0)
+        {
+            const char *name = arg + 9;
+            export_s = array_add(export_s, name);
+            continue;
+        }
+        if (arg[0] == '-')
+        {
+            fprintf(stderr, "%s: unexpected argument '%s'\n", argv[0], arg);
+            usage(argv[0]);
+            goto leave;
+        }
+        filename_s = array_add(filename_s, arg);
+    }
+
+    size_t files = array_size(filename_s);
+    if (files == 0)
+    {
+        usage(argv[0]);
+        goto leave;
+    }
+
+    if (jit && (artifacts != 0 || output != NULL || lto != BACKEND_LTO_NONE || array_size(export_s) > 1))
+    {
+        fprintf(stderr, "%s: run takes no output, LTO or export options\n", argv[0]);
+        goto leave;
+    }
+
+    if (x64 && ((artifacts & ~(1u << BACKEND_OBJECT)) != 0 || pipeline != NULL || lto != BACKEND_LTO_NONE))
+    {
+        fprintf(stderr, "%s: the x64 backend writes objects only, with no passes or LTO\n", argv[0]);
+        goto leave;
+    }
+
+    if (artifacts == 0)
+        artifacts = 1u << BACKEND_OBJECT;
+
+    // full LTO leaves a single module, named after the first file
+    size_t modules = lto == BACKEND_LTO_FULL ? 1 : files;
+    if (output != NULL && (modules > 1 || (artifacts & (artifacts - 1)) != 0))
+    {
+        fprintf(stderr, "%s: cannot use -o with more than one output\n", argv[0]);
+        goto leave;
+    }
+
+    array_t(source_t) source_s = array_empty();
+    for (size_t i = 0; i < files; i++)
+    {
+        source_t source = source_load(filename_s[i]);
+        if (source == NULL)
+        {
+            array_cleanup_free(source_s, (release_t)source_free);
+            goto leave;
+        }
+        source_s = array_add(source_s, source);
+    }
+
+    thread_pool_t pool = thread_pool_new(0);
+    array_t(unit_t) unit_s = syntax_analysis_s(source_s, pool);
+    thread_pool_free(pool);
+    if (unit_s == NULL)
+        goto leave;
+
+    compilation_t compilation = semantic_analysis(unit_s);
     if (compilation == NULL)
-        return 1;
+        goto leave;
+
+    if (jit && vm)
+    {
+        status = interpret(compilation, elapsed_ms(&start));
+        goto leave;
+    }
+
+    if (jit)
+    {
+        status = run(compilation, mode, level, pipeline, elapsed_ms(&start));
+        goto leave;
+    }
 
     compilation_print(compilation, stdout);
 
-    backend_t backend = backend_codegen(compilation);
+    if (x64)
+    {
+        status = compile_x64(compilation, unit_s, output);
+        goto leave;
+    }
+
+    backend = backend_codegen(compilation, level);
+
+    static const char *const extensions[] = { ".o", ".s", ".ll", ".bc" };
+
+    if (!backend_lto(backend, lto, export_s, array_size(export_s)))
+        goto leave;
+
+    for (size_t unit = 0; unit < modules; unit++)
+        for (size_t i = 0; i < BACKEND_ARTIFACTS; i++)
+            if (artifacts & (1u << i))
+            {
+                source_t source = unit_source(unit_s[unit]);
+                const char *path = output != NULL ? output : source_output_name(source, extensions[i]);
+                backend_output_t out = { unit, i, path };
+                output_s = array_add(output_s, out);
+            }
+
+    if (backend_optimize(backend, pipeline) && backend_emit(backend, output_s, array_size(output_s)))
+        status = 0;
+
+leave:
+    if (output == NULL)
+        for (size_t i = 0; i < array_size(output_s); i++)
+            mem_free((char*)output_s[i].path);
+    array_free(output_s);
 
-    backend_optimize(backend);
-    backend_emit_object(backend);
-    backend_emit_assembly(backend);
-    backend_emit_llvm(backend);
+    if (backend != NULL)
+        backend_free(backend);
 
-    backend_free(backend);
+    array_free(export_s);
+    array_free(filename_s);
+    array_cleanup_free(buffer_s, (release_t)array_free);
+    array_free(arg_s);
 
-    return 0;
+    return status;
 }
 // LCOV_EXCL_STOP